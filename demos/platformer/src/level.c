@@ -112,7 +112,7 @@ level* level_load_file(char* filename) {
   l->tile_sets = malloc(sizeof(tile_set) * num_tile_types);
   l->tile_map = calloc(sizeof(int), MAX_WIDTH * MAX_HEIGHT);
   
-  SDL_RWops* file = SDL_RWFromFile(filename, "r");
+  SDL_RWops* file = SDL_RWFromFileBuffered(filename, "r");
   char line[MAX_WIDTH];
   
   int y = 0;
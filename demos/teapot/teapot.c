@@ -67,6 +67,7 @@ int main(int argc, char **argv) {
     shader_program_set_vec3(shader, "camera_direction", camera_direction(cam));
     
     renderable* r = asset_hndl_ptr(&teapot_object);
+    renderable_upload(r);
     
     for(int i=0; i < r->num_surfaces; i++) {
       
@@ -32,8 +32,20 @@ void SDL_PathParentDirectory(char* dst, const char* path);
 char* SDL_GetWorkingDir();
 int SDL_SetWorkingDir(char* dir);
 
+SDL_RWops* SDL_RWFromFileBuffered(const char* file, const char* mode);
+size_t SDL_RWBytesRead();
+
 void SDL_RWsize(SDL_RWops* file, int* size);
 int SDL_RWreadline(SDL_RWops* file, char* buffer, int buffersize);
+const void* SDL_RWreadinplace(SDL_RWops* file, int size);
+
+bool SDL_PackBuild(const char* folder, const char* filename);
+bool SDL_PackMount(const char* filename, const char* root);
+void SDL_PackUnmount(const char* filename);
+void SDL_PackUnmountAll();
+bool SDL_PackContains(const char* file);
+void SDL_PackListFolder(const char* folder, bool recursive, void (*func)(const char* file));
+SDL_RWops* SDL_RWFromPack(const char* file);
 
 bool SDL_WM_UseResourceIcon();
 void SDL_WM_DeleteResourceIcon();
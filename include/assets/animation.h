@@ -3,6 +3,11 @@
 ***  
 ***   Contains an array of frames and frame times.
 ***
+***   Load using .bani format for best performance.
+***   These store compressed keyframe tracks which
+***   are much smaller than the full frames of an
+***   .ani file and are sampled without decompressing.
+***
 **/
 
 #ifndef animation_h
@@ -10,23 +15,63 @@
 
 #include "skeleton.h"
 
+/*
+** A track holds the keys of one joint's position or
+** rotation. Keys are frame numbers with three 16 bit
+** values each. Positions are quantized over the range of
+** the track given by offset and scale. Rotations store
+** the smallest three components of the quaternion with
+** the index of the largest in their top bits.
+*/
+
+typedef struct {
+  int num_keys;
+  uint16_t* keys;
+  uint16_t* values;
+  vec3 offset;
+  vec3 scale;
+} animation_track;
+
 typedef struct {
   
   int frame_count;
   float frame_time;
   frame** frames;
+  
+  /* Compressed animations have tracks instead of frames */
+  int joint_count;
+  int* joint_parents;
+  animation_track* positions;
+  animation_track* rotations;
 
 } animation;
 
 animation* animation_new();
 void animation_delete(animation* a);
 float animation_duration(animation* a);
+size_t animation_size(animation* a);
 
 frame* animation_add_frame(animation* a, frame* base);
 frame* animation_frame(animation* a, int i);
 frame* animation_sample(animation* a, float time);
 void animation_sample_to(animation* a, float time, frame* out);
 
+/*
+** Replaces the frames with keyframe tracks. Keys which
+** interpolating their neighbours predicts to within the
+** error, in units for positions and radians for
+** rotations, are dropped. Errors are per joint so they
+** add up along a chain of joints.
+*/
+#define ANIMATION_POSITION_ERROR 0.001
+#define ANIMATION_ROTATION_ERROR 0.001
+
+void animation_compress(animation* a, float position_error, float rotation_error);
+bool animation_compressed(animation* a);
+
 animation* ani_load_file(char* filename);
+animation* bani_load_file(char* filename);
+void bani_save_file(animation* a, char* filename);
+bool ani_cook_file(char* filename, char* output, float position_error, float rotation_error);
 
-#endif
\ No newline at end of file
+#endif
@@ -12,7 +12,6 @@
 typedef struct {
   vec3 a, b, c;
   vec3 norm;
-  sphere bound;
 } ctri;
 
 ctri ctri_new(vec3 a, vec3 b, vec3 c, vec3 norm);
@@ -22,30 +21,48 @@ bool ctri_inside_plane(ctri t, plane p);
 bool ctri_outside_plane(ctri t, plane p);
 bool ctri_intersects_plane(ctri t, plane p);
 
-typedef struct cmesh {
-  
-  bool is_leaf;
-  
-  union {
-    struct {
-      plane division;
-      struct cmesh* front;
-      struct cmesh* back;
-    };
-    
-    struct {
-      ctri* triangles;
-      int triangles_num;
-      sphere bound;
-    };
-  };
-  
+/*
+** Collision meshes are a bounding volume hierarchy of
+** boxes built using the surface area heuristic. Nodes
+** are stored depth first so the first child of a node
+** comes straight after it and offset gives the second.
+** Leaves have a count and give the offset of their
+** triangles, which are sorted so each leaf's triangles
+** are next to each other.
+*/
+
+#define CMESH_MAX_DEPTH 64
+
+typedef struct {
+  vec3 minimums;
+  vec3 maximums;
+  uint32_t offset;
+  uint32_t count;
+} cmesh_node;
+
+typedef struct {
+  int nodes_num;
+  cmesh_node* nodes;
+  int triangles_num;
+  ctri* triangles;
+  sphere bound;
 } cmesh;
 
-cmesh* col_load_file(char* filename);
+/* Takes ownership of the triangles, which get reordered */
+cmesh* cmesh_new(ctri* triangles, int triangles_num);
 void cmesh_delete(cmesh* cm);
 
+cmesh* col_load_file(char* filename);
+
+/*
+** cmf files store an already built tree so that loading
+** is just reading it back in. Cooking converts a col
+** file to one without needing the asset manager.
+*/
+cmesh* cmf_load_file(char* filename);
+void cmf_save_file(cmesh* cm, char* filename);
+bool col_cook_file(char* filename, char* output);
+
 sphere cmesh_bound(cmesh* cm);
-void cmesh_subdivide(cmesh* cm, int iterations);
 
 #endif
\ No newline at end of file
@@ -24,6 +24,7 @@ typedef struct {
 } font;
 
 font* font_load_file(char* filename);
+int font_scan_file(char* filename, fpath* dependencies, int max);
 void font_delete(font* font);
 
 
@@ -54,6 +54,7 @@ material* material_new();
 void material_delete(material* m);
 
 material* mat_load_file(char* filename);
+int mat_scan_file(char* filename, fpath* dependencies, int max);
 
 material_entry* material_get_entry(material* m, int index);
 material_entry* material_add_entry(material* m);
@@ -5,6 +5,10 @@
 ***   can be rigged or not depending on file type
 ***
 ***   Load using .bmf format for best performance.
+***   Version 2 bmf files are several times smaller,
+***   use bmf_convert_file to convert from version 1.
+***   They can also store simplified versions of each
+***   surface to draw in its place at a distance.
 ***
 **/
 
@@ -19,27 +23,62 @@ typedef struct {
   float bone_weights[3];
 } vertex_weight;
 
+#define RENDERABLE_MAX_LODS 4
+
+typedef struct {
+  GLuint triangle_vbo;
+  int num_triangles;
+  float error;
+  uint32_t* triangle_data;
+} renderable_lod;
+
+/*
+** Geometry is built on the CPU in vertex_data and
+** triangle_data. Loaders upload it and free it unless the
+** renderable is set to keep it. Servers never upload so
+** never need GL, and anything built without uploading is
+** uploaded when the surface is first rendered.
+*/
+
 typedef struct {
   GLuint vertex_vbo;
   GLuint triangle_vbo;
   int num_verticies;
   int num_triangles;
   sphere bound;
+  int num_lods;
+  renderable_lod lods[RENDERABLE_MAX_LODS];
+  float* vertex_data;
+  uint32_t* triangle_data;
 } renderable_surface;
 
 renderable_surface* renderable_surface_new(mesh* m);
 renderable_surface* renderable_surface_new_rigged(mesh* m, vertex_weight* weights);
 void renderable_surface_delete(renderable_surface* surface);
 
+/*
+** Each level of detail is a simplified set of triangles
+** using the vertex buffer of the full surface. Its error
+** is how far it strays from the full surface, so a level
+** is picked by scaling that with the on screen size of
+** the surface bound. Level zero is the full surface.
+*/
+void renderable_surface_generate_lods(renderable_surface* s, mesh* m, int num_lods);
+renderable_lod renderable_surface_lod(renderable_surface* s, float radius_pixels, float max_error_pixels);
+
 typedef struct {
   renderable_surface** surfaces;
   int num_surfaces;
   bool is_rigged;
+  bool keep_geometry;
   asset_hndl material;
 } renderable;
 
 renderable* renderable_new();
 void renderable_delete(renderable* r);
+size_t renderable_size(renderable* r);
+
+void renderable_upload(renderable* r);
 
 void renderable_add_mesh(renderable* r, mesh* m);
 void renderable_add_model(renderable* r, model* m);
@@ -53,6 +92,34 @@ renderable* smd_load_file(char* filename);
 renderable* ply_load_file(char* filename);
 
 void bmf_save_file(renderable* r, char* filename);
+void bmf_convert_file(char* filename, char* output, int num_lods);
+
+/*
+** Parses an obj, smd or ply file and writes it straight
+** out as a version 2 bmf file using the given material
+** path. Uses neither GL nor the asset manager so can be
+** called from any thread.
+*/
+bool bmf_cook_file(char* filename, char* output, char* material, int num_lods);
+int bmf_scan_file(char* filename, fpath* dependencies, int max);
+
+/*
+** Split loaders for asynchronous loading. The read stage
+** is thread safe and decodes the geometry, the upload
+** stage must be on the main thread and does the GL work.
+*/
+typedef struct {
+  renderable* renderable;
+  fpath material;
+  SDL_RWops* file;
+  bool* in_place;
+} bmf_file;
+
+bmf_file* bmf_read_file(char* filename);
+renderable* bmf_upload_file(char* filename, bmf_file* f);
+
+model* obj_read_file(char* filename);
+renderable* obj_upload_file(char* filename, model* obj_model);
 
 
 #endif
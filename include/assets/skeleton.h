@@ -1,6 +1,7 @@
 /**
 *** :: Skeleton ::
 ***
+***   Load using .bskl format for best performance.
 ***
 **/
 
@@ -43,6 +44,13 @@ void skeleton_delete(skeleton* s);
 void skeleton_joint_add(skeleton* s, char* name, int parent);
 int skeleton_joint_id(skeleton* s, char* name);
 
+/*
+** bskl files store the joint names, parents and rest
+** pose in binary so loading needs no parsing.
+*/
 skeleton* skl_load_file(char* filename);
+skeleton* bskl_load_file(char* filename);
+void bskl_save_file(skeleton* s, char* filename);
+bool skl_cook_file(char* filename, char* output);
 
 #endif
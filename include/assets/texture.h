@@ -23,6 +23,9 @@ texture* texture_new();
 texture* texture_new_handle(GLuint h);
 void texture_delete(texture* t);
 
+/* Approximate GPU memory used by all levels */
+size_t texture_size(texture* t);
+
 GLuint texture_handle(texture* t);
 GLenum texture_type(texture* t);
 
@@ -40,6 +43,15 @@ texture* dds_load_file( char* filename );
 texture* lut_load_file( char* filename );
 texture* acv_load_file( char* filename );
 
+/*
+** Split loaders for asynchronous loading. The read stage
+** is thread safe, the upload stage needs the GL context.
+*/
+texture* texture_upload_image( char* filename, image* i );
+
+SDL_RWops* dds_read_file( char* filename );
+texture* dds_upload_file( char* filename, SDL_RWops* f );
+
 void texture_write_to_file(texture* t, char* filename);
 void texture3d_write_to_file(texture* t, char* filename);
 
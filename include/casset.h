@@ -11,6 +11,22 @@
 ***
 ***     asset_handler(renderable, "obj", obj_load_file, renderable_delete);
 ***
+***   Handlers can also be split into a read stage, which
+***   does file io and parsing, and an upload stage which
+***   does any GL work. Files loaded with 'file_load_async'
+***   are read on worker threads, but are only uploaded
+***   when 'asset_async_update' is called from the main
+***   loop, in the order they were queued.
+***
+***     asset_handler_async(texture, "dds", dds_read_file, dds_upload_file, texture_delete);
+***
+***   Folders can be packed into a single archive which
+***   is memory mapped when mounted. Files inside a mounted
+***   pack are found before any loose files on disk.
+***
+***     asset_pack_build(P("./assets_core"), P("./assets_core.pak"));
+***     asset_pack_mount(P("./assets_core.pak"), P("$CORANGE"));
+***
 ***   Please do not store raw pointers to assets.
 ***   Use an 'asset_hndl' value instead. It is a kind
 ***   of smart pointer which will not become invalidated
@@ -22,6 +38,7 @@
 #define casset_h
 
 #include "cengine.h"
+#include "data/list.h"
 
 typedef void asset;
 
@@ -30,7 +47,8 @@ typedef void asset;
 typedef struct {
   fpath path;
   asset* ptr;
-  uint32_t timestamp;
+  uint32_t id;
+  uint32_t generation;
 } asset_hndl;
 
 asset_hndl asset_hndl_null(void);
@@ -43,6 +61,10 @@ fpath asset_hndl_path(asset_hndl* ah);
 asset* asset_hndl_ptr(asset_hndl* ah);
 bool asset_hndl_eq(asset_hndl* ah0, asset_hndl* ah1);
 
+/* Acquired handles keep their asset resident under a memory budget */
+void asset_hndl_acquire(asset_hndl* ah);
+void asset_hndl_release(asset_hndl* ah);
+
 void asset_cache_flush(void);
 
 /* Init and Finish operations */
@@ -55,6 +77,13 @@ void asset_add_path_variable(fpath variable, fpath mapping);
 fpath asset_map_filename(fpath filename);
 fpath asset_unmap_filename(fpath filename);
 
+/* Relative filenames are cached as given. Call after changing the working directory. */
+void asset_path_cache_clear(void);
+
+/* Interned id of a mapped filename. Ids are stable until asset_finish. */
+uint32_t asset_path_id(fpath filename);
+char* asset_path_name(uint32_t id);
+
 /* Create handler for asset type. Requires type, file extension, and load/unload functions. */
 #define asset_handler(type, extension, loader, deleter) \
   asset_handler_cast(typeid(type), extension, \
@@ -66,6 +95,45 @@ void asset_handler_cast(
   asset* asset_loader(const char* filename) , 
   void asset_deleter(asset* asset) );
 
+/* Create handler split into a thread safe read stage and a main thread upload stage. */
+#define asset_handler_async(type, extension, reader, uploader, deleter) \
+  asset_handler_async_cast(typeid(type), extension, \
+  (void*(*)(const char*))reader , \
+  (asset*(*)(const char*,void*))uploader , \
+  (void(*)(asset*))deleter)
+
+void asset_handler_async_cast(
+  type_id type, const char* extension,
+  void* asset_reader(const char* filename),
+  asset* asset_uploader(const char* filename, void* data),
+  void asset_deleter(asset* asset) );
+
+/*
+** Register a function which cheaply finds the files an asset
+** will load, writing at most max paths and returning how many.
+** Declared dependencies are read in parallel ahead of the asset.
+*/
+#define asset_handler_scan(extension, scanner) \
+  asset_handler_scan_cast(extension, (int(*)(const char*,fpath*,int))scanner)
+
+void asset_handler_scan_cast(const char* extension, 
+  int asset_scanner(const char* filename, fpath* dependencies, int max));
+
+/* Register a function returning the memory used by assets of a type. */
+#define asset_handler_size(type, sizer) \
+  asset_handler_size_cast(typeid(type), (size_t(*)(asset*))sizer)
+
+void asset_handler_size_cast(type_id type, size_t asset_sizer(asset* asset));
+
+/*
+** Set a memory budget in bytes, 0 for no limit. Call
+** asset_budget_update once per frame to evict assets
+** which are not acquired, least recently used first.
+*/
+void asset_set_budget(size_t bytes);
+void asset_budget_update(void);
+size_t asset_resident_size(void);
+
 /* Load/Reload/Unload assets at path or folder */
 void file_load(fpath filename);
 void file_unload(fpath filename);
@@ -78,17 +146,70 @@ void folder_unload(fpath folder);
 void folder_reload(fpath folder);
 void folder_load_recursive(fpath folder);
 
+/* Build a pack from a folder, or mount one in place of the folder at root */
+void asset_pack_build(fpath folder, fpath pack);
+void asset_pack_mount(fpath pack, fpath root);
+void asset_pack_unmount(fpath pack);
+
+/* Queue assets to be loaded in the background. Folders are loaded recursively. */
+void file_load_async(fpath filename);
+void folder_load_async(fpath folder);
+
+/* Upload finished assets, spending at most budget milliseconds (at least one asset) */
+void asset_async_update(uint32_t budget);
+int asset_async_pending(void);
+void asset_async_wait(void);
+
 asset* asset_get_load(fpath path);
 asset* asset_get(fpath path);
 
 #define asset_get_as(path, type) ((type*)asset_get_as_type(path, typeid(type)))
 asset* asset_get_as_type(fpath path, type_id type);
 
+/*
+** Watch folders for changed files. Call asset_watch_update once
+** per frame to reload changed assets and any assets depending on
+** them. Returns the number of changed assets which were reloaded.
+*/
+void asset_watch(fpath folder);
+int asset_watch_update(void);
+uint32_t asset_watch_reload_latency(void);
+
 /* Reload all assets of a given type */
 #define asset_reload_type(type) asset_reload_type_id(typeid(type))
 void asset_reload_type_id(type_id type);
 void asset_reload_all(void);
 
+/* All declared dependencies of path, leaves first. Delete with list_delete_with(l, free). */
+list* asset_dependencies(fpath path);
+
+/*
+** Load profiling. Time and bytes read count only the work
+** of each asset itself, not of assets it loads. Histograms
+** bucket assets by their average load time, from under 1ms
+** up to over 256ms, with each bucket four times the last.
+*/
+enum {
+  ASSET_PROFILE_BUCKETS = 6
+};
+
+typedef struct {
+  const char* extension;
+  int count;
+  int loads;
+  double time;
+  size_t bytes_read;
+  size_t resident;
+  int histogram[ASSET_PROFILE_BUCKETS];
+} asset_profile;
+
+asset_profile asset_profile_handler(const char* extension);
+asset_profile asset_profile_total(void);
+void asset_profile_reset(void);
+
+/* Write a report to a .csv or .json file, most expensive first */
+void asset_profile_dump(fpath filename);
+
 /* Get path or typename of asset at ptr */
 char* asset_ptr_path(asset* a);
 char* asset_ptr_typename(asset* a);
@@ -65,14 +65,15 @@ void error_(const char*);
 void warning_(const char*);
 void debug_(const char*);
 
-char error_buf[2048];
-char error_str[2048];
+/* Thread local so messages from worker threads don't overwrite each other */
+extern __thread char error_buf[2048];
+extern __thread char error_str[2048];
 
-char warning_buf[2048];
-char warning_str[2048];
+extern __thread char warning_buf[2048];
+extern __thread char warning_str[2048];
 
-char debug_buf[2048];
-char debug_str[2048];
+extern __thread char debug_buf[2048];
+extern __thread char debug_str[2048];
 
 #define error(MSG, ...) { \
   sprintf(error_str, "[ERROR] (%s:%s:%i) ", __FILE__, __func__, __LINE__); \
@@ -180,6 +181,15 @@ float bismootherstep_interp(float tl, float tr, float bl, float br, float x_amou
 ** == Vector Maths ==
 */
 
+/*
+** Matrix and quaternion products and inverses use SSE
+** when the compiler targets it and scalar code otherwise.
+** Define CORANGE_NO_SIMD to always use the scalar code.
+*/
+#if defined(__SSE__) && !defined(CORANGE_NO_SIMD)
+#define CORANGE_SSE
+#endif
+
 /* vec2 */
 
 typedef struct {
@@ -623,6 +633,50 @@ bool sphere_inside_frustum(sphere s, frustum f);
 bool sphere_outside_frustum(sphere s, frustum f);
 bool sphere_intersects_frustum(sphere s, frustum f);
 
+/*
+** Batched versions work on whole arrays, four at a time
+** with SSE, giving the same results as the functions
+** above. Points are spaced stride bytes apart so they can
+** be transformed in place inside vertex data. Visibility
+** sets bit i%32 of visible[i/32] for every sphere which
+** is not outside any plane of the box.
+*/
+void mat4_mul_vec3_many(mat4 m, vec3* points, int count, int stride);
+void sphere_transform_many(sphere* s, int count, mat4 world);
+void sphere_visible_box_many(sphere* s, int count, box b, uint32_t* visible);
+
+/* Frustum Planes */
+
+/*
+** The six clipping planes of a view projection matrix,
+** stored as vec4 with xyz the inward unit normal and w
+** the offset, so a point is inside when dot(xyz, p) + w
+** is positive. Bit i of a mask is plane i.
+*/
+typedef struct {
+  vec4 planes[6];
+} frustum_planes;
+
+#define FRUSTUM_PLANES_ALL 0x3F
+#define FRUSTUM_PLANES_OUTSIDE -1
+
+frustum_planes frustum_planes_new(mat4 view_proj);
+frustum_planes frustum_planes_new_camera(mat4 view, mat4 proj);
+
+/*
+** Culling returns FRUSTUM_PLANES_OUTSIDE, or else the mask
+** of planes the bound still crosses. Zero means it is
+** fully inside. Only planes in mask are tested, so the
+** children of a bound can be given its result. If last is
+** not NULL the plane that rejected the bound the previous
+** time is tried first, and is updated on rejection.
+*/
+int frustum_planes_cull_sphere(frustum_planes f, sphere s, int mask, int* last);
+int frustum_planes_cull_aabb(frustum_planes f, vec3 minimums, vec3 maximums, int mask, int* last);
+
+bool sphere_outside_frustum_planes(sphere s, frustum_planes f);
+void sphere_visible_frustum_planes_many(sphere* s, int count, frustum_planes f, uint32_t* visible);
+
 bool sphere_outside_sphere(sphere s1, sphere s2); 
 bool sphere_inside_sphere(sphere s1, sphere s2); 
 bool sphere_intersects_sphere(sphere s1, sphere s2); 
@@ -724,6 +778,27 @@ void mesh_scale(mesh* m, float scale);
 
 sphere mesh_bounding_sphere(mesh* m);
 
+/*
+** Reorder triangles and verticies for the GPU. Vertex
+** cache and overdraw ordering only move triangles, vertex
+** fetch ordering renumbers verticies so anything indexed
+** by vertex alongside the mesh must not use it.
+*/
+void mesh_optimize(mesh* m);
+void mesh_optimize_vertex_cache(mesh* m);
+void mesh_optimize_overdraw(mesh* m, float threshold);
+void mesh_optimize_vertex_fetch(mesh* m);
+float mesh_acmr(mesh* m, int cache_size);
+
+/*
+** Removes triangles by edge collapse until target_triangles
+** remain or nothing more can be collapsed. Verticies are not
+** moved or removed so the old vertex buffer is still valid.
+** Returns the quadric error of the worst collapse as a
+** distance, roughly how far the surface moved.
+*/
+float mesh_simplify(mesh* m, int target_triangles);
+
 /* Model */
 
 typedef struct {
@@ -746,6 +821,8 @@ void model_transform(model* m, mat4 transform);
 void model_translate(model* m, vec3 translation);
 void model_scale(model* m, float scale);
 
+void model_optimize(model* m);
+
 /* Triangle */
 
 vec3 triangle_tangent(vertex v1, vertex v2, vertex v3);
@@ -7,6 +7,11 @@
 ***   Values are _not_ managed by dict
 ***   User must delete them themselves
 ***
+***   Open addressing with linear probing. Hashes
+***   are stored alongside keys so that most probes
+***   do not need a strcmp. The table doubles in
+***   size when it becomes more than 3/4 full.
+***
 **/
 
 #ifndef dict_h
@@ -14,29 +19,12 @@
 
 #include "cengine.h"
 
-/* Buckets (Linked List) */
-
-struct bucket {
-  char* key;
-  void* item;
-  struct bucket* next;
-};
-
-struct bucket* bucket_new(char* string, void* item);
-
-void bucket_map(struct bucket* b, void func(void*) );
-void bucket_filter_map(struct bucket* b, int  filter(void*) , void func(void*) );
-
-void bucket_delete_with(struct bucket* b, void func(void*) );
-void bucket_delete_recursive(struct bucket* b);
-
-void bucket_print(struct bucket* b);
-
-/* dict */
-
 typedef struct {
   int size;
-  struct bucket** buckets;
+  int num_items;
+  uint32_t* hashes;
+  char** keys;
+  void** items;
 } dict;
 
 dict* dict_new(int size);
@@ -1,30 +1,38 @@
 /**
-*** :: Vertex List ::
+*** :: Vertex Hashtable ::
 ***
 ***   Hashtable for verticies
 ***   used to check duplicates
 ***   in various asset loaders.
 ***
+***   Verticies are keyed on the bit patterns of
+***   their position, normal and uvs, so two keys
+***   match exactly when vertex_equal would. Open
+***   addressing with linear probing. The table
+***   doubles in size when more than 3/4 full.
+***
 **/
 
 #ifndef vertex_hashtable_h
 #define vertex_hashtable_h
 
 #include "cengine.h"
-#include "data/vertex_list.h"
-#include "data/int_list.h"
 
 typedef struct {
-  vertex_list* keys;
-  int_list* values;
-} vertex_bucket;
+  uint32_t data[8];
+} vertex_key;
 
 typedef struct {
-  vertex_bucket* items;
-  int table_size;
-} vertex_hashtable;
+  vertex_key key;
+  uint32_t hash;
+  int value;
+} vertex_entry;
 
-int vertex_hash(vertex_hashtable* ht, vertex v);
+typedef struct {
+  int size;
+  int num_items;
+  vertex_entry* entries;
+} vertex_hashtable;
 
 vertex_hashtable* vertex_hashtable_new(int size);
 void vertex_hashtable_delete(vertex_hashtable* ht);
@@ -32,4 +40,7 @@ void vertex_hashtable_delete(vertex_hashtable* ht);
 void vertex_hashtable_set(vertex_hashtable* ht, vertex key, int value);
 int vertex_hashtable_get(vertex_hashtable* ht, vertex key);
 
-#endif
\ No newline at end of file
+/* Returns the existing value for key, or sets it to value and returns -1 */
+int vertex_hashtable_get_or_set(vertex_hashtable* ht, vertex key, int value);
+
+#endif
@@ -203,11 +203,24 @@ typedef struct {
   float exposure_target;
   bool skydome_enabled;
   bool sea_enabled;
+  float lod_error;
   
   /* Objects */
   int render_objects_num;
   render_object* render_objects;
   
+  /* Culling */
+  int     cull_num;
+  sphere* cull_bounds;
+  uint32_t* cull_visible;
+  int     cull_slot;
+  int     cull_hints_num;
+  int*    cull_hints;
+  
+  /* Level of detail */
+  int     lod_num;
+  float*  lod_scales;
+  
   /* Preprocessed */
   
   mat4  camera_view;
@@ -216,13 +229,13 @@ typedef struct {
   mat4  camera_inv_proj;
   float camera_near;
   float camera_far;
-  box   camera_frustum;
+  frustum_planes camera_frustum;
   
   mat4  shadow_view[3];
   mat4  shadow_proj[3];
   float shadow_near[3];
   float shadow_far[3];
-  box   shadow_frustum[3];
+  frustum_planes shadow_frustum[3];
   
 } deferred_renderer;
 
@@ -235,6 +248,7 @@ void deferred_renderer_set_vignetting(deferred_renderer* dr, asset_hndl v);
 void deferred_renderer_set_glitch(deferred_renderer* dr, float glitch);
 void deferred_renderer_set_skydome_enabled(deferred_renderer* dr, bool enabled);
 void deferred_renderer_set_sea_enabled(deferred_renderer* dr, bool enabled);
+void deferred_renderer_set_lod_error(deferred_renderer* dr, float pixels);
 void deferred_renderer_set_tod(deferred_renderer* dr, float tod, int seed);
 
 void deferred_renderer_add(deferred_renderer* dr, render_object ro);
@@ -14,6 +14,9 @@
 
 #ifdef __unix__
   #include <execinfo.h>
+  #include <fcntl.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
 #define MAX_PATH 512
 #endif
 
@@ -26,7 +29,39 @@ void SDL_PathFullName(char* dst, const char* path) {
 #elif __unix__
 
 void SDL_PathFullName(char* dst, const char* path) {
-  char* ret = realpath(path, dst);
+  
+  if (realpath(path, dst) != NULL) { return; }
+  
+  /*
+  ** Path does not exist on disk (it may be inside a
+  ** mounted pack) so resolve it without the filesystem.
+  */
+  
+  char full[MAX_PATH];
+  if (path[0] == '/') {
+    strcpy(full, path);
+  } else {
+    char* discard = getcwd(full, MAX_PATH);
+    strcat(full, "/");
+    strcat(full, path);
+  }
+  
+  dst[0] = '\0';
+  char* state = NULL;
+  char* part = strtok_r(full, "/", &state);
+  while (part != NULL) {
+    if (strcmp(part, "..") == 0) {
+      char* last = strrchr(dst, '/');
+      if (last) { *last = '\0'; }
+    } else if ((strcmp(part, ".") != 0) && (strcmp(part, "") != 0)) {
+      strcat(dst, "/");
+      strcat(dst, part);
+    }
+    part = strtok_r(NULL, "/", &state);
+  }
+  
+  if (dst[0] == '\0') { strcpy(dst, "/"); }
+  
 }
 
 #endif
@@ -145,8 +180,178 @@ void SDL_RWsize(SDL_RWops* file, int* size) {
   SDL_RWseek(file, pos, SEEK_SET);
 }
 
+/*
+** Buffered files read the whole file into memory on open
+** and serve all reads from there. This avoids a virtual
+** read call per character when reading lines.
+*/
+
+enum {
+  SDL_RWOPS_BUFFERED = 0x42554652
+};
+
+typedef struct {
+  char* data;
+  int size;
+  int pos;
+  bool owned;
+} SDL_RWbuffer;
+
+static int SDL_RWbuffer_seek(SDL_RWops* context, int offset, int whence) {
+  
+  SDL_RWbuffer* b = context->hidden.unknown.data1;
+  
+  int pos = b->pos;
+  switch (whence) {
+    case SEEK_SET: pos = offset; break;
+    case SEEK_CUR: pos = b->pos + offset; break;
+    case SEEK_END: pos = b->size + offset; break;
+    default: return -1;
+  }
+  
+  if (pos < 0) { pos = 0; }
+  if (pos > b->size) { pos = b->size; }
+  
+  b->pos = pos;
+  return b->pos;
+}
+
+static int SDL_RWbuffer_read(SDL_RWops* context, void* ptr, int size, int maxnum) {
+  
+  SDL_RWbuffer* b = context->hidden.unknown.data1;
+  
+  if (size <= 0) { return 0; }
+  
+  int num = (b->size - b->pos) / size;
+  if (num > maxnum) { num = maxnum; }
+  
+  memcpy(ptr, b->data + b->pos, num * size);
+  b->pos += num * size;
+  
+  return num;
+}
+
+static int SDL_RWbuffer_write(SDL_RWops* context, const void* ptr, int size, int num) {
+  return -1;
+}
+
+static int SDL_RWbuffer_close(SDL_RWops* context) {
+  
+  SDL_RWbuffer* b = context->hidden.unknown.data1;
+  if (b->owned) { free(b->data); }
+  free(b);
+  SDL_FreeRW(context);
+  
+  return 0;
+}
+
+/* Counted per thread so each loader can measure its own reads */
+static __thread size_t SDL_RWbytes_read = 0;
+
+size_t SDL_RWBytesRead() {
+  return SDL_RWbytes_read;
+}
+
+static SDL_RWops* SDL_RWFromBuffer(SDL_RWbuffer* b) {
+  
+  SDL_RWops* rw = SDL_AllocRW();
+  if (rw == NULL) { return NULL; }
+  
+  rw->seek = SDL_RWbuffer_seek;
+  rw->read = SDL_RWbuffer_read;
+  rw->write = SDL_RWbuffer_write;
+  rw->close = SDL_RWbuffer_close;
+  rw->type = SDL_RWOPS_BUFFERED;
+  rw->hidden.unknown.data1 = b;
+  
+  return rw;
+}
+
+SDL_RWops* SDL_RWFromFileBuffered(const char* file, const char* mode) {
+  
+  if (strpbrk(mode, "wa+") == NULL) {
+    SDL_RWops* packed = SDL_RWFromPack(file);
+    if (packed != NULL) { return packed; }
+  }
+  
+  SDL_RWops* src = SDL_RWFromFile(file, mode);
+  if (src == NULL) { return NULL; }
+  
+  int size = 0;
+  SDL_RWsize(src, &size);
+  
+  SDL_RWbuffer* b = malloc(sizeof(SDL_RWbuffer));
+  b->data = malloc(size + 1);
+  b->size = SDL_RWread(src, b->data, 1, size);
+  b->pos = 0;
+  b->owned = true;
+  
+  SDL_RWbytes_read += b->size;
+  
+  SDL_RWclose(src);
+  
+  if (b->size < 0) { b->size = 0; }
+  b->data[b->size] = '\0';
+  
+  SDL_RWops* rw = SDL_RWFromBuffer(b);
+  if (rw == NULL) {
+    free(b->data);
+    free(b);
+    return NULL;
+  }
+  
+  return rw;
+}
+
+/*
+** Returns a pointer to the next size bytes of a buffered
+** or packed file and skips past them. Callers can use the
+** data in place instead of copying it out. The pointer is
+** valid until the file is closed and may be unaligned.
+*/
+
+const void* SDL_RWreadinplace(SDL_RWops* file, int size) {
+  
+  if (file->type != SDL_RWOPS_BUFFERED) { return NULL; }
+  
+  SDL_RWbuffer* b = file->hidden.unknown.data1;
+  if (size < 0 || b->size - b->pos < size) { return NULL; }
+  
+  const void* data = b->data + b->pos;
+  b->pos += size;
+  
+  return data;
+}
+
+static int SDL_RWbuffer_readline(SDL_RWbuffer* b, char* buffer, int buffersize) {
+  
+  int remaining = b->size - b->pos;
+  if (remaining == 0) { return 0; }
+  
+  char* start = b->data + b->pos;
+  char* end = memchr(start, '\n', remaining);
+  int len = end ? (end - start) + 1 : remaining;
+  
+  if (len > buffersize-1) {
+    memcpy(buffer, start, buffersize-1);
+    buffer[buffersize-1] = '\0';
+    b->pos += buffersize-1;
+    return -1;
+  }
+  
+  memcpy(buffer, start, len);
+  buffer[len] = '\0';
+  b->pos += len;
+  
+  return len;
+}
+
 int SDL_RWreadline(SDL_RWops* file, char* buffer, int buffersize) {
   
+  if (file->type == SDL_RWOPS_BUFFERED) {
+    return SDL_RWbuffer_readline(file->hidden.unknown.data1, buffer, buffersize);
+  }
+  
   char c;
   int status = 0;
   int i = 0;
@@ -176,6 +381,453 @@ int SDL_RWreadline(SDL_RWops* file, char* buffer, int buffersize) {
   
 }
 
+/*
+** Packs are single archive files containing many assets.
+**
+**   header   "CPAK", version, num entries, names size
+**   entries  name offset, data offset, data size, unused
+**   names    NUL terminated paths relative to the packed folder
+**   data     each file, aligned to SDL_PACK_ALIGN bytes
+**
+** Entries are sorted by name so lookups are a binary
+** search, and all files in a folder are contiguous. All
+** values are stored in the native (little endian) order.
+**
+** A mounted pack is mapped into memory and files inside
+** it are served by buffered RWops pointing directly into
+** the mapping, so nothing is copied until it is read.
+*/
+
+enum {
+  SDL_PACK_VERSION = 1,
+  SDL_PACK_ALIGN = 16,
+  SDL_MAX_PACKS = 32
+};
+
+typedef struct {
+  char magic[4];
+  Uint32 version;
+  Uint32 num_entries;
+  Uint32 names_size;
+} SDL_PackHeader;
+
+typedef struct {
+  Uint32 name;
+  Uint32 offset;
+  Uint32 size;
+  Uint32 unused;
+} SDL_PackEntry;
+
+typedef struct {
+  char filename[MAX_PATH];
+  char root[MAX_PATH];
+  char* data;
+  size_t size;
+  SDL_PackEntry* entries;
+  char* names;
+  int num_entries;
+} SDL_Pack;
+
+static SDL_Pack* packs[SDL_MAX_PACKS];
+static int num_packs = 0;
+
+static char* SDL_PackMap(const char* filename, size_t* size) {
+  
+#ifdef __unix__
+  
+  int fd = open(filename, O_RDONLY);
+  if (fd == -1) { return NULL; }
+  
+  struct stat st;
+  if (fstat(fd, &st) == -1 || st.st_size == 0) { close(fd); return NULL; }
+  
+  void* data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  
+  if (data == MAP_FAILED) { return NULL; }
+  
+  *size = st.st_size;
+  return data;
+  
+#else
+  
+  SDL_RWops* file = SDL_RWFromFile(filename, "rb");
+  if (file == NULL) { return NULL; }
+  
+  int length = 0;
+  SDL_RWsize(file, &length);
+  
+  char* data = malloc(length);
+  *size = SDL_RWread(file, data, 1, length);
+  SDL_RWclose(file);
+  
+  return data;
+  
+#endif
+
+}
+
+static void SDL_PackUnmap(char* data, size_t size) {
+#ifdef __unix__
+  munmap(data, size);
+#else
+  free(data);
+#endif
+}
+
+static bool SDL_PackValid(SDL_Pack* p) {
+  
+  if (p->size < sizeof(SDL_PackHeader)) { return false; }
+  
+  SDL_PackHeader* h = (SDL_PackHeader*)p->data;
+  if (memcmp(h->magic, "CPAK", 4) != 0) { return false; }
+  if (h->version != SDL_PACK_VERSION) { return false; }
+  
+  size_t index_size = sizeof(SDL_PackHeader) + h->num_entries * sizeof(SDL_PackEntry);
+  if (index_size + h->names_size > p->size) { return false; }
+  if (h->names_size > 0 && p->data[index_size + h->names_size - 1] != '\0') { return false; }
+  
+  p->entries = (SDL_PackEntry*)(p->data + sizeof(SDL_PackHeader));
+  p->names = p->data + index_size;
+  p->num_entries = h->num_entries;
+  
+  for (int i = 0; i < p->num_entries; i++) {
+    SDL_PackEntry* e = &p->entries[i];
+    if (e->name >= h->names_size) { return false; }
+    if ((size_t)e->offset + e->size > p->size) { return false; }
+  }
+  
+  return true;
+}
+
+bool SDL_PackMount(const char* filename, const char* root) {
+  
+  if (num_packs == SDL_MAX_PACKS) { return false; }
+  
+  SDL_Pack* p = malloc(sizeof(SDL_Pack));
+  strcpy(p->filename, filename);
+  SDL_PathFullName(p->root, root);
+  
+  size_t len = strlen(p->root);
+  if (len > 1 && p->root[len-1] == '/') { p->root[len-1] = '\0'; }
+  
+  p->data = SDL_PackMap(filename, &p->size);
+  if (p->data == NULL) { free(p); return false; }
+  
+  if (!SDL_PackValid(p)) {
+    SDL_PackUnmap(p->data, p->size);
+    free(p);
+    return false;
+  }
+  
+  packs[num_packs] = p;
+  num_packs++;
+  
+  return true;
+}
+
+void SDL_PackUnmount(const char* filename) {
+  
+  for (int i = 0; i < num_packs; i++) {
+    if (strcmp(packs[i]->filename, filename) == 0) {
+      SDL_PackUnmap(packs[i]->data, packs[i]->size);
+      free(packs[i]);
+      memmove(&packs[i], &packs[i+1], sizeof(SDL_Pack*) * (num_packs - i - 1));
+      num_packs--;
+      return;
+    }
+  }
+  
+}
+
+void SDL_PackUnmountAll() {
+  while (num_packs > 0) {
+    SDL_PackUnmount(packs[num_packs-1]->filename);
+  }
+}
+
+/* Returns the path of file relative to the pack root or NULL */
+static const char* SDL_PackRelative(SDL_Pack* p, const char* file) {
+  
+  size_t len = strlen(p->root);
+  if (strncmp(file, p->root, len) != 0) { return NULL; }
+  if (file[len] == '\0') { return file + len; }
+  if (file[len] != '/') { return NULL; }
+  
+  return file + len + 1;
+}
+
+/* Index of first entry not less than name */
+static int SDL_PackLowerBound(SDL_Pack* p, const char* name) {
+  
+  int lo = 0, hi = p->num_entries;
+  while (lo < hi) {
+    int mid = (lo + hi) / 2;
+    if (strcmp(p->names + p->entries[mid].name, name) < 0) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  
+  return lo;
+}
+
+static SDL_PackEntry* SDL_PackFind(const char* file, SDL_Pack** pack) {
+  
+  /* Most recently mounted packs take priority */
+  for (int i = num_packs-1; i >= 0; i--) {
+    
+    const char* name = SDL_PackRelative(packs[i], file);
+    if (name == NULL) { continue; }
+    
+    int j = SDL_PackLowerBound(packs[i], name);
+    if (j < packs[i]->num_entries &&
+        strcmp(packs[i]->names + packs[i]->entries[j].name, name) == 0) {
+      *pack = packs[i];
+      return &packs[i]->entries[j];
+    }
+  }
+  
+  return NULL;
+}
+
+/* Skip resolving paths that are already absolute and clean */
+static const char* SDL_PackPath(char* full, const char* file) {
+  
+  if (file[0] == '/' && strstr(file, "//") == NULL && strstr(file, "/.") == NULL) {
+    return file;
+  }
+  
+  SDL_PathFullName(full, file);
+  return full;
+}
+
+bool SDL_PackContains(const char* file) {
+  
+  if (num_packs == 0) { return false; }
+  
+  char full[MAX_PATH];
+  
+  SDL_Pack* p;
+  return SDL_PackFind(SDL_PackPath(full, file), &p) != NULL;
+}
+
+SDL_RWops* SDL_RWFromPack(const char* file) {
+  
+  if (num_packs == 0) { return NULL; }
+  
+  char full[MAX_PATH];
+  
+  SDL_Pack* p;
+  SDL_PackEntry* e = SDL_PackFind(SDL_PackPath(full, file), &p);
+  if (e == NULL) { return NULL; }
+  
+  SDL_RWbuffer* b = malloc(sizeof(SDL_RWbuffer));
+  b->data = p->data + e->offset;
+  b->size = e->size;
+  b->pos = 0;
+  b->owned = false;
+  
+  SDL_RWbytes_read += b->size;
+  
+  SDL_RWops* rw = SDL_RWFromBuffer(b);
+  if (rw == NULL) { free(b); }
+  
+  return rw;
+}
+
+void SDL_PackListFolder(const char* folder, bool recursive, void (*func)(const char* file)) {
+  
+  char full[MAX_PATH];
+  SDL_PathFullName(full, folder);
+  
+  size_t len = strlen(full);
+  if (len > 1 && full[len-1] == '/') { full[len-1] = '\0'; }
+  
+  for (int i = num_packs-1; i >= 0; i--) {
+    
+    SDL_Pack* p = packs[i];
+    
+    /* Folder must be the pack root or inside it */
+    const char* rel = SDL_PackRelative(p, full);
+    if (rel == NULL) { continue; }
+    
+    char prefix[MAX_PATH];
+    strcpy(prefix, rel);
+    if (prefix[0] != '\0') { strcat(prefix, "/"); }
+    
+    size_t prefix_len = strlen(prefix);
+    
+    for (int j = SDL_PackLowerBound(p, prefix); j < p->num_entries; j++) {
+      
+      const char* name = p->names + p->entries[j].name;
+      if (strncmp(name, prefix, prefix_len) != 0) { break; }
+      if (!recursive && strchr(name + prefix_len, '/') != NULL) { continue; }
+      
+      char file[MAX_PATH];
+      strcpy(file, p->root);
+      strcat(file, "/");
+      strcat(file, name);
+      func(file);
+    }
+  }
+  
+}
+
+typedef struct {
+  char** names;
+  int num_names;
+} SDL_PackFiles;
+
+static void SDL_PackCollect(SDL_PackFiles* files, const char* base, const char* rel) {
+  
+  char path[MAX_PATH];
+  strcpy(path, base);
+  if (rel[0] != '\0') {
+    strcat(path, "/");
+    strcat(path, rel);
+  }
+  
+  DIR* dir = opendir(path);
+  if (dir == NULL) { return; }
+  
+  struct dirent* ent;
+  while ((ent = readdir(dir)) != NULL) {
+    
+    if ((strcmp(ent->d_name, ".") == 0) || 
+        (strcmp(ent->d_name, "..") == 0)) { continue; }
+    
+    char name[MAX_PATH];
+    strcpy(name, rel);
+    if (rel[0] != '\0') { strcat(name, "/"); }
+    strcat(name, ent->d_name);
+    
+    char child[MAX_PATH];
+    strcpy(child, base);
+    strcat(child, "/");
+    strcat(child, name);
+    
+    if (SDL_PathIsDirectory(child)) {
+      SDL_PackCollect(files, base, name);
+    } else {
+      files->num_names++;
+      files->names = realloc(files->names, sizeof(char*) * files->num_names);
+      files->names[files->num_names-1] = malloc(strlen(name) + 1);
+      strcpy(files->names[files->num_names-1], name);
+    }
+  }
+  
+  closedir(dir);
+}
+
+static int SDL_PackCompare(const void* a, const void* b) {
+  return strcmp(*(char**)a, *(char**)b);
+}
+
+static Uint32 SDL_PackAligned(Uint32 offset) {
+  return (offset + SDL_PACK_ALIGN - 1) & ~(SDL_PACK_ALIGN - 1);
+}
+
+bool SDL_PackBuild(const char* folder, const char* filename) {
+  
+  SDL_PackFiles files = { NULL, 0 };
+  
+  char base[MAX_PATH];
+  strcpy(base, folder);
+  size_t len = strlen(base);
+  if (len > 1 && base[len-1] == '/') { base[len-1] = '\0'; }
+  
+  SDL_PackCollect(&files, base, "");
+  qsort(files.names, files.num_names, sizeof(char*), SDL_PackCompare);
+  
+  SDL_PackHeader header;
+  memcpy(header.magic, "CPAK", 4);
+  header.version = SDL_PACK_VERSION;
+  header.num_entries = files.num_names;
+  header.names_size = 0;
+  
+  SDL_PackEntry* entries = malloc(sizeof(SDL_PackEntry) * files.num_names);
+  
+  for (int i = 0; i < files.num_names; i++) {
+    entries[i].name = header.names_size;
+    header.names_size += strlen(files.names[i]) + 1;
+  }
+  
+  Uint32 offset = sizeof(SDL_PackHeader) + sizeof(SDL_PackEntry) * files.num_names + header.names_size;
+  
+  for (int i = 0; i < files.num_names; i++) {
+    
+    char path[MAX_PATH];
+    sprintf(path, "%s/%s", base, files.names[i]);
+    
+    SDL_RWops* f = SDL_RWFromFile(path, "rb");
+    int size = 0;
+    if (f) { SDL_RWsize(f, &size); SDL_RWclose(f); }
+    
+    offset = SDL_PackAligned(offset);
+    entries[i].offset = offset;
+    entries[i].size = size;
+    entries[i].unused = 0;
+    offset += size;
+  }
+  
+  bool success = true;
+  
+  SDL_RWops* out = SDL_RWFromFile(filename, "wb");
+  if (out == NULL) {
+    success = false;
+    goto cleanup;
+  }
+  
+  SDL_RWwrite(out, &header, sizeof(SDL_PackHeader), 1);
+  SDL_RWwrite(out, entries, sizeof(SDL_PackEntry), files.num_names);
+  for (int i = 0; i < files.num_names; i++) {
+    SDL_RWwrite(out, files.names[i], strlen(files.names[i]) + 1, 1);
+  }
+  
+  Uint32 written = sizeof(SDL_PackHeader) + sizeof(SDL_PackEntry) * files.num_names + header.names_size;
+  
+  for (int i = 0; i < files.num_names; i++) {
+    
+    static const char padding[SDL_PACK_ALIGN] = {0};
+    SDL_RWwrite(out, padding, entries[i].offset - written, 1);
+    written = entries[i].offset;
+    
+    if (entries[i].size == 0) { continue; }
+    
+    char path[MAX_PATH];
+    sprintf(path, "%s/%s", base, files.names[i]);
+    
+    /* Read loose file directly, it may also be in a mounted pack */
+    SDL_RWops* f = SDL_RWFromFile(path, "rb");
+    if (f == NULL) {
+      success = false;
+      break;
+    }
+    
+    char* data = malloc(entries[i].size);
+    if (SDL_RWread(f, data, entries[i].size, 1) != 1) { success = false; }
+    SDL_RWwrite(out, data, entries[i].size, 1);
+    SDL_RWclose(f);
+    free(data);
+    
+    written += entries[i].size;
+  }
+  
+  SDL_RWclose(out);
+  
+cleanup:
+  
+  for (int i = 0; i < files.num_names; i++) {
+    free(files.names[i]);
+  }
+  free(files.names);
+  free(entries);
+  
+  return success;
+}
+
 #ifdef _WIN32
 
 static HICON icon;
@@ -8,21 +8,75 @@ animation* animation_new() {
   a->frame_time = 1.0/30.0;
   a->frames = NULL;
   
+  a->joint_count = 0;
+  a->joint_parents = NULL;
+  a->positions = NULL;
+  a->rotations = NULL;
+  
   return a;
 }
 
+static void animation_tracks_delete(animation* a) {
+  
+  for(int i = 0; i < a->joint_count; i++) {
+    free(a->positions[i].keys);
+    free(a->positions[i].values);
+    free(a->rotations[i].keys);
+    free(a->rotations[i].values);
+  }
+  
+  free(a->joint_parents);
+  free(a->positions);
+  free(a->rotations);
+}
+
 void animation_delete(animation* a) {
   
-  for(int i = 0; i < a->frame_count; i++) {
-    frame_delete(a->frames[i]);
+  if (animation_compressed(a)) {
+    animation_tracks_delete(a);
+  } else {
+    for(int i = 0; i < a->frame_count; i++) {
+      frame_delete(a->frames[i]);
+    }
   }
   
   free(a->frames);
   free(a);
 }
 
+bool animation_compressed(animation* a) {
+  return a->positions != NULL;
+}
+
+size_t animation_size(animation* a) {
+  
+  size_t size = sizeof(animation);
+  
+  if (animation_compressed(a)) {
+    size += (sizeof(int) + 2 * sizeof(animation_track)) * a->joint_count;
+    for(int i = 0; i < a->joint_count; i++) {
+      size += sizeof(uint16_t) * 4 * a->positions[i].num_keys;
+      size += sizeof(uint16_t) * 4 * a->rotations[i].num_keys;
+    }
+  } else {
+    size += sizeof(frame*) * a->frame_count;
+    for(int i = 0; i < a->frame_count; i++) {
+      frame* f = a->frames[i];
+      size += sizeof(frame);
+      size += (sizeof(int) + sizeof(vec3) + sizeof(quat) + 2 * sizeof(mat4)) * f->joint_count;
+    }
+  }
+  
+  return size;
+}
+
 frame* animation_add_frame(animation* a, frame* base) {
   
+  if (animation_compressed(a)) {
+    error("Cannot add frames to a compressed animation");
+    return NULL;
+  }
+  
   frame* f = frame_copy(base);
   
   a->frame_count++;
@@ -44,18 +98,150 @@ frame* animation_sample(animation* a, float time) {
     return NULL;
   }
   
-  frame* f = frame_copy(a->frames[0]);
+  frame* f;
+  if (animation_compressed(a)) {
+    f = frame_new();
+    for(int i = 0; i < a->joint_count; i++) {
+      frame_joint_add(f, a->joint_parents[i], vec3_zero(), quat_id());
+    }
+  } else {
+    f = frame_copy(a->frames[0]);
+  }
+  
   animation_sample_to(a, time, f);
   return f;
   
 }
 
 frame* animation_frame(animation* a, int i) {
+  
+  if (animation_compressed(a)) {
+    error("Compressed animations have no frames, use animation_sample");
+    return NULL;
+  }
+  
   i = i < 0 ? 0 : i;
   i = i > (a->frame_count-1) ? (a->frame_count-1) : i;
   return a->frames[i];
 }
 
+/*
+** Quantization of track values. Rotations are made
+** positive in their largest component so that it can be
+** rebuilt from the other three, which then all lie
+** within plus or minus one over root two.
+*/
+
+#define ANIMATION_QUAT_RANGE 0.70710678f
+#define ANIMATION_QUAT_STEPS 32767.0f
+
+static uint16_t animation_quantize(float x, float offset, float scale, float steps) {
+  if (scale == 0) { return 0; }
+  return (uint16_t)clamp(roundf((x - offset) / scale), 0, steps);
+}
+
+static void animation_position_encode(animation_track* t, vec3 p, uint16_t* out) {
+  out[0] = animation_quantize(p.x, t->offset.x, t->scale.x, 65535.0f);
+  out[1] = animation_quantize(p.y, t->offset.y, t->scale.y, 65535.0f);
+  out[2] = animation_quantize(p.z, t->offset.z, t->scale.z, 65535.0f);
+}
+
+static vec3 animation_position_decode(animation_track* t, uint16_t* in) {
+  return vec3_new(
+    t->offset.x + in[0] * t->scale.x,
+    t->offset.y + in[1] * t->scale.y,
+    t->offset.z + in[2] * t->scale.z);
+}
+
+static void animation_rotation_encode(quat q, uint16_t* out) {
+  
+  float c[4] = {q.x, q.y, q.z, q.w};
+  
+  int largest = 0;
+  for(int i = 1; i < 4; i++) {
+    if (fabs(c[i]) > fabs(c[largest])) { largest = i; }
+  }
+  
+  float sign = c[largest] < 0 ? -1 : 1;
+  float step = (2 * ANIMATION_QUAT_RANGE) / ANIMATION_QUAT_STEPS;
+  
+  int j = 0;
+  for(int i = 0; i < 4; i++) {
+    if (i == largest) { continue; }
+    out[j++] = animation_quantize(sign * c[i], -ANIMATION_QUAT_RANGE, step, ANIMATION_QUAT_STEPS);
+  }
+  
+  out[0] |= (largest & 1) << 15;
+  out[1] |= (largest >> 1) << 15;
+}
+
+static quat animation_rotation_decode(uint16_t* in) {
+  
+  int largest = (in[0] >> 15) | ((in[1] >> 15) << 1);
+  float step = (2 * ANIMATION_QUAT_RANGE) / ANIMATION_QUAT_STEPS;
+  
+  float c[4];
+  float sum = 0;
+  int j = 0;
+  for(int i = 0; i < 4; i++) {
+    if (i == largest) { continue; }
+    c[i] = -ANIMATION_QUAT_RANGE + (in[j++] & 0x7FFF) * step;
+    sum += c[i] * c[i];
+  }
+  c[largest] = sqrtf(max(1 - sum, 0));
+  
+  return quat_new(c[0], c[1], c[2], c[3]);
+}
+
+/* Index of the last key at or before frame f */
+static int animation_track_find(animation_track* t, float f) {
+  
+  int lo = 0;
+  int hi = t->num_keys - 1;
+  
+  while (hi - lo > 1) {
+    int mid = (lo + hi) / 2;
+    if (t->keys[mid] <= f) { lo = mid; } else { hi = mid; }
+  }
+  
+  return lo;
+}
+
+static float animation_track_amount(animation_track* t, int k, float f) {
+  return (f - t->keys[k]) / (t->keys[k+1] - t->keys[k]);
+}
+
+static void animation_sample_tracks(animation* a, float f, frame* out) {
+  
+  for(int i = 0; i < a->joint_count; i++) {
+    
+    animation_track* p = &a->positions[i];
+    animation_track* r = &a->rotations[i];
+    
+    if (p->num_keys == 1) {
+      out->joint_positions[i] = animation_position_decode(p, p->values);
+    } else {
+      int k = animation_track_find(p, f);
+      out->joint_positions[i] = vec3_lerp(
+        animation_position_decode(p, p->values + (k+0) * 3),
+        animation_position_decode(p, p->values + (k+1) * 3),
+        animation_track_amount(p, k, f));
+    }
+    
+    if (r->num_keys == 1) {
+      out->joint_rotations[i] = animation_rotation_decode(r->values);
+    } else {
+      int k = animation_track_find(r, f);
+      out->joint_rotations[i] = quat_slerp(
+        animation_rotation_decode(r->values + (k+0) * 3),
+        animation_rotation_decode(r->values + (k+1) * 3),
+        animation_track_amount(r, k, f));
+    }
+    
+  }
+  
+}
+
 void animation_sample_to(animation* a, float time, frame* out) {
   
   if (a->frame_count == 0) {
@@ -63,6 +249,16 @@ void animation_sample_to(animation* a, float time, frame* out) {
     return;
   }
   
+  if (animation_compressed(a)) {
+    float f = 0;
+    if (a->frame_count > 1) {
+      time = fmod(time, a->frame_time * (a->frame_count-1));
+      f = clamp(time / a->frame_time, 0, a->frame_count-1);
+    }
+    animation_sample_tracks(a, f, out);
+    return;
+  }
+  
   if (a->frame_count == 1) {
     frame_copy_to(a->frames[0], out);
     return;
@@ -78,6 +274,163 @@ void animation_sample_to(animation* a, float time, frame* out) {
 
 }
 
+/*
+** Keys are chosen greedily. Each segment is extended one
+** frame at a time for as long as interpolating between
+** its decoded end points stays within the error of every
+** original frame it covers. Segments are capped in length
+** to bound the cost of checking them.
+*/
+
+#define ANIMATION_MAX_SEGMENT 256
+
+static bool animation_positions_fit(vec3* orig, vec3* decoded, int start, int end, float error) {
+  for(int i = start+1; i < end; i++) {
+    float amount = (float)(i - start) / (end - start);
+    vec3 p = vec3_lerp(decoded[start], decoded[end], amount);
+    if (vec3_dist(p, orig[i]) > error) { return false; }
+  }
+  return true;
+}
+
+/*
+** Rotations are compared by the distance between unit
+** quaternions, which is 2 sin(angle / 4). Using the dot
+** product instead runs out of float precision for angles
+** of around a thousandth of a radian.
+*/
+
+static bool animation_rotations_fit(quat* orig, quat* decoded, int start, int end, float error) {
+  float threshold = 2 * sinf(error / 4);
+  for(int i = start+1; i < end; i++) {
+    float amount = (float)(i - start) / (end - start);
+    quat q = quat_normalize(quat_slerp(decoded[start], decoded[end], amount));
+    if (quat_dot(q, orig[i]) < 0) { q = quat_neg(q); }
+    if (vec4_length(vec4_sub(q, orig[i])) > threshold) { return false; }
+  }
+  return true;
+}
+
+static void animation_track_compress(animation_track* t, int count, vec3* positions, quat* rotations, float error) {
+  
+  uint16_t* values = malloc(sizeof(uint16_t) * 3 * count);
+  vec3* decoded_positions = NULL;
+  quat* decoded_rotations = NULL;
+  
+  if (positions) {
+    
+    vec3 lower = positions[0];
+    vec3 upper = positions[0];
+    for(int i = 1; i < count; i++) {
+      lower = vec3_new(
+        min(lower.x, positions[i].x),
+        min(lower.y, positions[i].y),
+        min(lower.z, positions[i].z));
+      upper = vec3_new(
+        max(upper.x, positions[i].x),
+        max(upper.y, positions[i].y),
+        max(upper.z, positions[i].z));
+    }
+    
+    t->offset = lower;
+    t->scale = vec3_div(vec3_sub(upper, lower), 65535.0f);
+    
+    decoded_positions = malloc(sizeof(vec3) * count);
+    for(int i = 0; i < count; i++) {
+      animation_position_encode(t, positions[i], values + i * 3);
+      decoded_positions[i] = animation_position_decode(t, values + i * 3);
+    }
+    
+  } else {
+    
+    t->offset = vec3_zero();
+    t->scale = vec3_zero();
+    
+    decoded_rotations = malloc(sizeof(quat) * count);
+    for(int i = 0; i < count; i++) {
+      animation_rotation_encode(rotations[i], values + i * 3);
+      decoded_rotations[i] = animation_rotation_decode(values + i * 3);
+    }
+  }
+  
+  bool* keep = calloc(count, sizeof(bool));
+  keep[0] = true;
+  keep[count-1] = true;
+  
+  int start = 0;
+  for(int end = 2; end < count; end++) {
+    bool fits = (end - start) <= ANIMATION_MAX_SEGMENT && (positions
+      ? animation_positions_fit(positions, decoded_positions, start, end, error)
+      : animation_rotations_fit(rotations, decoded_rotations, start, end, error));
+    if (!fits) {
+      keep[end-1] = true;
+      start = end-1;
+    }
+  }
+  
+  t->num_keys = 0;
+  for(int i = 0; i < count; i++) {
+    if (keep[i]) { t->num_keys++; }
+  }
+  
+  t->keys = malloc(sizeof(uint16_t) * t->num_keys);
+  t->values = malloc(sizeof(uint16_t) * 3 * t->num_keys);
+  
+  int k = 0;
+  for(int i = 0; i < count; i++) {
+    if (!keep[i]) { continue; }
+    t->keys[k] = i;
+    memcpy(t->values + k * 3, values + i * 3, sizeof(uint16_t) * 3);
+    k++;
+  }
+  
+  free(keep);
+  free(values);
+  free(decoded_positions);
+  free(decoded_rotations);
+  
+}
+
+void animation_compress(animation* a, float position_error, float rotation_error) {
+  
+  if (animation_compressed(a) || a->frame_count == 0) { return; }
+  
+  if (a->frame_count > 65536) {
+    error("Cannot compress animation with %i frames, maximum is 65536", a->frame_count);
+    return;
+  }
+  
+  a->joint_count = a->frames[0]->joint_count;
+  a->joint_parents = malloc(sizeof(int) * a->joint_count);
+  a->positions = malloc(sizeof(animation_track) * a->joint_count);
+  a->rotations = malloc(sizeof(animation_track) * a->joint_count);
+  memcpy(a->joint_parents, a->frames[0]->joint_parents, sizeof(int) * a->joint_count);
+  
+  vec3* positions = malloc(sizeof(vec3) * a->frame_count);
+  quat* rotations = malloc(sizeof(quat) * a->frame_count);
+  
+  for(int i = 0; i < a->joint_count; i++) {
+    
+    for(int j = 0; j < a->frame_count; j++) {
+      positions[j] = a->frames[j]->joint_positions[i];
+      rotations[j] = quat_normalize(a->frames[j]->joint_rotations[i]);
+    }
+    
+    animation_track_compress(&a->positions[i], a->frame_count, positions, NULL, position_error);
+    animation_track_compress(&a->rotations[i], a->frame_count, NULL, rotations, rotation_error);
+  }
+  
+  free(positions);
+  free(rotations);
+  
+  for(int i = 0; i < a->frame_count; i++) {
+    frame_delete(a->frames[i]);
+  }
+  free(a->frames);
+  a->frames = NULL;
+  
+}
+
 enum {
   STATE_LOAD_EMPTY    = 0,
   STATE_LOAD_SKELETON = 1,
@@ -92,7 +445,7 @@ animation* ani_load_file(char* filename) {
   skeleton* base = skeleton_new();
   frame* f = NULL;
   
-  SDL_RWops* file = SDL_RWFromFile(filename, "r");
+  SDL_RWops* file = SDL_RWFromFileBuffered(filename, "r");
   
   if(file == NULL) {
     error("Could not load file %s", filename);
@@ -171,3 +524,158 @@ animation* ani_load_file(char* filename) {
   
   return a;
 }
+
+static void bani_write_track(SDL_RWops* file, animation_track* t) {
+  uint32_t num_keys = t->num_keys;
+  SDL_RWwrite(file, &num_keys, sizeof(uint32_t), 1);
+  SDL_RWwrite(file, &t->offset, sizeof(vec3), 1);
+  SDL_RWwrite(file, &t->scale, sizeof(vec3), 1);
+  SDL_RWwrite(file, t->keys, sizeof(uint16_t), num_keys);
+  SDL_RWwrite(file, t->values, sizeof(uint16_t) * 3, num_keys);
+}
+
+static bool bani_read_track(SDL_RWops* file, animation_track* t, int frame_count) {
+  
+  uint32_t num_keys = 0;
+  SDL_RWread(file, &num_keys, sizeof(uint32_t), 1);
+  SDL_RWread(file, &t->offset, sizeof(vec3), 1);
+  SDL_RWread(file, &t->scale, sizeof(vec3), 1);
+  
+  if (num_keys == 0 || num_keys > frame_count) {
+    t->num_keys = 0;
+    t->keys = NULL;
+    t->values = NULL;
+    return false;
+  }
+  
+  t->num_keys = num_keys;
+  t->keys = malloc(sizeof(uint16_t) * num_keys);
+  t->values = malloc(sizeof(uint16_t) * 3 * num_keys);
+  SDL_RWread(file, t->keys, sizeof(uint16_t), num_keys);
+  SDL_RWread(file, t->values, sizeof(uint16_t) * 3, num_keys);
+  
+  /* Sampling relies on keys covering every frame in order */
+  if (t->keys[0] != 0 || t->keys[num_keys-1] != frame_count-1) { return false; }
+  for(int i = 1; i < num_keys; i++) {
+    if (t->keys[i] <= t->keys[i-1]) { return false; }
+  }
+  
+  return true;
+}
+
+animation* bani_load_file(char* filename) {
+  
+  SDL_RWops* file = SDL_RWFromFileBuffered(filename, "rb");
+  
+  if (file == NULL) {
+    error("Could not load file %s", filename);
+    return NULL;
+  }
+  
+  char magic[3];
+  uint32_t version = 0;
+  uint32_t frame_count = 0;
+  uint32_t joint_count = 0;
+  float frame_time = 0;
+  SDL_RWread(file, magic, 3, 1);
+  SDL_RWread(file, &version, sizeof(uint32_t), 1);
+  SDL_RWread(file, &frame_count, sizeof(uint32_t), 1);
+  SDL_RWread(file, &frame_time, sizeof(float), 1);
+  SDL_RWread(file, &joint_count, sizeof(uint32_t), 1);
+  
+  if (memcmp(magic, "ANI", 3) != 0 || version != 1 ||
+      frame_count == 0 || frame_count > 65536 || joint_count == 0 ||
+      !(frame_time > 0)) {
+    error("Badly formed bani file '%s'", filename);
+    SDL_RWclose(file);
+    return NULL;
+  }
+  
+  animation* a = animation_new();
+  a->frame_count = frame_count;
+  a->frame_time = frame_time;
+  a->joint_count = joint_count;
+  a->joint_parents = malloc(sizeof(int) * joint_count);
+  a->positions = calloc(joint_count, sizeof(animation_track));
+  a->rotations = calloc(joint_count, sizeof(animation_track));
+  
+  bool valid = SDL_RWread(file, a->joint_parents, sizeof(int32_t), joint_count) == joint_count;
+  for(int i = 0; valid && i < joint_count; i++) {
+    valid = a->joint_parents[i] >= -1 && a->joint_parents[i] < (int32_t)joint_count;
+  }
+  
+  if (!valid) {
+    error("Badly formed bani file '%s', bad joint parents", filename);
+    SDL_RWclose(file);
+    animation_delete(a);
+    return NULL;
+  }
+  
+  for(int i = 0; i < joint_count; i++) {
+    valid = valid && bani_read_track(file, &a->positions[i], frame_count);
+    valid = valid && bani_read_track(file, &a->rotations[i], frame_count);
+  }
+  
+  SDL_RWclose(file);
+  
+  if (!valid) {
+    error("Badly formed bani file '%s', bad track", filename);
+    animation_delete(a);
+    return NULL;
+  }
+  
+  return a;
+}
+
+static bool bani_write_file(animation* a, char* filename) {
+  
+  if (!animation_compressed(a)) {
+    error("Animation must be compressed before saving as bani");
+    return false;
+  }
+  
+  SDL_RWops* file = SDL_RWFromFile(filename, "wb");
+  
+  if (file == NULL) {
+    error("Could not open file %s for writing", filename);
+    return false;
+  }
+  
+  uint32_t version = 1;
+  uint32_t frame_count = a->frame_count;
+  uint32_t joint_count = a->joint_count;
+  SDL_RWwrite(file, "ANI", 3, 1);
+  SDL_RWwrite(file, &version, sizeof(uint32_t), 1);
+  SDL_RWwrite(file, &frame_count, sizeof(uint32_t), 1);
+  SDL_RWwrite(file, &a->frame_time, sizeof(float), 1);
+  SDL_RWwrite(file, &joint_count, sizeof(uint32_t), 1);
+  SDL_RWwrite(file, a->joint_parents, sizeof(int32_t), joint_count);
+  
+  for(int i = 0; i < a->joint_count; i++) {
+    bani_write_track(file, &a->positions[i]);
+    bani_write_track(file, &a->rotations[i]);
+  }
+  
+  SDL_RWclose(file);
+  
+  return true;
+}
+
+void bani_save_file(animation* a, char* filename) {
+  bani_write_file(a, filename);
+}
+
+bool ani_cook_file(char* filename, char* output, float position_error, float rotation_error) {
+  
+  if (!SDL_PathIsFile(filename)) {
+    error("Could not load file %s", filename);
+    return false;
+  }
+  
+  animation* a = ani_load_file(filename);
+  animation_compress(a, position_error, rotation_error);
+  bool written = bani_write_file(a, output);
+  animation_delete(a);
+  
+  return written;
+}
@@ -2,28 +2,12 @@
 
 #include "data/vertex_list.h"
 
-static sphere ctri_bound(ctri t) {
-  
-  vec3 center = vec3_add(vec3_add(t.a, t.b), t.c);
-  center = vec3_div(center, 3);
-  
-  float radius = 0;
-  radius = max(radius, vec3_dist_sqrd(t.a, center));
-  radius = max(radius, vec3_dist_sqrd(t.b, center));
-  radius = max(radius, vec3_dist_sqrd(t.c, center));
-  
-  return sphere_new(center, sqrt(radius));
-  
-}
-
 ctri ctri_new(vec3 a, vec3 b, vec3 c, vec3 norm) {
   ctri t;
   t.a = a;
   t.b = b;
   t.c = c;
   t.norm = norm;
-  t.bound = sphere_unit();
-  t.bound = ctri_bound(t);
   return t;
 }
 
@@ -48,7 +32,6 @@ ctri ctri_transform(ctri t, mat4 m, mat3 mn) {
   t.b = mat4_mul_vec3(m, t.b);
   t.c = mat4_mul_vec3(m, t.c);
   t.norm  = vec3_normalize(mat3_mul_vec3(mn, t.norm));
-  t.bound = ctri_bound(t);
   return t;
 }
 
@@ -57,33 +40,19 @@ ctri ctri_transform_space(ctri t, mat3 s, mat3 sn) {
   t.b = mat3_mul_vec3(s, t.b);
   t.c = mat3_mul_vec3(s, t.c);
   t.norm  = vec3_normalize(mat3_mul_vec3(sn, t.norm));
-  t.bound = ctri_bound(t);
   return t;
 }
 
 void cmesh_delete(cmesh* cm) {
-  
-  if (cm->is_leaf) {
-    free(cm->triangles);
-  } else {
-    cmesh_delete(cm->front);
-    cmesh_delete(cm->back);
-  }
-
+  free(cm->nodes);
+  free(cm->triangles);
   free(cm);
-  
 }
 
-static vec3 cmesh_center(cmesh* cm) {
-
-  if (!cm->is_leaf) {
-    error("cmesh is not leaf type!");
-    return vec3_zero();
-  }
-
+sphere cmesh_bound(cmesh* cm) {
+  
   if (cm->triangles_num == 0) {
-    error("Can't find center of mesh with no triangles");
-    return vec3_zero();
+    return sphere_new(vec3_zero(), 0);
   }
   
   vec3 center = vec3_zero();
@@ -94,18 +63,6 @@ static vec3 cmesh_center(cmesh* cm) {
   }
   center = vec3_div(center, cm->triangles_num * 3);
   
-  return center;
-
-}
-
-static float cmesh_radius(cmesh* cm) {
-  
-  if (!cm->is_leaf) {
-    error("cmesh is not leaf type!");
-    return 0;
-  }
-  
-  vec3 center = cmesh_center(cm);
   float radius = 0;
   for (int i = 0; i < cm->triangles_num; i++) {
     radius = max(radius, vec3_dist(center, cm->triangles[i].a));
@@ -113,189 +70,233 @@ static float cmesh_radius(cmesh* cm) {
     radius = max(radius, vec3_dist(center, cm->triangles[i].c));
   }
   
-  return radius;
+  return sphere_new(center, radius);
   
 }
 
-static box cmesh_box(cmesh* cm) {
+/*
+** The tree is built top down. At each node triangle
+** centers are sorted into bins along every axis and the
+** split between bins which gives the smallest surface
+** area heuristic cost is picked. Nodes become leaves
+** when splitting them costs more than testing all of
+** their triangles.
+*/
 
-  if (!cm->is_leaf) {
-    error("cmesh is not leaf type!");
-    return box_new(0,0,0,0,0,0);
-  }
-  
-  if (cm->triangles_num == 0) {
-    error("Can't find box of mesh with no triangles");
-    return box_new(0,0,0,0,0,0);
-  }
-  
-  float x_min = 0; float x_max = 0;
-  float y_min = 0; float y_max = 0;
-  float z_min = 0; float z_max = 0;
-  
-  for(int i = 0; i < cm->triangles_num; i++) {
-    x_min = min(x_min, cm->triangles[i].a.x);
-    x_max = max(x_max, cm->triangles[i].a.x);
-    y_min = min(y_min, cm->triangles[i].a.y);
-    y_max = max(y_max, cm->triangles[i].a.y);
-    z_min = min(z_min, cm->triangles[i].a.z);
-    z_max = max(z_max, cm->triangles[i].a.z);
-    
-    x_min = min(x_min, cm->triangles[i].b.x);
-    x_max = max(x_max, cm->triangles[i].b.x);
-    y_min = min(y_min, cm->triangles[i].b.y);
-    y_max = max(y_max, cm->triangles[i].b.y);
-    z_min = min(z_min, cm->triangles[i].b.z);
-    z_max = max(z_max, cm->triangles[i].b.z);
-    
-    x_min = min(x_min, cm->triangles[i].c.x);
-    x_max = max(x_max, cm->triangles[i].c.x);
-    y_min = min(y_min, cm->triangles[i].c.y);
-    y_max = max(y_max, cm->triangles[i].c.y);
-    z_min = min(z_min, cm->triangles[i].c.z);
-    z_max = max(z_max, cm->triangles[i].c.z);
-  }
-  
-  return box_new(x_min, x_max, y_min, y_max, z_min, z_max);
+#define CMESH_BINS 16
+#define CMESH_LEAF_MAX 8
+#define CMESH_TRAVERSAL_COST 0.5
 
+typedef struct {
+  vec3 minimums;
+  vec3 maximums;
+} cmesh_bounds;
+
+typedef struct {
+  cmesh_node* nodes;
+  int nodes_num;
+  int nodes_max;
+  cmesh_bounds* bounds;
+  vec3* centers;
+  int* indices;
+} cmesh_builder;
+
+static cmesh_bounds cmesh_bounds_empty(void) {
+  cmesh_bounds b;
+  b.minimums = vec3_new( FLT_MAX,  FLT_MAX,  FLT_MAX);
+  b.maximums = vec3_new(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+  return b;
 }
 
-static plane cmesh_division(cmesh* cm) {
-  
-  box bb = cmesh_box(cm);
-  
-  plane p;
-  p.position = cmesh_center(cm);
-    
-  float x_diff = bb.left.position.x  - bb.right.position.x;
-  float y_diff = bb.top.position.y   - bb.bottom.position.y;
-  float z_diff = bb.front.position.z - bb.back.position.z;
-  
-  if ((x_diff >= y_diff) && 
-      (x_diff >= z_diff)) {
-    p.direction = vec3_new(1,0,0);
-    
-  } else if ((y_diff >= x_diff) && 
-             (y_diff >= z_diff)) {
-    p.direction = vec3_new(0,1,0);
-    
-  } else if ((z_diff >= x_diff) && 
-             (z_diff >= y_diff)) {
-    p.direction = vec3_new(0,0,1);
-  } else {
-    p.direction = vec3_new(1,0,0);
-  }
-  
-  return p;
-  
+static cmesh_bounds cmesh_bounds_merge(cmesh_bounds b, vec3 minimums, vec3 maximums) {
+  b.minimums = vec3_new(min(b.minimums.x, minimums.x), min(b.minimums.y, minimums.y), min(b.minimums.z, minimums.z));
+  b.maximums = vec3_new(max(b.maximums.x, maximums.x), max(b.maximums.y, maximums.y), max(b.maximums.z, maximums.z));
+  return b;
 }
 
-sphere cmesh_bound(cmesh* cm) {
+static float cmesh_bounds_area(cmesh_bounds b) {
+  vec3 d = vec3_sub(b.maximums, b.minimums);
+  if (d.x < 0 || d.y < 0 || d.z < 0) { return 0; }
+  return d.x * d.y + d.y * d.z + d.z * d.x;
+}
+
+static float cmesh_axis(vec3 v, int axis) {
+  return axis == 0 ? v.x : (axis == 1 ? v.y : v.z);
+}
+
+static int cmesh_bin(float center, float lo, float scale) {
+  int bin = (int)((center - lo) * scale);
+  return bin < 0 ? 0 : (bin >= CMESH_BINS ? CMESH_BINS-1 : bin);
+}
+
+static int cmesh_build_node(cmesh_builder* cb, int start, int num, int depth) {
   
-  if (!cm->is_leaf) {
-    error("cmesh is not leaf type!");
-    return sphere_new(vec3_zero(), 0);
+  if (cb->nodes_num == cb->nodes_max) {
+    cb->nodes_max *= 2;
+    cb->nodes = realloc(cb->nodes, sizeof(cmesh_node) * cb->nodes_max);
   }
   
-  return sphere_new(cmesh_center(cm), cmesh_radius(cm));
+  int index = cb->nodes_num++;
   
-}
-
-void cmesh_subdivide(cmesh* cm, int iterations) {
-  
-  if (!cm->is_leaf) {
-    error("Attempt to subdivide non-leaf bsp tree!");
-    return;
+  cmesh_bounds bounds  = cmesh_bounds_empty();
+  cmesh_bounds centers = cmesh_bounds_empty();
+  for (int i = start; i < start + num; i++) {
+    int t = cb->indices[i];
+    bounds  = cmesh_bounds_merge(bounds, cb->bounds[t].minimums, cb->bounds[t].maximums);
+    centers = cmesh_bounds_merge(centers, cb->centers[t], cb->centers[t]);
   }
   
-  if (iterations == 0) { return; }
-  if (cm->triangles_num < 10) { return; }
+  cb->nodes[index].minimums = bounds.minimums;
+  cb->nodes[index].maximums = bounds.maximums;
+  cb->nodes[index].offset = start;
+  cb->nodes[index].count = num;
   
-  plane division = cmesh_division(cm);
+  if (num <= 2 || depth == CMESH_MAX_DEPTH-1) { return index; }
   
-  int num_front = 0;
-  int num_back  = 0;
+  float area = cmesh_bounds_area(bounds);
+  float best_cost = FLT_MAX;
+  int best_axis = -1;
+  int best_bin = 0;
   
-  for(int i = 0; i < cm->triangles_num; i++) {
-    ctri t = cm->triangles[i];
+  for (int axis = 0; axis < 3; axis++) {
+    
+    float lo = cmesh_axis(centers.minimums, axis);
+    float hi = cmesh_axis(centers.maximums, axis);
+    if (hi <= lo) { continue; }
+    float scale = CMESH_BINS / (hi - lo);
+    
+    cmesh_bounds bins[CMESH_BINS];
+    int counts[CMESH_BINS];
+    for (int i = 0; i < CMESH_BINS; i++) {
+      bins[i] = cmesh_bounds_empty();
+      counts[i] = 0;
+    }
     
-    if (ctri_inside_plane(t, division)) {
-      num_back++;
-    } else if (ctri_outside_plane(t, division)) {
-      num_front++;
-    } else { 
-      num_back++; 
-      num_front++; 
+    for (int i = start; i < start + num; i++) {
+      int t = cb->indices[i];
+      int bin = cmesh_bin(cmesh_axis(cb->centers[t], axis), lo, scale);
+      bins[bin] = cmesh_bounds_merge(bins[bin], cb->bounds[t].minimums, cb->bounds[t].maximums);
+      counts[bin]++;
+    }
+    
+    /* Area and count to the right of every split */
+    float right_area[CMESH_BINS];
+    int right_count[CMESH_BINS];
+    cmesh_bounds right = cmesh_bounds_empty();
+    int right_num = 0;
+    for (int i = CMESH_BINS-1; i > 0; i--) {
+      right = cmesh_bounds_merge(right, bins[i].minimums, bins[i].maximums);
+      right_num += counts[i];
+      right_area[i] = cmesh_bounds_area(right);
+      right_count[i] = right_num;
+    }
+    
+    cmesh_bounds left = cmesh_bounds_empty();
+    int left_num = 0;
+    for (int i = 1; i < CMESH_BINS; i++) {
+      left = cmesh_bounds_merge(left, bins[i-1].minimums, bins[i-1].maximums);
+      left_num += counts[i-1];
+      if (left_num == 0 || right_count[i] == 0) { continue; }
+      float cost = cmesh_bounds_area(left) * left_num + right_area[i] * right_count[i];
+      if (cost < best_cost) {
+        best_cost = cost;
+        best_axis = axis;
+        best_bin = i;
+      }
     }
   }
   
-  if (num_front > cm->triangles_num * 0.75) { return; }
-  if (num_back  > cm->triangles_num * 0.75) { return; }
+  int mid = start + num / 2;
   
-  cmesh* front = malloc(sizeof(cmesh));
-  front->is_leaf = true;
-  front->triangles_num = num_front;
-  front->triangles = malloc(sizeof(ctri) * num_front);
-  
-  cmesh* back = malloc(sizeof(cmesh));
-  back->is_leaf = true;
-  back->triangles_num = num_back;
-  back->triangles = malloc(sizeof(ctri) * num_back);
-  
-  int i_front = 0;
-  int i_back  = 0;
-  
-  for(int i = 0; i < cm->triangles_num; i++) {
+  if (best_axis != -1) {
     
-    ctri t = cm->triangles[i];
+    float split_cost = CMESH_TRAVERSAL_COST + (area > 0 ? best_cost / area : num);
+    if (split_cost >= num && num <= CMESH_LEAF_MAX) { return index; }
     
-    if (ctri_inside_plane(t, division)) {
-      back->triangles[i_back] = t;
-      i_back++;
-    } else if (ctri_outside_plane(t, division)) {
-      front->triangles[i_front] = t;
-      i_front++;
-    } else { 
-      back->triangles[i_back] = t;
-      front->triangles[i_front] = t;
-      i_back++; 
-      i_front++; 
+    float lo = cmesh_axis(centers.minimums, best_axis);
+    float scale = CMESH_BINS / (cmesh_axis(centers.maximums, best_axis) - lo);
+    
+    int i = start;
+    int j = start + num - 1;
+    while (i <= j) {
+      int t = cb->indices[i];
+      if (cmesh_bin(cmesh_axis(cb->centers[t], best_axis), lo, scale) < best_bin) {
+        i++;
+      } else {
+        cb->indices[i] = cb->indices[j];
+        cb->indices[j] = t;
+        j--;
+      }
     }
     
+    if (i != start && i != start + num) { mid = i; }
+    
+  } else if (num <= CMESH_LEAF_MAX) {
+    return index;
   }
   
-  if (front->triangles_num > 0) {
-    front->bound = cmesh_bound(front);
-  } else {
-    front->bound = sphere_new(vec3_zero(), 0);
+  cb->nodes[index].count = 0;
+  cmesh_build_node(cb, start, mid - start, depth+1);
+  int second = cmesh_build_node(cb, mid, start + num - mid, depth+1);
+  cb->nodes[index].offset = second;
+  
+  return index;
+  
+}
+
+cmesh* cmesh_new(ctri* triangles, int triangles_num) {
+  
+  cmesh* cm = malloc(sizeof(cmesh));
+  cm->nodes_num = 0;
+  cm->nodes = NULL;
+  cm->triangles_num = triangles_num;
+  cm->triangles = triangles;
+  cm->bound = cmesh_bound(cm);
+  
+  if (triangles_num == 0) { return cm; }
+  
+  cmesh_builder cb;
+  cb.nodes_num = 0;
+  cb.nodes_max = 64;
+  cb.nodes = malloc(sizeof(cmesh_node) * cb.nodes_max);
+  cb.bounds = malloc(sizeof(cmesh_bounds) * triangles_num);
+  cb.centers = malloc(sizeof(vec3) * triangles_num);
+  cb.indices = malloc(sizeof(int) * triangles_num);
+  
+  for (int i = 0; i < triangles_num; i++) {
+    ctri t = triangles[i];
+    cb.bounds[i] = cmesh_bounds_merge(cmesh_bounds_merge(cmesh_bounds_merge(
+      cmesh_bounds_empty(), t.a, t.a), t.b, t.b), t.c, t.c);
+    cb.centers[i] = vec3_div(vec3_add(vec3_add(t.a, t.b), t.c), 3);
+    cb.indices[i] = i;
   }
   
-  if (back->triangles_num > 0) {
-    back->bound = cmesh_bound(back);
-  } else {
-    back->bound = sphere_new(vec3_zero(), 0);
+  cmesh_build_node(&cb, 0, triangles_num, 0);
+  
+  /* Put triangles in leaf order */
+  cm->triangles = malloc(sizeof(ctri) * triangles_num);
+  for (int i = 0; i < triangles_num; i++) {
+    cm->triangles[i] = triangles[cb.indices[i]];
   }
+  free(triangles);
   
-  cmesh_subdivide(front, iterations-1);
-  cmesh_subdivide(back, iterations-1);
+  cm->nodes_num = cb.nodes_num;
+  cm->nodes = realloc(cb.nodes, sizeof(cmesh_node) * cb.nodes_num);
   
-  free(cm->triangles);
-  cm->is_leaf = false;
-  cm->division = division;
-  cm->front = front;
-  cm->back = back;
+  free(cb.bounds);
+  free(cb.centers);
+  free(cb.indices);
+  
+  return cm;
   
 }
 
 cmesh* col_load_file(char* filename) {
-    
-  cmesh* cm = malloc(sizeof(cmesh));
-  cm->is_leaf = true;
   
   vertex_list* vert_positions = vertex_list_new();
   vertex_list* vert_triangles = vertex_list_new();
   
-  SDL_RWops* file = SDL_RWFromFile(filename, "r");
+  SDL_RWops* file = SDL_RWFromFileBuffered(filename, "r");
   
   if(file == NULL) {
     error("Could not load file %s", filename);
@@ -399,8 +400,8 @@ cmesh* col_load_file(char* filename) {
     
   SDL_RWclose(file);
 
-  cm->triangles_num = vert_triangles->num_items / 3;
-  cm->triangles = malloc(sizeof(ctri) * cm->triangles_num);
+  int triangles_num = vert_triangles->num_items / 3;
+  ctri* triangles = malloc(sizeof(ctri) * triangles_num);
     
   for(int i = 0; i < vert_triangles->num_items; i += 3) {
     
@@ -409,20 +410,121 @@ cmesh* col_load_file(char* filename) {
     vertex c = vertex_list_get(vert_triangles, i+2);
     vec3 norm = triangle_normal(a, b, c);
     
-    cm->triangles[i / 3] = ctri_new(a.position, b.position, c.position, norm);
+    triangles[i / 3] = ctri_new(a.position, b.position, c.position, norm);
     
   }
   
   vertex_list_delete(vert_positions);
   vertex_list_delete(vert_triangles);
   
-  if (cm->triangles_num != 0) {
-    cm->bound = cmesh_bound(cm);
-  } else {
-    cm->bound = sphere_new(vec3_zero(), 0);
+  return cmesh_new(triangles, triangles_num);
+}
+
+/*
+** Version 2 cmf files hold the flat node and triangle
+** arrays as they are laid out in memory.
+*/
+
+#define CMF_VERSION 2
+
+cmesh* cmf_load_file(char* filename) {
+  
+  SDL_RWops* file = SDL_RWFromFileBuffered(filename, "rb");
+  
+  if (file == NULL) {
+    error("Could not load file %s", filename);
+    return NULL;
+  }
+  
+  char magic[3];
+  uint32_t version = 0;
+  SDL_RWread(file, magic, 3, 1);
+  SDL_RWread(file, &version, sizeof(uint32_t), 1);
+  
+  if (memcmp(magic, "CMF", 3) != 0 || version != CMF_VERSION) {
+    error("Badly formed cmf file '%s', cook it again", filename);
+    SDL_RWclose(file);
+    return NULL;
   }
   
-  cmesh_subdivide(cm, 5);
+  uint32_t nodes_num = 0, triangles_num = 0;
+  SDL_RWread(file, &nodes_num, sizeof(uint32_t), 1);
+  SDL_RWread(file, &triangles_num, sizeof(uint32_t), 1);
+  
+  cmesh* cm = malloc(sizeof(cmesh));
+  cm->nodes_num = nodes_num;
+  cm->nodes = malloc(sizeof(cmesh_node) * nodes_num);
+  cm->triangles_num = triangles_num;
+  cm->triangles = malloc(sizeof(ctri) * triangles_num);
+  
+  SDL_RWread(file, &cm->bound, sizeof(sphere), 1);
+  size_t read_nodes = SDL_RWread(file, cm->nodes, sizeof(cmesh_node), nodes_num);
+  size_t read_triangles = SDL_RWread(file, cm->triangles, sizeof(ctri), triangles_num);
+  
+  SDL_RWclose(file);
+  
+  /* Children must come after their parent and not be too deep to traverse */
+  bool valid = (read_nodes == nodes_num && read_triangles == triangles_num);
+  uint8_t* depths = calloc(nodes_num, 1);
+  for (uint32_t i = 0; valid && i < nodes_num; i++) {
+    cmesh_node n = cm->nodes[i];
+    if (n.count != 0) {
+      valid = (n.offset <= triangles_num && n.count <= triangles_num - n.offset);
+    } else {
+      valid = (n.offset > i + 1 && n.offset < nodes_num && depths[i] < CMESH_MAX_DEPTH-1);
+      if (valid) { depths[i+1] = depths[n.offset] = depths[i] + 1; }
+    }
+  }
+  free(depths);
+  
+  if (!valid) {
+    error("Badly formed cmf file '%s'", filename);
+    cmesh_delete(cm);
+    return NULL;
+  }
   
   return cm;
 }
+
+static bool cmf_write_file(cmesh* cm, char* filename) {
+  
+  SDL_RWops* file = SDL_RWFromFile(filename, "wb");
+  
+  if (file == NULL) {
+    error("Could not open file %s for writing", filename);
+    return false;
+  }
+  
+  uint32_t version = CMF_VERSION;
+  uint32_t nodes_num = cm->nodes_num;
+  uint32_t triangles_num = cm->triangles_num;
+  SDL_RWwrite(file, "CMF", 3, 1);
+  SDL_RWwrite(file, &version, sizeof(uint32_t), 1);
+  SDL_RWwrite(file, &nodes_num, sizeof(uint32_t), 1);
+  SDL_RWwrite(file, &triangles_num, sizeof(uint32_t), 1);
+  SDL_RWwrite(file, &cm->bound, sizeof(sphere), 1);
+  SDL_RWwrite(file, cm->nodes, sizeof(cmesh_node), nodes_num);
+  SDL_RWwrite(file, cm->triangles, sizeof(ctri), triangles_num);
+  
+  SDL_RWclose(file);
+  
+  return true;
+}
+
+void cmf_save_file(cmesh* cm, char* filename) {
+  cmf_write_file(cm, filename);
+}
+
+bool col_cook_file(char* filename, char* output) {
+  
+  if (!SDL_PathIsFile(filename)) {
+    error("Could not load file %s", filename);
+    return false;
+  }
+  
+  cmesh* cm = col_load_file(filename);
+  bool written = cmf_write_file(cm, output);
+  cmesh_delete(cm);
+  
+  return written;
+}
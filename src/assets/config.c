@@ -3,7 +3,7 @@
 
 config* cfg_load_file(const char* filename) {
 
-  SDL_RWops* file = SDL_RWFromFile(filename, "r");
+  SDL_RWops* file = SDL_RWFromFileBuffered(filename, "r");
   if(file == NULL) {
     error("Cannot load file %s", filename);
   }
@@ -51,7 +51,7 @@ effect* effect_load_file(char* filename) {
   
   effect* e = effect_new();
   
-  SDL_RWops* file = SDL_RWFromFile(filename, "r");
+  SDL_RWops* file = SDL_RWFromFileBuffered(filename, "r");
   if(file == NULL) {
     error("Cannot load file %s", filename);
   }
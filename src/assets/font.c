@@ -1,5 +1,35 @@
 #include "assets/font.h"
 
+int font_scan_file(char* filename, fpath* dependencies, int max) {
+  
+  SDL_RWops* file = SDL_RWFromFileBuffered(filename, "r");
+  if(file == NULL) { return 0; }
+  
+  int num = 0;
+  char line[1024];
+  while(SDL_RWreadline(file, line, 1024) && num < max) {
+    
+    int tex_id;
+    char tex_file[MAX_PATH];
+    if (sscanf(line, "page id=%i file=%s", &tex_id, tex_file) > 0) {
+      
+      fpath location;
+      SDL_PathFileLocation(location.ptr, filename);
+      strcat(location.ptr, tex_file+1); 
+      location.ptr[strlen(location.ptr)-1] = '\0';
+      
+      dependencies[num++] = location;
+    }
+    
+    /* Pages come before any character data */
+    if (strncmp(line, "char", 4) == 0) { break; }
+  }
+  
+  SDL_RWclose(file);
+  
+  return num;
+}
+
 font* font_load_file(char* filename) {
   
   font* f = malloc(sizeof(font));
@@ -11,7 +41,7 @@ font* font_load_file(char* filename) {
   f->sizes = malloc( sizeof(vec2) * 256 );
   f->offsets = malloc( sizeof(vec2) * 256 );
   
-  SDL_RWops* file = SDL_RWFromFile(filename, "r");
+  SDL_RWops* file = SDL_RWFromFileBuffered(filename, "r");
   
   if(file == NULL) {
     error("Could not load file %s", filename);
@@ -915,7 +915,7 @@ image* image_read_from_file(char* filename) {
 
 image* image_tga_load_file(char* filename) {
 
-  SDL_RWops* file = SDL_RWFromFile(filename, "rb");
+  SDL_RWops* file = SDL_RWFromFileBuffered(filename, "rb");
   
 	if (file == NULL) {
 		error("Cannot open file %s", filename);
@@ -990,7 +990,7 @@ image* image_tga_load_file(char* filename) {
 
 image* image_bmp_load_file(char* filename) {
   
-  SDL_Surface *surface = SDL_LoadBMP(filename);
+  SDL_Surface *surface = SDL_LoadBMP_RW(SDL_RWFromFileBuffered(filename, "rb"), 1);
   
   if (!surface) { error("Could not load file %s\n", filename); }
   
@@ -6,7 +6,7 @@ lang* lang_load_file(const char* filename) {
   lang* t = malloc(sizeof(lang));
   t->map = dict_new(512);
   
-  SDL_RWops* file = SDL_RWFromFile(filename, "r");
+  SDL_RWops* file = SDL_RWFromFileBuffered(filename, "r");
   
   if(file == NULL) {
     error("Could not load file %s", filename);
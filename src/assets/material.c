@@ -3,6 +3,10 @@
 void material_entry_delete(material_entry* me) {
   shader_program_delete(me->program);
   for(int i = 0; i < me->num_items; i++) {
+    if (me->types[i] == mat_item_shader ||
+        me->types[i] == mat_item_texture) {
+      asset_hndl_release(&me->items[i].as_asset);
+    }
     free(me->names[i]);
   }
   free(me->names);
@@ -106,7 +110,7 @@ material_entry* material_add_entry(material* m) {
 
 material* mat_load_file(char* filename) {
   
-  SDL_RWops* file = SDL_RWFromFile(filename, "r");
+  SDL_RWops* file = SDL_RWFromFileBuffered(filename, "r");
   if(file == NULL) {
     error("Cannot load file %s", filename);
   }
@@ -146,11 +150,13 @@ material* mat_load_file(char* filename) {
     if (strcmp(type, "shader") == 0) {
     
       mi.as_asset = asset_hndl_new_load(P(value));
+      asset_hndl_acquire(&mi.as_asset);
       type_id = mat_item_shader;
       
     } else if (strcmp(type, "texture") == 0) {
     
       mi.as_asset = asset_hndl_new_load(P(value));
+      asset_hndl_acquire(&mi.as_asset);
       type_id = mat_item_texture;
     
     } else if (strcmp(type, "int") == 0) {
@@ -199,6 +205,29 @@ material* mat_load_file(char* filename) {
   return m;
 }
 
+int mat_scan_file(char* filename, fpath* dependencies, int max) {
+  
+  SDL_RWops* file = SDL_RWFromFileBuffered(filename, "r");
+  if(file == NULL) { return 0; }
+  
+  int num = 0;
+  char line[1024];
+  while(SDL_RWreadline(file, line, 1024) && num < max) {
+    
+    char type[512]; char name[512]; char value[512];
+    if (sscanf(line, "%511s %511s = %511s", type, name, value) != 3) { continue; }
+    
+    if ((strcmp(type, "shader") == 0) ||
+        (strcmp(type, "texture") == 0)) {
+      dependencies[num++] = P(value);
+    }
+  }
+  
+  SDL_RWclose(file);
+  
+  return num;
+}
+
 material_entry* material_get_entry(material* m, int index) {
   return m->entries[(int)clamp(index, 0, m->num_entries-1)];
 }
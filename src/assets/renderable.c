@@ -1,5 +1,8 @@
 #include "assets/renderable.h"
 
+#include "cnet.h"
+#include "data/vertex_list.h"
+#include "data/int_list.h"
 #include "data/vertex_hashtable.h"
 
 
@@ -21,29 +24,127 @@ void renderable_add_model(renderable* r, model* m) {
   
 }
 
+/* Servers have no GL context so can't load materials */
+static asset_hndl renderable_material(fpath path) {
+  return net_is_server() ? asset_hndl_new(path) : asset_hndl_new_load(path);
+}
+
 renderable* renderable_new() {
   
   renderable* r = malloc(sizeof(renderable));
   
-  r->material = asset_hndl_new_load(P("$CORANGE/shaders/basic.mat"));
+  r->material = renderable_material(P("$CORANGE/shaders/basic.mat"));
   r->num_surfaces = 0;
   r->surfaces = NULL;
   r->is_rigged = false;
+  r->keep_geometry = false;
   
   return r;
 
 }
 
+static void renderable_surface_upload(renderable_surface* s, int stride) {
+  
+  if (s->vertex_vbo == 0 && s->vertex_data != NULL) {
+    glGenBuffers(1, &s->vertex_vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, s->vertex_vbo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(float) * s->num_verticies * stride, s->vertex_data, GL_STATIC_DRAW);
+  }
+  
+  if (s->triangle_vbo == 0 && s->triangle_data != NULL) {
+    glGenBuffers(1, &s->triangle_vbo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, s->triangle_vbo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(uint32_t) * s->num_triangles * 3, s->triangle_data, GL_STATIC_DRAW);
+  }
+  
+  for(int j = 0; j < s->num_lods; j++) {
+    renderable_lod* lod = &s->lods[j];
+    if (lod->triangle_vbo == 0 && lod->triangle_data != NULL) {
+      glGenBuffers(1, &lod->triangle_vbo);
+      glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, lod->triangle_vbo);
+      glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(uint32_t) * lod->num_triangles * 3, lod->triangle_data, GL_STATIC_DRAW);
+    }
+  }
+  
+}
+
+void renderable_upload(renderable* r) {
+  
+  if (net_is_server()) { return; }
+  
+  int stride = r->is_rigged ? 24 : 18;
+  
+  for(int i = 0; i < r->num_surfaces; i++) {
+    
+    renderable_surface* s = r->surfaces[i];
+    renderable_surface_upload(s, stride);
+    
+    if (!r->keep_geometry) {
+      free(s->vertex_data);
+      free(s->triangle_data);
+      s->vertex_data = NULL;
+      s->triangle_data = NULL;
+      for(int j = 0; j < s->num_lods; j++) {
+        free(s->lods[j].triangle_data);
+        s->lods[j].triangle_data = NULL;
+      }
+    }
+  }
+  
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  
+}
+
+/* Copies geometry from the CPU copy if there is one, otherwise back from the GPU */
+static void renderable_surface_read(renderable_surface* s, int stride, float* vert_data, uint32_t* index_data) {
+  
+  if (s->vertex_data != NULL) {
+    memcpy(vert_data, s->vertex_data, sizeof(float) * stride * s->num_verticies);
+  } else {
+    glBindBuffer(GL_ARRAY_BUFFER, s->vertex_vbo);
+    glGetBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(float) * stride * s->num_verticies, vert_data);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+  }
+  
+  if (s->triangle_data != NULL) {
+    memcpy(index_data, s->triangle_data, sizeof(uint32_t) * s->num_triangles * 3);
+  } else {
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, s->triangle_vbo);
+    glGetBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, sizeof(uint32_t) * s->num_triangles * 3, index_data);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+  }
+  
+}
+
 void renderable_delete(renderable* r) {
   
   for(int i = 0; i < r->num_surfaces; i++) {
     renderable_surface_delete( r->surfaces[i] );
   }
   
+  free(r->surfaces);
   free(r);
 
 }
 
+size_t renderable_size(renderable* r) {
+  
+  int stride = r->is_rigged ? 24 : 18;
+  
+  size_t size = sizeof(renderable) + sizeof(renderable_surface*) * r->num_surfaces;
+  for(int i = 0; i < r->num_surfaces; i++) {
+    size += sizeof(renderable_surface);
+    size += sizeof(float) * stride * r->surfaces[i]->num_verticies;
+    size += sizeof(uint32_t) * 3 * r->surfaces[i]->num_triangles;
+    for(int j = 0; j < r->surfaces[i]->num_lods; j++) {
+      size += sizeof(uint32_t) * 3 * r->surfaces[i]->lods[j].num_triangles;
+    }
+  }
+  
+  return size;
+}
+
 void renderable_set_material(renderable* r, asset_hndl mat) {
   r->material = mat;
 }
@@ -66,11 +167,7 @@ model* renderable_to_model(renderable* r) {
     float* vb_data = malloc(sizeof(float) * s->num_verticies * 18);
     uint32_t* ib_data = malloc(sizeof(uint32_t) * s->num_triangles * 3);
     
-    glBindBuffer(GL_ARRAY_BUFFER, s->vertex_vbo);
-    glGetBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(float) * s->num_verticies * 18, vb_data);
-    
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, s->triangle_vbo);
-    glGetBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, sizeof(uint32_t) * s->num_triangles * 3, ib_data);
+    renderable_surface_read(s, 18, vb_data, ib_data);
     
     m->meshes[i] = mesh_new();
     
@@ -123,12 +220,12 @@ renderable_surface* renderable_surface_new(mesh* m) {
 
   renderable_surface* s = malloc(sizeof(renderable_surface));
 
-  glGenBuffers(1, &s->vertex_vbo);
-  glGenBuffers(1, &s->triangle_vbo);
-
+  s->vertex_vbo = 0;
+  s->triangle_vbo = 0;
   s->num_verticies = m->num_verts;
   s->num_triangles = m->num_triangles;
   s->bound = mesh_bounding_sphere(m);
+  s->num_lods = 0;
   
   /* Position Normal Tangent Binormal Uvs Color      */
   /* 3        3      3       3        2   4     = 18 */
@@ -169,16 +266,9 @@ renderable_surface* renderable_surface_new(mesh* m) {
   
   }
   
-  glBindBuffer(GL_ARRAY_BUFFER, s->vertex_vbo);
-  glBufferData(GL_ARRAY_BUFFER, sizeof(float) * s->num_verticies * 18, vb_data, GL_STATIC_DRAW);
-  
-  free(vb_data);
-  
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, s->triangle_vbo);
-  glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(uint32_t) * s->num_triangles * 3, m->triangles, GL_STATIC_DRAW);
-  
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  s->vertex_data = vb_data;
+  s->triangle_data = malloc(sizeof(uint32_t) * s->num_triangles * 3);
+  memcpy(s->triangle_data, m->triangles, sizeof(uint32_t) * s->num_triangles * 3);
   
   return s;
 }
@@ -187,11 +277,12 @@ renderable_surface* renderable_surface_new_rigged(mesh* m, vertex_weight* weight
 
   renderable_surface* s = malloc(sizeof(renderable_surface));
 
-  glGenBuffers(1, &s->vertex_vbo);
-  glGenBuffers(1, &s->triangle_vbo);
-
+  s->vertex_vbo = 0;
+  s->triangle_vbo = 0;
   s->num_verticies = m->num_verts;
   s->num_triangles = m->num_triangles;
+  s->bound = mesh_bounding_sphere(m);
+  s->num_lods = 0;
   
   /* Position Normal Tangent Binormal Uvs Color WeightIds WeightAmounts      */
   /* 3        3      3       3        2   4     3         3             = 24 */
@@ -240,60 +331,531 @@ renderable_surface* renderable_surface_new_rigged(mesh* m, vertex_weight* weight
   
   }
   
-  glBindBuffer(GL_ARRAY_BUFFER, s->vertex_vbo);
-  glBufferData(GL_ARRAY_BUFFER, sizeof(float) * s->num_verticies * 24, vb_data, GL_STATIC_DRAW);
-  
-  free(vb_data);
+  s->vertex_data = vb_data;
+  s->triangle_data = malloc(sizeof(uint32_t) * s->num_triangles * 3);
+  memcpy(s->triangle_data, m->triangles, sizeof(uint32_t) * s->num_triangles * 3);
   
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, s->triangle_vbo);
-  glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(uint32_t) * s->num_triangles * 3, m->triangles, GL_STATIC_DRAW);
+  return s;
+}
+
+static void renderable_surface_delete_lods(renderable_surface* s) {
   
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  for(int i = 0; i < s->num_lods; i++) {
+    if (s->lods[i].triangle_vbo != 0) { glDeleteBuffers(1, &s->lods[i].triangle_vbo); }
+    free(s->lods[i].triangle_data);
+  }
   
-  return s;
+  s->num_lods = 0;
 }
 
 void renderable_surface_delete(renderable_surface* s) {
-
-  glDeleteBuffers(1, &s->vertex_vbo);
-  glDeleteBuffers(1, &s->triangle_vbo);
   
+  if (s->vertex_vbo != 0) { glDeleteBuffers(1, &s->vertex_vbo); }
+  if (s->triangle_vbo != 0) { glDeleteBuffers(1, &s->triangle_vbo); }
+  
+  renderable_surface_delete_lods(s);
+  
+  free(s->vertex_data);
+  free(s->triangle_data);
   free(s);
   
 }
 
-static sphere renderable_surface_bounding_sphere(float* verts, int num_verts, int stride) {
+/*
+** Each level aims for half the triangles of the one before
+** but is simplified from the full mesh so its error is
+** measured against the full mesh. The chain stops early
+** once simplification stalls.
+*/
+static int renderable_lod_chain(mesh* m, int num_lods, uint32_t** triangles, int* num_triangles, float* errors) {
+  
+  int count = 0;
+  int target = m->num_triangles;
+  
+  for(int i = 0; i < num_lods && i < RENDERABLE_MAX_LODS; i++) {
+    
+    int previous = (count == 0) ? m->num_triangles : num_triangles[count-1];
+    target /= 2;
+    
+    mesh lod = *m;
+    lod.triangles = malloc(sizeof(uint32_t) * m->num_triangles * 3);
+    memcpy(lod.triangles, m->triangles, sizeof(uint32_t) * m->num_triangles * 3);
+    
+    float error = mesh_simplify(&lod, target);
+    
+    if (lod.num_triangles == 0 || lod.num_triangles > previous * 3 / 4) {
+      free(lod.triangles);
+      break;
+    }
+    
+    mesh_optimize_vertex_cache(&lod);
+    
+    triangles[count] = lod.triangles;
+    num_triangles[count] = lod.num_triangles;
+    errors[count] = (count == 0) ? error : max(error, errors[count-1]);
+    count++;
+  }
+  
+  return count;
+}
+
+/* Takes ownership of triangles, they are uploaded with the rest of the surface */
+static void renderable_surface_add_lod(renderable_surface* s, uint32_t* triangles, int num_triangles, float error) {
+  
+  if (s->num_lods == RENDERABLE_MAX_LODS) {
+    free(triangles);
+    return;
+  }
+  
+  renderable_lod* lod = &s->lods[s->num_lods++];
+  lod->triangle_vbo = 0;
+  lod->num_triangles = num_triangles;
+  lod->error = error;
+  lod->triangle_data = triangles;
+  
+}
+
+void renderable_surface_generate_lods(renderable_surface* s, mesh* m, int num_lods) {
+  
+  renderable_surface_delete_lods(s);
+  
+  uint32_t* triangles[RENDERABLE_MAX_LODS];
+  int num_triangles[RENDERABLE_MAX_LODS];
+  float errors[RENDERABLE_MAX_LODS];
+  
+  int count = renderable_lod_chain(m, num_lods, triangles, num_triangles, errors);
+  
+  for(int i = 0; i < count; i++) {
+    renderable_surface_add_lod(s, triangles[i], num_triangles[i], errors[i]);
+  }
+  
+}
+
+renderable_lod renderable_surface_lod(renderable_surface* s, float radius_pixels, float max_error_pixels) {
+  
+  renderable_lod lod;
+  lod.triangle_vbo = s->triangle_vbo;
+  lod.num_triangles = s->num_triangles;
+  lod.error = 0;
+  lod.triangle_data = s->triangle_data;
+  
+  if (s->bound.radius <= 0) { return lod; }
+  
+  /* Levels are ordered by increasing error */
+  float pixels_per_unit = radius_pixels / s->bound.radius;
+  for(int i = 0; i < s->num_lods; i++) {
+    if (s->lods[i].error * pixels_per_unit > max_error_pixels) { break; }
+    lod = s->lods[i];
+  }
+  
+  return lod;
+}
+
+static vec3 renderable_surface_position(const char* verts, int index, int stride) {
+  vec3 position;
+  memcpy(&position, verts + sizeof(float) * stride * index, sizeof(vec3));
+  return position;
+}
+
+static sphere renderable_surface_bounding_sphere(const void* verts, int num_verts, int stride) {
   
   sphere s;
   
   s.center = vec3_zero();
-  for(int i = 0; i < num_verts * stride; i += stride) {
-    vec3 position = vec3_new(verts[i+0], verts[i+1], verts[i+2]);
-    s.center = vec3_add(s.center, position);
+  for(int i = 0; i < num_verts; i++) {
+    s.center = vec3_add(s.center, renderable_surface_position(verts, i, stride));
   }
   s.center = vec3_div(s.center, num_verts);
   
   s.radius = 0;
-  for(int i = 0; i < num_verts * stride; i += stride) {
-    vec3 position = vec3_new(verts[i+0], verts[i+1], verts[i+2]);
-    s.radius = max(s.radius, vec3_dist(s.center, position));
+  for(int i = 0; i < num_verts; i++) {
+    s.radius = max(s.radius, vec3_dist(s.center, renderable_surface_position(verts, i, stride)));
   }
   
   return s;
+}
+
+/*
+** BMF version 2 stores the same data as version 1 in a
+** compact form. Positions are quantized to 16 bits within
+** the bounds of each surface, normals and tangents are
+** octahedral encoded, uvs are half floats and colors and
+** weights are 8 bits. Binormals are not always orthogonal
+** to the normal and tangent so can't be rebuilt from them.
+** Instead they are octahedral encoded at 8 bits. Indices
+** are 16 bit when a surface has few enough verticies.
+** After its indices each surface lists its levels of
+** detail, each an error followed by another set of indices.
+**
+** Files are expanded back to the version 1 layout on load
+** so the renderer is unaffected by the version used.
+*/
+
+typedef struct {
+  uint16_t position[3];
+  int8_t binormal[2];
+  int16_t normal[2];
+  int16_t tangent[2];
+  uint16_t uvs[2];
+  uint8_t color[4];
+} bmf_vertex_v2;
+
+typedef struct {
+  bmf_vertex_v2 base;
+  uint8_t bone_ids[4];
+  uint8_t bone_weights[4];
+} bmf_vertex_rigged_v2;
+
+static uint16_t bmf_half_from_float(float f) {
+  
+  union { float f; uint32_t i; } u;
+  u.f = f;
   
+  uint32_t sign = (u.i >> 16) & 0x8000;
+  int exponent = ((u.i >> 23) & 0xFF) - 127 + 15;
+  uint32_t mantissa = u.i & 0x7FFFFF;
+  
+  if (((u.i >> 23) & 0xFF) == 0xFF) {
+    return sign | 0x7C00 | (mantissa ? 0x200 : 0);
+  }
+  
+  if (exponent >= 31) { return sign | 0x7C00; }
+  
+  if (exponent <= 0) {
+    if (exponent < -10) { return sign; }
+    mantissa |= 0x800000;
+    int shift = 14 - exponent;
+    uint32_t h = mantissa >> shift;
+    if ((mantissa >> (shift - 1)) & 1) { h++; }
+    return sign | h;
+  }
+  
+  /* Rounding may carry into the exponent which is still correct */
+  uint32_t h = sign | (exponent << 10) | (mantissa >> 13);
+  if (mantissa & 0x1000) { h++; }
+  return h;
+}
+
+static float bmf_half_to_float(uint16_t h) {
+  
+  uint32_t exponent = (h >> 10) & 0x1F;
+  uint32_t mantissa = h & 0x3FF;
+  
+  union { float f; uint32_t i; } u;
+  
+  if (exponent == 0) {
+    u.f = ldexpf((float)mantissa, -24);
+    u.i |= (uint32_t)(h & 0x8000) << 16;
+  } else if (exponent == 31) {
+    u.i = ((uint32_t)(h & 0x8000) << 16) | 0x7F800000 | (mantissa << 13);
+  } else {
+    u.i = ((uint32_t)(h & 0x8000) << 16) | ((exponent - 15 + 127) << 23) | (mantissa << 13);
+  }
+  
+  return u.f;
+}
+
+static float bmf_sign(float x) {
+  return (x >= 0) ? 1 : -1;
+}
+
+static vec2 bmf_octahedral_encode(vec3 n) {
+  
+  float l = fabs(n.x) + fabs(n.y) + fabs(n.z);
+  if (l == 0) { return vec2_zero(); }
+  
+  float x = n.x / l;
+  float y = n.y / l;
+  
+  if (n.z < 0) {
+    float ox = x;
+    x = (1 - fabs(y)) * bmf_sign(ox);
+    y = (1 - fabs(ox)) * bmf_sign(y);
+  }
+  
+  return vec2_new(clamp(x, -1, 1), clamp(y, -1, 1));
+}
+
+static vec3 bmf_octahedral_decode(vec2 e) {
+  
+  float x = e.x;
+  float y = e.y;
+  float z = 1 - fabs(x) - fabs(y);
+  
+  if (z < 0) {
+    float ox = x;
+    x = (1 - fabs(y)) * bmf_sign(ox);
+    y = (1 - fabs(ox)) * bmf_sign(y);
+  }
+  
+  return vec3_normalize(vec3_new(x, y, z));
+}
+
+static uint8_t bmf_unorm8(float x) {
+  return (uint8_t)roundf(clamp(x, 0, 1) * 255);
+}
+
+static void bmf_write_indicies_v2(SDL_RWops* file, const uint32_t* index_data, int num_indicies, int num_verticies) {
+  
+  uint32_t num = num_indicies;
+  uint32_t index_size = (num_verticies <= 65536) ? sizeof(uint16_t) : sizeof(uint32_t);
+  SDL_RWwrite(file, &num, sizeof(uint32_t), 1);
+  SDL_RWwrite(file, &index_size, sizeof(uint32_t), 1);
+  
+  if (index_size == sizeof(uint16_t)) {
+    uint16_t* short_data = malloc(sizeof(uint16_t) * num_indicies);
+    for(int i = 0; i < num_indicies; i++) {
+      uint32_t index;
+      memcpy(&index, &index_data[i], sizeof(uint32_t));
+      short_data[i] = index;
+    }
+    SDL_RWwrite(file, short_data, sizeof(uint16_t), num_indicies);
+    free(short_data);
+  } else {
+    SDL_RWwrite(file, index_data, sizeof(uint32_t), num_indicies);
+  }
+  
+}
+
+static void bmf_write_surface_v2(SDL_RWops* file, const void* vert_data, int num_verticies, bool is_rigged, const uint32_t* index_data, int num_indicies, int num_lods) {
+  
+  const int stride = is_rigged ? 24 : 18;
+  
+  vec3 pmin = vec3_new( FLT_MAX,  FLT_MAX,  FLT_MAX);
+  vec3 pmax = vec3_new(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+  for(int i = 0; i < num_verticies; i++) {
+    vec3 p = renderable_surface_position(vert_data, i, stride);
+    pmin = vec3_new(min(pmin.x, p.x), min(pmin.y, p.y), min(pmin.z, p.z));
+    pmax = vec3_new(max(pmax.x, p.x), max(pmax.y, p.y), max(pmax.z, p.z));
+  }
+  if (num_verticies == 0) { pmin = vec3_zero(); pmax = vec3_zero(); }
+  
+  vec3 extent = vec3_sub(pmax, pmin);
+  float quantization[6] = { pmin.x, pmin.y, pmin.z, extent.x, extent.y, extent.z };
+  
+  /* Grow the bound to cover the quantization error */
+  sphere bound = renderable_surface_bounding_sphere(vert_data, num_verticies, stride);
+  bound.radius += vec3_length(extent) / 65535;
+  float bound_data[4] = { bound.center.x, bound.center.y, bound.center.z, bound.radius };
+  
+  uint32_t num = num_verticies;
+  SDL_RWwrite(file, &num, sizeof(uint32_t), 1);
+  SDL_RWwrite(file, quantization, sizeof(float), 6);
+  SDL_RWwrite(file, bound_data, sizeof(float), 4);
+  
+  int vert_size = is_rigged ? sizeof(bmf_vertex_rigged_v2) : sizeof(bmf_vertex_v2);
+  char* out = calloc(num_verticies, vert_size);
+  
+  for(int i = 0; i < num_verticies; i++) {
+    
+    float v[24];
+    memcpy(v, (const char*)vert_data + sizeof(float) * stride * i, sizeof(float) * stride);
+    
+    bmf_vertex_rigged_v2* o = (bmf_vertex_rigged_v2*)(out + vert_size * i);
+    
+    float* scale = &quantization[3];
+    for(int j = 0; j < 3; j++) {
+      float t = (scale[j] == 0) ? 0 : (v[j] - quantization[j]) / scale[j];
+      o->base.position[j] = (uint16_t)roundf(clamp(t, 0, 1) * 65535);
+    }
+    
+    vec2 normal = bmf_octahedral_encode(vec3_new(v[3], v[4], v[5]));
+    vec2 tangent = bmf_octahedral_encode(vec3_new(v[6], v[7], v[8]));
+    vec2 binormal = bmf_octahedral_encode(vec3_new(v[9], v[10], v[11]));
+    
+    o->base.normal[0] = (int16_t)roundf(normal.x * 32767);
+    o->base.normal[1] = (int16_t)roundf(normal.y * 32767);
+    o->base.tangent[0] = (int16_t)roundf(tangent.x * 32767);
+    o->base.tangent[1] = (int16_t)roundf(tangent.y * 32767);
+    o->base.binormal[0] = (int8_t)roundf(binormal.x * 127);
+    o->base.binormal[1] = (int8_t)roundf(binormal.y * 127);
+    
+    o->base.uvs[0] = bmf_half_from_float(v[12]);
+    o->base.uvs[1] = bmf_half_from_float(v[13]);
+    
+    for(int j = 0; j < 4; j++) {
+      o->base.color[j] = bmf_unorm8(v[14+j]);
+    }
+    
+    if (is_rigged) {
+      for(int j = 0; j < 3; j++) {
+        o->bone_ids[j] = (uint8_t)clamp(v[18+j], 0, 255);
+        o->bone_weights[j] = bmf_unorm8(v[21+j]);
+      }
+    }
+  }
+  
+  SDL_RWwrite(file, out, vert_size, num_verticies);
+  free(out);
+  
+  bmf_write_indicies_v2(file, index_data, num_indicies, num_verticies);
+  
+  /* Simplification only looks at positions, normals and uvs */
+  mesh m;
+  m.num_verts = num_verticies;
+  m.num_triangles = num_indicies / 3;
+  m.verticies = calloc(num_verticies, sizeof(vertex));
+  m.triangles = malloc(sizeof(uint32_t) * num_indicies);
+  memcpy(m.triangles, index_data, sizeof(uint32_t) * num_indicies);
+  
+  for(int i = 0; i < num_verticies; i++) {
+    float v[24];
+    memcpy(v, (const char*)vert_data + sizeof(float) * stride * i, sizeof(float) * stride);
+    m.verticies[i].position = vec3_new(v[0], v[1], v[2]);
+    m.verticies[i].normal = vec3_new(v[3], v[4], v[5]);
+    m.verticies[i].uvs = vec2_new(v[12], v[13]);
+  }
+  
+  uint32_t* lod_indicies[RENDERABLE_MAX_LODS];
+  int lod_triangles[RENDERABLE_MAX_LODS];
+  float lod_errors[RENDERABLE_MAX_LODS];
+  
+  uint32_t count = renderable_lod_chain(&m, num_lods, lod_indicies, lod_triangles, lod_errors);
+  SDL_RWwrite(file, &count, sizeof(uint32_t), 1);
+  
+  for(int i = 0; i < count; i++) {
+    SDL_RWwrite(file, &lod_errors[i], sizeof(float), 1);
+    bmf_write_indicies_v2(file, lod_indicies[i], lod_triangles[i] * 3, num_verticies);
+    free(lod_indicies[i]);
+  }
+  
+  free(m.verticies);
+  free(m.triangles);
+  
+}
+
+static void bmf_decode_verticies_v2(float* vert_data, const char* in, int num_verticies, bool is_rigged, const float* quantization) {
+  
+  const int stride = is_rigged ? 24 : 18;
+  const int vert_size = is_rigged ? sizeof(bmf_vertex_rigged_v2) : sizeof(bmf_vertex_v2);
+  
+  for(int i = 0; i < num_verticies; i++) {
+    
+    bmf_vertex_rigged_v2 o;
+    memcpy(&o, in + vert_size * i, vert_size);
+    
+    float* v = &vert_data[i * stride];
+    
+    for(int j = 0; j < 3; j++) {
+      v[j] = quantization[j] + (o.base.position[j] / 65535.0) * quantization[3+j];
+    }
+    
+    vec3 normal = bmf_octahedral_decode(vec2_new(o.base.normal[0] / 32767.0, o.base.normal[1] / 32767.0));
+    vec3 tangent = bmf_octahedral_decode(vec2_new(o.base.tangent[0] / 32767.0, o.base.tangent[1] / 32767.0));
+    vec3 binormal = bmf_octahedral_decode(vec2_new(o.base.binormal[0] / 127.0, o.base.binormal[1] / 127.0));
+    
+    v[3] = normal.x;   v[4] = normal.y;   v[5] = normal.z;
+    v[6] = tangent.x;  v[7] = tangent.y;  v[8] = tangent.z;
+    v[9] = binormal.x; v[10] = binormal.y; v[11] = binormal.z;
+    
+    v[12] = bmf_half_to_float(o.base.uvs[0]);
+    v[13] = bmf_half_to_float(o.base.uvs[1]);
+    
+    for(int j = 0; j < 4; j++) {
+      v[14+j] = o.base.color[j] / 255.0;
+    }
+    
+    if (is_rigged) {
+      for(int j = 0; j < 3; j++) {
+        v[18+j] = o.bone_ids[j];
+        v[21+j] = o.bone_weights[j] / 255.0;
+      }
+    }
+  }
+  
+}
+
+/* Reads data in place when the file is buffered, otherwise into scratch */
+static const void* bmf_read_data(SDL_RWops* file, int size, void** scratch) {
+  
+  const void* data = SDL_RWreadinplace(file, size);
+  if (data != NULL) { return data; }
+  
+  *scratch = realloc(*scratch, size);
+  SDL_RWread(file, *scratch, size, 1);
+  return *scratch;
+}
+
+/* Reads indicies into a new array, widening them to 32 bits if needed */
+static uint32_t* bmf_read_indicies(SDL_RWops* file, int num_indicies, int index_size, void** scratch) {
+  
+  uint32_t* indicies = malloc(sizeof(uint32_t) * num_indicies);
+  
+  if (index_size != sizeof(uint16_t)) {
+    SDL_RWread(file, indicies, sizeof(uint32_t) * num_indicies, 1);
+    return indicies;
+  }
+  
+  const char* index_data = bmf_read_data(file, sizeof(uint16_t) * num_indicies, scratch);
+  for(int i = 0; i < num_indicies; i++) {
+    uint16_t index;
+    memcpy(&index, index_data + sizeof(uint16_t) * i, sizeof(uint16_t));
+    indicies[i] = index;
+  }
+  
+  return indicies;
+}
+
+int bmf_scan_file(char* filename, fpath* dependencies, int max) {
+  
+  /* Servers don't load the material */
+  if (net_is_server()) { return 0; }
+  
+  /* Only the header is needed so avoid buffering loose files */
+  SDL_RWops* file = SDL_RWFromPack(filename);
+  if (file == NULL) { file = SDL_RWFromFile(filename, "rb"); }
+  if (file == NULL || max < 1) { return 0; }
+  
+  char magic[3];
+  uint32_t version = 0;
+  char is_rigged;
+  uint32_t mat_len = 0;
+  
+  SDL_RWread(file, magic, 3, 1);
+  SDL_RWread(file, &version, sizeof(uint32_t), 1);
+  SDL_RWread(file, &is_rigged, 1, 1);
+  SDL_RWread(file, &mat_len, sizeof(uint32_t), 1);
+  
+  if (memcmp(magic, "BMF", 3) != 0 || mat_len >= MAX_PATH) {
+    SDL_RWclose(file);
+    return 0;
+  }
+  
+  SDL_RWread(file, dependencies[0].ptr, mat_len, 1);
+  dependencies[0].ptr[mat_len] = '\0';
+  
+  SDL_RWclose(file);
+  
+  return 1;
 }
 
 renderable* bmf_load_file(char* filename) {
+  return bmf_upload_file(filename, bmf_read_file(filename));
+}
 
-  renderable* r = malloc(sizeof(renderable));
+/*
+** The read stage decodes the whole file into the CPU copy
+** of each surface, leaving the upload stage only the GL
+** calls. Version 1 verticies are used straight out of the
+** file buffer when they can be, so the file is kept open
+** until the upload stage has copied them to the GPU.
+*/
+
+bmf_file* bmf_read_file(char* filename) {
   
-  SDL_RWops* file = SDL_RWFromFile(filename, "rb");
+  SDL_RWops* file = SDL_RWFromFileBuffered(filename, "rb");
   
   if(file == NULL) {
     error("Could not load file %s", filename);
+    return NULL;
   }
   
+  bmf_file* f = malloc(sizeof(bmf_file));
+  f->file = file;
+  
+  renderable* r = malloc(sizeof(renderable));
+  f->renderable = r;
+  
   char magic[4];
   SDL_RWread(file, &magic, 3, 1);
   magic[3] = '\0';
@@ -305,8 +867,8 @@ renderable* bmf_load_file(char* filename) {
   uint32_t version = 0;
   SDL_RWread(file, &version, sizeof(uint32_t), 1);
   
-  if (version != 1) {
-    error("Only version 1 of bmf format supported. Recieved file of version %i.", version);
+  if (version != 1 && version != 2) {
+    error("Only versions 1 and 2 of bmf format supported. Recieved file of version %i.", version);
   }
     
   SDL_RWread(file, &r->is_rigged, 1, 1);
@@ -314,59 +876,209 @@ renderable* bmf_load_file(char* filename) {
   uint32_t mat_len;
   SDL_RWread(file, &mat_len, sizeof(uint32_t), 1);
     
-  fpath material_path;
-  SDL_RWread(file, material_path.ptr, mat_len, 1);
-  material_path.ptr[mat_len] = '\0';
-    
-  r->material = asset_hndl_new_load(material_path);
+  SDL_RWread(file, f->material.ptr, mat_len, 1);
+  f->material.ptr[mat_len] = '\0';
+  
+  r->material = asset_hndl_null();
+  r->keep_geometry = false;
   
   uint32_t num_surfaces;
   SDL_RWread(file, &num_surfaces, sizeof(uint32_t), 1);
   r->num_surfaces = num_surfaces;
   
   r->surfaces = malloc(sizeof(renderable_surface*) * r->num_surfaces);
+  f->in_place = calloc(r->num_surfaces, sizeof(bool));
   
   const int stride = r->is_rigged ? 24 : 18;
   
+  /* Holds file data when it can't be used in place */
+  void* vert_scratch = NULL;
+  void* index_scratch = NULL;
+  
   for(int i = 0; i < r->num_surfaces; i++) {
     renderable_surface* s = malloc(sizeof(renderable_surface));
+    s->vertex_vbo = 0;
+    s->triangle_vbo = 0;
+    s->num_lods = 0;
     
     uint32_t num_verticies;
     SDL_RWread(file, &num_verticies, sizeof(uint32_t), 1);
     s->num_verticies = num_verticies;
     
-    float* vert_data = malloc(sizeof(float) * stride * s->num_verticies);
-    SDL_RWread(file, vert_data, sizeof(float) * stride * s->num_verticies, 1);
-    
-    s->bound = renderable_surface_bounding_sphere(vert_data, s->num_verticies, stride);
-    
-    glGenBuffers(1, &s->vertex_vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, s->vertex_vbo);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(float) * s->num_verticies * stride, vert_data, GL_STATIC_DRAW);
-    free(vert_data);
+    if (version == 1) {
+      
+      size_t vert_size = sizeof(float) * stride * s->num_verticies;
+      s->vertex_data = (float*)SDL_RWreadinplace(file, vert_size);
+      f->in_place[i] = s->vertex_data != NULL;
+      
+      if (!f->in_place[i]) {
+        s->vertex_data = malloc(vert_size);
+        SDL_RWread(file, s->vertex_data, vert_size, 1);
+      }
+      
+      s->bound = renderable_surface_bounding_sphere(s->vertex_data, s->num_verticies, stride);
+      
+    } else {
+      
+      float quantization[6];
+      float bound[4];
+      SDL_RWread(file, quantization, sizeof(float), 6);
+      SDL_RWread(file, bound, sizeof(float), 4);
+      s->bound = sphere_new(vec3_new(bound[0], bound[1], bound[2]), bound[3]);
+      
+      int vert_size = r->is_rigged ? sizeof(bmf_vertex_rigged_v2) : sizeof(bmf_vertex_v2);
+      const void* encoded = bmf_read_data(file, vert_size * s->num_verticies, &vert_scratch);
+      s->vertex_data = malloc(sizeof(float) * stride * s->num_verticies);
+      bmf_decode_verticies_v2(s->vertex_data, encoded, s->num_verticies, r->is_rigged, quantization);
+    }
     
     uint32_t num_indicies;
     SDL_RWread(file, &num_indicies, sizeof(uint32_t), 1);
     s->num_triangles = num_indicies / 3;
     
-    uint32_t* index_data = malloc(sizeof(uint32_t) * num_indicies);
-    SDL_RWread(file, index_data, sizeof(uint32_t) * num_indicies, 1);
-    glGenBuffers(1, &s->triangle_vbo);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, s->triangle_vbo);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(uint32_t) * num_indicies, index_data, GL_STATIC_DRAW);
-    free(index_data);
+    uint32_t index_size = sizeof(uint32_t);
+    if (version == 2) {
+      SDL_RWread(file, &index_size, sizeof(uint32_t), 1);
+    }
+    
+    s->triangle_data = bmf_read_indicies(file, num_indicies, index_size, &index_scratch);
+    
+    uint32_t num_lods = 0;
+    if (version == 2) {
+      SDL_RWread(file, &num_lods, sizeof(uint32_t), 1);
+    }
+    
+    for(int j = 0; j < num_lods; j++) {
+      
+      float error;
+      SDL_RWread(file, &error, sizeof(float), 1);
+      SDL_RWread(file, &num_indicies, sizeof(uint32_t), 1);
+      SDL_RWread(file, &index_size, sizeof(uint32_t), 1);
+      
+      uint32_t* lod_data = bmf_read_indicies(file, num_indicies, index_size, &index_scratch);
+      renderable_surface_add_lod(s, lod_data, num_indicies / 3, error);
+    }
     
     r->surfaces[i] = s;
   }
   
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  free(vert_scratch);
+  free(index_scratch);
   
-  SDL_RWclose(file);
+  return f;
+}
+
+/*
+** Uploads straight away unless this is a server, which
+** keeps the CPU copy and so must copy out any verticies
+** still pointing into the file before it is closed.
+*/
+renderable* bmf_upload_file(char* filename, bmf_file* f) {
+  
+  if (f == NULL) { return NULL; }
+  
+  renderable* r = f->renderable;
+  r->material = renderable_material(f->material);
+  
+  const int stride = r->is_rigged ? 24 : 18;
+  
+  for(int i = 0; i < r->num_surfaces; i++) {
+    
+    if (!f->in_place[i]) { continue; }
+    
+    renderable_surface* s = r->surfaces[i];
+    
+    if (net_is_server()) {
+      float* vertex_data = malloc(sizeof(float) * stride * s->num_verticies);
+      memcpy(vertex_data, s->vertex_data, sizeof(float) * stride * s->num_verticies);
+      s->vertex_data = vertex_data;
+    } else {
+      renderable_surface_upload(s, stride);
+      s->vertex_data = NULL;
+    }
+  }
+  
+  renderable_upload(r);
+  
+  SDL_RWclose(f->file);
+  free(f->in_place);
+  free(f);
   
   return r;
 }
 
+void bmf_convert_file(char* filename, char* output, int num_lods) {
+  
+  SDL_RWops* file = SDL_RWFromFileBuffered(filename, "rb");
+  
+  if(file == NULL) {
+    error("Could not load file %s", filename);
+  }
+  
+  char magic[3];
+  uint32_t version = 0;
+  char is_rigged;
+  uint32_t mat_len;
+  fpath material_path;
+  
+  SDL_RWread(file, magic, 3, 1);
+  SDL_RWread(file, &version, sizeof(uint32_t), 1);
+  
+  if (memcmp(magic, "BMF", 3) != 0 || version != 1) {
+    error("Can only convert version 1 bmf files. '%s' is not one.", filename);
+    SDL_RWclose(file);
+    return;
+  }
+  
+  SDL_RWread(file, &is_rigged, 1, 1);
+  SDL_RWread(file, &mat_len, sizeof(uint32_t), 1);
+  SDL_RWread(file, material_path.ptr, mat_len, 1);
+  
+  SDL_RWops* out = SDL_RWFromFile(output, "wb");
+  
+  if (out == NULL) {
+    error("Could not open file %s for writing", output);
+    SDL_RWclose(file);
+    return;
+  }
+  
+  version = 2;
+  SDL_RWwrite(out, "BMF", 3, 1);
+  SDL_RWwrite(out, &version, sizeof(uint32_t), 1);
+  SDL_RWwrite(out, &is_rigged, 1, 1);
+  SDL_RWwrite(out, &mat_len, sizeof(uint32_t), 1);
+  SDL_RWwrite(out, material_path.ptr, mat_len, 1);
+  
+  uint32_t num_surfaces;
+  SDL_RWread(file, &num_surfaces, sizeof(uint32_t), 1);
+  SDL_RWwrite(out, &num_surfaces, sizeof(uint32_t), 1);
+  
+  const int stride = is_rigged ? 24 : 18;
+  
+  void* vert_scratch = NULL;
+  void* index_scratch = NULL;
+  
+  for(int i = 0; i < num_surfaces; i++) {
+    
+    uint32_t num_verticies;
+    SDL_RWread(file, &num_verticies, sizeof(uint32_t), 1);
+    const void* vert_data = bmf_read_data(file, sizeof(float) * stride * num_verticies, &vert_scratch);
+    
+    uint32_t num_indicies;
+    SDL_RWread(file, &num_indicies, sizeof(uint32_t), 1);
+    const void* index_data = bmf_read_data(file, sizeof(uint32_t) * num_indicies, &index_scratch);
+    
+    bmf_write_surface_v2(out, vert_data, num_verticies, is_rigged, index_data, num_indicies, num_lods);
+  }
+  
+  free(vert_scratch);
+  free(index_scratch);
+  
+  SDL_RWclose(out);
+  SDL_RWclose(file);
+  
+}
+
 void bmf_save_file(renderable* r, char* filename) {
   
   SDL_RWops* file = SDL_RWFromFile(filename, "wb");
@@ -394,465 +1106,489 @@ void bmf_save_file(renderable* r, char* filename) {
     renderable_surface* s = r->surfaces[i];
     
     uint32_t num_verticies = s->num_verticies;
-    SDL_RWwrite(file, &num_verticies, sizeof(uint32_t), 1);
+    uint32_t num_indicies = s->num_triangles * 3;
     
     uint32_t vert_data_size = sizeof(float) * vertsize * num_verticies;
+    uint32_t index_data_size = sizeof(uint32_t) * num_indicies;
     float* vert_data = calloc(vert_data_size, 1);
-    glBindBuffer(GL_ARRAY_BUFFER, s->vertex_vbo);
-    glGetBufferSubData(GL_ARRAY_BUFFER, 0, vert_data_size, vert_data);
-    SDL_RWwrite(file, vert_data, 1, vert_data_size);
-    free(vert_data);
+    uint32_t* index_data = calloc(index_data_size, 1);
+    renderable_surface_read(s, vertsize, vert_data, index_data);
     
-    uint32_t num_indicies = s->num_triangles * 3;
+    SDL_RWwrite(file, &num_verticies, sizeof(uint32_t), 1);
+    SDL_RWwrite(file, vert_data, 1, vert_data_size);
     SDL_RWwrite(file, &num_indicies, sizeof(uint32_t), 1);
-    
-    uint32_t index_data_size = sizeof(uint32_t) * num_indicies;
-    uint32_t* index_data = calloc(index_data_size, 1);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, s->triangle_vbo);
-    glGetBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, index_data_size, index_data);
     SDL_RWwrite(file, index_data, 1, index_data_size);
+    
+    free(vert_data);
     free(index_data);
     
   }
   
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-  glBindBuffer(GL_ARRAY_BUFFER, 0);
-  
   SDL_RWclose(file);
     
 }
 
-renderable* obj_load_file(char* filename) {
-    
-  model* obj_model = malloc(sizeof(model));
-  obj_model->num_meshes = 0;
-  obj_model->meshes = malloc(sizeof(mesh*) * 0);
+/*
+** Imported meshes are reordered for the vertex cache, but
+** the new order is only kept if it lowers the ACMR, as
+** files exported already optimised can come out worse.
+** Rigged meshes have weights indexed by vertex so they
+** can only have their triangles reordered.
+*/
+
+enum {
+  RENDERABLE_ACMR_CACHE = 32
+};
+
+static void renderable_mesh_optimize(mesh* m, char* filename, bool reorder_verticies) {
   
-  mesh* active_mesh = NULL;
+  size_t triangles_size = sizeof(*m->triangles) * m->num_triangles * 3;
+  void* original = malloc(triangles_size);
+  memcpy(original, m->triangles, triangles_size);
   
-  vertex_list* vert_data = vertex_list_new();
-  vertex_list* vert_list = vertex_list_new();
-  int_list* tri_list = int_list_new();
-  vertex_hashtable* vert_hashes = vertex_hashtable_new(4096);
+  float before = mesh_acmr(m, RENDERABLE_ACMR_CACHE);
+  mesh_optimize_vertex_cache(m);
+  mesh_optimize_overdraw(m, 1.05);
+  float after = mesh_acmr(m, RENDERABLE_ACMR_CACHE);
   
-  int num_pos, num_norm, num_tex;
-  num_pos = num_norm = num_tex = 0;
+  debug("Optimized '%s', ACMR %0.3f before, %0.3f after", filename, before, after);
   
-  int vert_index = 0;
+  if (after >= before) {
+    memcpy(m->triangles, original, triangles_size);
+  } else if (reorder_verticies) {
+    mesh_optimize_vertex_fetch(m);
+  }
   
-  bool has_normal_data = false;
-  bool has_texcoord_data = false;
+  free(original);
+}
+
+renderable* obj_load_file(char* filename) {
+  return obj_upload_file(filename, obj_read_file(filename));
+}
+
+/*
+** OBJ files are parsed straight out of the file contents
+** rather than line by line with sscanf. Each line is
+** dispatched on its first token and numbers are parsed
+** by hand, which avoids any locale handling.
+*/
+
+static const double obj_powers_of_ten[] = {
+  1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+  1e8,  1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+  1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static const char* obj_skip_space(const char* c) {
+  while (*c == ' ' || *c == '\t') { c++; }
+  return c;
+}
+
+static const char* obj_skip_line(const char* c) {
+  while (*c != '\0' && *c != '\n') { c++; }
+  return c+1;
+}
+
+static bool obj_end_of_line(const char* c) {
+  return (*c == '\0') || (*c == '\n') || (*c == '\r') || (*c == '#');
+}
+
+static const char* obj_parse_int(const char* c, int* out) {
   
-  SDL_RWops* file = SDL_RWFromFile(filename, "r");
+  bool negative = false;
+  if (*c == '-') { negative = true; c++; }
+  else if (*c == '+') { c++; }
   
-  if(file == NULL) {
-    error("Could not load file %s", filename);
+  int value = 0;
+  while (*c >= '0' && *c <= '9') {
+    value = value * 10 + (*c - '0');
+    c++;
   }
   
-  char line[1024];
-  while(SDL_RWreadline(file, line, 1024)) {
-    
-    char comment[512];
-    char matlib[512];
-    char object[512];
-    char group[512];
-    char material[512];
-    float px, py, pz, tx, ty, nx, ny, nz;
-    int smoothing_group;
-    int pi1, ti1, ni1, pi2, ti2, ni2, pi3, ti3, ni3;
-    
-    if (sscanf(line, "# %512s", comment) == 1) {
-      /* Comment, do nothing */
-    }
-    
-    else if (sscanf(line, "mtllib %512s", matlib) == 1) {
-      /* Do Nothing */
-    }
-    
-    else if (sscanf(line, "o %512s", object) == 1) {
-      /* Do Nothing */
-    }
-    
-    else if (sscanf(line, "v %f %f %f", &px, &py, &pz) == 3) {
-    
-      while(vert_data->num_items <= num_pos) { vertex_list_push_back(vert_data, vertex_new()); }
-      vertex vert = vertex_list_get(vert_data, num_pos);
-      vert.position = vec3_new(px, py, pz);
-      vertex_list_set(vert_data, num_pos, vert);
-      num_pos++;
-    }
-    
-    else if (sscanf(line, "vt %f %f", &tx, &ty) == 2) {
-    
-      while(vert_data->num_items <= num_tex) { vertex_list_push_back(vert_data, vertex_new()); }
-      vertex vert = vertex_list_get(vert_data, num_tex);
-      vert.uvs = vec2_new(tx, ty);
-      vertex_list_set(vert_data, num_tex, vert);
-      num_tex++;
-    }
-    
-    else if (sscanf(line, "vn %f %f %f", &nx, &ny, &nz) == 3) {
-    
-      while(vert_data->num_items <= num_norm) { vertex_list_push_back(vert_data, vertex_new()); }
-      vertex vert = vertex_list_get(vert_data, num_norm);
-      vert.normal = vec3_new(nx, ny, nz);
-      vertex_list_set(vert_data, num_norm, vert);
-      num_norm++;
-    }
-    
-    else if (sscanf(line, "g %512s", group) == 1) {
-        
-      if (active_mesh != NULL) {
-      
-        active_mesh->num_verts = vert_index;
-        active_mesh->num_triangles = tri_list->num_items / 3;
-        
-        active_mesh->verticies = malloc(sizeof(vertex) * active_mesh->num_verts);
-        for(int i = 0; i < active_mesh->num_verts; i++) {
-          active_mesh->verticies[i] = vertex_list_get(vert_list, i);
-        }
-        
-        active_mesh->triangles = malloc(sizeof(int) * active_mesh->num_triangles * 3);
-        for(int i = 0; i < active_mesh->num_triangles * 3; i++) {
-          active_mesh->triangles[i] = int_list_get(tri_list, i);
-        }
-      
-        obj_model->num_meshes++;
-        obj_model->meshes = realloc(obj_model->meshes, sizeof(mesh*) * obj_model->num_meshes);
-        obj_model->meshes[obj_model->num_meshes-1] = active_mesh;
-        
-      }
-      
-      vert_index = 0;
-      
-      vertex_hashtable_delete(vert_hashes);
-      vertex_list_delete(vert_list);
-      int_list_delete(tri_list);
-      
-      vert_list = vertex_list_new();
-      tri_list = int_list_new();
-      vert_hashes = vertex_hashtable_new(4096);
-      
-      active_mesh = malloc(sizeof(mesh));
-      
-    }
-    
-    else if (sscanf(line, "usemtl %512s", material) == 1) {
-      /* Do Nothing */
-    }
-    
-    else if (sscanf(line, "s %i", &smoothing_group) == 1) {
-      /* Smoothing group, do nothing */
-    }
-    
-    else if (sscanf(line, "f %i/%i/%i %i/%i/%i %i/%i/%i", &pi1, &ti1, &ni1, &pi2, &ti2, &ni2, &pi3, &ti3, &ni3) == 9) {
-      
-      if (active_mesh == NULL) {
-        vert_index = 0;
-        
-        vertex_hashtable_delete(vert_hashes);
-        vertex_list_delete(vert_list);
-        int_list_delete(tri_list);
-        
-        vert_list = vertex_list_new();
-        tri_list = int_list_new();
-        vert_hashes = vertex_hashtable_new(4096);
-        
-        active_mesh = malloc(sizeof(mesh));
-      }
-      
-      has_normal_data = true;
-      has_texcoord_data = true;
-      
-      /* OBJ file indicies start from one, have to subtract one */
-      pi1--; ti1--; ni1--; pi2--; ti2--; ni2--; pi3--; ti3--; ni3--;
-      
-      vertex v1, v2, v3;
-      v1.position = vertex_list_get(vert_data, pi1).position;
-      v1.uvs = vertex_list_get(vert_data, ti1).uvs;
-      v1.normal = vertex_list_get(vert_data, ni1).normal;
-      
-      v2.position = vertex_list_get(vert_data, pi2).position;
-      v2.uvs = vertex_list_get(vert_data, ti2).uvs;
-      v2.normal = vertex_list_get(vert_data, ni2).normal;
-      
-      v3.position = vertex_list_get(vert_data, pi3).position;
-      v3.uvs = vertex_list_get(vert_data, ti3).uvs;
-      v3.normal = vertex_list_get(vert_data, ni3).normal;
-      
-      int v1_id = vertex_hashtable_get(vert_hashes, v1);
-      if ( v1_id == -1 ) {
-        vertex_hashtable_set(vert_hashes, v1, vert_index);
-        vertex_list_push_back(vert_list, v1);
-        int_list_push_back(tri_list, vert_index);
-        vert_index++;
-      } else {
-        int_list_push_back(tri_list, v1_id);
-      }
-      
-      int v2_id = vertex_hashtable_get(vert_hashes, v2);
-      if ( v2_id == -1 ) {
-        vertex_hashtable_set(vert_hashes, v2, vert_index);
-        vertex_list_push_back(vert_list, v2);
-        int_list_push_back(tri_list, vert_index);
-        vert_index++;
-      } else {
-        int_list_push_back(tri_list, v2_id);
-      }
-      
-      int v3_id = vertex_hashtable_get(vert_hashes, v3);
-      if ( v3_id == -1 ) {
-        vertex_hashtable_set(vert_hashes, v3, vert_index);
-        vertex_list_push_back(vert_list, v3);
-        int_list_push_back(tri_list, vert_index);
-        vert_index++;
-      } else {
-        int_list_push_back(tri_list, v3_id);
-      }
-      
+  *out = negative ? -value : value;
+  return c;
+}
+
+static const char* obj_parse_float(const char* c, float* out) {
+  
+  c = obj_skip_space(c);
+  
+  bool negative = false;
+  if (*c == '-') { negative = true; c++; }
+  else if (*c == '+') { c++; }
+  
+  /* Only the first 19 significant digits fit in the mantissa */
+  uint64_t mantissa = 0;
+  int digits = 0;
+  int exponent = 0;
+  
+  while (*c >= '0' && *c <= '9') {
+    if (digits < 19) {
+      mantissa = mantissa * 10 + (*c - '0');
+      if (mantissa != 0) { digits++; }
+    } else {
+      exponent++;
     }
-    
-    else if (sscanf(line, "f %i//%i %i//%i %i//%i", &pi1, &ni1, &pi2, &ni2, &pi3, &ni3) == 6) {
-      
-      if (active_mesh == NULL) {
-        vert_index = 0;
-        
-        vertex_hashtable_delete(vert_hashes);
-        vertex_list_delete(vert_list);
-        int_list_delete(tri_list);
-        
-        vert_list = vertex_list_new();
-        tri_list = int_list_new();
-        vert_hashes = vertex_hashtable_new(4096);
-        
-        active_mesh = malloc(sizeof(mesh));
-      }
-      
-      has_normal_data = true;
-      has_texcoord_data = false;
-      
-      /* OBJ file indicies start from one, have to subtract one */
-      pi1--; ni1--; pi2--; ni2--; pi3--; ni3--;
-      
-      vertex v1, v2, v3;
-      v1.position = vertex_list_get(vert_data, pi1).position;
-      v1.uvs = vec2_zero();
-      v1.normal = vertex_list_get(vert_data, ni1).normal;
-      
-      v2.position = vertex_list_get(vert_data, pi2).position;
-      v2.uvs = vec2_zero();
-      v2.normal = vertex_list_get(vert_data, ni2).normal;
-      
-      v3.position = vertex_list_get(vert_data, pi3).position;
-      v3.uvs = vec2_zero();
-      v3.normal = vertex_list_get(vert_data, ni3).normal;
-      
-      int v1_id = vertex_hashtable_get(vert_hashes, v1);
-      if ( v1_id == -1 ) {
-        vertex_hashtable_set(vert_hashes, v1, vert_index);
-        vertex_list_push_back(vert_list, v1);
-        int_list_push_back(tri_list, vert_index);
-        vert_index++;
-      } else {
-        int_list_push_back(tri_list, v1_id);
-      }
-      
-      int v2_id = vertex_hashtable_get(vert_hashes, v2);
-      if ( v2_id == -1 ) {
-        vertex_hashtable_set(vert_hashes, v2, vert_index);
-        vertex_list_push_back(vert_list, v2);
-        int_list_push_back(tri_list, vert_index);
-        vert_index++;
-      } else {
-        int_list_push_back(tri_list, v2_id);
-      }
-      
-      int v3_id = vertex_hashtable_get(vert_hashes, v3);
-      if ( v3_id == -1 ) {
-        vertex_hashtable_set(vert_hashes, v3, vert_index);
-        vertex_list_push_back(vert_list, v3);
-        int_list_push_back(tri_list, vert_index);
-        vert_index++;
-      } else {
-        int_list_push_back(tri_list, v3_id);
+    c++;
+  }
+  
+  if (*c == '.') {
+    c++;
+    while (*c >= '0' && *c <= '9') {
+      if (digits < 19) {
+        mantissa = mantissa * 10 + (*c - '0');
+        if (mantissa != 0) { digits++; }
+        exponent--;
       }
-      
+      c++;
     }
+  }
+  
+  if (*c == 'e' || *c == 'E') {
+    int e;
+    c = obj_parse_int(c+1, &e);
+    exponent += e;
+  }
+  
+  double value = (double)mantissa;
+  
+  while (exponent < -22) { value /= 1e22; exponent += 22; }
+  while (exponent >  22) { value *= 1e22; exponent -= 22; }
+  
+  if (exponent < 0) {
+    value /= obj_powers_of_ten[-exponent];
+  } else {
+    value *= obj_powers_of_ten[exponent];
+  }
+  
+  *out = negative ? -value : value;
+  return c;
+}
+
+/*
+** Face corners are welded on their (position, texcoord, normal)
+** index triple. This is exact and much cheaper than hashing
+** the full vertex. The table uses open addressing and grows
+** when it becomes more than 3/4 full.
+*/
+
+typedef struct {
+  int size;
+  int num_items;
+  int* keys;
+  int* values;
+} obj_weld_index;
+
+static uint32_t obj_weld_hash(const int* key) {
+  uint32_t h = (uint32_t)key[0] * 73856093u;
+  h ^= (uint32_t)key[1] * 19349663u;
+  h ^= (uint32_t)key[2] * 83492791u;
+  h ^= h >> 16;
+  h *= 0x85ebca6bu;
+  h ^= h >> 13;
+  return h;
+}
+
+static void obj_weld_alloc(obj_weld_index* w, int size) {
+  w->size = size;
+  w->num_items = 0;
+  w->keys = malloc(sizeof(int) * 3 * size);
+  w->values = malloc(sizeof(int) * size);
+  for(int i = 0; i < size; i++) { w->values[i] = -1; }
+}
+
+static int obj_weld_slot(obj_weld_index* w, const int* key) {
+  
+  int mask = w->size - 1;
+  int i = obj_weld_hash(key) & mask;
+  
+  while (w->values[i] != -1) {
+    int* k = &w->keys[i*3];
+    if (k[0] == key[0] && k[1] == key[1] && k[2] == key[2]) { return i; }
+    i = (i + 1) & mask;
+  }
+  
+  return i;
+}
+
+static void obj_weld_resize(obj_weld_index* w, int size) {
+  
+  int old_size = w->size;
+  int* old_keys = w->keys;
+  int* old_values = w->values;
+  
+  obj_weld_alloc(w, size);
+  
+  for(int i = 0; i < old_size; i++) {
+    if (old_values[i] == -1) { continue; }
+    int j = obj_weld_slot(w, &old_keys[i*3]);
+    memcpy(&w->keys[j*3], &old_keys[i*3], sizeof(int) * 3);
+    w->values[j] = old_values[i];
+    w->num_items++;
+  }
+  
+  free(old_keys);
+  free(old_values);
+}
+
+static void obj_weld_clear(obj_weld_index* w) {
+  for(int i = 0; i < w->size; i++) { w->values[i] = -1; }
+  w->num_items = 0;
+}
+
+typedef struct {
+  
+  vec3* positions;
+  vec3* normals;
+  vec2* texcoords;
+  int num_positions, num_normals, num_texcoords;
+  int cap_positions, cap_normals, cap_texcoords;
+  
+  vertex* verts;
+  uint32_t* tris;
+  int num_verts, num_tris;
+  int cap_verts, cap_tris;
+  
+  obj_weld_index weld;
+  
+  int line;
+  bool has_normal_data;
+  bool has_texcoord_data;
+  
+} obj_parser;
+
+static void* obj_reserve(void* data, int* capacity, int count, size_t stride) {
+  if (count < *capacity) { return data; }
+  while (*capacity <= count) { *capacity = (*capacity == 0) ? 1024 : *capacity * 2; }
+  return realloc(data, stride * (*capacity));
+}
+
+static void obj_parser_flush(obj_parser* p, model* m) {
+  
+  if (p->num_tris == 0) { return; }
+  
+  mesh* me = malloc(sizeof(mesh));
+  me->num_verts = p->num_verts;
+  me->num_triangles = p->num_tris / 3;
+  me->verticies = realloc(p->verts, sizeof(vertex) * p->num_verts);
+  me->triangles = realloc(p->tris, sizeof(uint32_t) * p->num_tris);
+  
+  m->num_meshes++;
+  m->meshes = realloc(m->meshes, sizeof(mesh*) * m->num_meshes);
+  m->meshes[m->num_meshes-1] = me;
+  
+  p->verts = NULL; p->num_verts = 0; p->cap_verts = 0;
+  p->tris = NULL; p->num_tris = 0; p->cap_tris = 0;
+  obj_weld_clear(&p->weld);
+}
+
+static int obj_resolve_index(int index, int count) {
+  if (index > 0) { return index - 1; }
+  if (index < 0) { return count + index; }
+  return -1;
+}
+
+static int obj_parser_corner(obj_parser* p, int* key) {
+  
+  int i = obj_weld_slot(&p->weld, key);
+  if (p->weld.values[i] != -1) { return p->weld.values[i]; }
+  
+  vertex v;
+  v.position = p->positions[key[0]];
+  v.uvs = (key[1] == -1) ? vec2_zero() : p->texcoords[key[1]];
+  v.normal = (key[2] == -1) ? vec3_zero() : p->normals[key[2]];
+  v.tangent = vec3_zero();
+  v.binormal = vec3_zero();
+  v.color = vec4_one();
+  
+  p->verts = obj_reserve(p->verts, &p->cap_verts, p->num_verts, sizeof(vertex));
+  p->verts[p->num_verts] = v;
+  
+  memcpy(&p->weld.keys[i*3], key, sizeof(int) * 3);
+  p->weld.values[i] = p->num_verts;
+  p->weld.num_items++;
+  
+  if (p->weld.num_items * 4 > p->weld.size * 3) {
+    obj_weld_resize(&p->weld, p->weld.size * 2);
+  }
+  
+  return p->num_verts++;
+}
+
+/*
+** Parses whole lines from c up to end. Every scan stops at
+** a newline, so as long as the last line ends in one the
+** contents need no NUL terminator and can be parsed in
+** place from the file buffer.
+*/
+static void obj_parser_lines(obj_parser* p, model* m, const char* c, const char* end, char* filename) {
+  
+  while (c < end) {
     
-    else if (sscanf(line, "f %i/%i %i/%i %i/%i", &pi1, &ti1, &pi2, &ti2, &pi3, &ti3) == 6) {
-      
-      if (active_mesh == NULL) {
-        vert_index = 0;
-        
-        vertex_hashtable_delete(vert_hashes);
-        vertex_list_delete(vert_list);
-        int_list_delete(tri_list);
-        
-        vert_list = vertex_list_new();
-        tri_list = int_list_new();
-        vert_hashes = vertex_hashtable_new(4096);
-        
-        active_mesh = malloc(sizeof(mesh));
-      }
-      
-      has_normal_data = false;
-      has_texcoord_data = true;
-      
-      /* OBJ file indicies start from one, have to subtract one */
-      pi1--; ti1--; pi2--; ti2--; pi3--; ti3--;
-      
-      vertex v1, v2, v3;
-      v1.position = vertex_list_get(vert_data, pi1).position;
-      v1.uvs = vertex_list_get(vert_data, ti1).uvs;
-      v1.normal = vec3_zero();
-      
-      v2.position = vertex_list_get(vert_data, pi2).position;
-      v2.uvs = vertex_list_get(vert_data, ti2).uvs;
-      v2.normal = vec3_zero();
-      
-      v3.position = vertex_list_get(vert_data, pi3).position;
-      v3.uvs = vertex_list_get(vert_data, ti3).uvs;
-      v3.normal = vec3_zero();
+    c = obj_skip_space(c);
+    
+    if (c[0] == 'v' && (c[1] == ' ' || c[1] == '\t')) {
       
-      int v1_id = vertex_hashtable_get(vert_hashes, v1);
-      if ( v1_id == -1 ) {
-        vertex_hashtable_set(vert_hashes, v1, vert_index);
-        vertex_list_push_back(vert_list, v1);
-        int_list_push_back(tri_list, vert_index);
-        vert_index++;
-      } else {
-        int_list_push_back(tri_list, v1_id);
-      }
+      vec3 v;
+      c = obj_parse_float(c+1, &v.x);
+      c = obj_parse_float(c, &v.y);
+      c = obj_parse_float(c, &v.z);
+      p->positions = obj_reserve(p->positions, &p->cap_positions, p->num_positions, sizeof(vec3));
+      p->positions[p->num_positions++] = v;
+    
+    } else if (c[0] == 'v' && c[1] == 't') {
       
-      int v2_id = vertex_hashtable_get(vert_hashes, v2);
-      if ( v2_id == -1 ) {
-        vertex_hashtable_set(vert_hashes, v2, vert_index);
-        vertex_list_push_back(vert_list, v2);
-        int_list_push_back(tri_list, vert_index);
-        vert_index++;
-      } else {
-        int_list_push_back(tri_list, v2_id);
-      }
+      vec2 v;
+      c = obj_parse_float(c+2, &v.x);
+      c = obj_parse_float(c, &v.y);
+      p->texcoords = obj_reserve(p->texcoords, &p->cap_texcoords, p->num_texcoords, sizeof(vec2));
+      p->texcoords[p->num_texcoords++] = v;
+    
+    } else if (c[0] == 'v' && c[1] == 'n') {
       
-      int v3_id = vertex_hashtable_get(vert_hashes, v3);
-      if ( v3_id == -1 ) {
-        vertex_hashtable_set(vert_hashes, v3, vert_index);
-        vertex_list_push_back(vert_list, v3);
-        int_list_push_back(tri_list, vert_index);
-        vert_index++;
-      } else {
-        int_list_push_back(tri_list, v3_id);
-      }
+      vec3 v;
+      c = obj_parse_float(c+2, &v.x);
+      c = obj_parse_float(c, &v.y);
+      c = obj_parse_float(c, &v.z);
+      p->normals = obj_reserve(p->normals, &p->cap_normals, p->num_normals, sizeof(vec3));
+      p->normals[p->num_normals++] = v;
+    
+    } else if (c[0] == 'f' && (c[1] == ' ' || c[1] == '\t')) {
       
-    }
-    
-    else if (sscanf(line, "f %i %i %i", &pi1, &pi2, &pi3) == 3) {
+      /* Polygons are triangulated as a fan around the first corner */
+      int first = -1, prev = -1, corners = 0;
       
-      if (active_mesh == NULL) {
-        vert_index = 0;
+      c = obj_skip_space(c+1);
+      while (!obj_end_of_line(c)) {
         
-        vertex_hashtable_delete(vert_hashes);
-        vertex_list_delete(vert_list);
-        int_list_delete(tri_list);
+        int key[3] = {0, 0, 0};
+        c = obj_parse_int(c, &key[0]);
+        if (*c == '/') {
+          if (c[1] != '/') { c = obj_parse_int(c+1, &key[1]); }
+          else { c++; }
+          if (*c == '/') { c = obj_parse_int(c+1, &key[2]); }
+        }
         
-        vert_list = vertex_list_new();
-        tri_list = int_list_new();
-        vert_hashes = vertex_hashtable_new(4096);
+        key[0] = obj_resolve_index(key[0], p->num_positions);
+        key[1] = obj_resolve_index(key[1], p->num_texcoords);
+        key[2] = obj_resolve_index(key[2], p->num_normals);
         
-        active_mesh = malloc(sizeof(mesh));
-      }
-      
-      has_normal_data = false;
-      has_texcoord_data = false;
-      
-      /* OBJ file indicies start from one, have to subtract one */
-      pi1--; pi2--; pi3--;
-      
-      vertex v1, v2, v3;
-      v1.position = vertex_list_get(vert_data, pi1).position;
-      v1.uvs = vec2_zero();
-      v1.normal = vec3_zero();
-      
-      v2.position = vertex_list_get(vert_data, pi2).position;
-      v2.uvs = vec2_zero();
-      v2.normal = vec3_zero();
-      
-      v3.position = vertex_list_get(vert_data, pi3).position;
-      v3.uvs = vec2_zero();
-      v3.normal = vec3_zero();
-      
-      int v1_id = vertex_hashtable_get(vert_hashes, v1);
-      if ( v1_id == -1 ) {
-        vertex_hashtable_set(vert_hashes, v1, vert_index);
-        vertex_list_push_back(vert_list, v1);
-        int_list_push_back(tri_list, vert_index);
-        vert_index++;
-      } else {
-        int_list_push_back(tri_list, v1_id);
-      }
-      
-      int v2_id = vertex_hashtable_get(vert_hashes, v2);
-      if ( v2_id == -1 ) {
-        vertex_hashtable_set(vert_hashes, v2, vert_index);
-        vertex_list_push_back(vert_list, v2);
-        int_list_push_back(tri_list, vert_index);
-        vert_index++;
-      } else {
-        int_list_push_back(tri_list, v2_id);
-      }
-      
-      int v3_id = vertex_hashtable_get(vert_hashes, v3);
-      if ( v3_id == -1 ) {
-        vertex_hashtable_set(vert_hashes, v3, vert_index);
-        vertex_list_push_back(vert_list, v3);
-        int_list_push_back(tri_list, vert_index);
-        vert_index++;
-      } else {
-        int_list_push_back(tri_list, v3_id);
+        if ((key[0] < 0 || key[0] >= p->num_positions) ||
+            (key[1] >= p->num_texcoords) ||
+            (key[2] >= p->num_normals)) {
+          error("Invalid face index in '%s' on line %i", filename, p->line);
+          break;
+        }
+        
+        if (key[1] == -1) { p->has_texcoord_data = false; }
+        if (key[2] == -1) { p->has_normal_data = false; }
+        
+        int index = obj_parser_corner(p, key);
+        
+        if (corners == 0) { first = index; }
+        if (corners >= 2) {
+          p->tris = obj_reserve(p->tris, &p->cap_tris, p->num_tris+2, sizeof(uint32_t));
+          p->tris[p->num_tris++] = first;
+          p->tris[p->num_tris++] = prev;
+          p->tris[p->num_tris++] = index;
+        }
+        
+        prev = index;
+        corners++;
+        
+        c = obj_skip_space(c);
       }
-      
+    
+    } else if (c[0] == 'g' && (c[1] == ' ' || c[1] == '\t' || c[1] == '\r' || c[1] == '\n')) {
+      obj_parser_flush(p, m);
     }
     
+    /* Comments, mtllib, o, usemtl, s and anything unknown are ignored */
+    c = obj_skip_line(c);
+    p->line++;
   }
+}
 
-  SDL_RWclose(file);
+model* obj_read_file(char* filename) {
   
-  if (active_mesh == NULL) {
-    error("Unable to load file '%s', it appears to be empty.", filename);
+  SDL_RWops* file = SDL_RWFromFileBuffered(filename, "r");
+  
+  if(file == NULL) {
+    error("Could not load file %s", filename);
   }
   
-  active_mesh->num_verts = vert_index;
-  active_mesh->num_triangles = tri_list->num_items / 3;
+  int size;
+  SDL_RWsize(file, &size);
   
-  active_mesh->verticies = malloc(sizeof(vertex) * active_mesh->num_verts);
-  for(int i = 0; i < active_mesh->num_verts; i++) {
-    active_mesh->verticies[i] = vertex_list_get(vert_list, i);
+  char* copy = NULL;
+  const char* contents = SDL_RWreadinplace(file, size);
+  if (contents == NULL) {
+    copy = malloc(size);
+    SDL_RWread(file, copy, size, 1);
+    contents = copy;
   }
   
-  active_mesh->triangles = malloc(sizeof(int) * active_mesh->num_triangles * 3);
-  for(int i = 0; i < active_mesh->num_triangles * 3; i++) {
-    active_mesh->triangles[i] = int_list_get(tri_list, i);
+  /* Only a last line without a newline needs copying out */
+  const char* end = contents + size;
+  const char* last = end;
+  while (last > contents && last[-1] != '\n') { last--; }
+  
+  model* obj_model = malloc(sizeof(model));
+  obj_model->num_meshes = 0;
+  obj_model->meshes = malloc(sizeof(mesh*) * 0);
+  
+  obj_parser p;
+  memset(&p, 0, sizeof(obj_parser));
+  obj_weld_alloc(&p.weld, 4096);
+  p.line = 1;
+  p.has_normal_data = true;
+  p.has_texcoord_data = true;
+  
+  obj_parser_lines(&p, obj_model, contents, last, filename);
+  
+  if (last != end) {
+    int len = end - last;
+    char* tail = malloc(len + 1);
+    memcpy(tail, last, len);
+    tail[len] = '\n';
+    obj_parser_lines(&p, obj_model, tail, tail + len + 1, filename);
+    free(tail);
   }
   
-  obj_model->num_meshes++;
-  obj_model->meshes = realloc(obj_model->meshes, sizeof(mesh*) * obj_model->num_meshes);
-  obj_model->meshes[obj_model->num_meshes-1] = active_mesh;
+  SDL_RWclose(file);
+  free(copy);
+  
+  obj_parser_flush(&p, obj_model);
   
-  vertex_hashtable_delete(vert_hashes);
-  vertex_list_delete(vert_data);
-  vertex_list_delete(vert_list);
-  int_list_delete(tri_list);
+  free(p.positions);
+  free(p.normals);
+  free(p.texcoords);
+  free(p.weld.keys);
+  free(p.weld.values);
+  
+  if (obj_model->num_meshes == 0) {
+    error("Unable to load file '%s', it appears to be empty.", filename);
+  }
   
-  if (!has_normal_data) {
+  if (!p.has_normal_data) {
     model_generate_normals(obj_model);
   }
   
-  if (!has_texcoord_data) {
+  if (!p.has_texcoord_data) {
     model_generate_texcoords_cylinder(obj_model);
   }
   
   model_generate_tangents(obj_model);
   
+  for(int i = 0; i < obj_model->num_meshes; i++) {
+    renderable_mesh_optimize(obj_model->meshes[i], filename, true);
+  }
+  
+  return obj_model;
+}
+
+renderable* obj_upload_file(char* filename, model* obj_model) {
+  
   renderable* renderable = renderable_new();
   renderable_add_model(renderable, obj_model);
   model_delete(obj_model);
@@ -876,6 +1612,8 @@ renderable* obj_load_file(char* filename) {
   strcat(bmf_file.ptr, ".bmf");
   bmf_save_file(renderable, bmf_file.ptr);
   
+  renderable_upload(renderable);
+  
   return renderable;
 }
 
@@ -894,7 +1632,7 @@ enum {
   STATE_LOAD_TRIANGLES = 1,
 };
 
-renderable* smd_load_file(char* filename) {
+static void smd_add_file(renderable* r, char* filename) {
   
   int state = STATE_LOAD_EMPTY;
   char state_material[1024];
@@ -908,13 +1646,12 @@ renderable* smd_load_file(char* filename) {
   
   int vert_index = 0;
   
-  SDL_RWops* file = SDL_RWFromFile(filename, "r");
+  SDL_RWops* file = SDL_RWFromFileBuffered(filename, "r");
   
   if(file == NULL) {
     error("Could not load file %s", filename);
   }
   
-  renderable* r = renderable_new();
   r->is_rigged = true;
   
   char line[1024];
@@ -967,11 +1704,10 @@ renderable* smd_load_file(char* filename) {
         vert.tangent = vec3_zero();
         vert.binormal = vec3_zero();
         
-        int vert_pos = vertex_hashtable_get(hashes, vert);
+        int vert_pos = vertex_hashtable_get_or_set(hashes, vert, vert_index);
         
         /* Not already in hashtable */
         if (vert_pos == -1) {
-          vertex_hashtable_set(hashes, vert, vert_index);
           vert_pos = vert_index;
           vertex_list_push_back(vert_list, vert);
           
@@ -1031,6 +1767,7 @@ renderable* smd_load_file(char* filename) {
           }
           
           mesh_generate_tangents(m);
+          renderable_mesh_optimize(m, filename, false);
           renderable_add_mesh_rigged(r, m, weights);
           mesh_delete(m);
           
@@ -1072,7 +1809,9 @@ renderable* smd_load_file(char* filename) {
     m->triangles[i+2] = int_list_get(tri_list, i+0);
   }
   
-  mesh_generate_tangents(m);  
+  mesh_generate_tangents(m);
+  
+  renderable_mesh_optimize(m, filename, false);
   renderable_add_mesh_rigged(r, m, weights);
   mesh_delete(m);
   
@@ -1080,7 +1819,14 @@ renderable* smd_load_file(char* filename) {
   vertex_list_delete(vert_list);
   int_list_delete(tri_list);
   free(weights);
+  
+}
 
+renderable* smd_load_file(char* filename) {
+  
+  renderable* r = renderable_new();
+  smd_add_file(r, filename);
+  
   fpath mat_file;
   fpath bmf_file;
   fpath fileid;
@@ -1100,81 +1846,484 @@ renderable* smd_load_file(char* filename) {
   strcat(bmf_file.ptr, ".bmf");
   bmf_save_file(r, bmf_file.ptr);
   
+  renderable_upload(r);
+  
   return r;
 }
 
-renderable* ply_load_file(char* filename) {
+/*
+** PLY files have a text header listing each element and
+** its properties, followed by the element data as text or
+** as little or big endian binary.
+**
+** The body is streamed through a fixed size buffer rather
+** than read into memory whole. Properties are matched to
+** vertex fields by name so they may come in any order. In
+** binary elements without lists every property is at a
+** fixed offset in the record, so used fields are decoded
+** straight from there and the rest are never looked at.
+*/
+
+#define PLY_CHUNK 65536
+#define PLY_MAX_ELEMENTS 16
+#define PLY_MAX_PROPERTIES 32
+
+enum {
+  PLY_ASCII,
+  PLY_BINARY_LE,
+  PLY_BINARY_BE
+};
+
+enum {
+  PLY_INT8,  PLY_UINT8,
+  PLY_INT16, PLY_UINT16,
+  PLY_INT32, PLY_UINT32,
+  PLY_FLOAT32, PLY_FLOAT64
+};
+
+static const int ply_type_sizes[] = { 1, 1, 2, 2, 4, 4, 4, 8 };
+
+static const char* ply_type_names[][2] = {
+  { "char",  "int8"  }, { "uchar",  "uint8"  },
+  { "short", "int16" }, { "ushort", "uint16" },
+  { "int",   "int32" }, { "uint",   "uint32" },
+  { "float", "float32" }, { "double", "float64" }
+};
+
+typedef struct {
+  int type;
+  int count_type;
+  int offset;
+  int target;
+  float scale;
+  bool indices;
+} ply_property;
+
+typedef struct {
+  char name[64];
+  int count;
+  int size;
+  int num_properties;
+  ply_property properties[PLY_MAX_PROPERTIES];
+} ply_element;
+
+typedef struct {
+  SDL_RWops* file;
+  int format;
+  int pos;
+  int len;
+  char data[PLY_CHUNK+1];
+} ply_stream;
+
+static int ply_type(const char* name) {
+  for(int i = 0; i < 8; i++) {
+    if (strcmp(name, ply_type_names[i][0]) == 0) { return i; }
+    if (strcmp(name, ply_type_names[i][1]) == 0) { return i; }
+  }
+  return -1;
+}
+
+/* Offset of the float in a vertex a property is read into */
+static int ply_target(const char* name) {
+  if (strcmp(name, "x") == 0) { return offsetof(vertex, position.x); }
+  if (strcmp(name, "y") == 0) { return offsetof(vertex, position.y); }
+  if (strcmp(name, "z") == 0) { return offsetof(vertex, position.z); }
+  if (strcmp(name, "nx") == 0) { return offsetof(vertex, normal.x); }
+  if (strcmp(name, "ny") == 0) { return offsetof(vertex, normal.y); }
+  if (strcmp(name, "nz") == 0) { return offsetof(vertex, normal.z); }
+  if (strcmp(name, "u") == 0 || strcmp(name, "s") == 0 || 
+      strcmp(name, "texture_u") == 0 || strcmp(name, "texture_s") == 0) { return offsetof(vertex, uvs.x); }
+  if (strcmp(name, "v") == 0 || strcmp(name, "t") == 0 || 
+      strcmp(name, "texture_v") == 0 || strcmp(name, "texture_t") == 0) { return offsetof(vertex, uvs.y); }
+  if (strcmp(name, "red") == 0 || strcmp(name, "diffuse_red") == 0) { return offsetof(vertex, color.x); }
+  if (strcmp(name, "green") == 0 || strcmp(name, "diffuse_green") == 0) { return offsetof(vertex, color.y); }
+  if (strcmp(name, "blue") == 0 || strcmp(name, "diffuse_blue") == 0) { return offsetof(vertex, color.z); }
+  if (strcmp(name, "alpha") == 0) { return offsetof(vertex, color.w); }
+  return -1;
+}
+
+/* Buffers at least size bytes unless the file ends first */
+static bool ply_stream_fill(ply_stream* s, int size) {
   
-  SDL_RWops* file = SDL_RWFromFile(filename, "r");
+  if (s->len - s->pos >= size) { return true; }
   
-  if(file == NULL) {
-    error("Could not load file %s", filename);
+  memmove(s->data, s->data + s->pos, s->len - s->pos);
+  s->len -= s->pos;
+  s->pos = 0;
+  
+  while (s->len < PLY_CHUNK) {
+    int read = SDL_RWread(s->file, s->data + s->len, 1, PLY_CHUNK - s->len);
+    if (read <= 0) { break; }
+    s->len += read;
   }
   
-  renderable* r = renderable_new();
+  s->data[s->len] = '\0';
+  
+  return s->len >= size;
+}
+
+static bool ply_stream_line(ply_stream* s, char* line, int max) {
+  
+  ply_stream_fill(s, max);
+  if (s->pos == s->len) { return false; }
+  
+  int i = 0;
+  while (s->pos < s->len && s->data[s->pos] != '\n' && i < max-1) {
+    line[i++] = s->data[s->pos++];
+  }
+  if (s->pos < s->len && s->data[s->pos] == '\n') { s->pos++; }
+  if (i > 0 && line[i-1] == '\r') { i--; }
+  line[i] = '\0';
+  
+  return true;
+}
+
+static double ply_decode(const char* p, int type, bool swap) {
+  
+  char b[8];
+  if (swap) {
+    int size = ply_type_sizes[type];
+    for(int i = 0; i < size; i++) { b[i] = p[size-1-i]; }
+    p = b;
+  }
+  
+  /* Fixed size copies so they compile to single loads */
+  switch (type) {
+    case PLY_INT8:    { int8_t v;   memcpy(&v, p, 1); return v; }
+    case PLY_UINT8:   { uint8_t v;  memcpy(&v, p, 1); return v; }
+    case PLY_INT16:   { int16_t v;  memcpy(&v, p, 2); return v; }
+    case PLY_UINT16:  { uint16_t v; memcpy(&v, p, 2); return v; }
+    case PLY_INT32:   { int32_t v;  memcpy(&v, p, 4); return v; }
+    case PLY_UINT32:  { uint32_t v; memcpy(&v, p, 4); return v; }
+    case PLY_FLOAT32: { float v;    memcpy(&v, p, 4); return v; }
+    case PLY_FLOAT64: { double v;   memcpy(&v, p, 8); return v; }
+  }
+  
+  return 0;
+}
+
+/* Reads the next value of any element in any format */
+static double ply_read(ply_stream* s, int type) {
+  
+  if (s->format != PLY_ASCII) {
+    int size = ply_type_sizes[type];
+    if (!ply_stream_fill(s, size)) { s->pos = s->len; return 0; }
+    double v = ply_decode(s->data + s->pos, type, s->format == PLY_BINARY_BE);
+    s->pos += size;
+    return v;
+  }
+  
+  ply_stream_fill(s, 256);
   
-  mesh* curr_mesh = NULL;
-  int vert_id = 0;
-  int tri_id = 0;
+  const char* c = s->data + s->pos;
+  while (*c == ' ' || *c == '\t' || *c == '\r' || *c == '\n') { c++; }
+  
+  double v;
+  if (type == PLY_FLOAT32 || type == PLY_FLOAT64) {
+    float f; c = obj_parse_float(c, &f); v = f;
+  } else {
+    int i; c = obj_parse_int(c, &i); v = i;
+  }
+  
+  s->pos = c - s->data;
+  return v;
+}
+
+static bool ply_read_header(ply_stream* s, ply_element* elements, int* num_elements, char* filename) {
   
   char line[1024];
-  while(SDL_RWreadline(file, line, 1024)) {
-        
-    if (strstr(line, "ply")) {
+  if (!ply_stream_line(s, line, 1024) || strcmp(line, "ply") != 0) {
+    error("Badly formed ply file '%s', missing magic number", filename);
+    return false;
+  }
+  
+  s->format = -1;
+  *num_elements = 0;
+  ply_element* e = NULL;
+  
+  while (true) {
+    
+    if (!ply_stream_line(s, line, 1024)) {
+      error("Badly formed ply file '%s', header has no end", filename);
+      return false;
+    }
+    
+    if (strcmp(line, "end_header") == 0) { break; }
+    
+    char format[64], type[64], count_type[64], name[64];
+    int count;
+    
+    if (sscanf(line, "format %63s", format) == 1) {
+      
+      if (strcmp(format, "ascii") == 0) { s->format = PLY_ASCII; }
+      if (strcmp(format, "binary_little_endian") == 0) { s->format = PLY_BINARY_LE; }
+      if (strcmp(format, "binary_big_endian") == 0) { s->format = PLY_BINARY_BE; }
+      
+    } else if (sscanf(line, "element %63s %i", name, &count) == 2) {
+      
+      if (*num_elements == PLY_MAX_ELEMENTS) {
+        error("Can't load ply file '%s', more than %i elements", filename, PLY_MAX_ELEMENTS);
+        return false;
+      }
+      
+      e = &elements[(*num_elements)++];
+      strcpy(e->name, name);
+      e->count = count;
+      e->size = 0;
+      e->num_properties = 0;
+      
+    } else if (sscanf(line, "property list %63s %63s %63s", count_type, type, name) == 3 ||
+               sscanf(line, "property %63s %63s", type, name) == 2) {
+      
+      bool list = strncmp(line, "property list", 13) == 0;
+      
+      if (e == NULL || e->num_properties == PLY_MAX_PROPERTIES) {
+        error("Can't load ply file '%s', unexpected property '%s'", filename, name);
+        return false;
+      }
       
-      if (curr_mesh != NULL) {
-        mesh_generate_tangents(curr_mesh);
-        renderable_add_mesh(r, curr_mesh);
-        mesh_delete(curr_mesh);
+      ply_property* p = &e->properties[e->num_properties++];
+      p->type = ply_type(type);
+      p->count_type = list ? ply_type(count_type) : -1;
+      p->offset = e->size;
+      p->target = list ? -1 : ply_target(name);
+      p->indices = list && (strcmp(name, "vertex_indices") == 0 || strcmp(name, "vertex_index") == 0);
+      
+      /* Integer colors are scaled by their full range */
+      p->scale = 1;
+      int color = offsetof(vertex, color);
+      if (p->target >= color && p->target < color + (int)sizeof(vec4)) {
+        if (p->type == PLY_UINT8)  { p->scale = 1.0 / 255; }
+        if (p->type == PLY_UINT16) { p->scale = 1.0 / 65535; }
+      }
+      
+      if (p->type == -1 || (list && p->count_type == -1)) {
+        error("Can't load ply file '%s', unknown property type in '%s'", filename, line);
+        return false;
+      }
+      
+      /* Records with lists have no fixed size */
+      if (list || e->size == -1) {
+        e->size = -1;
+      } else {
+        e->size += ply_type_sizes[p->type];
       }
+    }
+    
+  }
+  
+  if (s->format == -1) {
+    error("Can't load ply file '%s', unknown format", filename);
+    return false;
+  }
+  
+  return true;
+}
+
+static void ply_read_verticies(ply_stream* s, ply_element* e, vertex* verts) {
+  
+  bool fixed = s->format != PLY_ASCII && e->size > 0;
+  bool swap = s->format == PLY_BINARY_BE;
+  
+  for(int i = 0; i < e->count; i++) {
     
-      curr_mesh = mesh_new();
-      vert_id = 0;
-      tri_id = 0;
+    char* v = (char*)&verts[i];
+    
+    if (fixed) {
+      
+      if (!ply_stream_fill(s, e->size)) { break; }
+      const char* record = s->data + s->pos;
+      
+      for(int j = 0; j < e->num_properties; j++) {
+        ply_property* p = &e->properties[j];
+        if (p->target == -1) { continue; }
+        *(float*)(v + p->target) = ply_decode(record + p->offset, p->type, swap) * p->scale;
+      }
+      
+      s->pos += e->size;
+      
+    } else {
+      
+      for(int j = 0; j < e->num_properties; j++) {
+        ply_property* p = &e->properties[j];
+        if (p->count_type != -1) {
+          int n = ply_read(s, p->count_type);
+          for(int k = 0; k < n; k++) { ply_read(s, p->type); }
+        } else if (p->target != -1) {
+          *(float*)(v + p->target) = ply_read(s, p->type) * p->scale;
+        } else {
+          ply_read(s, p->type);
+        }
+      }
+      
+    }
+  }
+  
+}
+
+/* Polygons are split into a fan of triangles */
+static uint32_t* ply_read_faces(ply_stream* s, ply_element* e, int num_verts, int* num_triangles, char* filename) {
+  
+  int num = 0;
+  int max = e->count;
+  uint32_t* triangles = malloc(sizeof(uint32_t) * 3 * max);
+  bool invalid = false;
+  
+  for(int i = 0; i < e->count; i++) {
+    for(int j = 0; j < e->num_properties; j++) {
+      
+      ply_property* p = &e->properties[j];
+      
+      if (p->count_type == -1) {
+        ply_read(s, p->type);
+        continue;
+      }
+      
+      int n = ply_read(s, p->count_type);
+      
+      if (!p->indices) {
+        for(int k = 0; k < n; k++) { ply_read(s, p->type); }
+        continue;
+      }
+      
+      /* Binary index lists are decoded straight out of the buffer */
+      int size = ply_type_sizes[p->type];
+      bool direct = s->format != PLY_ASCII && ply_stream_fill(s, n * size);
+      
+      uint32_t first = 0, prev = 0;
+      for(int k = 0; k < n; k++) {
+        
+        int64_t index;
+        if (direct) {
+          index = ply_decode(s->data + s->pos, p->type, s->format == PLY_BINARY_BE);
+          s->pos += size;
+        } else {
+          index = ply_read(s, p->type);
+        }
+        
+        if (index < 0 || index >= num_verts) { invalid = true; index = 0; }
+        
+        if (k == 0) { first = index; }
+        if (k >= 2) {
+          if (num == max) {
+            max = max * 2 + 1;
+            triangles = realloc(triangles, sizeof(uint32_t) * 3 * max);
+          }
+          triangles[num*3+0] = first;
+          triangles[num*3+1] = prev;
+          triangles[num*3+2] = index;
+          num++;
+        }
+        prev = index;
+      }
+      
     }
+  }
+  
+  if (invalid) {
+    warning("Loading file '%s'. Faces index verticies which don't exist", filename);
+  }
+  
+  *num_triangles = num;
+  return triangles;
+}
+
+static void ply_skip_element(ply_stream* s, ply_element* e) {
+  
+  for(int i = 0; i < e->count; i++) {
     
-    int vert_count = 0;
-    if (sscanf(line, "element vertex %i", &vert_count)) {
-      curr_mesh->num_verts = vert_count;
-      curr_mesh->verticies = malloc(sizeof(vertex) * vert_count);
+    if (s->format != PLY_ASCII && e->size > 0) {
+      if (!ply_stream_fill(s, e->size)) { break; }
+      s->pos += e->size;
+      continue;
     }
     
-    int tri_count = 0;
-    if (sscanf(line, "element face %i", &tri_count)) {
-      curr_mesh->num_triangles = tri_count;
-      curr_mesh->triangles = malloc(sizeof(uint32_t) * tri_count * 3);
+    for(int j = 0; j < e->num_properties; j++) {
+      ply_property* p = &e->properties[j];
+      int n = (p->count_type == -1) ? 1 : ply_read(s, p->count_type);
+      for(int k = 0; k < n; k++) { ply_read(s, p->type); }
+    }
+  }
+  
+}
+
+static void ply_add_file(renderable* r, char* filename) {
+  
+  SDL_RWops* file = SDL_RWFromPack(filename);
+  if (file == NULL) { file = SDL_RWFromFile(filename, "rb"); }
+  
+  if(file == NULL) {
+    error("Could not load file %s", filename);
+    return;
+  }
+  
+  ply_stream* s = malloc(sizeof(ply_stream));
+  s->file = file;
+  s->pos = 0;
+  s->len = 0;
+  
+  ply_element elements[PLY_MAX_ELEMENTS];
+  int num_elements = 0;
+  
+  if (!ply_read_header(s, elements, &num_elements, filename)) {
+    SDL_RWclose(file);
+    free(s);
+    return;
+  }
+  
+  mesh* m = mesh_new();
+  bool has_normals = false;
+  
+  for(int i = 0; i < num_elements; i++) {
+    if (strcmp(elements[i].name, "vertex") == 0) {
+      m->num_verts = elements[i].count;
     }
+  }
+  
+  for(int i = 0; i < num_elements; i++) {
     
-    vertex v;
-    int r, g, b, a;
-    if (sscanf(line, "%f %f %f %f %f %f %f %f %i %i %i %i",
-      &v.position.x, &v.position.y, &v.position.z,
-      &v.normal.x, &v.normal.y, &v.normal.z,
-      &v.uvs.x, &v.uvs.y, &r, &g, &b, &a) == 12) {
+    ply_element* e = &elements[i];
+    
+    if (strcmp(e->name, "vertex") == 0) {
+      
+      m->verticies = realloc(m->verticies, sizeof(vertex) * m->num_verts);
+      for(int j = 0; j < m->num_verts; j++) {
+        m->verticies[j] = vertex_new();
+        m->verticies[j].color = vec4_one();
+      }
       
-      v.color = vec4_new(
-        (float)r / 255.0, (float)g / 255.0, 
-        (float)b / 255.0, (float)a / 255.0);
+      for(int j = 0; j < e->num_properties; j++) {
+        if (e->properties[j].target == offsetof(vertex, normal.x)) { has_normals = true; }
+      }
       
-      curr_mesh->verticies[vert_id] = v; vert_id++;
-    }
-    
-    int i0, i1, i2;
-    if (sscanf(line, "3 %i %i %i", &i0, &i1, &i2) == 3) {
-      curr_mesh->triangles[tri_id] = i0; tri_id++;
-      curr_mesh->triangles[tri_id] = i1; tri_id++;
-      curr_mesh->triangles[tri_id] = i2; tri_id++;
+      ply_read_verticies(s, e, m->verticies);
+      
+    } else if (strcmp(e->name, "face") == 0) {
+      
+      free(m->triangles);
+      m->triangles = ply_read_faces(s, e, m->num_verts, &m->num_triangles, filename);
+      
+    } else {
+      ply_skip_element(s, e);
     }
     
   }
   
   SDL_RWclose(file);
+  free(s);
   
-  if (curr_mesh != NULL) {
-    mesh_generate_tangents(curr_mesh);
-    renderable_add_mesh(r, curr_mesh);
-    mesh_delete(curr_mesh);
-  }
+  if (!has_normals) { mesh_generate_normals(m); }
+  mesh_generate_tangents(m);
+  renderable_mesh_optimize(m, filename, true);
+  renderable_add_mesh(r, m);
+  mesh_delete(m);
+  
+}
+
+renderable* ply_load_file(char* filename) {
+  
+  renderable* r = renderable_new();
+  ply_add_file(r, filename);
   
   fpath mat_file;
   fpath bmf_file;
@@ -1195,7 +2344,66 @@ renderable* ply_load_file(char* filename) {
   strcat(bmf_file.ptr, ".bmf");
   bmf_save_file(r, bmf_file.ptr);
   
+  renderable_upload(r);
+  
   return r;
   
 }
 
+bool bmf_cook_file(char* filename, char* output, char* material, int num_lods) {
+  
+  /* No material handle, so the asset manager is never touched */
+  renderable* r = malloc(sizeof(renderable));
+  r->material = asset_hndl_null();
+  r->num_surfaces = 0;
+  r->surfaces = NULL;
+  r->is_rigged = false;
+  r->keep_geometry = true;
+  
+  fpath ext;
+  SDL_PathFileExtension(ext.ptr, filename);
+  
+  if (strcmp(ext.ptr, "obj") == 0) {
+    model* m = obj_read_file(filename);
+    renderable_add_model(r, m);
+    model_delete(m);
+  } else if (strcmp(ext.ptr, "smd") == 0) {
+    smd_add_file(r, filename);
+  } else if (strcmp(ext.ptr, "ply") == 0) {
+    ply_add_file(r, filename);
+  } else {
+    error("Don't know how to cook '%s' into a bmf file", filename);
+    renderable_delete(r);
+    return false;
+  }
+  
+  SDL_RWops* out = SDL_RWFromFile(output, "wb");
+  
+  if (out == NULL) {
+    error("Could not open file %s for writing", output);
+    renderable_delete(r);
+    return false;
+  }
+  
+  uint32_t version = 2;
+  uint32_t mat_len = strlen(material);
+  uint32_t num_surfaces = r->num_surfaces;
+  
+  SDL_RWwrite(out, "BMF", 3, 1);
+  SDL_RWwrite(out, &version, sizeof(uint32_t), 1);
+  SDL_RWwrite(out, &r->is_rigged, 1, 1);
+  SDL_RWwrite(out, &mat_len, sizeof(uint32_t), 1);
+  SDL_RWwrite(out, material, mat_len, 1);
+  SDL_RWwrite(out, &num_surfaces, sizeof(uint32_t), 1);
+  
+  for(int i = 0; i < r->num_surfaces; i++) {
+    renderable_surface* s = r->surfaces[i];
+    bmf_write_surface_v2(out, s->vertex_data, s->num_verticies, r->is_rigged, 
+      s->triangle_data, s->num_triangles * 3, num_lods);
+  }
+  
+  SDL_RWclose(out);
+  renderable_delete(r);
+  
+  return true;
+}
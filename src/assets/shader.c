@@ -5,7 +5,7 @@ static shader* load_shader_file(char* filename, GLenum type) {
 
   shader* new_shader = malloc(sizeof(shader));
   
-  SDL_RWops* file = SDL_RWFromFile(filename, "r");
+  SDL_RWops* file = SDL_RWFromFileBuffered(filename, "r");
   if(file == NULL) {
     error("Cannot load file %s", filename);
   }
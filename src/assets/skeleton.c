@@ -198,7 +198,7 @@ skeleton* skl_load_file(char* filename) {
   
   skeleton* s =  skeleton_new();
   
-  SDL_RWops* file = SDL_RWFromFile(filename, "r");
+  SDL_RWops* file = SDL_RWFromFileBuffered(filename, "r");
   
   if(file == NULL) {
     error("Could not load file %s", filename);
@@ -273,6 +273,109 @@ skeleton* skl_load_file(char* filename) {
   return s;
 }
 
+skeleton* bskl_load_file(char* filename) {
+  
+  SDL_RWops* file = SDL_RWFromFileBuffered(filename, "rb");
+  
+  if (file == NULL) {
+    error("Could not load file %s", filename);
+    return NULL;
+  }
+  
+  char magic[3];
+  uint32_t version = 0;
+  uint32_t joint_count = 0;
+  SDL_RWread(file, magic, 3, 1);
+  SDL_RWread(file, &version, sizeof(uint32_t), 1);
+  SDL_RWread(file, &joint_count, sizeof(uint32_t), 1);
+  
+  if (memcmp(magic, "SKL", 3) != 0 || version != 1) {
+    error("Badly formed bskl file '%s'", filename);
+    SDL_RWclose(file);
+    return NULL;
+  }
+  
+  skeleton* s = skeleton_new();
+  
+  for (int i = 0; i < joint_count; i++) {
+    
+    int32_t parent = -1;
+    uint32_t name_len = 0;
+    SDL_RWread(file, &parent, sizeof(int32_t), 1);
+    SDL_RWread(file, &name_len, sizeof(uint32_t), 1);
+    
+    if (name_len >= 1024 || parent < -1 || parent >= (int32_t)joint_count) {
+      error("Badly formed bskl file '%s', bad joint %i", filename, i);
+      SDL_RWclose(file);
+      skeleton_delete(s);
+      return NULL;
+    }
+    
+    char name[1024];
+    SDL_RWread(file, name, 1, name_len);
+    name[name_len] = '\0';
+    
+    skeleton_joint_add(s, name, parent);
+    SDL_RWread(file, &s->rest_pose->joint_positions[i], sizeof(vec3), 1);
+    SDL_RWread(file, &s->rest_pose->joint_rotations[i], sizeof(quat), 1);
+  }
+  
+  SDL_RWclose(file);
+  
+  frame_gen_transforms(s->rest_pose);
+  frame_gen_inv_transforms(s->rest_pose);
+  
+  return s;
+}
+
+static bool bskl_write_file(skeleton* s, char* filename) {
+  
+  SDL_RWops* file = SDL_RWFromFile(filename, "wb");
+  
+  if (file == NULL) {
+    error("Could not open file %s for writing", filename);
+    return false;
+  }
+  
+  uint32_t version = 1;
+  uint32_t joint_count = s->joint_count;
+  SDL_RWwrite(file, "SKL", 3, 1);
+  SDL_RWwrite(file, &version, sizeof(uint32_t), 1);
+  SDL_RWwrite(file, &joint_count, sizeof(uint32_t), 1);
+  
+  for (int i = 0; i < s->joint_count; i++) {
+    int32_t parent = s->rest_pose->joint_parents[i];
+    uint32_t name_len = strlen(s->joint_names[i]);
+    SDL_RWwrite(file, &parent, sizeof(int32_t), 1);
+    SDL_RWwrite(file, &name_len, sizeof(uint32_t), 1);
+    SDL_RWwrite(file, s->joint_names[i], 1, name_len);
+    SDL_RWwrite(file, &s->rest_pose->joint_positions[i], sizeof(vec3), 1);
+    SDL_RWwrite(file, &s->rest_pose->joint_rotations[i], sizeof(quat), 1);
+  }
+  
+  SDL_RWclose(file);
+  
+  return true;
+}
+
+void bskl_save_file(skeleton* s, char* filename) {
+  bskl_write_file(s, filename);
+}
+
+bool skl_cook_file(char* filename, char* output) {
+  
+  if (!SDL_PathIsFile(filename)) {
+    error("Could not load file %s", filename);
+    return false;
+  }
+  
+  skeleton* s = skl_load_file(filename);
+  bool written = bskl_write_file(s, output);
+  skeleton_delete(s);
+  
+  return written;
+}
+
 
 
 
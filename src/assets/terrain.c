@@ -227,10 +227,8 @@ static void terrain_new_chunk(terrain* ter, int i) {
     free(index_buffer);
   }
   
-  tc->colmesh = malloc(sizeof(cmesh));
-  tc->colmesh->is_leaf = true;
-  tc->colmesh->triangles_num = (tc->width/4) * (tc->height/4) * 2;
-  tc->colmesh->triangles = malloc(sizeof(ctri) * tc->colmesh->triangles_num);
+  int triangles_num = (tc->width/4) * (tc->height/4) * 2;
+  ctri* triangles = malloc(sizeof(ctri) * triangles_num);
   
   int tri_i = 0;
   
@@ -249,15 +247,12 @@ static void terrain_new_chunk(terrain* ter, int i) {
     vec3 binorm = vec3_normalize(vec3_sub(d, a));
     vec3 norm   = vec3_cross( binorm, tang );
     
-    tc->colmesh->triangles[tri_i] = ctri_new(a, c, b, norm); tri_i++;
-    tc->colmesh->triangles[tri_i] = ctri_new(a, d, c, norm); tri_i++;
+    triangles[tri_i] = ctri_new(a, c, b, norm); tri_i++;
+    triangles[tri_i] = ctri_new(a, d, c, norm); tri_i++;
   
   }
   
-  tc->colmesh->bound = cmesh_bound(tc->colmesh);
-  
-  /* For some reason this is not working correctly */
-  cmesh_subdivide(tc->colmesh, 5);
+  tc->colmesh = cmesh_new(triangles, triangles_num);
 
   ter->chunks[i] = tc;
 
@@ -284,7 +279,7 @@ static const float MAX_HEIGHT = 128;
 
 terrain* raw_load_file(char* filename) {
   
-  SDL_RWops* file = SDL_RWFromFile(filename, "rb");
+  SDL_RWops* file = SDL_RWFromFileBuffered(filename, "rb");
   
   if (!file) {
     error("Could not load file %s\n", filename);
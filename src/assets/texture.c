@@ -16,6 +16,41 @@ void texture_delete(texture* t) {
   free(t);
 }
 
+size_t texture_size(texture* t) {
+  
+  GLenum target = t->type;
+  int faces = 1;
+  if (t->type == GL_TEXTURE_CUBE_MAP) {
+    target = GL_TEXTURE_CUBE_MAP_POSITIVE_X;
+    faces = 6;
+  }
+  
+  glBindTexture(t->type, t->handle);
+  
+  size_t size = 0;
+  for(int level = 0; ; level++) {
+    
+    int width = 0, height = 0, depth = 0, compressed = 0;
+    glGetTexLevelParameteriv(target, level, GL_TEXTURE_WIDTH, &width);
+    if (width == 0) { break; }
+    
+    glGetTexLevelParameteriv(target, level, GL_TEXTURE_HEIGHT, &height);
+    glGetTexLevelParameteriv(target, level, GL_TEXTURE_DEPTH, &depth);
+    glGetTexLevelParameteriv(target, level, GL_TEXTURE_COMPRESSED, &compressed);
+    
+    if (compressed) {
+      int bytes = 0;
+      glGetTexLevelParameteriv(target, level, GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &bytes);
+      size += bytes;
+    } else {
+      /* Assume four bytes per texel */
+      size += (size_t)width * (height > 0 ? height : 1) * (depth > 0 ? depth : 1) * 4;
+    }
+  }
+  
+  return size * faces;
+}
+
 GLuint texture_handle(texture* t) {
   return t->handle;
 }
@@ -29,9 +64,7 @@ void texture_set_image(texture* t, image* i) {
   glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, i->width, i->height, 0, GL_RGBA, GL_UNSIGNED_BYTE, i->data );
 }
 
-texture* tga_load_file( char* filename ) {
-  
-  image* i = image_tga_load_file(filename);
+texture* texture_upload_image( char* filename, image* i ) {
   
   texture* t = texture_new();
   glBindTexture(GL_TEXTURE_2D, texture_handle(t));
@@ -46,21 +79,12 @@ texture* tga_load_file( char* filename ) {
   return t;
 }
 
-texture* bmp_load_file( char* filename ) {
+texture* tga_load_file( char* filename ) {
+  return texture_upload_image(filename, image_tga_load_file(filename));
+}
 
-  image* i = image_bmp_load_file(filename);
-  
-  texture* t = texture_new();
-  glBindTexture(GL_TEXTURE_2D, texture_handle(t));
-  glTexParameteri( GL_TEXTURE_2D, GL_GENERATE_MIPMAP, GL_FALSE );
-  glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0 );
-  
-  texture_set_image(t, i);
-  texture_set_filtering_anisotropic(t);
-  
-  image_delete(i);
-  
-  return t;
+texture* bmp_load_file( char* filename ) {
+  return texture_upload_image(filename, image_bmp_load_file(filename));
 }
 
 image* texture_get_image(texture* t) {
@@ -228,7 +252,7 @@ void texture_write_to_file(texture* t, char* filename){
 
 texture* lut_load_file( char* filename ) {
   
-  SDL_RWops* file = SDL_RWFromFile(filename, "r");
+  SDL_RWops* file = SDL_RWFromFileBuffered(filename, "r");
   if(file == NULL) {
     error("Cannot load file %s", filename);
   }
@@ -442,7 +466,22 @@ static bool is_power_of_two(unsigned int x) {
   return (x == 1);
 }
 
+SDL_RWops* dds_read_file( char* filename ) {
+  
+  SDL_RWops* f = SDL_RWFromFileBuffered(filename, "rb");
+  
+  if (f == NULL) {
+    error("Cannot load file %s", filename);
+  }
+  
+  return f;
+}
+
 texture* dds_load_file( char* filename ) {
+  return dds_upload_file(filename, dds_read_file(filename));
+}
+
+texture* dds_upload_file( char* filename, SDL_RWops* f ) {
   
   DdsLoadInfo loadInfoDXT1 =   { true,  false, false, 4, 8,  GL_COMPRESSED_RGBA_S3TC_DXT1 };
   DdsLoadInfo loadInfoDXT3 =   { true,  false, false, 4, 16, GL_COMPRESSED_RGBA_S3TC_DXT3 };
@@ -453,12 +492,6 @@ texture* dds_load_file( char* filename ) {
   DdsLoadInfo loadInfoBGR565 = { false, true,  false, 1, 2,  GL_RGB5,    GL_RGB,  GL_UNSIGNED_SHORT_5_6_5 };
   DdsLoadInfo loadInfoIndex8 = { false, false, true,  1, 1,  GL_RGB8,    GL_BGRA, GL_UNSIGNED_BYTE };
   
-  SDL_RWops* f = SDL_RWFromFile(filename, "rb");
-  
-  if (f == NULL) {
-    error("Cannot load file %s", filename);
-  }
-  
   DDS_header hdr;
   SDL_RWread(f, &hdr, 1, sizeof(DDS_header));
   
@@ -3,19 +3,106 @@
 #include "data/dict.h"
 #include "data/list.h"
 
+#include <stdarg.h>
+
+#ifdef __linux__
+  #include <sys/inotify.h>
+  #include <sys/stat.h>
+  #include <unistd.h>
+  #include <errno.h>
+#endif
+
+/*
+** Every path an asset handle or loader has referred to
+** gets a permanent slot in a dense table. The dict maps
+** a path to its slot id, and the slot holds the currently
+** loaded asset along with a generation counter which is
+** bumped every time the slot's asset changes.
+**
+** Handles cache the slot id and the generation they saw,
+** so resolving a handle is an array index and a compare.
+** Slot 0 is reserved to mean "no slot yet".
+**
+** Each slot also records the slots of any assets its
+** loader created handles to, so that when an asset is
+** hot reloaded its dependents can be reloaded too.
+**
+** For residency each slot keeps the size reported by its
+** handler, the number of acquired handles, and the frame
+** it was last used. When over budget, unreferenced assets
+** are evicted least recently used first. Handles to an
+** evicted asset load it again when next dereferenced.
+*/
+
+typedef struct {
+  char* path;
+  asset* ptr;
+  uint32_t generation;
+  bool pending;
+  bool evicted;
+  uint32_t* dependencies;
+  int num_dependencies;
+  int references;
+  size_t size;
+  uint32_t last_used;
+  int loads;
+  double load_time;
+  size_t bytes_read;
+} asset_slot;
+
 static dict* asset_dict;
-static uint32_t asset_timestamp = 0;
+static asset_slot* asset_slots = NULL;
+static int num_asset_slots = 0;
+static int max_asset_slots = 0;
+
+static size_t asset_budget = 0;
+static size_t asset_resident = 0;
+static uint32_t asset_frame = 1;
 
 enum {
   MAX_ASSET_HANDLERS = 512,
-  MAX_PATH_VARIABLES = 512
+  MAX_PATH_VARIABLES = 512,
+  MAX_LOADING_DEPTH = 64,
+  MAX_ASSET_DEPENDENCIES = 64,
+  NUM_ASSET_WORKERS = 4
 };
 
+/*
+** Slots currently being loaded, innermost last. Each
+** records when it started, and how much time and io its
+** nested loads took, so that profiling of every asset
+** only counts its own work.
+*/
+typedef struct {
+  uint32_t id;
+  double start;
+  size_t bytes;
+  double child_time;
+  size_t child_bytes;
+} asset_loading_frame;
+
+static asset_loading_frame asset_loading[MAX_LOADING_DEPTH];
+static int asset_loading_depth = 0;
+
+static double asset_profile_clock(void) {
+#ifdef __unix__
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec / 1e9;
+#else
+  return SDL_GetTicks() / 1000.0;
+#endif
+}
+
 typedef struct {
   type_id type;
   char* extension;
   void* (*load_func)(const char*);
+  void* (*read_func)(const char*);
+  void* (*upload_func)(const char*, void*);
   void (*del_func)();
+  size_t (*size_func)(asset*);
+  int (*scan_func)(const char*, fpath*, int);
 } asset_handler;
 
 static asset_handler asset_handlers[MAX_ASSET_HANDLERS];
@@ -29,6 +116,75 @@ typedef struct {
 static path_variable path_variables[MAX_PATH_VARIABLES];
 static int num_path_variables = 0;
 
+/*
+** Mapping a filename means a string rebuild per path
+** variable and a realpath call, so results are cached
+** keyed on the filename as given. Mapped filenames are
+** interned as slots, so the map cache stores slot ids
+** and the unmap cache stores copies of the result.
+**
+** Both are cleared when path variables change. Relative
+** filenames are cached as given, so anything changing the
+** working directory must call asset_path_cache_clear.
+*/
+
+static dict* asset_map_cache = NULL;
+static dict* asset_unmap_cache = NULL;
+
+/*
+** Asynchronous loads are kept in a queue in submission
+** order. Worker threads take queued jobs and run the read
+** stage of the handler, which does file io and parsing.
+** The main thread then runs the upload stage in the same
+** order as the jobs were submitted, so any GL calls only
+** ever happen on the thread that owns the context.
+**
+** Workers only touch the job queue with the lock held and
+** never keep a pointer into it, as it may be reallocated.
+*/
+
+enum {
+  ASSET_JOB_QUEUED,
+  ASSET_JOB_READING,
+  ASSET_JOB_READ,
+  ASSET_JOB_DONE
+};
+
+typedef struct {
+  fpath path;
+  uint32_t id;
+  int handler;
+  int state;
+  void* data;
+  double read_time;
+  size_t read_bytes;
+} asset_job;
+
+static asset_job* asset_jobs = NULL;
+static int num_asset_jobs = 0;
+static int max_asset_jobs = 0;
+static int asset_jobs_head = 0;
+static int asset_jobs_next = 0;
+
+static SDL_Thread* asset_workers[NUM_ASSET_WORKERS];
+static SDL_mutex* asset_jobs_lock = NULL;
+static SDL_cond* asset_jobs_queued = NULL;
+static SDL_cond* asset_jobs_read = NULL;
+static bool asset_workers_running = false;
+static bool asset_workers_quit = false;
+
+void asset_path_cache_clear(void) {
+  
+  if (asset_map_cache) { dict_delete(asset_map_cache); }
+  if (asset_unmap_cache) {
+    dict_map(asset_unmap_cache, free);
+    dict_delete(asset_unmap_cache);
+  }
+  
+  asset_map_cache = dict_new(1024);
+  asset_unmap_cache = dict_new(1024);
+}
+
 void asset_add_path_variable(fpath variable, fpath mapping) {
   
   if (num_path_variables == MAX_PATH_VARIABLES) {
@@ -44,6 +200,8 @@ void asset_add_path_variable(fpath variable, fpath mapping) {
   path_variables[num_path_variables] = pv;
   num_path_variables++;
   
+  asset_path_cache_clear();
+  
 }
 
 static fpath asset_map_fullpath(fpath filename) {
@@ -58,7 +216,9 @@ static fpath asset_map_shortpath(fpath filename) {
   return out;
 }
 
-fpath asset_unmap_filename(fpath filename) {
+static uint32_t asset_slot_id(char* path);
+
+static fpath asset_unmap_uncached(fpath filename) {
   
   fpath fullpath = asset_map_fullpath(filename);
   
@@ -91,7 +251,7 @@ fpath asset_unmap_filename(fpath filename) {
   
 }
 
-fpath asset_map_filename(fpath filename) {
+static fpath asset_map_uncached(fpath filename) {
   
   fpath out = filename;
   
@@ -120,19 +280,169 @@ fpath asset_map_filename(fpath filename) {
   return asset_map_fullpath(out);
 }
 
+static uint32_t asset_map_id(char* filename) {
+  
+  uint32_t id = (uint32_t)(intptr_t)dict_get(asset_map_cache, filename);
+  if (likely(id != 0)) { return id; }
+  
+  fpath mapped = asset_map_uncached(P(filename));
+  id = asset_slot_id(mapped.ptr);
+  
+  dict_set(asset_map_cache, filename, (void*)(intptr_t)id);
+  dict_set(asset_map_cache, mapped.ptr, (void*)(intptr_t)id);
+  
+  return id;
+}
+
+fpath asset_map_filename(fpath filename) {
+  return P(asset_slots[asset_map_id(filename.ptr)].path);
+}
+
+fpath asset_unmap_filename(fpath filename) {
+  
+  char* cached = dict_get(asset_unmap_cache, filename.ptr);
+  if (likely(cached != NULL)) { return P(cached); }
+  
+  fpath out = asset_unmap_uncached(filename);
+  
+  cached = malloc(strlen(out.ptr) + 1);
+  strcpy(cached, out.ptr);
+  dict_set(asset_unmap_cache, filename.ptr, cached);
+  
+  return out;
+}
+
+uint32_t asset_path_id(fpath filename) {
+  return asset_map_id(filename.ptr);
+}
+
+char* asset_path_name(uint32_t id) {
+  if (id == 0 || id >= num_asset_slots) {
+    error("Invalid interned path id %u", id);
+    return NULL;
+  }
+  return asset_slots[id].path;
+}
+
+static uint32_t asset_slot_find(char* path) {
+  return (uint32_t)(intptr_t)dict_get(asset_dict, path);
+}
+
+static uint32_t asset_slot_id(char* path) {
+  
+  uint32_t id = asset_slot_find(path);
+  if (id != 0) { return id; }
+  
+  if (num_asset_slots == max_asset_slots) {
+    max_asset_slots = max_asset_slots * 2;
+    asset_slots = realloc(asset_slots, sizeof(asset_slot) * max_asset_slots);
+  }
+  
+  id = num_asset_slots;
+  num_asset_slots++;
+  
+  dict_set(asset_dict, path, (void*)(intptr_t)id);
+  
+  asset_slots[id].path = malloc(strlen(path) + 1);
+  strcpy(asset_slots[id].path, path);
+  asset_slots[id].ptr = NULL;
+  asset_slots[id].generation = 1;
+  asset_slots[id].pending = false;
+  asset_slots[id].evicted = false;
+  asset_slots[id].dependencies = NULL;
+  asset_slots[id].num_dependencies = 0;
+  asset_slots[id].references = 0;
+  asset_slots[id].size = 0;
+  asset_slots[id].last_used = 0;
+  asset_slots[id].loads = 0;
+  asset_slots[id].load_time = 0;
+  asset_slots[id].bytes_read = 0;
+  
+  return id;
+}
+
+static void asset_dependency_add(uint32_t id) {
+  
+  if (asset_loading_depth == 0) { return; }
+  
+  uint32_t parent = asset_loading[asset_loading_depth-1].id;
+  if (parent == id) { return; }
+  
+  asset_slot* slot = &asset_slots[parent];
+  for(int i = 0; i < slot->num_dependencies; i++) {
+    if (slot->dependencies[i] == id) { return; }
+  }
+  
+  slot->num_dependencies++;
+  slot->dependencies = realloc(slot->dependencies, sizeof(uint32_t) * slot->num_dependencies);
+  slot->dependencies[slot->num_dependencies-1] = id;
+}
+
+static void asset_loading_push(uint32_t id) {
+  
+  if (asset_loading_depth == MAX_LOADING_DEPTH) {
+    error("Assets nested too deeply while loading '%s'", asset_slots[id].path);
+  }
+  
+  /* Dependencies are recorded afresh on every load */
+  asset_slots[id].num_dependencies = 0;
+  
+  asset_loading_frame* frame = &asset_loading[asset_loading_depth];
+  frame->id = id;
+  frame->start = asset_profile_clock();
+  frame->bytes = SDL_RWBytesRead();
+  frame->child_time = 0;
+  frame->child_bytes = 0;
+  asset_loading_depth++;
+}
+
+static void asset_loading_pop(void) {
+  
+  asset_loading_depth--;
+  asset_loading_frame* frame = &asset_loading[asset_loading_depth];
+  
+  double time = asset_profile_clock() - frame->start;
+  size_t bytes = SDL_RWBytesRead() - frame->bytes;
+  
+  asset_slot* slot = &asset_slots[frame->id];
+  slot->loads++;
+  slot->load_time += time - frame->child_time;
+  slot->bytes_read += bytes - frame->child_bytes;
+  
+  if (asset_loading_depth > 0) {
+    asset_loading[asset_loading_depth-1].child_time += time;
+    asset_loading[asset_loading_depth-1].child_bytes += bytes;
+  }
+}
+
+static asset_slot* asset_slot_get(char* path) {
+  uint32_t id = asset_slot_find(path);
+  return id != 0 ? &asset_slots[id] : NULL;
+}
+
+static asset_slot* asset_slot_of_ptr(asset* a) {
+  for(int i = 1; i < num_asset_slots; i++) {
+    if (asset_slots[i].ptr == a) { return &asset_slots[i]; }
+  }
+  return NULL;
+}
+
 asset_hndl asset_hndl_null() {
   asset_hndl ah;
   ah.path = P("");
   ah.ptr = NULL;
-  ah.timestamp = 0;
+  ah.id = 0;
+  ah.generation = 0;
   return ah;
 }
 
 asset_hndl asset_hndl_new(fpath path) {
   asset_hndl ah;
-  ah.path = asset_map_filename(path);
+  ah.id = asset_map_id(path.ptr);
+  ah.path = P(asset_slots[ah.id].path);
   ah.ptr = NULL;
-  ah.timestamp = 0;
+  ah.generation = 0;
+  asset_dependency_add(ah.id);
   return ah;
 }
 
@@ -148,7 +458,8 @@ asset_hndl asset_hndl_new_ptr(asset* as) {
   asset_hndl ah;
   ah.path = P(asset_ptr_path(as));
   ah.ptr = as;
-  ah.timestamp = SDL_GetTicks();
+  ah.id = asset_slot_find(ah.path.ptr);
+  ah.generation = asset_slots[ah.id].generation;
   return ah;
 }
 
@@ -161,40 +472,93 @@ fpath asset_hndl_path(asset_hndl* ah) {
 }
 
 bool asset_hndl_eq(asset_hndl* ah0, asset_hndl* ah1) {
+  if (ah0->id != 0 && ah1->id != 0) {
+    return ah0->id == ah1->id;
+  }
   return (strcmp(ah0->path.ptr, ah1->path.ptr) == 0);
 }
 
 asset* asset_hndl_ptr(asset_hndl* ah) {
 
-  if (unlikely(ah->path.ptr[0] == '\0')) {
-    error("Cannot load NULL asset handle");
-    return NULL;
-  }
-  
-  if (likely(ah->timestamp > asset_timestamp)) {
-    return ah->ptr;
-  } else {
-    
-    ah->ptr = dict_get(asset_dict, ah->path.ptr);
-    ah->timestamp = SDL_GetTicks();
+  if (unlikely(ah->id == 0)) {
     
-    if (unlikely(ah->ptr == NULL)) {
-      error("Failed to get Asset '%s', is it loaded yet?", ah->path.ptr);
+    if (unlikely(ah->path.ptr[0] == '\0')) {
+      error("Cannot load NULL asset handle");
       return NULL;
     }
     
+    ah->id = asset_slot_id(ah->path.ptr);
+  }
+  
+  asset_slot* slot = &asset_slots[ah->id];
+  slot->last_used = asset_frame;
+  
+  if (likely(ah->generation == slot->generation)) {
     return ah->ptr;
   }
   
+  if (unlikely(slot->ptr == NULL && slot->evicted)) {
+    file_load(ah->path);
+    slot = &asset_slots[ah->id];
+  }
+  
+  if (unlikely(slot->ptr == NULL)) {
+    error("Failed to get Asset '%s', is it loaded yet?", ah->path.ptr);
+    return NULL;
+  }
+  
+  ah->ptr = slot->ptr;
+  ah->generation = slot->generation;
+  
+  return ah->ptr;
+  
+}
+
+void asset_hndl_acquire(asset_hndl* ah) {
+  if (ah->id == 0) {
+    if (asset_hndl_isnull(ah)) { return; }
+    ah->id = asset_slot_id(ah->path.ptr);
+  }
+  asset_slots[ah->id].references++;
+}
+
+void asset_hndl_release(asset_hndl* ah) {
+  if (ah->id == 0) { return; }
+  if (asset_slots[ah->id].references == 0) {
+    warning("Asset '%s' released more times than acquired", ah->path.ptr);
+    return;
+  }
+  asset_slots[ah->id].references--;
 }
 
 void asset_cache_flush(void) {
-  asset_timestamp = SDL_GetTicks();
+  for(int i = 1; i < num_asset_slots; i++) {
+    asset_slots[i].generation++;
+  }
 }
 
 void asset_init(void) {
   asset_dict = dict_new(1024);
-  asset_cache_flush();
+  
+  /* Slot 0 is reserved for unresolved handles */
+  max_asset_slots = 1024;
+  num_asset_slots = 1;
+  asset_slots = malloc(sizeof(asset_slot) * max_asset_slots);
+  asset_slots[0].path = NULL;
+  asset_slots[0].ptr = NULL;
+  asset_slots[0].generation = 0;
+  asset_slots[0].pending = false;
+  asset_slots[0].evicted = false;
+  asset_slots[0].dependencies = NULL;
+  asset_slots[0].num_dependencies = 0;
+  asset_slots[0].references = 0;
+  asset_slots[0].size = 0;
+  asset_slots[0].last_used = 0;
+  asset_slots[0].loads = 0;
+  asset_slots[0].load_time = 0;
+  asset_slots[0].bytes_read = 0;
+  
+  asset_path_cache_clear();
 }
 
 void asset_handler_delete(asset_handler* h) {
@@ -204,44 +568,57 @@ void asset_handler_delete(asset_handler* h) {
 
 }
 
-static void delete_bucket_list(struct bucket* b) {
-  
-  if(b == NULL) {
-    return;
-  }
-  
-  delete_bucket_list(b->next);
-  
-  debug("Unloading: '%s'", b->key);
-  
-  fpath ext;
-  SDL_PathFileExtension(ext.ptr, b->key);
-  
-  for(int i = 0; i < num_asset_handlers; i++) {
-  
-    asset_handler handler = asset_handlers[i];
-    if (strcmp(ext.ptr, handler.extension) == 0) {
-      
-      bucket_delete_with(b, handler.del_func);
-      
-      break;
+static void asset_workers_finish(void);
+static void asset_watch_finish(void);
+
+void asset_finish() {
+
+  asset_async_wait();
+  asset_workers_finish();
+  asset_watch_finish();
+
+  for(int i = 1; i < num_asset_slots; i++) {
+    
+    asset_slot* slot = &asset_slots[i];
+    if (slot->ptr == NULL) { continue; }
+    
+    debug("Unloading: '%s'", slot->path);
+    
+    fpath ext;
+    SDL_PathFileExtension(ext.ptr, slot->path);
+    
+    for(int j = 0; j < num_asset_handlers; j++) {
+      asset_handler handler = asset_handlers[j];
+      if (strcmp(ext.ptr, handler.extension) == 0) {
+        handler.del_func(slot->ptr);
+        break;
+      }
     }
     
   }
   
-}
-
-void asset_finish() {
-
-  for(int i=0; i <asset_dict->size; i++) {
-    struct bucket* b = asset_dict->buckets[i];
-    delete_bucket_list(b);
+  for(int i = 1; i < num_asset_slots; i++) {
+    free(asset_slots[i].path);
+    free(asset_slots[i].dependencies);
   }
   
+  dict_delete(asset_dict);
+  dict_delete(asset_map_cache);
+  dict_map(asset_unmap_cache, free);
+  dict_delete(asset_unmap_cache);
+  asset_map_cache = NULL;
+  asset_unmap_cache = NULL;
+  free(asset_slots);
+  asset_slots = NULL;
+  num_asset_slots = 0;
+  max_asset_slots = 0;
+  
   for(int i=0; i < num_asset_handlers; i++) {
     free(asset_handlers[num_asset_handlers].extension);
   }
   
+  SDL_PackUnmountAll();
+  
 }
 
 void asset_handler_cast(type_id type, const char* extension, void* asset_loader(const char* filename) , void asset_deleter(void* asset) ) {
@@ -257,21 +634,159 @@ void asset_handler_cast(type_id type, const char* extension, void* asset_loader(
   h.type = type;
   h.extension = c;
   h.load_func = asset_loader;
+  h.read_func = NULL;
+  h.upload_func = NULL;
   h.del_func = asset_deleter;
+  h.size_func = NULL;
+  h.scan_func = NULL;
 
   asset_handlers[num_asset_handlers] = h;
   num_asset_handlers++;
   
 }
 
-void file_load(fpath filename) {
+void asset_handler_async_cast(
+  type_id type, const char* extension,
+  void* asset_reader(const char* filename),
+  asset* asset_uploader(const char* filename, void* data),
+  void asset_deleter(asset* asset) ) {
+  
+  asset_handler_cast(type, extension, NULL, asset_deleter);
+  
+  asset_handler* h = &asset_handlers[num_asset_handlers-1];
+  if (strcmp(h->extension, extension) != 0) { return; }
+  
+  h->read_func = asset_reader;
+  h->upload_func = asset_uploader;
+  
+}
+
+void asset_handler_size_cast(type_id type, size_t asset_sizer(asset* asset)) {
+  for(int i = 0; i < num_asset_handlers; i++) {
+    if (asset_handlers[i].type == type) {
+      asset_handlers[i].size_func = asset_sizer;
+    }
+  }
+}
+
+void asset_handler_scan_cast(const char* extension, int asset_scanner(const char* filename, fpath* dependencies, int max)) {
+  for(int i = 0; i < num_asset_handlers; i++) {
+    if (strcmp(asset_handlers[i].extension, extension) == 0) {
+      asset_handlers[i].scan_func = asset_scanner;
+    }
+  }
+}
+
+static int asset_handler_find(char* filename) {
+  
+  fpath ext;
+  SDL_PathFileExtension(ext.ptr, filename);
+  
+  for(int i = 0; i < num_asset_handlers; i++) {
+    if (strcmp(ext.ptr, asset_handlers[i].extension) == 0) { return i; }
+  }
+  
+  return -1;
+}
+
+/* Declared dependencies of a file, mapped. Returns how many. */
+static int asset_scan(char* filename, fpath* dependencies) {
+  
+  int handler = asset_handler_find(filename);
+  if (handler == -1 || asset_handlers[handler].scan_func == NULL) { return 0; }
+  
+  int num = asset_handlers[handler].scan_func(filename, dependencies, MAX_ASSET_DEPENDENCIES);
+  for(int i = 0; i < num; i++) {
+    dependencies[i] = asset_map_filename(dependencies[i]);
+  }
+  
+  return num;
+}
+
+static void asset_dependencies_visit(char* filename, dict* visited, list* order) {
+  
+  fpath dependencies[MAX_ASSET_DEPENDENCIES];
+  int num = asset_scan(filename, dependencies);
+  
+  for(int i = 0; i < num; i++) {
     
-  filename = asset_map_filename(filename);
+    if (dict_contains(visited, dependencies[i].ptr)) { continue; }
+    dict_set(visited, dependencies[i].ptr, NULL);
+    
+    asset_dependencies_visit(dependencies[i].ptr, visited, order);
+    
+    char* path = malloc(strlen(dependencies[i].ptr) + 1);
+    strcpy(path, dependencies[i].ptr);
+    list_push_back(order, path);
+  }
+  
+}
+
+list* asset_dependencies(fpath path) {
+  
+  path = asset_map_filename(path);
+  
+  dict* visited = dict_new(64);
+  dict_set(visited, path.ptr, NULL);
+  
+  list* order = list_new();
+  asset_dependencies_visit(path.ptr, visited, order);
+  
+  dict_delete(visited);
+  
+  return order;
+}
+
+static void asset_slot_set(uint32_t id, asset_handler* handler, asset* a) {
+  
+  asset_slot* slot = &asset_slots[id];
+  slot->ptr = a;
+  slot->generation++;
+  slot->evicted = false;
+  slot->last_used = asset_frame;
+  slot->size = handler->size_func ? handler->size_func(a) : 0;
+  
+  asset_resident += slot->size;
+}
+
+static void asset_async_wait_jobs(int first, uint32_t* ids, int num);
+
+void file_load(fpath filename) {
+  
+  uint32_t id = asset_map_id(filename.ptr);
+  filename = P(asset_slots[id].path);
   
-  if (dict_contains(asset_dict, filename.ptr)) {
+  if (asset_slots[id].ptr != NULL) {
     error("Asset '%s' already loaded", filename.ptr);
   }
   
+  asset_dependency_add(id);
+  
+  /*
+  ** At the top level, read any declared dependencies
+  ** in parallel first. They are uploaded in order, so
+  ** leaves are loaded before the assets that use them.
+  ** Only their jobs are waited on, anything else already
+  ** queued is left to upload within the frame budget.
+  */
+  if (asset_loading_depth == 0) {
+    
+    fpath dependencies[MAX_ASSET_DEPENDENCIES];
+    int num = asset_scan(filename.ptr, dependencies);
+    
+    if (num > 0) {
+      asset_slots[id].pending = true;
+      int first = num_asset_jobs;
+      uint32_t ids[MAX_ASSET_DEPENDENCIES];
+      for(int i = 0; i < num; i++) {
+        file_load_async(dependencies[i]);
+        ids[i] = asset_map_id(dependencies[i].ptr);
+      }
+      asset_async_wait_jobs(first, ids, num);
+      asset_slots[id].pending = false;
+    }
+  }
+  
   fpath ext;
   SDL_PathFileExtension(ext.ptr, filename.ptr);
   
@@ -280,8 +795,13 @@ void file_load(fpath filename) {
     
     if (strcmp(ext.ptr, handler.extension) == 0) {
       debug("Loading: '%s'", filename.ptr);
-      asset* a = handler.load_func(filename.ptr);
-      dict_set(asset_dict, filename.ptr, a);
+      asset_loading_push(id);
+      asset* a = handler.read_func
+        ? handler.upload_func(filename.ptr, handler.read_func(filename.ptr))
+        : handler.load_func(filename.ptr);
+      asset_loading_pop();
+      /* Loader may have created slots, reallocating the table */
+      asset_slot_set(id, &handler, a);
       break;
     }
     
@@ -292,6 +812,8 @@ void file_load(fpath filename) {
 bool file_exists(fpath filename) {
 
   filename = asset_map_filename(filename);
+  if (SDL_PackContains(filename.ptr)) { return true; }
+  
   SDL_RWops* file = SDL_RWFromFile(filename.ptr, "r");
   if (file) {
     SDL_RWclose(file);
@@ -307,8 +829,19 @@ void folder_load(fpath folder) {
   folder = asset_map_filename(folder);
   debug("Loading Folder: '%s'", folder.ptr);
   
+  int num_packed = 0;
+  void load_packed(const char* filename) {
+    num_packed++;
+    if (!file_isloaded(P(filename))) {
+      file_load(P(filename));
+    }
+  }
+  
+  SDL_PackListFolder(folder.ptr, false, load_packed);
+  
   DIR* dir = opendir(folder.ptr);
   if (dir == NULL) {
+    if (num_packed > 0) { return; }
     error("Could not open directory '%s' to load.", folder.ptr);
   }
   
@@ -336,9 +869,29 @@ void folder_load(fpath folder) {
   closedir(dir);
 }
 
-void folder_load_recursive(fpath folder) {
+static void folder_load_recursive_loose(fpath folder);
 
+void folder_load_recursive(fpath folder) {
+  
   folder = asset_map_filename(folder);
+  
+  int num_packed = 0;
+  void load_packed(const char* filename) {
+    num_packed++;
+    if (!file_isloaded(P(filename))) {
+      file_load(P(filename));
+    }
+  }
+  
+  SDL_PackListFolder(folder.ptr, true, load_packed);
+  
+  if (num_packed > 0 && !SDL_PathIsDirectory(folder.ptr)) { return; }
+  
+  folder_load_recursive_loose(folder);
+}
+
+static void folder_load_recursive_loose(fpath folder) {
+
   debug("Loading Folder: '%s'", folder.ptr);
   
   DIR* dir = opendir(folder.ptr);
@@ -363,7 +916,8 @@ void folder_load_recursive(fpath folder) {
       
       DIR* sub = opendir(filename.ptr);
       if (sub) {
-        folder_load_recursive(filename);
+        closedir(sub);
+        folder_load_recursive_loose(filename);
       }
       
       if (!file_isloaded(filename)) {
@@ -376,40 +930,689 @@ void folder_load_recursive(fpath folder) {
 
 }
 
-void file_reload(fpath filename) {
-  file_unload(filename);
-  file_load(filename);
-  asset_cache_flush();
-}
-
-void folder_reload(fpath folder) {
-  folder_unload(folder);
-  folder_load(folder);
-  asset_cache_flush();
+static int asset_worker(void* unused) {
+  
+  SDL_LockMutex(asset_jobs_lock);
+  
+  while (true) {
+    
+    while (!asset_workers_quit && asset_jobs_next == num_asset_jobs) {
+      SDL_CondWait(asset_jobs_queued, asset_jobs_lock);
+    }
+    
+    if (asset_workers_quit) { break; }
+    
+    int i = asset_jobs_next++;
+    if (asset_jobs[i].state != ASSET_JOB_QUEUED) { continue; }
+    
+    asset_jobs[i].state = ASSET_JOB_READING;
+    fpath path = asset_jobs[i].path;
+    void* (*read_func)(const char*) = asset_handlers[asset_jobs[i].handler].read_func;
+    
+    SDL_UnlockMutex(asset_jobs_lock);
+    double start = asset_profile_clock();
+    size_t bytes = SDL_RWBytesRead();
+    void* data = read_func(path.ptr);
+    double read_time = asset_profile_clock() - start;
+    size_t read_bytes = SDL_RWBytesRead() - bytes;
+    SDL_LockMutex(asset_jobs_lock);
+    
+    asset_jobs[i].data = data;
+    asset_jobs[i].read_time = read_time;
+    asset_jobs[i].read_bytes = read_bytes;
+    asset_jobs[i].state = ASSET_JOB_READ;
+    SDL_CondBroadcast(asset_jobs_read);
+    
+  }
+  
+  SDL_UnlockMutex(asset_jobs_lock);
+  
+  return 0;
 }
 
-void file_unload(fpath filename) {
-  
-  filename = asset_map_filename(filename);
+static void asset_workers_init(void) {
   
-  fpath ext;
-  SDL_PathFileExtension(ext.ptr, filename.ptr);
+  if (asset_workers_running) { return; }
   
-  for(int i=0; i < num_asset_handlers; i++) {
+  asset_jobs_lock = SDL_CreateMutex();
+  asset_jobs_queued = SDL_CreateCond();
+  asset_jobs_read = SDL_CreateCond();
+  asset_workers_quit = false;
   
-    asset_handler handler = asset_handlers[i];
-    if (strcmp(ext.ptr, handler.extension) == 0) {
-      debug("Unloading: '%s'", filename.ptr);
-      dict_remove_with(asset_dict, filename.ptr, handler.del_func);
-      break;
+  for(int i = 0; i < NUM_ASSET_WORKERS; i++) {
+    asset_workers[i] = SDL_CreateThread(asset_worker, NULL);
+    if (asset_workers[i] == NULL) {
+      error("Could not create asset worker thread: %s", SDL_GetError());
     }
-    
   }
+  
+  asset_workers_running = true;
 }
 
-void folder_unload(fpath folder) {
-    
-  folder = asset_map_filename(folder);
+static void asset_workers_finish(void) {
+  
+  if (!asset_workers_running) { return; }
+  
+  SDL_LockMutex(asset_jobs_lock);
+  asset_workers_quit = true;
+  SDL_CondBroadcast(asset_jobs_queued);
+  SDL_UnlockMutex(asset_jobs_lock);
+  
+  for(int i = 0; i < NUM_ASSET_WORKERS; i++) {
+    SDL_WaitThread(asset_workers[i], NULL);
+  }
+  
+  SDL_DestroyCond(asset_jobs_queued);
+  SDL_DestroyCond(asset_jobs_read);
+  SDL_DestroyMutex(asset_jobs_lock);
+  
+  free(asset_jobs);
+  asset_jobs = NULL;
+  num_asset_jobs = 0;
+  max_asset_jobs = 0;
+  asset_jobs_head = 0;
+  asset_jobs_next = 0;
+  
+  asset_workers_running = false;
+}
+
+void file_load_async(fpath filename) {
+  
+  uint32_t id = asset_map_id(filename.ptr);
+  filename = P(asset_slots[id].path);
+  if (asset_slots[id].ptr != NULL || asset_slots[id].pending) { return; }
+  
+  int handler = asset_handler_find(filename.ptr);
+  if (handler == -1) { return; }
+  
+  asset_workers_init();
+  
+  asset_slots[id].pending = true;
+  
+  /* Dependencies are queued first so that they finish first */
+  fpath dependencies[MAX_ASSET_DEPENDENCIES];
+  int num = asset_scan(filename.ptr, dependencies);
+  for(int i = 0; i < num; i++) {
+    file_load_async(dependencies[i]);
+  }
+  
+  debug("Queueing: '%s'", filename.ptr);
+  
+  SDL_LockMutex(asset_jobs_lock);
+  
+  if (num_asset_jobs == max_asset_jobs) {
+    max_asset_jobs = max_asset_jobs == 0 ? 64 : max_asset_jobs * 2;
+    asset_jobs = realloc(asset_jobs, sizeof(asset_job) * max_asset_jobs);
+  }
+  
+  /* Handlers without a read stage are loaded whole on the main thread */
+  asset_job* job = &asset_jobs[num_asset_jobs];
+  job->path = filename;
+  job->id = id;
+  job->handler = handler;
+  job->state = asset_handlers[handler].read_func ? ASSET_JOB_QUEUED : ASSET_JOB_READ;
+  job->data = NULL;
+  job->read_time = 0;
+  job->read_bytes = 0;
+  num_asset_jobs++;
+  
+  SDL_CondSignal(asset_jobs_queued);
+  SDL_UnlockMutex(asset_jobs_lock);
+  
+}
+
+static void asset_job_finish(asset_job job) {
+  
+  asset_handler handler = asset_handlers[job.handler];
+  
+  debug("Loading: '%s'", job.path.ptr);
+  asset_loading_push(asset_slot_id(job.path.ptr));
+  asset* a = handler.read_func
+    ? handler.upload_func(job.path.ptr, job.data)
+    : handler.load_func(job.path.ptr);
+  asset_loading_pop();
+  
+  /* Loader may have created slots, reallocating the table */
+  uint32_t id = asset_slot_id(job.path.ptr);
+  asset_slots[id].pending = false;
+  asset_slots[id].load_time += job.read_time;
+  asset_slots[id].bytes_read += job.read_bytes;
+  
+  /* Already loaded synchronously while this job was in flight */
+  if (asset_slots[id].ptr != NULL) {
+    handler.del_func(a);
+    return;
+  }
+  
+  asset_slot_set(id, &handler, a);
+  
+}
+
+void asset_async_update(uint32_t budget) {
+  
+  if (!asset_workers_running) { return; }
+  
+  uint32_t start = SDL_GetTicks();
+  
+  SDL_LockMutex(asset_jobs_lock);
+  
+  while (asset_jobs_head < num_asset_jobs) {
+    
+    /* Already finished by a synchronous load waiting on it */
+    if (asset_jobs[asset_jobs_head].state == ASSET_JOB_DONE) {
+      asset_jobs_head++;
+      continue;
+    }
+    
+    if (asset_jobs[asset_jobs_head].state != ASSET_JOB_READ) { break; }
+    
+    asset_job job = asset_jobs[asset_jobs_head++];
+    
+    SDL_UnlockMutex(asset_jobs_lock);
+    asset_job_finish(job);
+    SDL_LockMutex(asset_jobs_lock);
+    
+    if (SDL_GetTicks() - start >= budget) { break; }
+  }
+  
+  /* Once workers have caught up the queue can be reused from the start */
+  if (asset_jobs_head == num_asset_jobs && asset_jobs_next == num_asset_jobs) {
+    asset_jobs_head = 0;
+    asset_jobs_next = 0;
+    num_asset_jobs = 0;
+  }
+  
+  SDL_UnlockMutex(asset_jobs_lock);
+  
+}
+
+int asset_async_pending(void) {
+  
+  if (!asset_workers_running) { return 0; }
+  
+  SDL_LockMutex(asset_jobs_lock);
+  int pending = 0;
+  for(int i = asset_jobs_head; i < num_asset_jobs; i++) {
+    pending += asset_jobs[i].state != ASSET_JOB_DONE;
+  }
+  SDL_UnlockMutex(asset_jobs_lock);
+  
+  return pending;
+}
+
+void asset_async_wait(void) {
+  
+  if (!asset_workers_running) { return; }
+  
+  while (asset_async_pending()) {
+    
+    SDL_LockMutex(asset_jobs_lock);
+    while (asset_jobs_head < num_asset_jobs &&
+           asset_jobs[asset_jobs_head].state != ASSET_JOB_READ &&
+           asset_jobs[asset_jobs_head].state != ASSET_JOB_DONE) {
+      SDL_CondWait(asset_jobs_read, asset_jobs_lock);
+    }
+    SDL_UnlockMutex(asset_jobs_lock);
+    
+    asset_async_update(0xFFFFFFFF);
+  }
+  
+}
+
+/*
+** Finishes just the jobs a synchronous load is waiting
+** on. Those are the jobs queued from first onward and
+** any queued earlier for the given slots. They finish in
+** queue order and other jobs are left to
+** asset_async_update, so its budget still holds.
+*/
+static void asset_async_wait_jobs(int first, uint32_t* ids, int num) {
+  
+  if (!asset_workers_running) { return; }
+  
+  SDL_LockMutex(asset_jobs_lock);
+  
+  while (true) {
+    
+    int next = -1;
+    for(int i = asset_jobs_head; i < num_asset_jobs && next == -1; i++) {
+      if (asset_jobs[i].state == ASSET_JOB_DONE) { continue; }
+      if (i >= first) { next = i; continue; }
+      for(int j = 0; j < num; j++) {
+        if (asset_jobs[i].id == ids[j]) { next = i; break; }
+      }
+    }
+    
+    if (next == -1) { break; }
+    
+    if (asset_jobs[next].state != ASSET_JOB_READ) {
+      SDL_CondWait(asset_jobs_read, asset_jobs_lock);
+      continue;
+    }
+    
+    asset_job job = asset_jobs[next];
+    asset_jobs[next].state = ASSET_JOB_DONE;
+    
+    SDL_UnlockMutex(asset_jobs_lock);
+    asset_job_finish(job);
+    SDL_LockMutex(asset_jobs_lock);
+  }
+  
+  SDL_UnlockMutex(asset_jobs_lock);
+  
+}
+
+static void folder_load_async_loose(fpath folder);
+
+void folder_load_async(fpath folder) {
+  
+  folder = asset_map_filename(folder);
+  
+  int num_packed = 0;
+  void load_packed(const char* filename) {
+    num_packed++;
+    file_load_async(P(filename));
+  }
+  
+  SDL_PackListFolder(folder.ptr, true, load_packed);
+  
+  if (num_packed > 0 && !SDL_PathIsDirectory(folder.ptr)) { return; }
+  
+  folder_load_async_loose(folder);
+}
+
+static void folder_load_async_loose(fpath folder) {
+  
+  debug("Queueing Folder: '%s'", folder.ptr);
+  
+  DIR* dir = opendir(folder.ptr);
+  if (dir == NULL) {
+    error("Could not open directory '%s' to load.", folder.ptr);
+  }
+  
+  struct dirent* ent;
+  while ((ent = readdir(dir)) != NULL) {
+  
+    if ((strcmp(ent->d_name,".") != 0) && 
+        (strcmp(ent->d_name,"..") != 0)) {
+    
+      fpath filename = folder;
+      
+      // If does not end in "/" then copy it.
+      if (folder.ptr[strlen(folder.ptr)-1] != '/') {
+        strcat(filename.ptr, "/");
+      }
+      
+      strcat(filename.ptr, ent->d_name);
+      
+      DIR* sub = opendir(filename.ptr);
+      if (sub) {
+        closedir(sub);
+        folder_load_async_loose(filename);
+        continue;
+      }
+      
+      file_load_async(filename);
+    } 
+  }
+  
+  closedir(dir);
+}
+
+void asset_pack_build(fpath folder, fpath pack) {
+  
+  folder = asset_map_filename(folder);
+  debug("Packing Folder: '%s'", folder.ptr);
+  
+  if (!SDL_PackBuild(folder.ptr, pack.ptr)) {
+    error("Could not build pack '%s' from '%s'", pack.ptr, folder.ptr);
+  }
+  
+}
+
+void asset_pack_mount(fpath pack, fpath root) {
+  
+  root = asset_map_filename(root);
+  debug("Mounting Pack: '%s' at '%s'", pack.ptr, root.ptr);
+  
+  if (!SDL_PackMount(pack.ptr, root.ptr)) {
+    error("Could not mount pack '%s'", pack.ptr);
+  }
+  
+}
+
+void asset_pack_unmount(fpath pack) {
+  debug("Unmounting Pack: '%s'", pack.ptr);
+  SDL_PackUnmount(pack.ptr);
+}
+
+/*
+** Watched folders are registered with inotify and polled
+** without blocking once per frame. Any loaded asset whose
+** file was written is reloaded, followed by every loaded
+** asset which depends on it.
+*/
+
+typedef struct {
+  int descriptor;
+  fpath folder;
+} asset_watch_folder;
+
+static int asset_watch_fd = -1;
+static asset_watch_folder* asset_watch_folders = NULL;
+static int num_asset_watch_folders = 0;
+static uint32_t asset_watch_last_latency = 0;
+
+static void asset_reload_dependents(uint32_t id) {
+  
+  /* Breadth first so dependents reload after what they use */
+  int num_reload = 1;
+  uint32_t* reload = malloc(sizeof(uint32_t));
+  reload[0] = id;
+  
+  for(int r = 0; r < num_reload; r++) {
+    for(int i = 1; i < num_asset_slots; i++) {
+      
+      asset_slot* slot = &asset_slots[i];
+      if (slot->ptr == NULL) { continue; }
+      
+      bool depends = false;
+      for(int j = 0; j < slot->num_dependencies; j++) {
+        if (slot->dependencies[j] == reload[r]) { depends = true; break; }
+      }
+      if (!depends) { continue; }
+      
+      bool queued = false;
+      for(int j = 0; j < num_reload; j++) {
+        if (reload[j] == i) { queued = true; break; }
+      }
+      if (queued) { continue; }
+      
+      num_reload++;
+      reload = realloc(reload, sizeof(uint32_t) * num_reload);
+      reload[num_reload-1] = i;
+    }
+  }
+  
+  for(int r = 0; r < num_reload; r++) {
+    fpath path = P(asset_slots[reload[r]].path);
+    file_unload(path);
+    if (!file_isloaded(path)) { file_load(path); }
+  }
+  
+  free(reload);
+}
+
+#ifdef __linux__
+
+static void asset_watch_folder_add(fpath folder) {
+  
+  int descriptor = inotify_add_watch(asset_watch_fd, folder.ptr, 
+    IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+  
+  if (descriptor == -1) {
+    warning("Could not watch folder '%s'", folder.ptr);
+    return;
+  }
+  
+  num_asset_watch_folders++;
+  asset_watch_folders = realloc(asset_watch_folders, sizeof(asset_watch_folder) * num_asset_watch_folders);
+  asset_watch_folders[num_asset_watch_folders-1].descriptor = descriptor;
+  asset_watch_folders[num_asset_watch_folders-1].folder = folder;
+  
+  DIR* dir = opendir(folder.ptr);
+  if (dir == NULL) { return; }
+  
+  struct dirent* ent;
+  while ((ent = readdir(dir)) != NULL) {
+    
+    if ((strcmp(ent->d_name,".") == 0) || 
+        (strcmp(ent->d_name,"..") == 0)) { continue; }
+    
+    fpath sub = folder;
+    strcat(sub.ptr, "/");
+    strcat(sub.ptr, ent->d_name);
+    
+    if (SDL_PathIsDirectory(sub.ptr)) {
+      asset_watch_folder_add(sub);
+    }
+  }
+  
+  closedir(dir);
+}
+
+void asset_watch(fpath folder) {
+  
+  folder = asset_map_filename(folder);
+  debug("Watching Folder: '%s'", folder.ptr);
+  
+  if (asset_watch_fd == -1) {
+    asset_watch_fd = inotify_init1(IN_NONBLOCK);
+    if (asset_watch_fd == -1) {
+      warning("Could not initialise file watching");
+      return;
+    }
+  }
+  
+  asset_watch_folder_add(folder);
+}
+
+static uint32_t asset_watch_latency(fpath path) {
+  
+  struct stat st;
+  if (stat(path.ptr, &st) == -1) { return 0; }
+  
+  struct timespec now;
+  clock_gettime(CLOCK_REALTIME, &now);
+  
+  int64_t ms = (int64_t)(now.tv_sec - st.st_mtim.tv_sec) * 1000 
+             + (now.tv_nsec - st.st_mtim.tv_nsec) / 1000000;
+  
+  return ms > 0 ? ms : 0;
+}
+
+int asset_watch_update(void) {
+  
+  if (asset_watch_fd == -1) { return 0; }
+  
+  int num_changed = 0;
+  uint32_t* changed = NULL;
+  
+  char buffer[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+  
+  while (true) {
+    
+    int len = read(asset_watch_fd, buffer, sizeof(buffer));
+    if (len <= 0) { break; }
+    
+    for (char* ptr = buffer; ptr < buffer + len; ) {
+      
+      struct inotify_event* event = (struct inotify_event*)ptr;
+      ptr += sizeof(struct inotify_event) + event->len;
+      
+      if (event->len == 0) { continue; }
+      
+      fpath path; path.ptr[0] = '\0';
+      for(int i = 0; i < num_asset_watch_folders; i++) {
+        if (asset_watch_folders[i].descriptor == event->wd) {
+          path = asset_watch_folders[i].folder;
+          break;
+        }
+      }
+      
+      if (path.ptr[0] == '\0') { continue; }
+      strcat(path.ptr, "/");
+      strcat(path.ptr, event->name);
+      
+      if (event->mask & IN_ISDIR) {
+        if (event->mask & IN_CREATE) { asset_watch_folder_add(path); }
+        continue;
+      }
+      
+      if (!(event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO))) { continue; }
+      
+      /*
+      ** Watched folders are already mapped so the path can
+      ** be looked up as it is. Editors write plenty of
+      ** temporary files, which shouldn't be given slots.
+      */
+      uint32_t id = asset_slot_find(path.ptr);
+      if (id == 0 || asset_slots[id].ptr == NULL) { continue; }
+      
+      bool seen = false;
+      for(int i = 0; i < num_changed; i++) {
+        if (changed[i] == id) { seen = true; break; }
+      }
+      if (seen) { continue; }
+      
+      num_changed++;
+      changed = realloc(changed, sizeof(uint32_t) * num_changed);
+      changed[num_changed-1] = id;
+    }
+  }
+  
+  int num_reloaded = 0;
+  
+  for(int i = 0; i < num_changed; i++) {
+    
+    fpath path = P(asset_slots[changed[i]].path);
+    
+    /* File may have been written then moved away again */
+    if (!SDL_PathIsFile(path.ptr)) { continue; }
+    
+    uint32_t start = SDL_GetTicks();
+    asset_reload_dependents(changed[i]);
+    uint32_t latency = asset_watch_latency(path);
+    
+    debug("Reloaded '%s' in %ims, %ims after change", path.ptr, SDL_GetTicks() - start, latency);
+    
+    asset_watch_last_latency = latency;
+    num_reloaded++;
+  }
+  
+  free(changed);
+  
+  return num_reloaded;
+}
+
+static void asset_watch_finish(void) {
+  
+  if (asset_watch_fd != -1) {
+    close(asset_watch_fd);
+    asset_watch_fd = -1;
+  }
+  
+  free(asset_watch_folders);
+  asset_watch_folders = NULL;
+  num_asset_watch_folders = 0;
+}
+
+#else
+
+void asset_watch(fpath folder) {
+  warning("File watching is not supported on this platform");
+}
+
+int asset_watch_update(void) {
+  return 0;
+}
+
+static void asset_watch_finish(void) {}
+
+#endif
+
+uint32_t asset_watch_reload_latency(void) {
+  return asset_watch_last_latency;
+}
+
+void file_reload(fpath filename) {
+  file_unload(filename);
+  file_load(filename);
+}
+
+void folder_reload(fpath folder) {
+  folder_unload(folder);
+  folder_load(folder);
+}
+
+void file_unload(fpath filename) {
+  
+  filename = asset_map_filename(filename);
+  
+  asset_slot* slot = asset_slot_get(filename.ptr);
+  if (slot == NULL || slot->ptr == NULL) { return; }
+  
+  fpath ext;
+  SDL_PathFileExtension(ext.ptr, filename.ptr);
+  
+  for(int i=0; i < num_asset_handlers; i++) {
+  
+    asset_handler handler = asset_handlers[i];
+    if (strcmp(ext.ptr, handler.extension) == 0) {
+      debug("Unloading: '%s'", filename.ptr);
+      asset* a = slot->ptr;
+      slot->ptr = NULL;
+      slot->generation++;
+      slot->evicted = false;
+      asset_resident -= slot->size;
+      slot->size = 0;
+      handler.del_func(a);
+      break;
+    }
+    
+  }
+}
+
+void asset_set_budget(size_t bytes) {
+  asset_budget = bytes;
+}
+
+size_t asset_resident_size(void) {
+  return asset_resident;
+}
+
+static int asset_lru_compare(const void* a, const void* b) {
+  uint32_t ua = asset_slots[*(const uint32_t*)a].last_used;
+  uint32_t ub = asset_slots[*(const uint32_t*)b].last_used;
+  return (ua > ub) - (ua < ub);
+}
+
+void asset_budget_update(void) {
+  
+  asset_frame++;
+  
+  if (asset_budget == 0 || asset_resident <= asset_budget) { return; }
+  
+  /* Anything used last frame or still referenced stays resident */
+  int num_candidates = 0;
+  uint32_t* candidates = malloc(sizeof(uint32_t) * num_asset_slots);
+  
+  for(int i = 1; i < num_asset_slots; i++) {
+    asset_slot* slot = &asset_slots[i];
+    if (slot->ptr == NULL || slot->references > 0) { continue; }
+    if (slot->last_used + 1 >= asset_frame) { continue; }
+    candidates[num_candidates++] = i;
+  }
+  
+  qsort(candidates, num_candidates, sizeof(uint32_t), asset_lru_compare);
+  
+  for(int i = 0; i < num_candidates && asset_resident > asset_budget; i++) {
+    
+    /* Deleting an earlier asset may have released this one's owner */
+    asset_slot* slot = &asset_slots[candidates[i]];
+    if (slot->ptr == NULL || slot->references > 0) { continue; }
+    
+    debug("Evicting: '%s' (%i bytes)", slot->path, (int)slot->size);
+    file_unload(P(slot->path));
+    asset_slots[candidates[i]].evicted = true;
+  }
+  
+  free(candidates);
+}
+
+void folder_unload(fpath folder) {
+    
+  folder = asset_map_filename(folder);
   
   debug("Unloading Folder: '%s'", folder.ptr);
   DIR* dir = opendir(folder.ptr);
@@ -427,7 +1630,7 @@ void folder_unload(fpath folder) {
       fpath filename = folder;
       strcat(filename.ptr, ent->d_name);
       
-      if(dict_contains(asset_dict, filename.ptr) ) {
+      if(file_isloaded(filename)) {
         file_unload(filename);
       }
       
@@ -438,7 +1641,8 @@ void folder_unload(fpath folder) {
 
 bool file_isloaded(fpath path) {
   path = asset_map_filename(path);
-  return dict_contains(asset_dict, path.ptr);
+  asset_slot* slot = asset_slot_get(path.ptr);
+  return slot != NULL && slot->ptr != NULL;
 }
 
 asset* asset_get_load(fpath path) {
@@ -473,19 +1677,18 @@ void asset_reload_type_id(type_id type) {
   
   list* asset_names = list_new();
   
-  for(int i = 0; i < asset_dict->size; i++) {
-    struct bucket* b = asset_dict->buckets[i];
-    while(b != NULL) {
-      fpath bucket_ext;
-      SDL_PathFileExtension(bucket_ext.ptr, b->key);
-      
-      if (strcmp(bucket_ext.ptr, ext.ptr) == 0) {
-        char* new_name = malloc(strlen(b->key)+1);
-        strcpy(new_name, b->key);
-        list_push_back(asset_names, new_name);
-      }
-      
-      b = b->next;
+  for(int i = 1; i < num_asset_slots; i++) {
+    if (asset_slots[i].ptr == NULL) { continue; }
+    
+    char* path = asset_slots[i].path;
+    
+    fpath path_ext;
+    SDL_PathFileExtension(path_ext.ptr, path);
+    
+    if (strcmp(path_ext.ptr, ext.ptr) == 0) {
+      char* new_name = malloc(strlen(path)+1);
+      strcpy(new_name, path);
+      list_push_back(asset_names, new_name);
     }
   }
 
@@ -504,8 +1707,6 @@ void asset_reload_type_id(type_id type) {
   }
   
   list_delete_with(asset_names, free);
-  
-  asset_cache_flush();
 }
 
 void asset_reload_all() {
@@ -514,14 +1715,12 @@ void asset_reload_all() {
   
   list* asset_names = list_new();
   
-  for(int i = 0; i < asset_dict->size; i++) {
-    struct bucket* b = asset_dict->buckets[i];
-    while(b != NULL) {
-      char* new_name = malloc(strlen(b->key)+1);
-      strcpy(new_name, b->key);
-      list_push_back(asset_names, new_name);
-      b = b->next;
-    }
+  for(int i = 1; i < num_asset_slots; i++) {
+    if (asset_slots[i].ptr == NULL) { continue; }
+    char* path = asset_slots[i].path;
+    char* new_name = malloc(strlen(path)+1);
+    strcpy(new_name, path);
+    list_push_back(asset_names, new_name);
   }
   
   for(int i = 0; i < asset_names->num_items; i++) {
@@ -539,27 +1738,209 @@ void asset_reload_all() {
   }
   
   list_delete_with(asset_names, free);
+}
+
+static int asset_profile_bucket(double time) {
+  double limit = 0.001;
+  for(int i = 0; i < ASSET_PROFILE_BUCKETS-1; i++) {
+    if (time < limit) { return i; }
+    limit *= 4;
+  }
+  return ASSET_PROFILE_BUCKETS-1;
+}
+
+static void asset_profile_add(asset_profile* p, asset_slot* slot) {
+  if (slot->loads == 0) { return; }
+  p->count++;
+  p->loads += slot->loads;
+  p->time += slot->load_time;
+  p->bytes_read += slot->bytes_read;
+  p->resident += slot->size;
+  p->histogram[asset_profile_bucket(slot->load_time / slot->loads)]++;
+}
+
+asset_profile asset_profile_handler(const char* extension) {
+  
+  asset_profile p;
+  memset(&p, 0, sizeof(asset_profile));
+  p.extension = extension;
+  
+  for(int i = 1; i < num_asset_slots; i++) {
+    fpath ext;
+    SDL_PathFileExtension(ext.ptr, asset_slots[i].path);
+    if (strcmp(ext.ptr, extension) == 0) {
+      asset_profile_add(&p, &asset_slots[i]);
+    }
+  }
+  
+  return p;
+}
+
+asset_profile asset_profile_total(void) {
+  
+  asset_profile p;
+  memset(&p, 0, sizeof(asset_profile));
+  
+  for(int i = 1; i < num_asset_slots; i++) {
+    asset_profile_add(&p, &asset_slots[i]);
+  }
+  
+  return p;
+}
+
+void asset_profile_reset(void) {
+  for(int i = 1; i < num_asset_slots; i++) {
+    asset_slots[i].loads = 0;
+    asset_slots[i].load_time = 0;
+    asset_slots[i].bytes_read = 0;
+  }
+}
+
+static void asset_profile_write(SDL_RWops* file, const char* fmt, ...) {
+  char line[MAX_PATH * 2 + 512];
+  va_list args;
+  va_start(args, fmt);
+  vsnprintf(line, sizeof(line), fmt, args);
+  va_end(args);
+  SDL_RWwrite(file, line, strlen(line), 1);
+}
+
+static void asset_profile_escape(char* dst, const char* src) {
+  while (*src) {
+    if (*src == '"' || *src == '\\') { *dst++ = '\\'; }
+    *dst++ = *src++;
+  }
+  *dst = '\0';
+}
+
+/* CSV fields are quoted, so quotes inside them are doubled */
+static void asset_profile_escape_csv(char* dst, const char* src) {
+  while (*src) {
+    if (*src == '"') { *dst++ = '"'; }
+    *dst++ = *src++;
+  }
+  *dst = '\0';
+}
+
+static int asset_profile_compare_slots(const void* a, const void* b) {
+  double ta = asset_slots[*(const uint32_t*)a].load_time;
+  double tb = asset_slots[*(const uint32_t*)b].load_time;
+  return (ta < tb) - (ta > tb);
+}
+
+static int asset_profile_compare_handlers(const void* a, const void* b) {
+  double ta = ((const asset_profile*)a)->time;
+  double tb = ((const asset_profile*)b)->time;
+  return (ta < tb) - (ta > tb);
+}
+
+void asset_profile_dump(fpath filename) {
+  
+  fpath ext;
+  SDL_PathFileExtension(ext.ptr, filename.ptr);
+  bool json = (strcmp(ext.ptr, "json") == 0);
+  
+  SDL_RWops* file = SDL_RWFromFile(filename.ptr, "w");
+  if (file == NULL) {
+    error("Cannot write profile to %s", filename.ptr);
+  }
+  
+  /* Handlers and assets, most expensive first */
+  
+  int num_handlers = 0;
+  asset_profile* handlers = malloc(sizeof(asset_profile) * num_asset_handlers);
+  for(int i = 0; i < num_asset_handlers; i++) {
+    asset_profile p = asset_profile_handler(asset_handlers[i].extension);
+    if (p.count == 0) { continue; }
+    handlers[num_handlers++] = p;
+  }
+  qsort(handlers, num_handlers, sizeof(asset_profile), asset_profile_compare_handlers);
+  
+  int num_loaded = 0;
+  uint32_t* loaded = malloc(sizeof(uint32_t) * num_asset_slots);
+  for(int i = 1; i < num_asset_slots; i++) {
+    if (asset_slots[i].loads > 0) { loaded[num_loaded++] = i; }
+  }
+  qsort(loaded, num_loaded, sizeof(uint32_t), asset_profile_compare_slots);
+  
+  char name[MAX_PATH * 2];
+  
+  if (json) {
+    
+    asset_profile_write(file, "{\n  \"handlers\": [\n");
+    for(int i = 0; i < num_handlers; i++) {
+      asset_profile* p = &handlers[i];
+      asset_profile_write(file, 
+        "    { \"extension\": \"%s\", \"assets\": %i, \"loads\": %i, \"time_ms\": %.3f, "
+        "\"bytes_read\": %lu, \"resident\": %lu, \"histogram\": [%i, %i, %i, %i, %i, %i] }%s\n",
+        p->extension, p->count, p->loads, p->time * 1000, 
+        (unsigned long)p->bytes_read, (unsigned long)p->resident, 
+        p->histogram[0], p->histogram[1], p->histogram[2], 
+        p->histogram[3], p->histogram[4], p->histogram[5],
+        i == num_handlers-1 ? "" : ",");
+    }
+    
+    asset_profile_write(file, "  ],\n  \"assets\": [\n");
+    for(int i = 0; i < num_loaded; i++) {
+      asset_slot* slot = &asset_slots[loaded[i]];
+      asset_profile_escape(name, slot->path);
+      asset_profile_write(file, 
+        "    { \"path\": \"%s\", \"loads\": %i, \"time_ms\": %.3f, \"bytes_read\": %lu, \"resident\": %lu }%s\n",
+        name, slot->loads, slot->load_time * 1000, 
+        (unsigned long)slot->bytes_read, (unsigned long)slot->size,
+        i == num_loaded-1 ? "" : ",");
+    }
+    asset_profile_write(file, "  ]\n}\n");
+    
+  } else {
+    
+    asset_profile_write(file, "kind,name,assets,loads,time_ms,bytes_read,resident,"
+      "under_1ms,under_4ms,under_16ms,under_64ms,under_256ms,over_256ms\n");
+    
+    for(int i = 0; i < num_handlers; i++) {
+      asset_profile* p = &handlers[i];
+      asset_profile_write(file, "handler,%s,%i,%i,%.3f,%lu,%lu,%i,%i,%i,%i,%i,%i\n",
+        p->extension, p->count, p->loads, p->time * 1000, 
+        (unsigned long)p->bytes_read, (unsigned long)p->resident, 
+        p->histogram[0], p->histogram[1], p->histogram[2], 
+        p->histogram[3], p->histogram[4], p->histogram[5]);
+    }
+    
+    for(int i = 0; i < num_loaded; i++) {
+      asset_slot* slot = &asset_slots[loaded[i]];
+      asset_profile_escape_csv(name, slot->path);
+      asset_profile_write(file, "asset,\"%s\",1,%i,%.3f,%lu,%lu,,,,,,\n",
+        name, slot->loads, slot->load_time * 1000, 
+        (unsigned long)slot->bytes_read, (unsigned long)slot->size);
+    }
+  }
+  
+  SDL_RWclose(file);
+  
+  free(handlers);
+  free(loaded);
   
-  asset_cache_flush();
 }
 
 char* asset_ptr_path(asset* a) {
-  char* path = dict_find(asset_dict, a);
-  if (path == NULL) {
+  asset_slot* slot = asset_slot_of_ptr(a);
+  if (slot == NULL) {
     error("Asset dict doesn't contain asset pointer %p", a);
     return NULL;
   } else {
-    return path; 
+    return slot->path; 
   }
 }
 
 char* asset_ptr_typename(asset* a) {
-  char* path = dict_find(asset_dict, a);
-  if (path == NULL) {
+  asset_slot* slot = asset_slot_of_ptr(a);
+  if (slot == NULL) {
     error("Asset dict doesn't contain asset pointer %p", a);
     return NULL;
   }
   
+  char* path = slot->path;
+  
   fpath ext;
   SDL_PathFileExtension(ext.ptr, path);
   
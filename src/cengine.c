@@ -1,5 +1,25 @@
 #include "cengine.h"
 
+#ifdef CORANGE_SSE
+#include <xmmintrin.h>
+
+/*
+** Small vectors are passed and returned in halves, so
+** they are moved in and out of SSE registers in halves
+** too. A single wide load of them stalls the processor.
+*/
+static inline __m128 vec4_load_sse(const vec4* v) {
+  return _mm_loadh_pi(_mm_loadl_pi(_mm_setzero_ps(), (const __m64*)&v->x), (const __m64*)&v->z);
+}
+
+static inline vec4 vec4_store_sse(__m128 r) {
+  vec4 v;
+  _mm_storel_pi((__m64*)&v.x, r);
+  _mm_storeh_pi((__m64*)&v.z, r);
+  return v;
+}
+#endif
+
 fpath P(const char* path) {
   fpath p;
   //strncpy(p.ptr, path, PATH_MAX-1);
@@ -37,6 +57,15 @@ typedef void (*error_func_t)(const char*);
 typedef void (*warn_func_t)(const char*);
 typedef void (*debug_func_t)(const char*);
 
+__thread char error_buf[2048];
+__thread char error_str[2048];
+
+__thread char warning_buf[2048];
+__thread char warning_str[2048];
+
+__thread char debug_buf[2048];
+__thread char debug_str[2048];
+
 #define MAX_AT_FUNCS 32
 static error_func_t error_funcs[MAX_AT_FUNCS];
 static warn_func_t warn_funcs[MAX_AT_FUNCS];
@@ -1254,11 +1283,28 @@ vec3 quat_to_euler(quat q) {
 
 quat quat_mul_quat(quat q1, quat q2) {
 
+#ifdef CORANGE_SSE
+  /*
+  ** Sums the same products in the same order as the
+  ** scalar code so results are identical.
+  */
+  __m128 b = vec4_load_sse(&q2);
+  __m128 r = _mm_mul_ps(_mm_set1_ps(q1.w), b);
+  r = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(q1.x), 
+    _mm_mul_ps(_mm_shuffle_ps(b, b, _MM_SHUFFLE(0,1,2,3)), _mm_setr_ps( 1,-1, 1,-1))));
+  r = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(q1.y),
+    _mm_mul_ps(_mm_shuffle_ps(b, b, _MM_SHUFFLE(1,0,3,2)), _mm_setr_ps( 1, 1,-1,-1))));
+  r = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(q1.z),
+    _mm_mul_ps(_mm_shuffle_ps(b, b, _MM_SHUFFLE(2,3,0,1)), _mm_setr_ps(-1, 1, 1,-1))));
+  
+  return vec4_store_sse(r);
+#else
   return quat_new(
     (q1.w * q2.x) + (q1.x * q2.w) + (q1.y * q2.z) - (q1.z * q2.y),
     (q1.w * q2.y) - (q1.x * q2.z) + (q1.y * q2.w) + (q1.z * q2.x),
     (q1.w * q2.z) + (q1.x * q2.y) - (q1.y * q2.x) + (q1.z * q2.w),
     (q1.w * q2.w) - (q1.x * q2.x) - (q1.y * q2.y) - (q1.z * q2.z));
+#endif
 
 }
 
@@ -1927,6 +1973,18 @@ mat4 mat4_new(float xx, float xy, float xz, float xw,
 mat4 mat4_transpose(mat4 m) {
   mat4 mat;
   
+#ifdef CORANGE_SSE
+  __m128 r0 = _mm_loadu_ps(&m.xx);
+  __m128 r1 = _mm_loadu_ps(&m.yx);
+  __m128 r2 = _mm_loadu_ps(&m.zx);
+  __m128 r3 = _mm_loadu_ps(&m.wx);
+  _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+  _mm_storeu_ps(&mat.xx, r0);
+  _mm_storeu_ps(&mat.yx, r1);
+  _mm_storeu_ps(&mat.zx, r2);
+  _mm_storeu_ps(&mat.wx, r3);
+  return mat;
+#else
   mat.xx = m.xx;
   mat.xy = m.yx;
   mat.xz = m.zx;
@@ -1948,6 +2006,7 @@ mat4 mat4_transpose(mat4 m) {
   mat.ww = m.ww;
   
   return mat;
+#endif
 }
 
 mat4 mat3_to_mat4(mat3 m) {
@@ -1977,10 +2036,34 @@ mat4 mat3_to_mat4(mat3 m) {
   return mat;
 }
 
+#ifdef CORANGE_SSE
+
+/* Row of m1 times m2, summed in the same order as the scalar code */
+static __m128 mat4_row_mul_sse(const float* row, __m128 r0, __m128 r1, __m128 r2, __m128 r3) {
+  __m128 r = _mm_mul_ps(_mm_set1_ps(row[0]), r0);
+  r = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(row[1]), r1));
+  r = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(row[2]), r2));
+  r = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(row[3]), r3));
+  return r;
+}
+
+#endif
+
 mat4 mat4_mul_mat4(mat4 m1, mat4 m2) {
 
   mat4 mat;
 
+#ifdef CORANGE_SSE
+  __m128 r0 = _mm_loadu_ps(&m2.xx);
+  __m128 r1 = _mm_loadu_ps(&m2.yx);
+  __m128 r2 = _mm_loadu_ps(&m2.zx);
+  __m128 r3 = _mm_loadu_ps(&m2.wx);
+  _mm_storeu_ps(&mat.xx, mat4_row_mul_sse(&m1.xx, r0, r1, r2, r3));
+  _mm_storeu_ps(&mat.yx, mat4_row_mul_sse(&m1.yx, r0, r1, r2, r3));
+  _mm_storeu_ps(&mat.zx, mat4_row_mul_sse(&m1.zx, r0, r1, r2, r3));
+  _mm_storeu_ps(&mat.wx, mat4_row_mul_sse(&m1.wx, r0, r1, r2, r3));
+  return mat;
+#else
   mat.xx = (m1.xx * m2.xx) + (m1.xy * m2.yx) + (m1.xz * m2.zx) + (m1.xw * m2.wx);
   mat.xy = (m1.xx * m2.xy) + (m1.xy * m2.yy) + (m1.xz * m2.zy) + (m1.xw * m2.wy);
   mat.xz = (m1.xx * m2.xz) + (m1.xy * m2.yz) + (m1.xz * m2.zz) + (m1.xw * m2.wz);
@@ -2002,6 +2085,7 @@ mat4 mat4_mul_mat4(mat4 m1, mat4 m2) {
   mat.ww = (m1.wx * m2.xw) + (m1.wy * m2.yw) + (m1.wz * m2.zw) + (m1.ww * m2.ww);
   
   return mat;
+#endif
   
 }
 
@@ -2009,12 +2093,21 @@ vec4 mat4_mul_vec4(mat4 m, vec4 v) {
   
   vec4 vec;
   
+#ifdef CORANGE_SSE
+  __m128 c0 = _mm_loadu_ps(&m.xx);
+  __m128 c1 = _mm_loadu_ps(&m.yx);
+  __m128 c2 = _mm_loadu_ps(&m.zx);
+  __m128 c3 = _mm_loadu_ps(&m.wx);
+  _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+  return vec4_store_sse(mat4_row_mul_sse(&v.x, c0, c1, c2, c3));
+#else
   vec.x = (m.xx * v.x) + (m.xy * v.y) + (m.xz * v.z) + (m.xw * v.w);
   vec.y = (m.yx * v.x) + (m.yy * v.y) + (m.yz * v.z) + (m.yw * v.w);
   vec.z = (m.zx * v.x) + (m.zy * v.y) + (m.zz * v.z) + (m.zw * v.w);
   vec.w = (m.wx * v.x) + (m.wy * v.y) + (m.wz * v.z) + (m.ww * v.w);
   
   return vec;
+#endif
 }
 
 vec3 mat4_mul_vec3(mat4 m, vec3 v) {
@@ -2104,8 +2197,79 @@ float mat4_det(mat4 m) {
   return (cofact_xx * m.xx) + (cofact_xy * m.xy) + (cofact_xz * m.xz) + (cofact_xw * m.xw);
 }
 
+#ifdef CORANGE_SSE
+
+/*
+** Inverse from the 2x2 determinants of the top and bottom
+** pairs of rows. For the columns i and j this gives the
+** bottom determinant in the first two lanes and the top
+** determinant in the last two.
+*/
+static __m128 mat4_minors_sse(__m128 ci, __m128 cj) {
+  return _mm_sub_ps(
+    _mm_mul_ps(_mm_shuffle_ps(ci, ci, _MM_SHUFFLE(0,0,2,2)), _mm_shuffle_ps(cj, cj, _MM_SHUFFLE(1,1,3,3))),
+    _mm_mul_ps(_mm_shuffle_ps(cj, cj, _MM_SHUFFLE(0,0,2,2)), _mm_shuffle_ps(ci, ci, _MM_SHUFFLE(1,1,3,3))));
+}
+
+static __m128 mat4_cofactors_sse(__m128 a, __m128 ma, __m128 b, __m128 mb, __m128 c, __m128 mc, __m128 sign) {
+  __m128 r = _mm_mul_ps(a, ma);
+  r = _mm_sub_ps(r, _mm_mul_ps(b, mb));
+  r = _mm_add_ps(r, _mm_mul_ps(c, mc));
+  return _mm_mul_ps(r, sign);
+}
+
+static mat4 mat4_inverse_sse(mat4 m) {
+  
+  __m128 c0 = _mm_loadu_ps(&m.xx);
+  __m128 c1 = _mm_loadu_ps(&m.yx);
+  __m128 c2 = _mm_loadu_ps(&m.zx);
+  __m128 c3 = _mm_loadu_ps(&m.wx);
+  _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+  
+  __m128 m01 = mat4_minors_sse(c0, c1);
+  __m128 m02 = mat4_minors_sse(c0, c2);
+  __m128 m03 = mat4_minors_sse(c0, c3);
+  __m128 m12 = mat4_minors_sse(c1, c2);
+  __m128 m13 = mat4_minors_sse(c1, c3);
+  __m128 m23 = mat4_minors_sse(c2, c3);
+  
+  /* Columns with pairs of rows swapped */
+  __m128 p0 = _mm_shuffle_ps(c0, c0, _MM_SHUFFLE(2,3,0,1));
+  __m128 p1 = _mm_shuffle_ps(c1, c1, _MM_SHUFFLE(2,3,0,1));
+  __m128 p2 = _mm_shuffle_ps(c2, c2, _MM_SHUFFLE(2,3,0,1));
+  __m128 p3 = _mm_shuffle_ps(c3, c3, _MM_SHUFFLE(2,3,0,1));
+  
+  __m128 pos = _mm_setr_ps( 1,-1, 1,-1);
+  __m128 neg = _mm_setr_ps(-1, 1,-1, 1);
+  
+  __m128 i0 = mat4_cofactors_sse(p1, m23, p2, m13, p3, m12, pos);
+  __m128 i1 = mat4_cofactors_sse(p0, m23, p2, m03, p3, m02, neg);
+  __m128 i2 = mat4_cofactors_sse(p0, m13, p1, m03, p3, m01, pos);
+  __m128 i3 = mat4_cofactors_sse(p0, m12, p1, m02, p2, m01, neg);
+  
+  /* Determinant is the first row dotted with the first column of the cofactors */
+  __m128 col = _mm_movelh_ps(_mm_unpacklo_ps(i0, i1), _mm_unpacklo_ps(i2, i3));
+  __m128 dot = _mm_mul_ps(_mm_loadu_ps(&m.xx), col);
+  dot = _mm_add_ps(dot, _mm_movehl_ps(dot, dot));
+  dot = _mm_add_ss(dot, _mm_shuffle_ps(dot, dot, _MM_SHUFFLE(1,1,1,1)));
+  
+  __m128 fac = _mm_set1_ps(1.0f / _mm_cvtss_f32(dot));
+  
+  mat4 ret;
+  _mm_storeu_ps(&ret.xx, _mm_mul_ps(i0, fac));
+  _mm_storeu_ps(&ret.yx, _mm_mul_ps(i1, fac));
+  _mm_storeu_ps(&ret.zx, _mm_mul_ps(i2, fac));
+  _mm_storeu_ps(&ret.wx, _mm_mul_ps(i3, fac));
+  return ret;
+}
+
+#endif
+
 mat4 mat4_inverse(mat4 m) {
-    
+  
+#ifdef CORANGE_SSE
+  return mat4_inverse_sse(m);
+#else
   float det = mat4_det(m);
   float fac = 1.0 / det;
   
@@ -2133,6 +2297,7 @@ mat4 mat4_inverse(mat4 m) {
   ret = mat4_transpose(ret);
   
   return ret;
+#endif
 }
 
 void mat4_to_array(mat4 m, float* out) {
@@ -2414,16 +2579,20 @@ mat4 mat4_rotation_quat_dual(quat_dual q) {
 
 mat4 mat4_world(vec3 position, vec3 scale, quat rotation) {
   
-  mat4 pos_m, sca_m, rot_m, result;
+  /*
+  ** Translation times rotation times scale. Only the
+  ** products which are not with zero or one are done.
+  */
+  
+  mat4 result = mat4_rotation_quat(rotation);
   
-  pos_m = mat4_translation(position);
-  rot_m = mat4_rotation_quat(rotation);
-  sca_m = mat4_scale(scale);
+  result.xx *= scale.x; result.xy *= scale.y; result.xz *= scale.z;
+  result.yx *= scale.x; result.yy *= scale.y; result.yz *= scale.z;
+  result.zx *= scale.x; result.zy *= scale.y; result.zz *= scale.z;
   
-  result = mat4_id();
-  result = mat4_mul_mat4( result, pos_m );
-  result = mat4_mul_mat4( result, rot_m );
-  result = mat4_mul_mat4( result, sca_m );
+  result.xw = position.x;
+  result.yw = position.y;
+  result.zw = position.z;
   
   return result;
   
@@ -3004,6 +3173,248 @@ sphere sphere_transform(sphere s, mat4 world) {
   return sphere_new(center, radius);
 }
 
+#ifdef CORANGE_SSE
+
+/* One row of a matrix times four points with w of one */
+static __m128 mat4_row_points_sse(const float* row, __m128 x, __m128 y, __m128 z) {
+  __m128 r = _mm_mul_ps(_mm_set1_ps(row[0]), x);
+  r = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(row[1]), y));
+  r = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(row[2]), z));
+  r = _mm_add_ps(r, _mm_set1_ps(row[3]));
+  return r;
+}
+
+static void mat4_mul_points_sse(mat4* m, __m128* x, __m128* y, __m128* z) {
+  __m128 w = mat4_row_points_sse(&m->wx, *x, *y, *z);
+  __m128 rx = mat4_row_points_sse(&m->xx, *x, *y, *z);
+  __m128 ry = mat4_row_points_sse(&m->yx, *x, *y, *z);
+  __m128 rz = mat4_row_points_sse(&m->zx, *x, *y, *z);
+  *x = _mm_div_ps(rx, w);
+  *y = _mm_div_ps(ry, w);
+  *z = _mm_div_ps(rz, w);
+}
+
+#endif
+
+void mat4_mul_vec3_many(mat4 m, vec3* points, int count, int stride) {
+  
+  char* data = (char*)points;
+  int i = 0;
+  
+#ifdef CORANGE_SSE
+  for (; i + 4 <= count; i += 4) {
+    
+    vec3* p0 = (vec3*)(data + (i+0) * stride);
+    vec3* p1 = (vec3*)(data + (i+1) * stride);
+    vec3* p2 = (vec3*)(data + (i+2) * stride);
+    vec3* p3 = (vec3*)(data + (i+3) * stride);
+    
+    __m128 x = _mm_setr_ps(p0->x, p1->x, p2->x, p3->x);
+    __m128 y = _mm_setr_ps(p0->y, p1->y, p2->y, p3->y);
+    __m128 z = _mm_setr_ps(p0->z, p1->z, p2->z, p3->z);
+    
+    mat4_mul_points_sse(&m, &x, &y, &z);
+    
+    float xs[4], ys[4], zs[4];
+    _mm_storeu_ps(xs, x);
+    _mm_storeu_ps(ys, y);
+    _mm_storeu_ps(zs, z);
+    
+    *p0 = vec3_new(xs[0], ys[0], zs[0]);
+    *p1 = vec3_new(xs[1], ys[1], zs[1]);
+    *p2 = vec3_new(xs[2], ys[2], zs[2]);
+    *p3 = vec3_new(xs[3], ys[3], zs[3]);
+  }
+#endif
+  
+  for (; i < count; i++) {
+    vec3* p = (vec3*)(data + i * stride);
+    *p = mat4_mul_vec3(m, *p);
+  }
+  
+}
+
+void sphere_transform_many(sphere* s, int count, mat4 world) {
+  
+  float scale = max(max(world.xx, world.yy), world.zz);
+  int i = 0;
+  
+#ifdef CORANGE_SSE
+  for (; i + 4 <= count; i += 4) {
+    
+    __m128 x = _mm_loadu_ps((float*)&s[i+0]);
+    __m128 y = _mm_loadu_ps((float*)&s[i+1]);
+    __m128 z = _mm_loadu_ps((float*)&s[i+2]);
+    __m128 r = _mm_loadu_ps((float*)&s[i+3]);
+    _MM_TRANSPOSE4_PS(x, y, z, r);
+    
+    mat4_mul_points_sse(&world, &x, &y, &z);
+    r = _mm_mul_ps(r, _mm_set1_ps(scale));
+    
+    _MM_TRANSPOSE4_PS(x, y, z, r);
+    _mm_storeu_ps((float*)&s[i+0], x);
+    _mm_storeu_ps((float*)&s[i+1], y);
+    _mm_storeu_ps((float*)&s[i+2], z);
+    _mm_storeu_ps((float*)&s[i+3], r);
+  }
+#endif
+  
+  for (; i < count; i++) {
+    s[i] = sphere_transform(s[i], world);
+  }
+  
+}
+
+void sphere_visible_box_many(sphere* s, int count, box b, uint32_t* visible) {
+  
+  plane planes[6] = { b.top, b.bottom, b.left, b.right, b.front, b.back };
+  
+  memset(visible, 0, sizeof(uint32_t) * ((count + 31) / 32));
+  
+  int i = 0;
+  
+#ifdef CORANGE_SSE
+  for (; i + 4 <= count; i += 4) {
+    
+    __m128 x = _mm_loadu_ps((float*)&s[i+0]);
+    __m128 y = _mm_loadu_ps((float*)&s[i+1]);
+    __m128 z = _mm_loadu_ps((float*)&s[i+2]);
+    __m128 r = _mm_loadu_ps((float*)&s[i+3]);
+    _MM_TRANSPOSE4_PS(x, y, z, r);
+    
+    __m128 outside = _mm_setzero_ps();
+    for (int j = 0; j < 6; j++) {
+      vec3 p = planes[j].position;
+      vec3 n = planes[j].direction;
+      __m128 d = _mm_mul_ps(_mm_sub_ps(x, _mm_set1_ps(p.x)), _mm_set1_ps(n.x));
+      d = _mm_add_ps(d, _mm_mul_ps(_mm_sub_ps(y, _mm_set1_ps(p.y)), _mm_set1_ps(n.y)));
+      d = _mm_add_ps(d, _mm_mul_ps(_mm_sub_ps(z, _mm_set1_ps(p.z)), _mm_set1_ps(n.z)));
+      outside = _mm_or_ps(outside, _mm_cmpgt_ps(d, r));
+    }
+    
+    visible[i / 32] |= (uint32_t)(_mm_movemask_ps(outside) ^ 0xF) << (i % 32);
+  }
+#endif
+  
+  for (; i < count; i++) {
+    bool inside = true;
+    for (int j = 0; j < 6; j++) {
+      inside = inside && !sphere_outside_plane(s[i], planes[j]);
+    }
+    if (inside) { visible[i / 32] |= 1u << (i % 32); }
+  }
+  
+}
+
+frustum_planes frustum_planes_new(mat4 m) {
+  
+  /* Clip space is -w to w on every axis */
+  frustum_planes f;
+  f.planes[0] = vec4_new(m.wx + m.xx, m.wy + m.xy, m.wz + m.xz, m.ww + m.xw);
+  f.planes[1] = vec4_new(m.wx - m.xx, m.wy - m.xy, m.wz - m.xz, m.ww - m.xw);
+  f.planes[2] = vec4_new(m.wx + m.yx, m.wy + m.yy, m.wz + m.yz, m.ww + m.yw);
+  f.planes[3] = vec4_new(m.wx - m.yx, m.wy - m.yy, m.wz - m.yz, m.ww - m.yw);
+  f.planes[4] = vec4_new(m.wx + m.zx, m.wy + m.zy, m.wz + m.zz, m.ww + m.zw);
+  f.planes[5] = vec4_new(m.wx - m.zx, m.wy - m.zy, m.wz - m.zz, m.ww - m.zw);
+  
+  for (int i = 0; i < 6; i++) {
+    vec4 p = f.planes[i];
+    f.planes[i] = vec4_div(p, sqrtf(p.x * p.x + p.y * p.y + p.z * p.z));
+  }
+  
+  return f;
+}
+
+frustum_planes frustum_planes_new_camera(mat4 view, mat4 proj) {
+  return frustum_planes_new(mat4_mul_mat4(proj, view));
+}
+
+static float frustum_plane_distance(vec4 p, vec3 v) {
+  return p.x * v.x + p.y * v.y + p.z * v.z + p.w;
+}
+
+/*
+** Bounds are a center with a radius plus a box extent,
+** projected onto each plane normal.
+*/
+static int frustum_planes_cull(frustum_planes f, vec3 center, float radius, vec3 extent, int mask, int* last) {
+  
+  int crossing = 0;
+  for (int j = -1; j < 6; j++) {
+    
+    /* Previous rejecting plane is tried first */
+    int i = j;
+    if (j == -1) {
+      if (last == NULL) { continue; }
+      i = *last;
+    } else if (last != NULL && j == *last) {
+      continue;
+    }
+    if (!(mask & (1 << i))) { continue; }
+    
+    vec4 p = f.planes[i];
+    float d = frustum_plane_distance(p, center);
+    float r = radius + extent.x * fabsf(p.x) + extent.y * fabsf(p.y) + extent.z * fabsf(p.z);
+    if (d < -r) {
+      if (last != NULL) { *last = i; }
+      return FRUSTUM_PLANES_OUTSIDE;
+    }
+    if (d < r) { crossing |= 1 << i; }
+  }
+  
+  return crossing;
+}
+
+int frustum_planes_cull_sphere(frustum_planes f, sphere s, int mask, int* last) {
+  return frustum_planes_cull(f, s.center, s.radius, vec3_zero(), mask, last);
+}
+
+int frustum_planes_cull_aabb(frustum_planes f, vec3 minimums, vec3 maximums, int mask, int* last) {
+  vec3 center = vec3_mul(vec3_add(maximums, minimums), 0.5);
+  vec3 extent = vec3_mul(vec3_sub(maximums, minimums), 0.5);
+  return frustum_planes_cull(f, center, 0, extent, mask, last);
+}
+
+bool sphere_outside_frustum_planes(sphere s, frustum_planes f) {
+  return frustum_planes_cull_sphere(f, s, FRUSTUM_PLANES_ALL, NULL) == FRUSTUM_PLANES_OUTSIDE;
+}
+
+void sphere_visible_frustum_planes_many(sphere* s, int count, frustum_planes f, uint32_t* visible) {
+  
+  memset(visible, 0, sizeof(uint32_t) * ((count + 31) / 32));
+  
+  int i = 0;
+  
+#ifdef CORANGE_SSE
+  for (; i + 4 <= count; i += 4) {
+    
+    __m128 x = _mm_loadu_ps((float*)&s[i+0]);
+    __m128 y = _mm_loadu_ps((float*)&s[i+1]);
+    __m128 z = _mm_loadu_ps((float*)&s[i+2]);
+    __m128 r = _mm_loadu_ps((float*)&s[i+3]);
+    _MM_TRANSPOSE4_PS(x, y, z, r);
+    
+    __m128 nr = _mm_sub_ps(_mm_setzero_ps(), r);
+    __m128 outside = _mm_setzero_ps();
+    for (int j = 0; j < 6; j++) {
+      vec4 p = f.planes[j];
+      __m128 d = _mm_mul_ps(x, _mm_set1_ps(p.x));
+      d = _mm_add_ps(d, _mm_mul_ps(y, _mm_set1_ps(p.y)));
+      d = _mm_add_ps(d, _mm_mul_ps(z, _mm_set1_ps(p.z)));
+      d = _mm_add_ps(d, _mm_set1_ps(p.w));
+      outside = _mm_or_ps(outside, _mm_cmplt_ps(d, nr));
+    }
+    
+    visible[i / 32] |= (uint32_t)(_mm_movemask_ps(outside) ^ 0xF) << (i % 32);
+  }
+#endif
+  
+  for (; i < count; i++) {
+    if (!sphere_outside_frustum_planes(s[i], f)) { visible[i / 32] |= 1u << (i % 32); }
+  }
+  
+}
+
 sphere sphere_translate(sphere s, vec3 x) {
   s.center = vec3_add(s.center, x);
   return s;
@@ -3560,21 +3971,7 @@ void mesh_scale(mesh* m, float scale) {
 }
 
 void mesh_transform(mesh* m, mat4 transform) {
-
-  int i = 0;
-  while(i < m->num_triangles * 3) {
-  
-    int t_i1 = m->triangles[i];
-    int t_i2 = m->triangles[i+1];
-    int t_i3 = m->triangles[i+2];
-    
-    m->verticies[t_i1].position = mat4_mul_vec3(transform, m->verticies[t_i1].position);
-    m->verticies[t_i2].position = mat4_mul_vec3(transform, m->verticies[t_i2].position);
-    m->verticies[t_i3].position = mat4_mul_vec3(transform, m->verticies[t_i3].position);
-    
-    i = i + 3;
-  }
-
+  mat4_mul_vec3_many(transform, &m->verticies[0].position, m->num_verts, sizeof(vertex));
 }
 
 sphere mesh_bounding_sphere(mesh* m) {
@@ -3593,6 +3990,683 @@ sphere mesh_bounding_sphere(mesh* m) {
   return s;
 }
 
+/*
+** Triangle order is optimized for the post-transform vertex
+** cache using Tom Forsyth's linear-speed algorithm. Each
+** step emits the triangle whose verticies score highest
+** based on their position in a simulated cache and the
+** number of triangles still using them.
+*/
+
+enum {
+  MESH_CACHE_SIZE = 32
+};
+
+static float mesh_vertex_score(int cache_position, int remaining) {
+  
+  if (remaining == 0) { return -1; }
+  
+  float score = 0;
+  if (cache_position >= 0) {
+    if (cache_position < 3) {
+      score = 0.75;
+    } else {
+      float scaler = 1.0 - (float)(cache_position - 3) / (MESH_CACHE_SIZE - 3);
+      score = powf(scaler, 1.5);
+    }
+  }
+  
+  return score + 2.0 * powf((float)remaining, -0.5);
+}
+
+void mesh_optimize_vertex_cache(mesh* m) {
+  
+  int num_tris = m->num_triangles;
+  if (num_tris == 0) { return; }
+  
+  /* Triangles using each vertex, stored contiguously */
+  int* remaining = calloc(m->num_verts, sizeof(int));
+  int* offsets = malloc(sizeof(int) * (m->num_verts + 1));
+  int* adjacency = malloc(sizeof(int) * num_tris * 3);
+  
+  for(int i = 0; i < num_tris * 3; i++) { remaining[m->triangles[i]]++; }
+  
+  offsets[0] = 0;
+  for(int i = 0; i < m->num_verts; i++) { offsets[i+1] = offsets[i] + remaining[i]; }
+  
+  int* fill = malloc(sizeof(int) * m->num_verts);
+  memcpy(fill, offsets, sizeof(int) * m->num_verts);
+  for(int i = 0; i < num_tris * 3; i++) { adjacency[fill[m->triangles[i]]++] = i / 3; }
+  free(fill);
+  
+  int* cache_position = malloc(sizeof(int) * m->num_verts);
+  float* vertex_score = malloc(sizeof(float) * m->num_verts);
+  for(int i = 0; i < m->num_verts; i++) {
+    cache_position[i] = -1;
+    vertex_score[i] = mesh_vertex_score(-1, remaining[i]);
+  }
+  
+  bool* emitted = calloc(num_tris, sizeof(bool));
+  float* triangle_score = malloc(sizeof(float) * num_tris);
+  for(int i = 0; i < num_tris; i++) {
+    triangle_score[i] = vertex_score[m->triangles[i*3+0]]
+                      + vertex_score[m->triangles[i*3+1]]
+                      + vertex_score[m->triangles[i*3+2]];
+  }
+  
+  uint32_t* output = malloc(sizeof(uint32_t) * num_tris * 3);
+  
+  int cache[MESH_CACHE_SIZE + 3];
+  int cache_count = 0;
+  int next_input = 0;
+  
+  for(int t = 0; t < num_tris; t++) {
+    
+    /* Pick best triangle touching the cache, else the next one in input order */
+    int best = -1;
+    float best_score = -1;
+    for(int i = 0; i < cache_count; i++) {
+      int v = cache[i];
+      for(int j = offsets[v]; j < offsets[v] + remaining[v]; j++) {
+        int tri = adjacency[j];
+        if (triangle_score[tri] > best_score) {
+          best = tri;
+          best_score = triangle_score[tri];
+        }
+      }
+    }
+    
+    if (best == -1) {
+      while (emitted[next_input]) { next_input++; }
+      best = next_input;
+    }
+    
+    emitted[best] = true;
+    memcpy(&output[t*3], &m->triangles[best*3], sizeof(uint32_t) * 3);
+    
+    /* Remove triangle from the adjacency of its verticies */
+    for(int k = 0; k < 3; k++) {
+      int v = m->triangles[best*3+k];
+      int* adj = &adjacency[offsets[v]];
+      for(int j = 0; j < remaining[v]; j++) {
+        if (adj[j] == best) {
+          adj[j] = adj[remaining[v]-1];
+          break;
+        }
+      }
+      remaining[v]--;
+    }
+    
+    /* Push verticies to the front of the cache */
+    int new_cache[MESH_CACHE_SIZE + 3];
+    int new_count = 0;
+    for(int k = 0; k < 3; k++) { new_cache[new_count++] = m->triangles[best*3+k]; }
+    for(int i = 0; i < cache_count; i++) {
+      int v = cache[i];
+      if (v != new_cache[0] && v != new_cache[1] && v != new_cache[2]) {
+        new_cache[new_count++] = v;
+      }
+    }
+    
+    /* Update scores of everything that was in the cache */
+    for(int i = 0; i < new_count; i++) {
+      int v = new_cache[i];
+      cache_position[v] = (i < MESH_CACHE_SIZE) ? i : -1;
+      float score = mesh_vertex_score(cache_position[v], remaining[v]);
+      float delta = score - vertex_score[v];
+      vertex_score[v] = score;
+      for(int j = offsets[v]; j < offsets[v] + remaining[v]; j++) {
+        triangle_score[adjacency[j]] += delta;
+      }
+    }
+    
+    cache_count = new_count < MESH_CACHE_SIZE ? new_count : MESH_CACHE_SIZE;
+    memcpy(cache, new_cache, sizeof(int) * cache_count);
+  }
+  
+  free(m->triangles);
+  m->triangles = output;
+  
+  free(remaining);
+  free(offsets);
+  free(adjacency);
+  free(cache_position);
+  free(vertex_score);
+  free(emitted);
+  free(triangle_score);
+  
+}
+
+/*
+** Splits the triangle order into clusters that each start
+** with a cold vertex cache. A cluster ends as soon as its
+** own ACMR drops to within threshold of the ACMR of the
+** region it was cut from, so moving clusters around costs
+** at most that much cache efficiency. Clusters facing away
+** from the mesh center are then drawn first, as they are
+** the most likely to occlude others.
+*/
+
+typedef struct {
+  int start;
+  int count;
+  float sort_key;
+} mesh_cluster;
+
+static int mesh_cluster_cmp(const void* a, const void* b) {
+  float ka = ((const mesh_cluster*)a)->sort_key;
+  float kb = ((const mesh_cluster*)b)->sort_key;
+  return (ka < kb) - (ka > kb);
+}
+
+static int mesh_triangle_misses(mesh* m, int tri, int* cache_time, int* time) {
+  int misses = 0;
+  for(int k = 0; k < 3; k++) {
+    int v = m->triangles[tri*3+k];
+    if (*time - cache_time[v] >= MESH_CACHE_SIZE) {
+      cache_time[v] = (*time)++;
+      misses++;
+    }
+  }
+  return misses;
+}
+
+void mesh_optimize_overdraw(mesh* m, float threshold) {
+  
+  int num_tris = m->num_triangles;
+  if (num_tris == 0) { return; }
+  
+  int* cache_time = malloc(sizeof(int) * m->num_verts);
+  for(int i = 0; i < m->num_verts; i++) { cache_time[i] = INT_MIN / 2; }
+  int time = 0;
+  
+  /* Hard boundaries are where the cache is flushed anyway */
+  int* hard = malloc(sizeof(int) * (num_tris + 1));
+  int num_hard = 0;
+  for(int i = 0; i < num_tris; i++) {
+    if (mesh_triangle_misses(m, i, cache_time, &time) == 3) { hard[num_hard++] = i; }
+  }
+  if (num_hard == 0 || hard[0] != 0) {
+    memmove(&hard[1], &hard[0], sizeof(int) * num_hard);
+    hard[0] = 0; num_hard++;
+  }
+  hard[num_hard] = num_tris;
+  
+  mesh_cluster* clusters = malloc(sizeof(mesh_cluster) * num_tris);
+  int num_clusters = 0;
+  
+  for(int h = 0; h < num_hard; h++) {
+    
+    int start = hard[h];
+    int end = hard[h+1];
+    
+    /* Flushing the cache just means moving time past it */
+    time += MESH_CACHE_SIZE;
+    int misses = 0;
+    for(int i = start; i < end; i++) {
+      misses += mesh_triangle_misses(m, i, cache_time, &time);
+    }
+    
+    float limit = threshold * misses / (end - start);
+    
+    time += MESH_CACHE_SIZE;
+    int cluster_start = start;
+    int cluster_misses = 0;
+    
+    for(int i = start; i < end; i++) {
+      cluster_misses += mesh_triangle_misses(m, i, cache_time, &time);
+      if (i + 1 == end || cluster_misses <= limit * (i - cluster_start + 1)) {
+        clusters[num_clusters].start = cluster_start;
+        clusters[num_clusters].count = i - cluster_start + 1;
+        num_clusters++;
+        cluster_start = i + 1;
+        cluster_misses = 0;
+        time += MESH_CACHE_SIZE;
+      }
+    }
+  }
+  
+  free(hard);
+  free(cache_time);
+  
+  vec3 center = mesh_bounding_sphere(m).center;
+  
+  for(int c = 0; c < num_clusters; c++) {
+    
+    vec3 normal = vec3_zero();
+    vec3 centroid = vec3_zero();
+    float area = 0;
+    
+    for(int i = clusters[c].start; i < clusters[c].start + clusters[c].count; i++) {
+      vec3 p0 = m->verticies[m->triangles[i*3+0]].position;
+      vec3 p1 = m->verticies[m->triangles[i*3+1]].position;
+      vec3 p2 = m->verticies[m->triangles[i*3+2]].position;
+      vec3 n = vec3_cross(vec3_sub(p1, p0), vec3_sub(p2, p0));
+      float a = vec3_length(n);
+      normal = vec3_add(normal, n);
+      centroid = vec3_add(centroid, vec3_mul(vec3_add(vec3_add(p0, p1), p2), a / 3));
+      area += a;
+    }
+    
+    if (area > 0) { centroid = vec3_div(centroid, area); }
+    if (vec3_length(normal) > 0) { normal = vec3_normalize(normal); }
+    
+    clusters[c].sort_key = vec3_dot(vec3_sub(centroid, center), normal);
+  }
+  
+  qsort(clusters, num_clusters, sizeof(mesh_cluster), mesh_cluster_cmp);
+  
+  uint32_t* output = malloc(sizeof(uint32_t) * num_tris * 3);
+  int offset = 0;
+  for(int c = 0; c < num_clusters; c++) {
+    memcpy(&output[offset], &m->triangles[clusters[c].start * 3], sizeof(uint32_t) * clusters[c].count * 3);
+    offset += clusters[c].count * 3;
+  }
+  
+  free(m->triangles);
+  m->triangles = output;
+  free(clusters);
+  
+}
+
+/*
+** Renumbers verticies in the order the triangles first use
+** them so vertex fetches walk through memory. Verticies not
+** used by any triangle are kept at the end.
+*/
+
+void mesh_optimize_vertex_fetch(mesh* m) {
+  
+  int* remap = malloc(sizeof(int) * m->num_verts);
+  for(int i = 0; i < m->num_verts; i++) { remap[i] = -1; }
+  
+  vertex* verticies = malloc(sizeof(vertex) * m->num_verts);
+  int next = 0;
+  
+  for(int i = 0; i < m->num_triangles * 3; i++) {
+    int v = m->triangles[i];
+    if (remap[v] == -1) {
+      remap[v] = next;
+      verticies[next++] = m->verticies[v];
+    }
+    m->triangles[i] = remap[v];
+  }
+  
+  for(int i = 0; i < m->num_verts; i++) {
+    if (remap[i] == -1) { verticies[next++] = m->verticies[i]; }
+  }
+  
+  free(m->verticies);
+  m->verticies = verticies;
+  free(remap);
+  
+}
+
+void mesh_optimize(mesh* m) {
+  mesh_optimize_vertex_cache(m);
+  mesh_optimize_overdraw(m, 1.05);
+  mesh_optimize_vertex_fetch(m);
+}
+
+/* Average verticies transformed per triangle with a FIFO cache */
+float mesh_acmr(mesh* m, int cache_size) {
+  
+  if (m->num_triangles == 0) { return 0; }
+  
+  int* cache_time = malloc(sizeof(int) * m->num_verts);
+  for(int i = 0; i < m->num_verts; i++) { cache_time[i] = INT_MIN / 2; }
+  
+  int time = 0;
+  for(int i = 0; i < m->num_triangles * 3; i++) {
+    int v = m->triangles[i];
+    if (time - cache_time[v] >= cache_size) { cache_time[v] = time++; }
+  }
+  
+  free(cache_time);
+  
+  return (float)time / m->num_triangles;
+}
+
+/*
+** Simplification collapses edges in order of quadric error
+** (Garland and Heckbert). Each collapse moves one vertex onto
+** the other rather than placing a new vertex, so the result
+** only indexes existing verticies and can share the vertex
+** buffer of the original.
+**
+** Collapses are decided on positions with seams welded, then
+** every vertex that moved picks whichever vertex at its new
+** position has the closest normal and uvs. Verticies on a
+** seam only move onto other seam verticies and verticies on
+** an open border never move, so outlines and texture mapping
+** stay intact.
+*/
+
+typedef struct {
+  double a[10];
+  double weight;
+} mesh_quadric;
+
+static void mesh_quadric_add_plane(mesh_quadric* q, vec3 n, double d, double w) {
+  q->a[0] += w * n.x * n.x; q->a[1] += w * n.x * n.y; q->a[2] += w * n.x * n.z; q->a[3] += w * n.x * d;
+  q->a[4] += w * n.y * n.y; q->a[5] += w * n.y * n.z; q->a[6] += w * n.y * d;
+  q->a[7] += w * n.z * n.z; q->a[8] += w * n.z * d;
+  q->a[9] += w * d * d;
+  q->weight += w;
+}
+
+static void mesh_quadric_add(mesh_quadric* q, const mesh_quadric* o) {
+  for(int i = 0; i < 10; i++) { q->a[i] += o->a[i]; }
+  q->weight += o->weight;
+}
+
+/* Mean squared distance of p to the planes in q0 and q1 */
+static double mesh_quadric_error(const mesh_quadric* q0, const mesh_quadric* q1, vec3 p) {
+  
+  double a[10];
+  for(int i = 0; i < 10; i++) { a[i] = q0->a[i] + q1->a[i]; }
+  double w = q0->weight + q1->weight;
+  
+  double x = p.x, y = p.y, z = p.z;
+  double e = a[0]*x*x + 2*a[1]*x*y + 2*a[2]*x*z + 2*a[3]*x
+           + a[4]*y*y + 2*a[5]*y*z + 2*a[6]*y
+           + a[7]*z*z + 2*a[8]*z
+           + a[9];
+  
+  return (e > 0 && w > 0) ? e / w : 0;
+}
+
+typedef struct {
+  int from;
+  int to;
+  double cost;
+} mesh_collapse;
+
+static int mesh_collapse_cmp(const void* a, const void* b) {
+  double ca = ((const mesh_collapse*)a)->cost;
+  double cb = ((const mesh_collapse*)b)->cost;
+  return (ca > cb) - (ca < cb);
+}
+
+static int mesh_edge_triangles(const uint32_t* tris, int a, int b, const int* offsets, const int* adjacency) {
+  int count = 0;
+  for(int j = offsets[a]; j < offsets[a+1]; j++) {
+    const uint32_t* t = &tris[adjacency[j] * 3];
+    if (t[0] == b || t[1] == b || t[2] == b) { count++; }
+  }
+  return count;
+}
+
+/*
+** A collapse is rejected if it would turn a triangle by 45
+** degrees or more, or if from and to share neighbours other
+** than the far corners of the triangles on their edge, which
+** would pinch the surface into a non-manifold shape. Only
+** rejecting flips lets a triangle turn most of the way over
+** in one collapse and fold over in the next, and lets
+** triangles along an open border stand up on their edge.
+*/
+static bool mesh_collapse_valid(mesh* m, const uint32_t* tris, int from, int to, const int* offsets, const int* adjacency) {
+  
+  int shared = 0;
+  for(int j = offsets[from]; j < offsets[from+1]; j++) {
+    const uint32_t* t = &tris[adjacency[j] * 3];
+    for(int k = 0; k < 3; k++) {
+      if (t[k] != from && t[k] != to && mesh_edge_triangles(tris, to, t[k], offsets, adjacency) > 0) { shared++; }
+    }
+  }
+  
+  if (shared != 2 * mesh_edge_triangles(tris, from, to, offsets, adjacency)) { return false; }
+  
+  vec3 pto = m->verticies[to].position;
+  
+  for(int j = offsets[from]; j < offsets[from+1]; j++) {
+    
+    const uint32_t* t = &tris[adjacency[j] * 3];
+    if (t[0] == to || t[1] == to || t[2] == to) { continue; }
+    
+    vec3 p0 = m->verticies[t[0]].position;
+    vec3 p1 = m->verticies[t[1]].position;
+    vec3 p2 = m->verticies[t[2]].position;
+    vec3 n0 = vec3_cross(vec3_sub(p1, p0), vec3_sub(p2, p0));
+    
+    if (t[0] == from) { p0 = pto; }
+    if (t[1] == from) { p1 = pto; }
+    if (t[2] == from) { p2 = pto; }
+    vec3 n1 = vec3_cross(vec3_sub(p1, p0), vec3_sub(p2, p0));
+    
+    if (vec3_dot(n0, n1) <= 0.7071 * vec3_length(n0) * vec3_length(n1)) { return false; }
+  }
+  
+  return true;
+}
+
+float mesh_simplify(mesh* m, int target_triangles) {
+  
+  int num_verts = m->num_verts;
+  int num_tris = m->num_triangles;
+  
+  /*
+  ** Weld verticies by position. Each position is represented
+  ** by the first vertex found there and the others at the
+  ** same position are chained together through wedges.
+  */
+  
+  int* welded = malloc(sizeof(int) * num_verts);
+  int* wedges = malloc(sizeof(int) * num_verts);
+  bool* seam = calloc(num_verts, sizeof(bool));
+  
+  int table_size = 16;
+  while (table_size < num_verts * 2) { table_size *= 2; }
+  int* table = malloc(sizeof(int) * table_size);
+  for(int i = 0; i < table_size; i++) { table[i] = -1; }
+  
+  for(int i = 0; i < num_verts; i++) {
+    
+    /* Adding zero folds -0 into 0 so both hash the same */
+    vec3 p = m->verticies[i].position;
+    float key[3] = { p.x + 0.0f, p.y + 0.0f, p.z + 0.0f };
+    uint32_t bits[3];
+    memcpy(bits, key, sizeof(bits));
+    uint32_t h = (bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u);
+    
+    int j = h & (table_size - 1);
+    while (table[j] != -1 && !vec3_equ(m->verticies[table[j]].position, p)) {
+      j = (j + 1) & (table_size - 1);
+    }
+    
+    if (table[j] == -1) {
+      table[j] = i;
+      welded[i] = i;
+      wedges[i] = -1;
+    } else {
+      int first = table[j];
+      welded[i] = first;
+      wedges[i] = wedges[first];
+      wedges[first] = i;
+      seam[first] = true;
+    }
+  }
+  
+  free(table);
+  
+  uint32_t* tris = malloc(sizeof(uint32_t) * num_tris * 3);
+  for(int i = 0; i < num_tris * 3; i++) { tris[i] = welded[m->triangles[i]]; }
+  
+  mesh_quadric* quadrics = calloc(num_verts, sizeof(mesh_quadric));
+  
+  for(int i = 0; i < num_tris; i++) {
+    vec3 p0 = m->verticies[tris[i*3+0]].position;
+    vec3 p1 = m->verticies[tris[i*3+1]].position;
+    vec3 p2 = m->verticies[tris[i*3+2]].position;
+    vec3 n = vec3_cross(vec3_sub(p1, p0), vec3_sub(p2, p0));
+    float area = vec3_length(n);
+    if (area == 0) { continue; }
+    n = vec3_div(n, area);
+    for(int k = 0; k < 3; k++) {
+      mesh_quadric_add_plane(&quadrics[tris[i*3+k]], n, -vec3_dot(n, p0), area);
+    }
+  }
+  
+  bool* locked = calloc(num_verts, sizeof(bool));
+  bool* touched = malloc(sizeof(bool) * num_verts);
+  int* collapsed = malloc(sizeof(int) * num_verts);
+  int* remaining = malloc(sizeof(int) * num_verts);
+  int* offsets = malloc(sizeof(int) * (num_verts + 1));
+  int* adjacency = malloc(sizeof(int) * num_tris * 3);
+  mesh_collapse* collapses = malloc(sizeof(mesh_collapse) * num_tris * 3);
+  
+  for(int i = 0; i < num_verts; i++) { collapsed[i] = i; }
+  
+  double max_cost = 0;
+  
+  while (num_tris > target_triangles) {
+    
+    /* Triangles using each vertex */
+    memset(remaining, 0, sizeof(int) * num_verts);
+    for(int i = 0; i < num_tris * 3; i++) { remaining[tris[i]]++; }
+    
+    offsets[0] = 0;
+    for(int i = 0; i < num_verts; i++) { offsets[i+1] = offsets[i] + remaining[i]; }
+    
+    memcpy(remaining, offsets, sizeof(int) * num_verts);
+    for(int i = 0; i < num_tris * 3; i++) { adjacency[remaining[tris[i]]++] = i / 3; }
+    
+    /* Edges without exactly two triangles are borders */
+    for(int i = 0; i < num_tris * 3; i++) {
+      int a = tris[i];
+      int b = tris[i - i % 3 + (i + 1) % 3];
+      if (mesh_edge_triangles(tris, a, b, offsets, adjacency) != 2) {
+        locked[a] = true;
+        locked[b] = true;
+      }
+    }
+    
+    /*
+    ** Interior edges appear once in each direction so only
+    ** the one going from the lower index is used, and it
+    ** collapses whichever way is cheaper.
+    */
+    
+    int num_collapses = 0;
+    for(int i = 0; i < num_tris * 3; i++) {
+      
+      int a = tris[i];
+      int b = tris[i - i % 3 + (i + 1) % 3];
+      if (a > b) { continue; }
+      
+      bool ab = !locked[a] && (!seam[a] || seam[b]);
+      bool ba = !locked[b] && (!seam[b] || seam[a]);
+      if (!ab && !ba) { continue; }
+      
+      double cost_ab = ab ? mesh_quadric_error(&quadrics[a], &quadrics[b], m->verticies[b].position) : DBL_MAX;
+      double cost_ba = ba ? mesh_quadric_error(&quadrics[a], &quadrics[b], m->verticies[a].position) : DBL_MAX;
+      
+      collapses[num_collapses].from = cost_ab <= cost_ba ? a : b;
+      collapses[num_collapses].to = cost_ab <= cost_ba ? b : a;
+      collapses[num_collapses].cost = cost_ab <= cost_ba ? cost_ab : cost_ba;
+      num_collapses++;
+    }
+    
+    qsort(collapses, num_collapses, sizeof(mesh_collapse), mesh_collapse_cmp);
+    
+    /*
+    ** Collapses are applied cheapest first. Verticies around
+    ** a collapse are left alone for the rest of the pass so
+    ** the costs and checks of later collapses stay accurate.
+    */
+    
+    memset(touched, 0, sizeof(bool) * num_verts);
+    int removed = 0;
+    
+    for(int i = 0; i < num_collapses && num_tris - removed > target_triangles; i++) {
+      
+      int from = collapses[i].from;
+      int to = collapses[i].to;
+      
+      if (touched[from] || touched[to]) { continue; }
+      if (!mesh_collapse_valid(m, tris, from, to, offsets, adjacency)) { continue; }
+      
+      collapsed[from] = to;
+      mesh_quadric_add(&quadrics[to], &quadrics[from]);
+      removed += mesh_edge_triangles(tris, from, to, offsets, adjacency);
+      max_cost = collapses[i].cost > max_cost ? collapses[i].cost : max_cost;
+      
+      for(int j = offsets[from]; j < offsets[from+1]; j++) {
+        const uint32_t* t = &tris[adjacency[j] * 3];
+        touched[t[0]] = true;
+        touched[t[1]] = true;
+        touched[t[2]] = true;
+      }
+    }
+    
+    if (removed == 0) { break; }
+    
+    /* Apply collapses and drop triangles that became degenerate */
+    int count = 0;
+    for(int i = 0; i < num_tris; i++) {
+      
+      uint32_t i0 = collapsed[tris[i*3+0]];
+      uint32_t i1 = collapsed[tris[i*3+1]];
+      uint32_t i2 = collapsed[tris[i*3+2]];
+      if (i0 == i1 || i1 == i2 || i2 == i0) { continue; }
+      
+      tris[count*3+0] = i0;
+      tris[count*3+1] = i1;
+      tris[count*3+2] = i2;
+      memcpy(&m->triangles[count*3], &m->triangles[i*3], sizeof(uint32_t) * 3);
+      count++;
+    }
+    
+    num_tris = count;
+    
+    /* Collapsed verticies point straight at where they ended up */
+    for(int i = 0; i < num_verts; i++) {
+      collapsed[i] = collapsed[collapsed[i]];
+    }
+  }
+  
+  /* Moved verticies take the closest matching vertex at their new position */
+  for(int i = 0; i < num_tris * 3; i++) {
+    
+    int v = m->triangles[i];
+    if (welded[v] == tris[i]) { continue; }
+    
+    vertex* from = &m->verticies[v];
+    int best = tris[i];
+    float best_dist = FLT_MAX;
+    
+    for(int w = tris[i]; w != -1; w = wedges[w]) {
+      vertex* to = &m->verticies[w];
+      float dist = vec3_dist_sqrd(from->normal, to->normal) + vec2_dist_sqrd(from->uvs, to->uvs);
+      if (dist < best_dist) {
+        best = w;
+        best_dist = dist;
+      }
+    }
+    
+    m->triangles[i] = best;
+  }
+  
+  m->num_triangles = num_tris;
+  m->triangles = realloc(m->triangles, sizeof(uint32_t) * num_tris * 3);
+  
+  free(welded);
+  free(wedges);
+  free(seam);
+  free(tris);
+  free(quadrics);
+  free(locked);
+  free(touched);
+  free(collapsed);
+  free(remaining);
+  free(offsets);
+  free(adjacency);
+  free(collapses);
+  
+  return sqrt(max_cost);
+}
+
 void model_print(model* m) {
   for(int i=0; i<m->num_meshes; i++) {
     mesh_print( m->meshes[i] );
@@ -3669,6 +4743,12 @@ void model_transform(model* m, mat4 transform) {
   }
 }
 
+void model_optimize(model* m) {
+  for(int i = 0; i < m->num_meshes; i++) {
+    mesh_optimize(m->meshes[i]);
+  }
+}
+
 vec3 triangle_tangent(vertex vert1, vertex vert2, vertex vert3) {
   
   vec3 pos1 = vert1.position;
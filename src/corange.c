@@ -75,18 +75,21 @@ void corange_init(const char* core_assets_path) {
   asset_init();
   asset_add_path_variable(P("$CORANGE"), P(core_assets_path));
   
-  asset_handler(renderable, "bmf", bmf_load_file, renderable_delete);
-  asset_handler(renderable, "obj", obj_load_file, renderable_delete);
+  asset_handler_async(renderable, "bmf", bmf_read_file, bmf_upload_file, renderable_delete);
+  asset_handler_async(renderable, "obj", obj_read_file, obj_upload_file, renderable_delete);
   asset_handler(renderable, "smd", smd_load_file, renderable_delete);
   asset_handler(renderable, "ply", ply_load_file, renderable_delete);
   asset_handler(skeleton, "skl", skl_load_file, skeleton_delete);
   asset_handler(animation, "ani", ani_load_file, animation_delete);
+  asset_handler(skeleton, "bskl", bskl_load_file, skeleton_delete);
+  asset_handler(animation, "bani", bani_load_file, animation_delete);
   asset_handler(cmesh, "col", col_load_file, cmesh_delete);
+  asset_handler(cmesh, "cmf", cmf_load_file, cmesh_delete);
   asset_handler(terrain, "raw", raw_load_file, terrain_delete);
   
-  asset_handler(texture, "bmp", bmp_load_file, texture_delete);
-  asset_handler(texture, "tga", tga_load_file, texture_delete);
-  asset_handler(texture, "dds", dds_load_file, texture_delete);
+  asset_handler_async(texture, "bmp", image_bmp_load_file, texture_upload_image, texture_delete);
+  asset_handler_async(texture, "tga", image_tga_load_file, texture_upload_image, texture_delete);
+  asset_handler_async(texture, "dds", dds_read_file, dds_upload_file, texture_delete);
   asset_handler(texture, "lut", lut_load_file, texture_delete);
   asset_handler(texture, "acv", acv_load_file, texture_delete);
   
@@ -103,6 +106,13 @@ void corange_init(const char* core_assets_path) {
   asset_handler(material, "mat", mat_load_file, material_delete);
   asset_handler(effect, "effect" , effect_load_file, effect_delete);
   
+  asset_handler_scan("bmf", bmf_scan_file);
+  asset_handler_scan("mat", mat_scan_file);
+  asset_handler_scan("fnt", font_scan_file);
+  
+  asset_handler_size(renderable, renderable_size);
+  asset_handler_size(texture, texture_size);
+  
   asset_handler(sound, "wav", wav_load_file, sound_delete);
   asset_handler(music, "ogg", ogg_load_file, music_delete);
   asset_handler(music, "mp3", mp3_load_file, music_delete);
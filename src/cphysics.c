@@ -198,35 +198,167 @@ collision point_collide_ctri(vec3 p, vec3 v, ctri ct) {
 
 }
 
-static collision point_collide_mesh_space(vec3 p, vec3 v, cmesh* cm, mat4 world, mat3 world_normal, mat3 space, mat3 space_normal) {
+/*
+** Meshes are swept in their own space so their triangles
+** don't need moving. The query is moved into mesh space
+** once and any collision is moved back out, times stay
+** the same either way. Spheres only stay spheres if the
+** mesh is not skewed or unevenly scaled. When it is, the
+** triangles whose planes the sweep crosses are moved out
+** into query space to be tested instead.
+*/
+
+typedef struct {
+  mat3 linear;
+  vec3 translation;
+  mat3 normal;
+  mat3 inverse;
+  mat3 inverse_normal;
+  bool similar;
+  vec3 position;
+  vec3 velocity;
+  float radius;
+  vec3 local_position;
+  vec3 local_velocity;
+  float local_radius;
+  vec3 minimums;
+  vec3 maximums;
+} mesh_query;
+
+static mesh_query mesh_query_new(vec3 p, vec3 v, float radius, mat4 world, mat3 world_normal, mat3 space, mat3 space_normal) {
+  
+  mesh_query q;
+  q.linear = mat3_mul_mat3(space, mat4_to_mat3(world));
+  q.translation = mat3_mul_vec3(space, vec3_new(world.xw, world.yw, world.zw));
+  q.normal = mat3_mul_mat3(space_normal, world_normal);
+  q.inverse = mat3_inverse(q.linear);
+  q.inverse_normal = mat3_transpose(q.inverse);
+  
+  q.position = p;
+  q.velocity = v;
+  q.radius = radius;
+  q.local_position = mat3_mul_vec3(q.inverse, vec3_sub(p, q.translation));
+  q.local_velocity = mat3_mul_vec3(q.inverse, v);
+  
+  /* Columns of equal length at right angles to each other */
+  mat3 m = q.linear;
+  vec3 cx = vec3_new(m.xx, m.yx, m.zx);
+  vec3 cy = vec3_new(m.xy, m.yy, m.zy);
+  vec3 cz = vec3_new(m.xz, m.yz, m.zz);
+  float len = vec3_dot(cx, cx);
+  float eps = len * 1e-5;
+  q.similar = (fabs(vec3_dot(cy, cy) - len) <= eps && fabs(vec3_dot(cz, cz) - len) <= eps &&
+               fabs(vec3_dot(cx, cy)) <= eps && fabs(vec3_dot(cy, cz)) <= eps && fabs(vec3_dot(cz, cx)) <= eps);
+  q.local_radius = radius / sqrtf(len);
+  
+  /* The sphere becomes an ellipsoid so grow the box by its extent along each axis */
+  mat3 n = q.inverse;
+  vec3 r = vec3_mul(vec3_new(
+    sqrtf(n.xx * n.xx + n.xy * n.xy + n.xz * n.xz),
+    sqrtf(n.yx * n.yx + n.yy * n.yy + n.yz * n.yz),
+    sqrtf(n.zx * n.zx + n.zy * n.zy + n.zz * n.zz)), radius);
+  
+  vec3 s = q.local_position;
+  vec3 e = vec3_add(s, q.local_velocity);
+  q.minimums = vec3_sub(vec3_new(min(s.x, e.x), min(s.y, e.y), min(s.z, e.z)), r);
+  q.maximums = vec3_add(vec3_new(max(s.x, e.x), max(s.y, e.y), max(s.z, e.z)), r);
+  
+  return q;
+}
+
+static bool mesh_query_outside_node(mesh_query* q, cmesh_node* n) {
+  return (n->minimums.x > q->maximums.x || n->maximums.x < q->minimums.x ||
+          n->minimums.y > q->maximums.y || n->maximums.y < q->minimums.y ||
+          n->minimums.z > q->maximums.z || n->maximums.z < q->minimums.z);
+}
+
+static collision mesh_query_collision(mesh_query* q, collision c, mat3 direction) {
+  if (!c.collided) { return c; }
+  c.point = vec3_add(mat3_mul_vec3(q->linear, c.point), q->translation);
+  c.norm  = vec3_normalize(mat3_mul_vec3(direction, c.norm));
+  return c;
+}
+
+/*
+** Face normals move out with the normal matrix but edge
+** and vertex normals point back toward the query so they
+** move out with the mesh.
+*/
+static collision mesh_query_point_ctri(mesh_query* q, ctri ct) {
   
-  if ( !cm->is_leaf ) {
+  vec3 p = q->local_position;
+  vec3 v = q->local_velocity;
   
-    plane div = cm->division;
-    div = plane_transform(div, world, world_normal);
-    div = plane_transform_space(div, space, space_normal);
+  if (!point_swept_intersects_plane(p, v, plane_new(ct.a, ct.norm))) {
+    return collision_none();
+  }
   
-         if ( point_swept_inside_plane(p, v, div)  ) { return point_collide_mesh_space(p, v, cm->back,  world, world_normal, space, space_normal); }
-    else if ( point_swept_outside_plane(p, v, div) ) { return point_collide_mesh_space(p, v, cm->front, world, world_normal, space, space_normal); }
-    else {
-    
-      collision c0 = point_collide_mesh_space(p, v, cm->back,  world, world_normal, space, space_normal);
-      collision c1 = point_collide_mesh_space(p, v, cm->front, world, world_normal, space, space_normal);
-      return collision_merge(c0, c1);
-      
-    }
+  collision col = point_collide_face(p, v, ct);
+  
+  if (col.collided) { return mesh_query_collision(q, col, q->normal); }
+  
+  col = collision_merge(col, point_collide_edge(p, v, ct.a, ct.b));
+  col = collision_merge(col, point_collide_edge(p, v, ct.b, ct.c));
+  col = collision_merge(col, point_collide_edge(p, v, ct.c, ct.a));
+  col = collision_merge(col, point_collide_point(p, v, ct.a));
+  col = collision_merge(col, point_collide_point(p, v, ct.b));
+  col = collision_merge(col, point_collide_point(p, v, ct.c));
+  
+  return mesh_query_collision(q, col, q->linear);
+  
+}
+
+static collision mesh_query_sphere_ctri(mesh_query* q, ctri ct) {
+  
+  if (q->similar) {
+    sphere s = sphere_new(q->local_position, q->local_radius);
+    return mesh_query_collision(q, sphere_collide_ctri(s, q->local_velocity, ct), q->normal);
   }
   
+  /* Distances to the plane in query space, scaled by the length of the moved normal */
+  float reach = q->radius * vec3_length(mat3_mul_vec3(q->inverse_normal, ct.norm)) * 1.001;
+  float dist  = vec3_dot(ct.norm, vec3_sub(q->local_position, ct.a));
+  float angle = vec3_dot(ct.norm, q->local_velocity);
+  
+  if ((dist >  reach && dist + angle >  reach) ||
+      (dist < -reach && dist + angle < -reach)) {
+    return collision_none();
+  }
+  
+  ct.a = vec3_add(mat3_mul_vec3(q->linear, ct.a), q->translation);
+  ct.b = vec3_add(mat3_mul_vec3(q->linear, ct.b), q->translation);
+  ct.c = vec3_add(mat3_mul_vec3(q->linear, ct.c), q->translation);
+  ct.norm = vec3_normalize(mat3_mul_vec3(q->normal, ct.norm));
+  
+  return sphere_collide_ctri(sphere_new(q->position, q->radius), q->velocity, ct);
+  
+}
+
+static collision point_collide_mesh_space(vec3 p, vec3 v, cmesh* cm, mat4 world, mat3 world_normal, mat3 space, mat3 space_normal) {
+  
+  mesh_query q = mesh_query_new(p, v, 0, world, world_normal, space, space_normal);
   collision col = collision_none();
   
-  for (int i = 0; i < cm->triangles_num; i++) {
-    ctri ct = cm->triangles[i];
-    ct = ctri_transform(ct, world, world_normal);
-    ct = ctri_transform_space(ct, space, space_normal);
+  int stack[CMESH_MAX_DEPTH+1];
+  int top = 0;
+  if (cm->nodes_num > 0) { stack[top++] = 0; }
+  
+  while (top > 0) {
+    
+    int i = stack[--top];
+    cmesh_node* n = &cm->nodes[i];
     
-    /* This does not work for some reason */
-    //if (point_swept_outside_sphere(p, v, ct.bound)) continue;
-    col = collision_merge(col, point_collide_ctri(p, v, ct));
+    if (mesh_query_outside_node(&q, n)) { continue; }
+    
+    if (n->count == 0) {
+      stack[top++] = n->offset;
+      stack[top++] = i + 1;
+      continue;
+    }
+    
+    for (int j = n->offset; j < n->offset + n->count; j++) {
+      col = collision_merge(col, mesh_query_point_ctri(&q, cm->triangles[j]));
+    }
   }
   
   return col;
@@ -402,33 +534,29 @@ collision ellipsoid_collide_sphere(ellipsoid e, vec3 v, sphere s) {
 
 static collision sphere_collide_mesh_space(sphere s, vec3 v, cmesh* cm, mat4 world, mat3 world_normal, mat3 space, mat3 space_normal) {
   
-  if ( !cm->is_leaf ) {
+  mesh_query q = mesh_query_new(s.center, v, s.radius, world, world_normal, space, space_normal);
+  collision col = collision_none();
   
-    plane div = cm->division;
-    div = plane_transform(div, world, world_normal);
-    div = plane_transform_space(div, space, space_normal);
+  int stack[CMESH_MAX_DEPTH+1];
+  int top = 0;
+  if (cm->nodes_num > 0) { stack[top++] = 0; }
   
-         if ( sphere_swept_inside_plane(s, v, div)  ) { return sphere_collide_mesh_space(s, v, cm->back,  world, world_normal, space, space_normal); }
-    else if ( sphere_swept_outside_plane(s, v, div) ) { return sphere_collide_mesh_space(s, v, cm->front, world, world_normal, space, space_normal); }
-    else {
+  while (top > 0) {
+    
+    int i = stack[--top];
+    cmesh_node* n = &cm->nodes[i];
     
-      collision c0 = sphere_collide_mesh_space(s, v, cm->back,  world, world_normal, space, space_normal);
-      collision c1 = sphere_collide_mesh_space(s, v, cm->front, world, world_normal, space, space_normal);
-      return collision_merge(c0, c1);
-      
+    if (mesh_query_outside_node(&q, n)) { continue; }
+    
+    if (n->count == 0) {
+      stack[top++] = n->offset;
+      stack[top++] = i + 1;
+      continue;
     }
-  }
-  
-  collision col = collision_none();
-  
-  for (int i = 0; i < cm->triangles_num; i++) {
-    ctri ct = cm->triangles[i];
-    ct = ctri_transform(ct, world, world_normal);
-    ct = ctri_transform_space(ct, space, space_normal);
     
-    /* This does not work for some reason */
-    //if (sphere_swept_outside_sphere(s, v, ct.bound)) continue;
-    col = collision_merge(col, sphere_collide_ctri(s, v, ct));
+    for (int j = n->offset; j < n->offset + n->count; j++) {
+      col = collision_merge(col, mesh_query_sphere_ctri(&q, cm->triangles[j]));
+    }
   }
   
   return col;
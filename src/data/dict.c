@@ -1,112 +1,166 @@
 #include "data/dict.h"
 
-static int hash(const char* s, int size) {
-  int h = 0;
-  while (*s) h = h * 101 + *s++;
-  return abs(h) % size;
+static uint32_t hash(const char* s) {
+  
+  /* FNV-1a */
+  uint32_t h = 2166136261u;
+  while (*s) {
+    h ^= (unsigned char)*s++;
+    h *= 16777619u;
+  }
+  
+  /* Final avalanche so low bits depend on every character */
+  h ^= h >> 16;
+  h *= 0x85ebca6bu;
+  h ^= h >> 13;
+  h *= 0xc2b2ae35u;
+  h ^= h >> 16;
+  
+  return h;
 }
 
-dict* dict_new(int size) {
+static int dict_slot(dict* d, char* key, uint32_t h) {
   
-  dict* d = malloc( sizeof(dict) );
+  int mask = d->size - 1;
+  int i = h & mask;
+  
+  while (d->keys[i] != NULL) {
+    if (d->hashes[i] == h && strcmp(d->keys[i], key) == 0) { return i; }
+    i = (i + 1) & mask;
+  }
   
+  return i;
+}
+
+static void dict_alloc(dict* d, int size) {
   d->size = size;
-  d->buckets = malloc( sizeof(struct bucket*) * d->size );
+  d->num_items = 0;
+  d->hashes = malloc(sizeof(uint32_t) * d->size);
+  d->keys = calloc(d->size, sizeof(char*));
+  d->items = malloc(sizeof(void*) * d->size);
+}
+
+static void dict_resize(dict* d, int size) {
   
-  for(int i = 0; i < d->size; i++) {
-    d->buckets[i] = NULL;
+  int old_size = d->size;
+  uint32_t* old_hashes = d->hashes;
+  char** old_keys = d->keys;
+  void** old_items = d->items;
+  
+  dict_alloc(d, size);
+  
+  for(int i = 0; i < old_size; i++) {
+    if (old_keys[i] == NULL) { continue; }
+    int j = dict_slot(d, old_keys[i], old_hashes[i]);
+    d->hashes[j] = old_hashes[i];
+    d->keys[j] = old_keys[i];
+    d->items[j] = old_items[i];
+    d->num_items++;
   }
   
+  free(old_hashes);
+  free(old_keys);
+  free(old_items);
+  
+}
+
+dict* dict_new(int size) {
+  
+  int slots = 8;
+  while (slots < size) { slots *= 2; }
+  
+  dict* d = malloc( sizeof(dict) );
+  dict_alloc(d, slots);
+  
   return d;
   
 }
 
 void dict_delete(dict* d) {
-
-  for(int i=0; i< d->size; i++) {
-    bucket_delete_recursive(d->buckets[i]);
+  
+  for(int i = 0; i < d->size; i++) {
+    free(d->keys[i]);
   }
   
-  free(d->buckets);
+  free(d->hashes);
+  free(d->keys);
+  free(d->items);
   free(d);
 }
 
 bool dict_contains(dict* d, char* key) {
-
-  int index = hash(key, d->size);
-  struct bucket* b = d->buckets[index];
-  
-  while(true) {
-    if (b == NULL) { return false;}
-    if ( strcmp(b->key, key) == 0 ){ return true; }
-    b = b->next;
-  }
-
+  int i = dict_slot(d, key, hash(key));
+  return d->keys[i] != NULL;
 }
 
 void* dict_get(dict* d, char* key) {
+  int i = dict_slot(d, key, hash(key));
+  return d->keys[i] != NULL ? d->items[i] : NULL;
+}
+
+void dict_set(dict* d, char* key, void* item) {
   
-  int index = hash(key, d->size);
-  struct bucket* b = d->buckets[index];
+  uint32_t h = hash(key);
+  int i = dict_slot(d, key, h);
   
-  while(true){
-    if (b == NULL) { return NULL; }
-    if ( strcmp(b->key, key) == 0 ){ return b->item; }
-    b = b->next;
+  if (d->keys[i] != NULL) {
+    d->items[i] = item;
+    return;
   }
   
-  return NULL;
-
-}
-
-void dict_set(dict* d, char* key, void* item) {
-
-  int index = hash(key, d->size);
-  struct bucket* b = d->buckets[index];
-  struct bucket** p = &d->buckets[index];
-  
-  while(true) {
-    
-    if (b == NULL) {
-      *p = bucket_new(key, item);
-      return;
-    }
-    
-    if( strcmp(b->key, key) == 0) {
-      b->item = item;
-      return;
-    }
-    
-    p = &b->next;
-    b = b->next;
+  if ((d->num_items + 1) * 4 > d->size * 3) {
+    dict_resize(d, d->size * 2);
+    i = dict_slot(d, key, h);
   }
   
+  d->hashes[i] = h;
+  d->keys[i] = malloc(strlen(key) + 1);
+  strcpy(d->keys[i], key);
+  d->items[i] = item;
+  d->num_items++;
+  
 }
 
 void dict_remove_with(dict* d, char* key, void func(void*)) {
   
-  int index = hash(key, d->size);
-  struct bucket* b = d->buckets[index];
-  struct bucket** p = &d->buckets[index];
-  
-  while(true) {
-    
-    if(b == NULL) { return; }
-    if(strcmp(b->key, key) == 0) {
-      *p = b->next;
-      bucket_delete_with(b, func);
-      return;
+  int i = dict_slot(d, key, hash(key));
+  if (d->keys[i] == NULL) { return; }
+  
+  func(d->items[i]);
+  free(d->keys[i]);
+  d->num_items--;
+  
+  /*
+  ** Shift following entries back into the hole so
+  ** that probe sequences stay unbroken without
+  ** needing tombstones.
+  */
+  
+  int mask = d->size - 1;
+  int j = i;
+  while (true) {
+  
+    j = (j + 1) & mask;
+    if (d->keys[j] == NULL) { break; }
+  
+    int home = d->hashes[j] & mask;
+    bool movable = (i <= j) ? (home <= i || home > j) : (home <= i && home > j);
+  
+    if (movable) {
+      d->hashes[i] = d->hashes[j];
+      d->keys[i] = d->keys[j];
+      d->items[i] = d->items[j];
+      i = j;
     }
-    
-    p = &b->next;
-    b = b->next;
   }
+  
+  d->keys[i] = NULL;
 }
 
 void dict_map(dict* d, void func(void*)) {
   
   for(int i = 0; i < d->size; i++) {
-    bucket_map(d->buckets[i], func);
+    if (d->keys[i] != NULL) { func(d->items[i]); }
   }
   
 }
@@ -114,83 +168,29 @@ void dict_map(dict* d, void func(void*)) {
 void dict_filter_map(dict* d, int filter(void*) , void func(void*) ) {
   
   for(int i = 0; i < d->size; i++) {
-    bucket_filter_map(d->buckets[i], filter, func);
+    if (d->keys[i] != NULL && filter(d->items[i])) { func(d->items[i]); }
   }
   
 }
 
 void dict_print(dict* d) {
-  int num_bucket_lists = 0;
   
   for(int i = 0; i < d->size; i++) {
-    struct bucket* b = d->buckets[i];
-    if(b != NULL) {
-      printf("%i - ", i); bucket_print(b); printf("\n");
-      num_bucket_lists++;
+    if (d->keys[i] != NULL) {
+      printf("%i - (%s : %p) home %i\n", i, d->keys[i], d->items[i], d->hashes[i] & (d->size-1));
     }
   }
   
-  printf("Num slots with bucketlists: %i\n", num_bucket_lists);
+  printf("Num items: %i, Num slots: %i\n", d->num_items, d->size);
   
 }
 
 char* dict_find(dict* d, void* item) {
   
   for(int i = 0; i < d->size; i++) {
-    struct bucket* b = d->buckets[i];
-    while (b != NULL) {
-      if (b->item == item) { return b->key; }
-      b = b->next;
-    }
+    if (d->keys[i] != NULL && d->items[i] == item) { return d->keys[i]; }
   }
   
-  return NULL; 
-  
-}
-
-struct bucket* bucket_new(char* key, void* item) {
-  
-  struct bucket* b = malloc(sizeof(struct bucket));
-  b->item = item;
-  b->key = malloc(strlen(key) + 1);
-  strcpy(b->key, key);
-  
-  b->next = NULL;
-  
-  return b;
-}
-
-void bucket_map(struct bucket* b, void func(void*) ) {
-  if( b == NULL) { return; }
-  func(b->item);
-  bucket_map(b->next, func);
-}
-
-void bucket_filter_map(struct bucket* b, int filter(void*) , void func(void*) ) {
-  if( b == NULL) { return; }
-  if(filter(b->item)) { func(b->item);}
-  bucket_filter_map(b->next, filter, func);
-}
-
-void bucket_delete_with(struct bucket* b, void func(void*) ){
-  func(b->item);
-  free(b->key);
-  free(b);
-}
-
-void bucket_delete_recursive(struct bucket* b) {
-  if (b == NULL) return;
-  
-  bucket_delete_recursive(b->next);
-  free(b->key);
-  free(b);
-}
-
-void bucket_print(struct bucket* b) {
-  
-  printf("(%s : %p)", b->key, b->item);
-  if (b->next != NULL) {
-    printf(" -> "); bucket_print(b->next);
-  }
+  return NULL;
   
 }
@@ -197,7 +197,7 @@ float spline_get_x(spline* s, float y) {
 
 color_curves* color_curves_load(char* filename) {
   
-  SDL_RWops* file = SDL_RWFromFile(filename, "r");
+  SDL_RWops* file = SDL_RWFromFileBuffered(filename, "r");
   
   if(file == NULL) {
     error("Cannot load curves file %s", filename);
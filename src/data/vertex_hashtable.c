@@ -1,77 +1,162 @@
 #include "data/vertex_hashtable.h"
 
-int vertex_hash(vertex_hashtable* ht, vertex v) {
-  int val = abs(vec3_hash(v.position) ^ vec3_hash(v.normal) ^ vec2_hash(v.uvs));
-  return val % ht->table_size;
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+static uint32_t vertex_key_bits(float f) {
+  union { float f; uint32_t i; } u;
+  u.f = f;
+  /* Fold negative zero so that keys agree with float comparison */
+  return (u.i == 0x80000000u) ? 0 : u.i;
 }
 
-vertex_hashtable* vertex_hashtable_new(int table_size) {
+static vertex_key vertex_key_new(vertex v) {
+  vertex_key k;
+  k.data[0] = vertex_key_bits(v.position.x);
+  k.data[1] = vertex_key_bits(v.position.y);
+  k.data[2] = vertex_key_bits(v.position.z);
+  k.data[3] = vertex_key_bits(v.normal.x);
+  k.data[4] = vertex_key_bits(v.normal.y);
+  k.data[5] = vertex_key_bits(v.normal.z);
+  k.data[6] = vertex_key_bits(v.uvs.x);
+  k.data[7] = vertex_key_bits(v.uvs.y);
+  return k;
+}
 
-  vertex_hashtable* ht = malloc(sizeof(vertex_hashtable));
+static uint32_t vertex_key_hash(const vertex_key* k) {
   
-  ht->items =  malloc( sizeof(vertex_bucket) * table_size );
-  ht->table_size = table_size;
-  
-  for(int i = 0; i < ht->table_size; i++) {
-    ht->items[i].keys = vertex_list_new();
-    ht->items[i].values = int_list_new();
+  uint32_t h = 2166136261u;
+  for(int i = 0; i < 8; i++) {
+    h ^= k->data[i];
+    h *= 16777619u;
+    h ^= h >> 15;
   }
   
-  return ht;
-
+  h ^= h >> 16;
+  h *= 0x85ebca6bu;
+  h ^= h >> 13;
+  h *= 0xc2b2ae35u;
+  h ^= h >> 16;
+  
+  /* Zero marks an empty slot */
+  return (h == 0) ? 1 : h;
 }
 
-void vertex_hashtable_delete(vertex_hashtable* ht) {
+static bool vertex_key_equal(const vertex_key* k0, const vertex_key* k1) {
+#ifdef __SSE2__
+  __m128i a0 = _mm_loadu_si128((const __m128i*)&k0->data[0]);
+  __m128i a1 = _mm_loadu_si128((const __m128i*)&k0->data[4]);
+  __m128i b0 = _mm_loadu_si128((const __m128i*)&k1->data[0]);
+  __m128i b1 = _mm_loadu_si128((const __m128i*)&k1->data[4]);
+  __m128i eq = _mm_and_si128(_mm_cmpeq_epi32(a0, b0), _mm_cmpeq_epi32(a1, b1));
+  return _mm_movemask_epi8(eq) == 0xFFFF;
+#else
+  for(int i = 0; i < 8; i++) {
+    if (k0->data[i] != k1->data[i]) { return false; }
+  }
+  return true;
+#endif
+}
 
-  for(int i = 0; i < ht->table_size; i++) {
-    vertex_list_delete( ht->items[i].keys );
-    int_list_delete( ht->items[i].values );
+static int vertex_hashtable_slot(vertex_hashtable* ht, const vertex_key* k, uint32_t h) {
+  
+  int mask = ht->size - 1;
+  int i = h & mask;
+  
+  while (ht->entries[i].hash != 0) {
+    if (ht->entries[i].hash == h && vertex_key_equal(&ht->entries[i].key, k)) { return i; }
+    i = (i + 1) & mask;
   }
   
-  free(ht->items);
-  free(ht);
+  return i;
+}
 
+static void vertex_hashtable_alloc(vertex_hashtable* ht, int size) {
+  ht->size = size;
+  ht->num_items = 0;
+  ht->entries = calloc(size, sizeof(vertex_entry));
 }
 
-void vertex_hashtable_set(vertex_hashtable* ht, vertex key, int value) {
+static void vertex_hashtable_resize(vertex_hashtable* ht, int size) {
   
-  int index = vertex_hash(ht, key);
+  int old_size = ht->size;
+  vertex_entry* old_entries = ht->entries;
   
-  vertex_bucket bucket = ht->items[index];
-    
-  /* Check existing items for replacement */
-  for(int i = 0; i < bucket.keys->num_items; i++) {
-    
-    vertex t_key = vertex_list_get(bucket.keys, i);
-    if( vertex_equal(t_key, key) ) {
-      int_list_set(bucket.values, i, value);
-      return;
-    }
+  vertex_hashtable_alloc(ht, size);
   
+  for(int i = 0; i < old_size; i++) {
+    if (old_entries[i].hash == 0) { continue; }
+    int j = vertex_hashtable_slot(ht, &old_entries[i].key, old_entries[i].hash);
+    ht->entries[j] = old_entries[i];
+    ht->num_items++;
   }
   
-  /* If it doesn't already exist then append */
-  vertex_list_push_back(bucket.keys, key);
-  int_list_push_back(bucket.values, value);
+  free(old_entries);
+  
+}
+
+vertex_hashtable* vertex_hashtable_new(int size) {
+  
+  int slots = 8;
+  while (slots < size) { slots *= 2; }
+  
+  vertex_hashtable* ht = malloc(sizeof(vertex_hashtable));
+  vertex_hashtable_alloc(ht, slots);
+  
+  return ht;
+  
+}
 
+void vertex_hashtable_delete(vertex_hashtable* ht) {
+  free(ht->entries);
+  free(ht);
 }
 
-int vertex_hashtable_get(vertex_hashtable* ht, vertex key) {
+static void vertex_hashtable_insert(vertex_hashtable* ht, int i, vertex_key* k, uint32_t h, int value) {
   
-  int index = vertex_hash(ht, key);
+  if ((ht->num_items + 1) * 4 > ht->size * 3) {
+    vertex_hashtable_resize(ht, ht->size * 2);
+    i = vertex_hashtable_slot(ht, k, h);
+  }
+  
+  ht->entries[i].key = *k;
+  ht->entries[i].hash = h;
+  ht->entries[i].value = value;
+  ht->num_items++;
   
-  //printf("Vertex Hashed: %i \n", index); fflush(stdout);
+}
+
+void vertex_hashtable_set(vertex_hashtable* ht, vertex key, int value) {
   
-  vertex_bucket bucket = ht->items[index];
+  vertex_key k = vertex_key_new(key);
+  uint32_t h = vertex_key_hash(&k);
+  int i = vertex_hashtable_slot(ht, &k, h);
   
-  for(int i = 0; i < bucket.keys->num_items; i++) {
-    
-    vertex t_key = vertex_list_get(bucket.keys, i);
-    if( vertex_equal(t_key, key) ) {
-      return int_list_get(bucket.values, i);
-    }
-    
+  if (ht->entries[i].hash != 0) {
+    ht->entries[i].value = value;
+  } else {
+    vertex_hashtable_insert(ht, i, &k, h, value);
   }
   
+}
+
+int vertex_hashtable_get_or_set(vertex_hashtable* ht, vertex key, int value) {
+  
+  vertex_key k = vertex_key_new(key);
+  uint32_t h = vertex_key_hash(&k);
+  int i = vertex_hashtable_slot(ht, &k, h);
+  
+  if (ht->entries[i].hash != 0) { return ht->entries[i].value; }
+  
+  vertex_hashtable_insert(ht, i, &k, h, value);
   return -1;
-}
\ No newline at end of file
+}
+
+int vertex_hashtable_get(vertex_hashtable* ht, vertex key) {
+  
+  vertex_key k = vertex_key_new(key);
+  int i = vertex_hashtable_slot(ht, &k, vertex_key_hash(&k));
+  
+  return (ht->entries[i].hash != 0) ? ht->entries[i].value : -1;
+}
@@ -182,27 +182,27 @@ void particles_update(particles* p, float timestep, camera* cam) {
   
   mat3 rot_camera = mat3_inverse(mat4_to_mat3(camera_view_matrix(cam)));
   
+  /*
+  ** Vertices are first built facing down the z axis and
+  ** then all turned to face the camera in one batch before
+  ** being moved to the particle positions.
+  */
+  
   int vi = 0;
   for (int i = 0; i < p->count; i++) {
-    
-    mat4 world_pos = mat4_new(
-      rot_camera.xx, rot_camera.xy, rot_camera.xz, p->positions[i].x,
-      rot_camera.yx, rot_camera.yy, rot_camera.yz, p->positions[i].y,
-      rot_camera.zx, rot_camera.zy, rot_camera.zz, p->positions[i].z,
-      0, 0, 0, 1);
     
     vec3 scale = p->actives[i] ? p->scales[i] : vec3_zero();
     
     mat3 rot_axis = mat3_rotation_z(p->rotations[i] * 2 * M_PI);
     
-    vec3 vertex_0 = mat4_mul_vec3(world_pos, mat3_mul_vec3(rot_axis, vec3_new(-scale.x,  scale.y, 0)));
-    vec3 vertex_1 = mat4_mul_vec3(world_pos, mat3_mul_vec3(rot_axis, vec3_new( scale.x,  scale.y, 0)));
-    vec3 vertex_2 = mat4_mul_vec3(world_pos, mat3_mul_vec3(rot_axis, vec3_new( scale.x, -scale.y, 0)));
-    vec3 vertex_3 = mat4_mul_vec3(world_pos, mat3_mul_vec3(rot_axis, vec3_new(-scale.x, -scale.y, 0)));
+    vec3 vertex_0 = mat3_mul_vec3(rot_axis, vec3_new(-scale.x,  scale.y, 0));
+    vec3 vertex_1 = mat3_mul_vec3(rot_axis, vec3_new( scale.x,  scale.y, 0));
+    vec3 vertex_2 = mat3_mul_vec3(rot_axis, vec3_new( scale.x, -scale.y, 0));
+    vec3 vertex_3 = mat3_mul_vec3(rot_axis, vec3_new(-scale.x, -scale.y, 0));
     
-    vec3 normal   = mat3_mul_vec3(rot_camera, mat3_mul_vec3(rot_axis, vec3_new(0, 0, 1)));
-    vec3 tangent  = mat3_mul_vec3(rot_camera, mat3_mul_vec3(rot_axis, vec3_new(1, 0, 0)));
-    vec3 binormal = mat3_mul_vec3(rot_camera, mat3_mul_vec3(rot_axis, vec3_new(0, 1, 0)));
+    vec3 normal   = mat3_mul_vec3(rot_axis, vec3_new(0, 0, 1));
+    vec3 tangent  = mat3_mul_vec3(rot_axis, vec3_new(1, 0, 0));
+    vec3 binormal = mat3_mul_vec3(rot_axis, vec3_new(0, 1, 0));
     
     add_vertex(p->vertex_data, &vi, vertex_0, normal, tangent, binormal, vec2_new(0, 1), p->colors[i]);
     add_vertex(p->vertex_data, &vi, vertex_1, normal, tangent, binormal, vec2_new(1, 1), p->colors[i]);
@@ -214,6 +214,19 @@ void particles_update(particles* p, float timestep, camera* cam) {
     
   }
   
+  mat4 world_camera = mat3_to_mat4(rot_camera);
+  int stride = sizeof(float) * 18;
+  for (int j = 0; j < 4; j++) {
+    mat4_mul_vec3_many(world_camera, (vec3*)(p->vertex_data + j * 3), p->count * 6, stride);
+  }
+  
+  for (int i = 0; i < p->count; i++) {
+    for (int j = 0; j < 6; j++) {
+      vec3* position = (vec3*)(p->vertex_data + (i * 6 + j) * 18);
+      *position = vec3_add(*position, p->positions[i]);
+    }
+  }
+  
   if (net_is_client()) {
     glBindBuffer(GL_ARRAY_BUFFER, p->vertex_buff);
     glBufferData(GL_ARRAY_BUFFER, sizeof(float) * 18 * 6 * p->count, p->vertex_data, GL_DYNAMIC_DRAW);
@@ -399,11 +399,24 @@ deferred_renderer* deferred_renderer_new(asset_hndl options) {
   dr->exposure_target = 0.4;
   dr->skydome_enabled = true;
   dr->sea_enabled = false;
+  dr->lod_error = 1.0;
   
   /* Objects */
   dr->render_objects_num = 0;
   dr->render_objects = NULL;
   
+  /* Culling */
+  dr->cull_num = 0;
+  dr->cull_bounds = NULL;
+  dr->cull_visible = NULL;
+  dr->cull_slot = 0;
+  dr->cull_hints_num = 0;
+  dr->cull_hints = NULL;
+  
+  /* Level of detail */
+  dr->lod_num = 0;
+  dr->lod_scales = NULL;
+  
   glTexEnvf(GL_TEXTURE_FILTER_CONTROL, GL_TEXTURE_LOD_BIAS, option_graphics_float(asset_hndl_ptr(&dr->options), "lod_bias", -1.0, 0.0, 1.0));
   
   SDL_GL_CheckError();
@@ -446,6 +459,10 @@ void deferred_renderer_delete(deferred_renderer* dr) {
   glDeleteTextures(3, dr->shadows_texture);
   
   free(dr->render_objects);
+  free(dr->cull_bounds);
+  free(dr->cull_visible);
+  free(dr->cull_hints);
+  free(dr->lod_scales);
     
   folder_unload(P("$CORANGE/shaders/deferred/"));
   
@@ -478,6 +495,10 @@ void deferred_renderer_set_sea_enabled(deferred_renderer* dr, bool enabled) {
   dr->sea_enabled = enabled;
 }
 
+void deferred_renderer_set_lod_error(deferred_renderer* dr, float pixels) {
+  dr->lod_error = pixels;
+}
+
 void deferred_renderer_set_tod(deferred_renderer* dr, float tod, int seed) {
   dr->time_of_day = tod;
   sky_update(dr->sky, dr->time_of_day, 0);
@@ -548,9 +569,54 @@ static void shadow_mapper_transforms(deferred_renderer* dr, int i, mat4* view, m
   
 }
 
+/*
+** Transforms the bounds of every surface into world
+** space and tests them against the frustum in one batch.
+** Results are left in cull_bounds and cull_visible.
+*/
+static void cull_surfaces(deferred_renderer* dr, renderable* r, mat4 world, frustum_planes frustum) {
+  
+  if (r->num_surfaces > dr->cull_num) {
+    dr->cull_num = r->num_surfaces;
+    dr->cull_bounds = realloc(dr->cull_bounds, sizeof(sphere) * dr->cull_num);
+    dr->cull_visible = realloc(dr->cull_visible, sizeof(uint32_t) * ((dr->cull_num + 31) / 32));
+  }
+  
+  for(int i = 0; i < r->num_surfaces; i++) {
+    dr->cull_bounds[i] = r->surfaces[i]->bound;
+  }
+  
+  sphere_transform_many(dr->cull_bounds, r->num_surfaces, world);
+  sphere_visible_frustum_planes_many(dr->cull_bounds, r->num_surfaces, frustum, dr->cull_visible);
+  
+}
+
+static bool cull_surface_visible(deferred_renderer* dr, int i) {
+  return dr->cull_visible[i / 32] & (1u << (i % 32));
+}
+
+/*
+** Object bounds start with the plane which culled them
+** the previous frame. Hints are matched up by the order
+** objects are tested in each frame, so if the scene
+** changes they only become less useful.
+*/
+static bool cull_outside(deferred_renderer* dr, frustum_planes frustum, sphere s) {
+  
+  if (dr->cull_slot >= dr->cull_hints_num) {
+    int num = max(dr->cull_hints_num * 2, 64);
+    dr->cull_hints = realloc(dr->cull_hints, sizeof(int) * num);
+    memset(dr->cull_hints + dr->cull_hints_num, 0, sizeof(int) * (num - dr->cull_hints_num));
+    dr->cull_hints_num = num;
+  }
+  
+  int* last = &dr->cull_hints[dr->cull_slot++];
+  return frustum_planes_cull_sphere(frustum, s, FRUSTUM_PLANES_ALL, last) == FRUSTUM_PLANES_OUTSIDE;
+}
+
 static void render_shadows_vegetation(deferred_renderer* dr, int i, instance_object* io) {
   
-  if (sphere_outside_box(io->bound, dr->camera_frustum)) { return; }
+  if (cull_outside(dr, dr->camera_frustum, io->bound)) { return; }
   
   shader_program* shader = material_first_program(asset_hndl_ptr(&dr->mat_depth_veg));
   shader_program_enable(shader);
@@ -561,6 +627,7 @@ static void render_shadows_vegetation(deferred_renderer* dr, int i, instance_obj
   shader_program_set_float(shader, "time", dr->time);
   
   renderable* r = asset_hndl_ptr(&io->renderable);
+  renderable_upload(r);
 
   if(r->is_rigged) { error("Static Object is rigged!"); }
   
@@ -605,6 +672,51 @@ static void render_shadows_vegetation(deferred_renderer* dr, int i, instance_obj
 
 }
 
+/*
+** Level of detail is picked from the size of a surface on
+** screen. Shadows use the same level as the camera view so
+** objects don't cast shadows of a different shape.
+*/
+
+static float screen_radius(deferred_renderer* dr, sphere s) {
+  
+  float dist = vec3_dist(dr->camera->position, s.center);
+  if (dist <= s.radius) { return FLT_MAX; }
+  
+  return (s.radius / (dist * tanf(dr->camera->fov))) * graphics_viewport_width() / 2;
+}
+
+/*
+** Instance objects have one scale from object space to
+** pixels per frame, taken from the closest instance and
+** shared by every surface and every shadow cascade. It
+** is found the first time render object j is drawn.
+*/
+static float instance_screen_scale(deferred_renderer* dr, int j, instance_object* io, renderable* r) {
+  
+  if (dr->lod_scales[j] >= 0) { return dr->lod_scales[j]; }
+  
+  sphere bound = sphere_unit();
+  for(int i = 0; i < r->num_surfaces; i++) {
+    bound = sphere_merge(bound, r->surfaces[i]->bound);
+  }
+  
+  float scale = 0;
+  for(int i = 0; i < io->num_instances; i++) {
+    float radius = screen_radius(dr, sphere_transform(bound, io->instances[i].world));
+    if (radius == FLT_MAX) { scale = FLT_MAX; break; }
+    scale = max(scale, radius / bound.radius);
+  }
+  
+  dr->lod_scales[j] = scale;
+  return scale;
+}
+
+static float instance_screen_radius(float scale, renderable_surface* s) {
+  if (scale == FLT_MAX) { return FLT_MAX; }
+  return scale * s->bound.radius;
+}
+
 static void render_shadows_static(deferred_renderer* dr, int i, static_object* s) {
   
   mat4 world = mat4_world(s->position, s->scale, s->rotation);
@@ -618,14 +730,20 @@ static void render_shadows_static(deferred_renderer* dr, int i, static_object* s
   shader_program_set_float(shader, "clip_far",  dr->shadow_far[i]);
   
   renderable* r = asset_hndl_ptr(&s->renderable);
+  renderable_upload(r);
 
   if(r->is_rigged) { error("Static Object is rigged!"); }
   
+  cull_surfaces(dr, r, world, dr->shadow_frustum[i]);
+  
   for(int j = 0; j < r->num_surfaces; j++) {
     
     renderable_surface* s = r->surfaces[j];
     
-    if (sphere_outside_box(sphere_transform(s->bound, world), dr->shadow_frustum[i])) { continue; }
+    if (!cull_surface_visible(dr, j)) { continue; }
+    sphere bound = dr->cull_bounds[j];
+    
+    renderable_lod lod = renderable_surface_lod(s, screen_radius(dr, bound), dr->lod_error);
     
     material_entry* me = material_get_entry(asset_hndl_ptr(&r->material), j);
     
@@ -638,12 +756,12 @@ static void render_shadows_static(deferred_renderer* dr, int i, static_object* s
     }
     
     glBindBuffer(GL_ARRAY_BUFFER, s->vertex_vbo);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, s->triangle_vbo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, lod.triangle_vbo);
     
     shader_program_enable_attribute(shader, "vPosition", 3, 18, (void*)0);
     shader_program_enable_attribute(shader, "vTexcoord", 2, 18, (void*)(sizeof(float) * 12));
     
-      glDrawElements(GL_TRIANGLES, s->num_triangles * 3, GL_UNSIGNED_INT, (void*)0);
+      glDrawElements(GL_TRIANGLES, lod.num_triangles * 3, GL_UNSIGNED_INT, (void*)0);
     
     shader_program_disable_attribute(shader, "vPosition");
     shader_program_disable_attribute(shader, "vTexcoord");
@@ -656,9 +774,9 @@ static void render_shadows_static(deferred_renderer* dr, int i, static_object* s
   
 }
 
-static void render_shadows_instance(deferred_renderer* dr, int i, instance_object* io) {
+static void render_shadows_instance(deferred_renderer* dr, int i, int j, instance_object* io) {
   
-  if (sphere_outside_box(io->bound, dr->camera_frustum)) { return; }
+  if (cull_outside(dr, dr->camera_frustum, io->bound)) { return; }
   
   shader_program* shader = material_first_program(asset_hndl_ptr(&dr->mat_depth_ins));
   shader_program_enable(shader);
@@ -668,14 +786,18 @@ static void render_shadows_instance(deferred_renderer* dr, int i, instance_objec
   shader_program_set_float(shader, "clip_far",  dr->shadow_far[i]);
   
   renderable* r = asset_hndl_ptr(&io->renderable);
+  renderable_upload(r);
 
   if(r->is_rigged) { error("Static Object is rigged!"); }
   
-  for(int j = 0; j < r->num_surfaces; j++) {
+  float scale = instance_screen_scale(dr, j, io, r);
+  
+  for(int k = 0; k < r->num_surfaces; k++) {
     
-    renderable_surface* s = r->surfaces[j];
+    renderable_surface* s = r->surfaces[k];
+    renderable_lod lod = renderable_surface_lod(s, instance_screen_radius(scale, s), dr->lod_error);
     
-    material_entry* me = material_get_entry(asset_hndl_ptr(&r->material), j);
+    material_entry* me = material_get_entry(asset_hndl_ptr(&r->material), k);
     
     if (material_entry_has_item(me, "alpha_test")) {
       shader_program_set_texture(shader, "diffuse_map", 0, material_entry_item(me, "diffuse_map").as_asset);
@@ -694,8 +816,8 @@ static void render_shadows_instance(deferred_renderer* dr, int i, instance_objec
     
     shader_program_enable_attribute_instance_matrix(shader, "vWorld", (void*)0);
     
-      glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, s->triangle_vbo);
-      glDrawElementsInstanced(GL_TRIANGLES, s->num_triangles * 3, GL_UNSIGNED_INT, (void*)0, io->num_instances);
+      glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, lod.triangle_vbo);
+      glDrawElementsInstanced(GL_TRIANGLES, lod.num_triangles * 3, GL_UNSIGNED_INT, (void*)0, io->num_instances);
     
     shader_program_disable_attribute(shader, "vPosition");
     shader_program_disable_attribute(shader, "vTexcoord");
@@ -746,13 +868,14 @@ static void render_shadows_animated(deferred_renderer* dr, int i, animated_objec
   shader_program_set_float(shader, "clip_far",  dr->shadow_far[i]);
   
   renderable* r = asset_hndl_ptr(&ao->renderable);
+  renderable_upload(r);
   
   if(!r->is_rigged) { error("animated object is not rigged"); }
   
   for(int j = 0; j < r->num_surfaces; j++) {
     renderable_surface* s = r->surfaces[j];
     
-    //if (sphere_outside_box(sphere_transform(s->bound, world), dr->shadow_frustum[i])) { continue; }
+    //if (sphere_outside_frustum_planes(sphere_transform(s->bound, world), dr->shadow_frustum[i])) { continue; }
     
     material_entry* me = material_get_entry(asset_hndl_ptr(&r->material), j);
     
@@ -788,15 +911,16 @@ static void render_shadows_animated(deferred_renderer* dr, int i, animated_objec
 
 }
 
-static void render_shadows_landscape_blobtree(deferred_renderer* dr, int i, shader* shader, landscape_blobtree* lbt, terrain* terr) {
+static void render_shadows_landscape_blobtree(deferred_renderer* dr, int i, shader* shader, landscape_blobtree* lbt, terrain* terr, int planes) {
 
-  if (sphere_outside_box(lbt->bound, dr->shadow_frustum[i])) { return; }
+  planes = frustum_planes_cull_sphere(dr->shadow_frustum[i], lbt->bound, planes, NULL);
+  if (planes == FRUSTUM_PLANES_OUTSIDE) { return; }
   
   if (!lbt->is_leaf) {
-    render_shadows_landscape_blobtree(dr, i, shader, lbt->child0, terr);
-    render_shadows_landscape_blobtree(dr, i, shader, lbt->child1, terr);
-    render_shadows_landscape_blobtree(dr, i, shader, lbt->child2, terr);
-    render_shadows_landscape_blobtree(dr, i, shader, lbt->child3, terr);
+    render_shadows_landscape_blobtree(dr, i, shader, lbt->child0, terr, planes);
+    render_shadows_landscape_blobtree(dr, i, shader, lbt->child1, terr, planes);
+    render_shadows_landscape_blobtree(dr, i, shader, lbt->child2, terr, planes);
+    render_shadows_landscape_blobtree(dr, i, shader, lbt->child3, terr, planes);
     return;
   }
   
@@ -830,7 +954,7 @@ static void render_shadows_landscape(deferred_renderer* dr, int i, landscape* l)
   
   if (unlikely(l->blobtree == NULL)) { error("Blobtree must be generated for landscape"); }
   
-  render_shadows_landscape_blobtree(dr, i, shader, l->blobtree, terr);
+  render_shadows_landscape_blobtree(dr, i, shader, l->blobtree, terr, FRUSTUM_PLANES_ALL);
   
   glBindBuffer(GL_ARRAY_BUFFER, 0);
   glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
@@ -852,7 +976,7 @@ static void render_shadows(deferred_renderer* dr) {
       &dr->shadow_view[i], &dr->shadow_proj[i],
       &dr->shadow_near[i], &dr->shadow_far[i]);
     
-    dr->shadow_frustum[i] = box_invert_depth(box_invert(frustum_box(frustum_new_camera(dr->shadow_view[i], dr->shadow_proj[i]))));
+    dr->shadow_frustum[i] = frustum_planes_new_camera(dr->shadow_view[i], dr->shadow_proj[i]);
     
     glBindFramebuffer(GL_FRAMEBUFFER, dr->shadows_fbo[i]);  
     glViewport( 0, 0, dr->shadows_widths[i], dr->shadows_heights[i]);
@@ -884,7 +1008,7 @@ static void render_shadows(deferred_renderer* dr) {
       if (veg_found) continue;
       
       if (dr->render_objects[j].type == RO_TYPE_STATIC) { render_shadows_static(dr, i, dr->render_objects[j].static_object); }
-      if (dr->render_objects[j].type == RO_TYPE_INSTANCE) { render_shadows_instance(dr, i, dr->render_objects[j].instance_object); }
+      if (dr->render_objects[j].type == RO_TYPE_INSTANCE) { render_shadows_instance(dr, i, j, dr->render_objects[j].instance_object); }
       if (dr->render_objects[j].type == RO_TYPE_ANIMATED) { render_shadows_animated(dr, i, dr->render_objects[j].animated_object); }
       if (dr->render_objects[j].type == RO_TYPE_LANDSCAPE) { render_shadows_landscape(dr, i, dr->render_objects[j].landscape); }
       
@@ -954,13 +1078,8 @@ static fpath cmesh_pallet[14] = {
   {"$CORANGE/textures/solid/grey.dds"},
 };
 
-static void render_cmesh(deferred_renderer* dr, cmesh* cm, mat4 world) {
-  
-  if (!cm->is_leaf) {
-    render_cmesh(dr, cm->front, world);
-    render_cmesh(dr, cm->back,  world);
-    return;
-  }
+/* Each leaf of the tree is drawn in a different color */
+static void render_cmesh_leaf(deferred_renderer* dr, ctri* triangles, int triangles_num, mat4 world) {
   
   shader_program* shader = material_first_program(asset_hndl_ptr(&dr->mat_static));
   shader_program_enable(shader);
@@ -983,11 +1102,11 @@ static void render_cmesh(deferred_renderer* dr, cmesh* cm, mat4 world) {
   shader_program_set_float(shader, "alpha_test", 0);
   shader_program_set_int(shader, "material", material_entry_item(me, "material").as_int);
   
-  vec3* positions = malloc(sizeof(vec3) * cm->triangles_num * 3);
-  vec3* normals   = malloc(sizeof(vec3) * cm->triangles_num * 3);
+  vec3* positions = malloc(sizeof(vec3) * triangles_num * 3);
+  vec3* normals   = malloc(sizeof(vec3) * triangles_num * 3);
   
-  for (int i = 0; i < cm->triangles_num * 3; i += 3) {
-    ctri t = cm->triangles[i / 3];
+  for (int i = 0; i < triangles_num * 3; i += 3) {
+    ctri t = triangles[i / 3];
     
     positions[i+0] = t.a;
     positions[i+1] = t.b;
@@ -1006,7 +1125,7 @@ static void render_cmesh(deferred_renderer* dr, cmesh* cm, mat4 world) {
   shader_program_enable_attribute(shader, "vBinormal",  3, 3, normals);
   shader_program_enable_attribute(shader, "vTexcoord",  2, 2, normals);
     
-    glDrawArrays(GL_TRIANGLES, 0, cm->triangles_num * 3);
+    glDrawArrays(GL_TRIANGLES, 0, triangles_num * 3);
   
   shader_program_disable_attribute(shader, "vPosition");
   shader_program_disable_attribute(shader, "vNormal");
@@ -1023,6 +1142,14 @@ static void render_cmesh(deferred_renderer* dr, cmesh* cm, mat4 world) {
     
 }
 
+static void render_cmesh(deferred_renderer* dr, cmesh* cm, mat4 world) {
+  for (int i = 0; i < cm->nodes_num; i++) {
+    cmesh_node n = cm->nodes[i];
+    if (n.count == 0) { continue; }
+    render_cmesh_leaf(dr, cm->triangles + n.offset, n.count, world);
+  }
+}
+
 static void render_static(deferred_renderer* dr, static_object* so) {
   
   mat4 world = mat4_world( so->position, so->scale, so->rotation );
@@ -1036,6 +1163,7 @@ static void render_static(deferred_renderer* dr, static_object* so) {
   }
   
   renderable* r = asset_hndl_ptr(&so->renderable);
+  renderable_upload(r);
   
   if(r->is_rigged) { error("Static object is rigged!"); }
   
@@ -1047,11 +1175,16 @@ static void render_static(deferred_renderer* dr, static_object* so) {
   shader_program_set_float(shader, "clip_near", dr->camera_near);
   shader_program_set_float(shader, "clip_far",  dr->camera_far);
   
+  cull_surfaces(dr, r, world, dr->camera_frustum);
+  
   for(int i=0; i < r->num_surfaces; i++) {
     
     renderable_surface* s = r->surfaces[i];
     
-    if (sphere_outside_box(sphere_transform(s->bound, world), dr->camera_frustum)) { continue; }
+    if (!cull_surface_visible(dr, i)) { continue; }
+    sphere bound = dr->cull_bounds[i];
+    
+    renderable_lod lod = renderable_surface_lod(s, screen_radius(dr, bound), dr->lod_error);
     
     material_entry* me = material_get_entry(asset_hndl_ptr(&r->material), i);
     
@@ -1076,8 +1209,8 @@ static void render_static(deferred_renderer* dr, static_object* so) {
     shader_program_enable_attribute(shader, "vBinormal",  3, 18, (void*)(sizeof(float) * 9));
     shader_program_enable_attribute(shader, "vTexcoord",  2, 18, (void*)(sizeof(float) * 12));
     
-      glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, s->triangle_vbo);
-      glDrawElements(GL_TRIANGLES, s->num_triangles * 3, GL_UNSIGNED_INT, (void*)0);
+      glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, lod.triangle_vbo);
+      glDrawElements(GL_TRIANGLES, lod.num_triangles * 3, GL_UNSIGNED_INT, (void*)0);
     
     shader_program_disable_attribute(shader, "vPosition");
     shader_program_disable_attribute(shader, "vNormal");
@@ -1096,7 +1229,7 @@ static void render_static(deferred_renderer* dr, static_object* so) {
 
 static void render_skin(deferred_renderer* dr, instance_object* io) {
   
-  if (sphere_outside_box(io->bound, dr->camera_frustum)) { return; }
+  if (cull_outside(dr, dr->camera_frustum, io->bound)) { return; }
   
   if (config_bool(asset_hndl_ptr(&dr->options), "render_colmeshes")) {
     if (!file_isloaded(io->collision_body.path)) {
@@ -1106,6 +1239,7 @@ static void render_skin(deferred_renderer* dr, instance_object* io) {
   }
   
   renderable* r = asset_hndl_ptr(&io->renderable);
+  renderable_upload(r);
   
   if(r->is_rigged) { error("Static object is rigged!"); }
   
@@ -1166,9 +1300,9 @@ static void render_skin(deferred_renderer* dr, instance_object* io) {
 
 }
 
-static void render_instance(deferred_renderer* dr, instance_object* io) {
+static void render_instance(deferred_renderer* dr, int j, instance_object* io) {
   
-  if (sphere_outside_box(io->bound, dr->camera_frustum)) { return; }
+  if (cull_outside(dr, dr->camera_frustum, io->bound)) { return; }
   
   if (config_bool(asset_hndl_ptr(&dr->options), "render_colmeshes")) {
     if (!file_isloaded(io->collision_body.path)) {
@@ -1181,6 +1315,7 @@ static void render_instance(deferred_renderer* dr, instance_object* io) {
   }
   
   renderable* r = asset_hndl_ptr(&io->renderable);
+  renderable_upload(r);
   
   if(r->is_rigged) { error("Static object is rigged!"); }
   
@@ -1191,9 +1326,12 @@ static void render_instance(deferred_renderer* dr, instance_object* io) {
   shader_program_set_float(shader, "clip_near", dr->camera_near);
   shader_program_set_float(shader, "clip_far",  dr->camera_far);
   
+  float scale = instance_screen_scale(dr, j, io, r);
+  
   for(int i=0; i < r->num_surfaces; i++) {
     
     renderable_surface* s = r->surfaces[i];
+    renderable_lod lod = renderable_surface_lod(s, instance_screen_radius(scale, s), dr->lod_error);
     
     material_entry* me = material_get_entry(asset_hndl_ptr(&r->material), i);
     
@@ -1222,8 +1360,8 @@ static void render_instance(deferred_renderer* dr, instance_object* io) {
     
     shader_program_enable_attribute_instance_matrix(shader, "vWorld", (void*)0);
     
-      glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, s->triangle_vbo);
-      glDrawElementsInstanced(GL_TRIANGLES, s->num_triangles * 3, GL_UNSIGNED_INT, (void*)0, io->num_instances);
+      glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, lod.triangle_vbo);
+      glDrawElementsInstanced(GL_TRIANGLES, lod.num_triangles * 3, GL_UNSIGNED_INT, (void*)0, io->num_instances);
     
     shader_program_disable_attribute(shader, "vPosition");
     shader_program_disable_attribute(shader, "vNormal");
@@ -1245,7 +1383,7 @@ static void render_vegetation(deferred_renderer* dr, instance_object* io) {
   
   if (config_int(asset_hndl_ptr(&dr->options), "vegetation") == 0) return;  
   
-  if (sphere_outside_box(io->bound, dr->camera_frustum)) { return; }  
+  if (cull_outside(dr, dr->camera_frustum, io->bound)) { return; }  
   
   if (config_bool(asset_hndl_ptr(&dr->options), "render_colmeshes")) {
     if (!file_isloaded(io->collision_body.path)) {
@@ -1255,6 +1393,7 @@ static void render_vegetation(deferred_renderer* dr, instance_object* io) {
   }
   
   renderable* r = asset_hndl_ptr(&io->renderable);
+  renderable_upload(r);
   
   if(r->is_rigged) { error("Static object is rigged!"); }
   
@@ -1321,6 +1460,7 @@ static void render_vegetation(deferred_renderer* dr, instance_object* io) {
 static void render_animated(deferred_renderer* dr, animated_object* ao) {
     
   renderable* r = asset_hndl_ptr(&ao->renderable);
+  renderable_upload(r);
   skeleton* skel = asset_hndl_ptr(&ao->skeleton);
   
   if (!r->is_rigged) { error("Animated object is not rigged!"); }
@@ -1351,7 +1491,7 @@ static void render_animated(deferred_renderer* dr, animated_object* ao) {
     
     renderable_surface* s = r->surfaces[i];
     
-    //if (sphere_outside_box(sphere_transform(s->bound, world), dr->camera_frustum)) { continue; }
+    //if (sphere_outside_frustum_planes(sphere_transform(s->bound, world), dr->camera_frustum)) { continue; }
     
     material_entry* me = material_get_entry(asset_hndl_ptr(&r->material), i);
     
@@ -1397,15 +1537,17 @@ static void render_animated(deferred_renderer* dr, animated_object* ao) {
   
 }
 
-static void render_landscape_blobtree(deferred_renderer* dr, shader* shader, landscape_blobtree* lbt, terrain* terr) {
+static void render_landscape_blobtree(deferred_renderer* dr, shader* shader, landscape_blobtree* lbt, terrain* terr, int planes) {
   
-  if (sphere_outside_box(lbt->bound, dr->camera_frustum)) { return; }
+  /* Children only test the planes their parent crossed */
+  planes = frustum_planes_cull_sphere(dr->camera_frustum, lbt->bound, planes, NULL);
+  if (planes == FRUSTUM_PLANES_OUTSIDE) { return; }
   
   if (!lbt->is_leaf) {
-    render_landscape_blobtree(dr, shader, lbt->child0, terr);
-    render_landscape_blobtree(dr, shader, lbt->child1, terr);
-    render_landscape_blobtree(dr, shader, lbt->child2, terr);
-    render_landscape_blobtree(dr, shader, lbt->child3, terr);
+    render_landscape_blobtree(dr, shader, lbt->child0, terr, planes);
+    render_landscape_blobtree(dr, shader, lbt->child1, terr, planes);
+    render_landscape_blobtree(dr, shader, lbt->child2, terr, planes);
+    render_landscape_blobtree(dr, shader, lbt->child3, terr, planes);
     return;
   }
   
@@ -1481,7 +1623,7 @@ static void render_landscape(deferred_renderer* dr, landscape* l) {
   
   if (unlikely(l->blobtree == NULL)) { error("Landscape blobtree must be generated!"); }
   
-  render_landscape_blobtree(dr, shader, l->blobtree, terr);
+  render_landscape_blobtree(dr, shader, l->blobtree, terr, FRUSTUM_PLANES_ALL);
   
   glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
   glBindBuffer(GL_ARRAY_BUFFER, 0);
@@ -1833,7 +1975,7 @@ static void render_gbuffer(deferred_renderer* dr) {
   dr->camera_proj = camera_proj_matrix(dr->camera);
   dr->camera_near = dr->camera->near_clip;
   dr->camera_far  = dr->camera->far_clip;
-  dr->camera_frustum = box_invert_depth(frustum_box(frustum_new_camera(dr->camera_view, dr->camera_proj)));
+  dr->camera_frustum = frustum_planes_new_camera(dr->camera_view, dr->camera_proj);
   
   int width = graphics_viewport_width();
   int height = graphics_viewport_height();
@@ -1885,7 +2027,7 @@ static void render_gbuffer(deferred_renderer* dr) {
     if (veg_found) continue;
     
     if (dr->render_objects[j].type == RO_TYPE_STATIC)     { render_static(dr, dr->render_objects[j].static_object); continue; }
-    if (dr->render_objects[j].type == RO_TYPE_INSTANCE)   { render_instance(dr, dr->render_objects[j].instance_object); continue; }
+    if (dr->render_objects[j].type == RO_TYPE_INSTANCE)   { render_instance(dr, j, dr->render_objects[j].instance_object); continue; }
     if (dr->render_objects[j].type == RO_TYPE_ANIMATED)   { render_animated(dr, dr->render_objects[j].animated_object); continue; }
     if (dr->render_objects[j].type == RO_TYPE_LANDSCAPE)  { render_landscape(dr, dr->render_objects[j].landscape); }
     if (dr->render_objects[j].type == RO_TYPE_LIGHT)      { render_light(dr, dr->render_objects[j].light); continue; }
@@ -2004,6 +2146,7 @@ static void render_skies(deferred_renderer* dr) {
     //shader_program_set_vec3(shader, "camera_position", dr->camera->position);
     
     renderable* skybox_r = asset_hndl_ptr(&dr->mesh_skydome);
+    renderable_upload(skybox_r);
     renderable_surface* s = skybox_r->surfaces[0];
     
     glBindBuffer(GL_ARRAY_BUFFER, s->vertex_vbo);
@@ -2037,6 +2180,7 @@ static void render_skies(deferred_renderer* dr) {
     shader_program_set_texture(shader, "sun_texture", 0, dr->sky->sun_tex);
     
     renderable* sun_r = asset_hndl_ptr(&dr->sky->sun_sprite);
+    renderable_upload(sun_r);
     renderable_surface* s = sun_r->surfaces[0];
     
     glBindBuffer(GL_ARRAY_BUFFER, s->vertex_vbo);
@@ -2080,6 +2224,7 @@ static void render_skies(deferred_renderer* dr) {
       shader_program_set_float(shader, "opacity", dr->sky->cloud_opacity[i]);
       
       renderable* sun_r = asset_hndl_ptr(&dr->sky->cloud_mesh[i]);
+      renderable_upload(sun_r);
       renderable_surface* s = sun_r->surfaces[0];
       
       glBindBuffer(GL_ARRAY_BUFFER, s->vertex_vbo);
@@ -2154,6 +2299,7 @@ static void render_sea(deferred_renderer* dr) {
   shader_program_set_texture(shader, "cube_sea", 5, dr->tex_cube_sea);
   
   renderable* sea_r = asset_hndl_ptr(&dr->mesh_sea);
+  renderable_upload(sea_r);
   renderable_surface* s = sea_r->surfaces[0];
   
   glBindBuffer(GL_ARRAY_BUFFER, s->vertex_vbo);
@@ -2576,6 +2722,16 @@ static void render_post1(deferred_renderer* dr) {
 void deferred_renderer_render(deferred_renderer* dr) {
   
   dr->time += frame_time();
+  dr->cull_slot = 0;
+  
+  if (dr->render_objects_num > dr->lod_num) {
+    dr->lod_num = dr->render_objects_num;
+    dr->lod_scales = realloc(dr->lod_scales, sizeof(float) * dr->lod_num);
+  }
+  
+  for(int j = 0; j < dr->render_objects_num; j++) {
+    dr->lod_scales[j] = -1;
+  }
   
   //timer t = timer_start(0, "Rendering Start");
   
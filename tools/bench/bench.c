@@ -0,0 +1,878 @@
+/**
+*** :: Bench ::
+***
+***   Microbenchmarks for the maths and geometry routines
+***   in cengine, the colliders in cphysics, the data
+***   structures and the mesh loaders.
+***
+***   Every benchmark calls one function over a fixed table
+***   of random inputs. The number of calls is calibrated
+***   so that a trial takes a few milliseconds, then some
+***   warmup trials are run and thrown away before the
+***   timed ones. The minimum and median time per call of
+***   the timed trials are reported in nanoseconds.
+***
+***   File benchmarks load a generated grid mesh, written
+***   to the working directory on first use and removed on
+***   exit. A call is one whole file, and the throughput of
+***   the median is also reported in MB/s.
+***
+***   bench [-t trials] [-w warmup] [-l label] [-o output] [filter...]
+***
+***     -t  Number of timed trials
+***     -w  Number of warmup trials
+***     -l  Label stored with the results, such as a commit
+***     -o  Write the results to a file, .csv or .json
+***
+***   Only benchmarks with a name containing one of the
+***   filters are run.
+***
+**/
+
+#include "corange.h"
+
+#ifdef _WIN32
+  #include <windows.h>
+#endif
+
+#define BENCH_INPUTS 1024
+#define BENCH_MASK (BENCH_INPUTS-1)
+#define BENCH_TRIAL_TIME 0.005
+#define BENCH_MAX 256
+
+/* Timing */
+
+static double bench_clock(void) {
+#if defined(__unix__) || defined(__APPLE__)
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec / 1e9;
+#elif defined(_WIN32)
+  LARGE_INTEGER count, frequency;
+  QueryPerformanceCounter(&count);
+  QueryPerformanceFrequency(&frequency);
+  return (double)count.QuadPart / frequency.QuadPart;
+#else
+  return SDL_GetTicks() / 1000.0;
+#endif
+}
+
+/*
+** Inputs are generated from a fixed seed so every run
+** and every machine benchmarks the same values.
+*/
+
+static uint32_t bench_seed = 0x9E3779B9;
+
+static float bench_rand(float lo, float hi) {
+  bench_seed ^= bench_seed << 13;
+  bench_seed ^= bench_seed >> 17;
+  bench_seed ^= bench_seed << 5;
+  return lo + (hi - lo) * ((bench_seed >> 8) / 16777216.0f);
+}
+
+static vec3 bench_rand_vec3(float lo, float hi) {
+  return vec3_new(bench_rand(lo, hi), bench_rand(lo, hi), bench_rand(lo, hi));
+}
+
+static quat bench_rand_quat(void) {
+  return quat_normalize(quat_new(
+    bench_rand(-1, 1), bench_rand(-1, 1),
+    bench_rand(-1, 1), bench_rand(-1, 1)));
+}
+
+static float     floats[BENCH_INPUTS];
+static vec3      vec3s[BENCH_INPUTS];
+static vec4      vec4s[BENCH_INPUTS];
+static quat      quats[BENCH_INPUTS];
+static mat3      mat3s[BENCH_INPUTS];
+static mat4      mat4s[BENCH_INPUTS];
+static plane     planes[BENCH_INPUTS];
+static sphere    spheres[BENCH_INPUTS];
+static box       boxes[BENCH_INPUTS];
+static frustum   frustums[BENCH_INPUTS];
+static ctri      ctris[BENCH_INPUTS];
+
+static mat4           views[BENCH_INPUTS];
+static mat4           projs[BENCH_INPUTS];
+static frustum_planes frustum_clips[BENCH_INPUTS];
+
+static vec3 velocities[BENCH_INPUTS];
+static vec3 points[BENCH_INPUTS];
+static cmesh* terrain_mesh;
+
+#define BENCH_DICT_SIZE 512
+
+static char dict_keys[BENCH_INPUTS][48];
+static dict* lookup_dict;
+
+/*
+** The chained dict which open addressing replaced, kept
+** to compare against. Each slot is a linked list of
+** buckets and the table never grows.
+*/
+
+typedef struct bench_bucket {
+  char* key;
+  void* item;
+  struct bench_bucket* next;
+} bench_bucket;
+
+typedef struct {
+  int size;
+  bench_bucket** buckets;
+} bench_chained;
+
+static bench_chained* lookup_chained;
+
+static int bench_chained_hash(const char* s, int size) {
+  uint32_t h = 0;
+  while (*s) { h = h * 101 + *s++; }
+  return (h & 0x7FFFFFFF) % size;
+}
+
+static bench_chained* bench_chained_new(int size) {
+  bench_chained* d = malloc(sizeof(bench_chained));
+  d->size = size;
+  d->buckets = calloc(size, sizeof(bench_bucket*));
+  return d;
+}
+
+static void bench_chained_delete(bench_chained* d) {
+  for (int i = 0; i < d->size; i++) {
+    bench_bucket* b = d->buckets[i];
+    while (b) {
+      bench_bucket* next = b->next;
+      free(b->key);
+      free(b);
+      b = next;
+    }
+  }
+  free(d->buckets);
+  free(d);
+}
+
+static void* bench_chained_get(bench_chained* d, char* key) {
+  bench_bucket* b = d->buckets[bench_chained_hash(key, d->size)];
+  while (b) {
+    if (strcmp(b->key, key) == 0) { return b->item; }
+    b = b->next;
+  }
+  return NULL;
+}
+
+static void bench_chained_set(bench_chained* d, char* key, void* item) {
+  bench_bucket** p = &d->buckets[bench_chained_hash(key, d->size)];
+  while (*p) {
+    if (strcmp((*p)->key, key) == 0) { (*p)->item = item; return; }
+    p = &(*p)->next;
+  }
+  bench_bucket* b = malloc(sizeof(bench_bucket));
+  b->key = malloc(strlen(key) + 1);
+  strcpy(b->key, key);
+  b->item = item;
+  b->next = NULL;
+  *p = b;
+}
+
+/* Results are stored so calls are not optimised away */
+static union {
+  char bytes[BENCH_INPUTS * 256];
+  vec4 align;
+} bench_out;
+
+/* A grid of triangles over uneven ground */
+static cmesh* bench_terrain(int size) {
+
+  int triangles_num = size * size * 2;
+  ctri* triangles = malloc(sizeof(ctri) * triangles_num);
+
+  for (int y = 0; y < size; y++)
+  for (int x = 0; x < size; x++) {
+    vec3 p[4];
+    for (int i = 0; i < 4; i++) {
+      float px = x + (i & 1) - size / 2;
+      float pz = y + (i >> 1) - size / 2;
+      p[i] = vec3_new(px, sinf(px * 0.3) * cosf(pz * 0.2) * 2, pz);
+    }
+    ctri* t = &triangles[(y * size + x) * 2];
+    t[0] = ctri_new(p[0], p[2], p[1], vec3_normalize(vec3_cross(vec3_sub(p[2], p[0]), vec3_sub(p[1], p[0]))));
+    t[1] = ctri_new(p[1], p[2], p[3], vec3_normalize(vec3_cross(vec3_sub(p[2], p[1]), vec3_sub(p[3], p[1]))));
+  }
+
+  return cmesh_new(triangles, triangles_num);
+}
+
+static void bench_inputs(void) {
+
+  for (int i = 0; i < BENCH_INPUTS; i++) {
+
+    floats[i] = bench_rand(0, 1);
+    vec3s[i] = bench_rand_vec3(-10, 10);
+    vec4s[i] = vec4_new(bench_rand(-10, 10), bench_rand(-10, 10), bench_rand(-10, 10), 1);
+    quats[i] = bench_rand_quat();
+
+    mat4s[i] = mat4_world(bench_rand_vec3(-10, 10), bench_rand_vec3(0.5, 2), quats[i]);
+    mat3s[i] = mat4_to_mat3(mat4s[i]);
+
+    planes[i] = plane_new(bench_rand_vec3(-10, 10), vec3_normalize(bench_rand_vec3(-1, 1)));
+    spheres[i] = sphere_new(bench_rand_vec3(-50, 50), bench_rand(0.5, 5));
+    velocities[i] = bench_rand_vec3(-5, 5);
+
+    vec3 a = bench_rand_vec3(-5, 5);
+    vec3 b = vec3_add(a, bench_rand_vec3(-3, 3));
+    vec3 c = vec3_add(a, bench_rand_vec3(-3, 3));
+    ctris[i] = ctri_new(a, b, c, vec3_normalize(vec3_cross(vec3_sub(b, a), vec3_sub(c, a))));
+
+    vec3 eye = bench_rand_vec3(-20, 20);
+    views[i] = mat4_view_look_at(eye, vec3_add(eye, bench_rand_vec3(-1, 1)), vec3_up());
+    projs[i] = mat4_perspective(bench_rand(0.4, 1.0), 0.1, bench_rand(100, 1000), bench_rand(0.5, 2));
+    frustums[i] = frustum_new_camera(views[i], projs[i]);
+    frustum_clips[i] = frustum_planes_new_camera(views[i], projs[i]);
+    boxes[i] = box_invert_depth(frustum_box(frustums[i]));
+  }
+
+  memcpy(points, vec3s, sizeof(vec3s));
+  terrain_mesh = bench_terrain(64);
+
+  /* Keys look like asset paths, sharing a long prefix */
+  lookup_dict = dict_new(BENCH_DICT_SIZE);
+  for (int i = 0; i < BENCH_INPUTS; i++) {
+    snprintf(dict_keys[i], sizeof(dict_keys[i]), "$CORANGE/assets/%06x_%04i.dds", (unsigned)(bench_rand(0, 1) * 0xFFFFFF), i);
+    dict_set(lookup_dict, dict_keys[i], dict_keys[i]);
+  }
+
+  lookup_chained = bench_chained_new(BENCH_DICT_SIZE);
+  for (int i = 0; i < BENCH_INPUTS; i++) {
+    bench_chained_set(lookup_chained, dict_keys[i], dict_keys[i]);
+  }
+
+}
+
+/*
+** Each benchmark makes n calls. The expression can use i
+** for the current input and k for the one after it.
+*/
+
+#define BENCH(name, type, expr) \
+  static void bench_##name(int n) { \
+    type* out = (type*)bench_out.bytes; \
+    for (int j = 0; j < n; j++) { \
+      int i = j & BENCH_MASK; \
+      int k = (j + 1) & BENCH_MASK; \
+      out[i] = expr; \
+    } \
+  }
+
+BENCH(vec3_add,         vec3,   vec3_add(vec3s[i], vec3s[k]))
+BENCH(vec3_dot,         float,  vec3_dot(vec3s[i], vec3s[k]))
+BENCH(vec3_cross,       vec3,   vec3_cross(vec3s[i], vec3s[k]))
+BENCH(vec3_length,      float,  vec3_length(vec3s[i]))
+BENCH(vec3_normalize,   vec3,   vec3_normalize(vec3s[i]))
+BENCH(vec3_lerp,        vec3,   vec3_lerp(vec3s[i], vec3s[k], floats[i]))
+BENCH(vec4_normalize,   vec4,   vec4_normalize(vec4s[i]))
+
+BENCH(quat_mul_quat,    quat,   quat_mul_quat(quats[i], quats[k]))
+BENCH(quat_mul_vec3,    vec3,   quat_mul_vec3(quats[i], vec3s[i]))
+BENCH(quat_inverse,     quat,   quat_inverse(quats[i]))
+BENCH(quat_normalize,   quat,   quat_normalize(quats[i]))
+BENCH(quat_slerp,       quat,   quat_slerp(quats[i], quats[k], floats[i]))
+BENCH(quat_to_euler,    vec3,   quat_to_euler(quats[i]))
+BENCH(quat_from_euler,  quat,   quat_from_euler(vec3s[i]))
+
+BENCH(mat3_mul_mat3,    mat3,   mat3_mul_mat3(mat3s[i], mat3s[k]))
+BENCH(mat3_mul_vec3,    vec3,   mat3_mul_vec3(mat3s[i], vec3s[i]))
+BENCH(mat3_transpose,   mat3,   mat3_transpose(mat3s[i]))
+BENCH(mat3_det,         float,  mat3_det(mat3s[i]))
+BENCH(mat3_inverse,     mat3,   mat3_inverse(mat3s[i]))
+
+BENCH(mat4_mul_mat4,    mat4,   mat4_mul_mat4(mat4s[i], mat4s[k]))
+BENCH(mat4_mul_vec4,    vec4,   mat4_mul_vec4(mat4s[i], vec4s[i]))
+BENCH(mat4_mul_vec3,    vec3,   mat4_mul_vec3(mat4s[i], vec3s[i]))
+BENCH(mat4_transpose,   mat4,   mat4_transpose(mat4s[i]))
+BENCH(mat4_det,         float,  mat4_det(mat4s[i]))
+BENCH(mat4_inverse,     mat4,   mat4_inverse(mat4s[i]))
+BENCH(mat4_rotation_quat, mat4, mat4_rotation_quat(quats[i]))
+BENCH(mat4_world,       mat4,   mat4_world(vec3s[i], vec3s[k], quats[i]))
+BENCH(mat4_view_look_at, mat4,  mat4_view_look_at(vec3s[i], vec3s[k], vec3_up()))
+BENCH(mat4_perspective, mat4,   mat4_perspective(floats[i], 0.1, 1000, floats[k] + 0.5))
+
+BENCH(plane_distance,   float,  plane_distance(planes[i], vec3s[i]))
+BENCH(plane_transform,  plane,  plane_transform(planes[i], mat4s[i], mat3s[i]))
+BENCH(box_transform,    box,    box_transform(boxes[i], mat4s[i], mat3s[i]))
+BENCH(point_inside_box, bool,   point_inside_box(vec3s[i], boxes[i]))
+
+BENCH(sphere_merge,     sphere, sphere_merge(spheres[i], spheres[k]))
+BENCH(sphere_transform, sphere, sphere_transform(spheres[i], mat4s[i]))
+BENCH(sphere_of_box,    sphere, sphere_of_box(boxes[i]))
+BENCH(sphere_outside_box, bool, sphere_outside_box(spheres[i], boxes[i]))
+BENCH(sphere_outside_frustum_planes, bool, sphere_outside_frustum_planes(spheres[i], frustum_clips[i]))
+BENCH(sphere_outside_sphere, bool, sphere_outside_sphere(spheres[i], spheres[k]))
+
+BENCH(frustum_new_camera, frustum, frustum_new_camera(views[i], projs[i]))
+BENCH(frustum_box,      box,    frustum_box(frustums[i]))
+BENCH(frustum_planes_new_camera, frustum_planes, frustum_planes_new_camera(views[i], projs[i]))
+
+BENCH(dict_get,         void*,  dict_get(lookup_dict, dict_keys[i]))
+BENCH(dict_get_chained, void*,  bench_chained_get(lookup_chained, dict_keys[i]))
+
+BENCH(point_collide_sphere,     collision, point_collide_sphere(vec3s[i], velocities[i], spheres[k]))
+BENCH(point_collide_ctri,       collision, point_collide_ctri(vec3s[i], velocities[i], ctris[k]))
+BENCH(sphere_collide_sphere,    collision, sphere_collide_sphere(spheres[i], velocities[i], spheres[k]))
+BENCH(sphere_collide_edge,      collision, sphere_collide_edge(sphere_new(vec3s[i], 1), velocities[i], ctris[k].a, ctris[k].b))
+BENCH(sphere_collide_ctri,      collision, sphere_collide_ctri(sphere_new(vec3s[i], 1), velocities[i], ctris[k]))
+
+BENCH(point_collide_mesh,       collision, point_collide_mesh(vec3_add(vec3s[i], vec3_new(0, 5, 0)), velocities[i], terrain_mesh, mat4_id(), mat3_id()))
+BENCH(sphere_collide_mesh,      collision, sphere_collide_mesh(sphere_new(vec3_add(vec3s[i], vec3_new(0, 5, 0)), 1), velocities[i], terrain_mesh, mat4_id(), mat3_id()))
+BENCH(ellipsoid_collide_mesh,   collision, ellipsoid_collide_mesh(ellipsoid_new(vec3_add(vec3s[i], vec3_new(0, 5, 0)), vec3_new(0.5, 1, 0.5)), velocities[i], terrain_mesh, mat4_id(), mat3_id()))
+
+/*
+** Batched calls are timed per element, the same as the
+** single versions above, over the whole input table.
+*/
+
+static int bench_block(int n, int j) {
+  return n - j < BENCH_INPUTS ? n - j : BENCH_INPUTS;
+}
+
+/*
+** Views are rigid so the points can be transformed in
+** place run after run without growing, and don't need
+** copying back from the inputs inside the timing.
+*/
+static void bench_mat4_mul_vec3_many(int n) {
+  for (int j = 0; j < n; j += BENCH_INPUTS) {
+    mat4_mul_vec3_many(views[(j / BENCH_INPUTS) & BENCH_MASK], points, bench_block(n, j), sizeof(vec3));
+  }
+}
+
+static void bench_sphere_visible_frustum_planes_many(int n) {
+  uint32_t* out = (uint32_t*)bench_out.bytes;
+  for (int j = 0; j < n; j += BENCH_INPUTS) {
+    sphere_visible_frustum_planes_many(spheres, bench_block(n, j), frustum_clips[(j / BENCH_INPUTS) & BENCH_MASK], out);
+  }
+}
+
+/* Filling a dict is timed per key, the table is created and deleted each block */
+static void bench_dict_set(int n) {
+  for (int j = 0; j < n; j += BENCH_INPUTS) {
+    dict* d = dict_new(BENCH_DICT_SIZE);
+    for (int i = 0; i < bench_block(n, j); i++) {
+      dict_set(d, dict_keys[i], dict_keys[i]);
+    }
+    dict_delete(d);
+  }
+}
+
+static void bench_dict_set_chained(int n) {
+  for (int j = 0; j < n; j += BENCH_INPUTS) {
+    bench_chained* d = bench_chained_new(BENCH_DICT_SIZE);
+    for (int i = 0; i < bench_block(n, j); i++) {
+      bench_chained_set(d, dict_keys[i], dict_keys[i]);
+    }
+    bench_chained_delete(d);
+  }
+}
+
+/*
+** Vertex tables are filled the way the smd loader fills
+** them, starting small and growing, with over a million
+** distinct verticies so they are much larger than cache.
+** Lookups are in a scattered order.
+*/
+
+#define BENCH_VERTICES (1 << 20)
+
+static vertex_hashtable* lookup_verticies;
+
+static vertex bench_vertex(int i) {
+  vertex v = vertex_new();
+  v.position = vec3_new(i & 1023, (i >> 10) & 1023, i >> 20);
+  v.normal = vec3_up();
+  v.uvs = vec2_new((i & 1023) / 1024.0, ((i >> 10) & 1023) / 1024.0);
+  return v;
+}
+
+static size_t bench_vertex_table(void) {
+  if (lookup_verticies) { return 0; }
+  lookup_verticies = vertex_hashtable_new(1024);
+  for (int i = 0; i < BENCH_VERTICES; i++) {
+    vertex_hashtable_set(lookup_verticies, bench_vertex(i), i);
+  }
+  return 0;
+}
+
+static void bench_vertex_hashtable_get_or_set(int n) {
+  for (int j = 0; j < n; j += BENCH_VERTICES) {
+    vertex_hashtable* ht = vertex_hashtable_new(1024);
+    int block = n - j < BENCH_VERTICES ? n - j : BENCH_VERTICES;
+    for (int i = 0; i < block; i++) {
+      vertex_hashtable_get_or_set(ht, bench_vertex(i), i);
+    }
+    vertex_hashtable_delete(ht);
+  }
+}
+
+static void bench_vertex_hashtable_get(int n) {
+  int* out = (int*)bench_out.bytes;
+  for (int j = 0; j < n; j++) {
+    int i = (j * 2654435761u) & (BENCH_VERTICES-1);
+    out[j & BENCH_MASK] = vertex_hashtable_get(lookup_verticies, bench_vertex(i));
+  }
+}
+
+/* Files */
+
+#define BENCH_GRID 192
+#define BENCH_OBJ_FILE "bench_mesh.obj"
+#define BENCH_PLY_ASCII "bench_mesh_ascii.ply"
+#define BENCH_PLY_BINARY "bench_mesh_binary.ply"
+
+static vec3 bench_grid_position(int x, int y) {
+  float px = x - BENCH_GRID / 2;
+  float pz = y - BENCH_GRID / 2;
+  return vec3_new(px, sinf(px * 0.3) * cosf(pz * 0.2) * 2, pz);
+}
+
+static vec3 bench_grid_normal(int x, int y) {
+  vec3 dx = vec3_sub(bench_grid_position(x+1, y), bench_grid_position(x-1, y));
+  vec3 dz = vec3_sub(bench_grid_position(x, y+1), bench_grid_position(x, y-1));
+  return vec3_normalize(vec3_cross(dz, dx));
+}
+
+static FILE* bench_file_open(const char* filename, const char* mode) {
+  FILE* f = fopen(filename, mode);
+  if (f == NULL) {
+    error("Cannot write benchmark file %s", filename);
+    exit(EXIT_FAILURE);
+  }
+  return f;
+}
+
+static size_t bench_file_size(const char* filename) {
+  int size = 0;
+  SDL_RWops* file = SDL_RWFromFile(filename, "rb");
+  SDL_RWsize(file, &size);
+  SDL_RWclose(file);
+  return size;
+}
+
+/* Triangles are wound the same as the terrain inputs */
+static size_t bench_obj_file(void) {
+
+  static size_t size = 0;
+  if (size) { return size; }
+
+  FILE* f = bench_file_open(BENCH_OBJ_FILE, "w");
+  int row = BENCH_GRID + 1;
+
+  for (int y = 0; y < row; y++)
+  for (int x = 0; x < row; x++) {
+    vec3 p = bench_grid_position(x, y);
+    fprintf(f, "v %f %f %f\n", p.x, p.y, p.z);
+  }
+
+  for (int y = 0; y < row; y++)
+  for (int x = 0; x < row; x++) {
+    fprintf(f, "vt %f %f\n", (float)x / BENCH_GRID, (float)y / BENCH_GRID);
+  }
+
+  for (int y = 0; y < row; y++)
+  for (int x = 0; x < row; x++) {
+    vec3 n = bench_grid_normal(x, y);
+    fprintf(f, "vn %f %f %f\n", n.x, n.y, n.z);
+  }
+
+  for (int y = 0; y < BENCH_GRID; y++)
+  for (int x = 0; x < BENCH_GRID; x++) {
+    int a = y * row + x + 1, b = a + 1, c = a + row, d = c + 1;
+    fprintf(f, "f %i/%i/%i %i/%i/%i %i/%i/%i\n", a, a, a, c, c, c, b, b, b);
+    fprintf(f, "f %i/%i/%i %i/%i/%i %i/%i/%i\n", b, b, b, c, c, c, d, d, d);
+  }
+
+  fclose(f);
+
+  size = bench_file_size(BENCH_OBJ_FILE);
+  return size;
+}
+
+static void bench_ply_header(FILE* f, const char* format) {
+  int row = BENCH_GRID + 1;
+  fprintf(f, "ply\nformat %s 1.0\n", format);
+  fprintf(f, "element vertex %i\n", row * row);
+  fprintf(f, "property float x\nproperty float y\nproperty float z\n");
+  fprintf(f, "property float nx\nproperty float ny\nproperty float nz\n");
+  fprintf(f, "element face %i\n", BENCH_GRID * BENCH_GRID * 2);
+  fprintf(f, "property list uchar int vertex_indices\nend_header\n");
+}
+
+static size_t bench_ply_ascii_file(void) {
+
+  static size_t size = 0;
+  if (size) { return size; }
+
+  FILE* f = bench_file_open(BENCH_PLY_ASCII, "w");
+  bench_ply_header(f, "ascii");
+  int row = BENCH_GRID + 1;
+
+  for (int y = 0; y < row; y++)
+  for (int x = 0; x < row; x++) {
+    vec3 p = bench_grid_position(x, y);
+    vec3 n = bench_grid_normal(x, y);
+    fprintf(f, "%f %f %f %f %f %f\n", p.x, p.y, p.z, n.x, n.y, n.z);
+  }
+
+  for (int y = 0; y < BENCH_GRID; y++)
+  for (int x = 0; x < BENCH_GRID; x++) {
+    int a = y * row + x, b = a + 1, c = a + row, d = c + 1;
+    fprintf(f, "3 %i %i %i\n3 %i %i %i\n", a, c, b, b, c, d);
+  }
+
+  fclose(f);
+
+  size = bench_file_size(BENCH_PLY_ASCII);
+  return size;
+}
+
+/* Written in the native order, which the header declares */
+static size_t bench_ply_binary_file(void) {
+
+  static size_t size = 0;
+  if (size) { return size; }
+
+  FILE* f = bench_file_open(BENCH_PLY_BINARY, "wb");
+  bench_ply_header(f, SDL_BYTEORDER == SDL_LIL_ENDIAN ? "binary_little_endian" : "binary_big_endian");
+  int row = BENCH_GRID + 1;
+
+  for (int y = 0; y < row; y++)
+  for (int x = 0; x < row; x++) {
+    vec3 p = bench_grid_position(x, y);
+    vec3 n = bench_grid_normal(x, y);
+    float v[6] = { p.x, p.y, p.z, n.x, n.y, n.z };
+    fwrite(v, sizeof(float), 6, f);
+  }
+
+  for (int y = 0; y < BENCH_GRID; y++)
+  for (int x = 0; x < BENCH_GRID; x++) {
+    int a = y * row + x, b = a + 1, c = a + row, d = c + 1;
+    int32_t faces[2][3] = { { a, c, b }, { b, c, d } };
+    for (int i = 0; i < 2; i++) {
+      fputc(3, f);
+      fwrite(faces[i], sizeof(int32_t), 3, f);
+    }
+  }
+
+  fclose(f);
+
+  size = bench_file_size(BENCH_PLY_BINARY);
+  return size;
+}
+
+static void bench_file_lines(SDL_RWops* file) {
+  char line[1024];
+  while (SDL_RWreadline(file, line, sizeof(line)) > 0) {}
+  SDL_RWclose(file);
+}
+
+/* Text assets used to be read a character at a time */
+static void bench_obj_lines_unbuffered(int n) {
+  for (int j = 0; j < n; j++) {
+    bench_file_lines(SDL_RWFromFile(BENCH_OBJ_FILE, "r"));
+  }
+}
+
+static void bench_obj_lines_buffered(int n) {
+  for (int j = 0; j < n; j++) {
+    bench_file_lines(SDL_RWFromFileBuffered(BENCH_OBJ_FILE, "r"));
+  }
+}
+
+/* Parsing, welding, tangents and vertex cache optimisation */
+static void bench_obj_read_file(int n) {
+  for (int j = 0; j < n; j++) {
+    model_delete(obj_read_file(BENCH_OBJ_FILE));
+  }
+}
+
+/*
+** Loading includes the same tangents, optimisation and
+** bmf cache write for both formats. Run as a server so
+** that nothing is uploaded.
+*/
+static void bench_ply_ascii_load_file(int n) {
+  for (int j = 0; j < n; j++) {
+    renderable_delete(ply_load_file(BENCH_PLY_ASCII));
+  }
+}
+
+static void bench_ply_binary_load_file(int n) {
+  for (int j = 0; j < n; j++) {
+    renderable_delete(ply_load_file(BENCH_PLY_BINARY));
+  }
+}
+
+static void bench_files_delete(void) {
+  remove(BENCH_OBJ_FILE);
+  remove(BENCH_PLY_ASCII);
+  remove(BENCH_PLY_BINARY);
+  remove("bench_mesh_ascii.bmf");
+  remove("bench_mesh_binary.bmf");
+}
+
+/*
+** The setup function prepares inputs before the first
+** trial and returns how many bytes each call processes,
+** or zero if the benchmark is not measured in bytes.
+** Calls are always a multiple of the block size.
+*/
+
+typedef struct {
+  const char* group;
+  const char* name;
+  void (*func)(int n);
+  size_t (*setup)(void);
+  size_t bytes;
+  int block;
+  int calls;
+  double min;
+  double median;
+} bench;
+
+#define B(group, name) { group, #name, bench_##name, NULL, 0, 1, 0, 0, 0 }
+#define BF(group, name, setup) { group, #name, bench_##name, setup, 0, 1, 0, 0, 0 }
+#define BB(group, name, setup, block) { group, #name, bench_##name, setup, 0, block, 0, 0, 0 }
+
+static bench benches[] = {
+  B("vec", vec3_add),
+  B("vec", vec3_dot),
+  B("vec", vec3_cross),
+  B("vec", vec3_length),
+  B("vec", vec3_normalize),
+  B("vec", vec3_lerp),
+  B("vec", vec4_normalize),
+  B("quat", quat_mul_quat),
+  B("quat", quat_mul_vec3),
+  B("quat", quat_inverse),
+  B("quat", quat_normalize),
+  B("quat", quat_slerp),
+  B("quat", quat_to_euler),
+  B("quat", quat_from_euler),
+  B("mat", mat3_mul_mat3),
+  B("mat", mat3_mul_vec3),
+  B("mat", mat3_transpose),
+  B("mat", mat3_det),
+  B("mat", mat3_inverse),
+  B("mat", mat4_mul_mat4),
+  B("mat", mat4_mul_vec4),
+  B("mat", mat4_mul_vec3),
+  B("mat", mat4_mul_vec3_many),
+  B("mat", mat4_transpose),
+  B("mat", mat4_det),
+  B("mat", mat4_inverse),
+  B("mat", mat4_rotation_quat),
+  B("mat", mat4_world),
+  B("mat", mat4_view_look_at),
+  B("mat", mat4_perspective),
+  B("plane", plane_distance),
+  B("plane", plane_transform),
+  B("box", box_transform),
+  B("box", point_inside_box),
+  B("sphere", sphere_merge),
+  B("sphere", sphere_transform),
+  B("sphere", sphere_of_box),
+  B("sphere", sphere_outside_box),
+  B("sphere", sphere_outside_frustum_planes),
+  B("sphere", sphere_visible_frustum_planes_many),
+  B("sphere", sphere_outside_sphere),
+  B("frustum", frustum_new_camera),
+  B("frustum", frustum_box),
+  B("frustum", frustum_planes_new_camera),
+  B("collide", point_collide_sphere),
+  B("collide", point_collide_ctri),
+  B("collide", sphere_collide_sphere),
+  B("collide", sphere_collide_edge),
+  B("collide", sphere_collide_ctri),
+  B("collide", point_collide_mesh),
+  B("collide", sphere_collide_mesh),
+  B("collide", ellipsoid_collide_mesh),
+  B("dict", dict_get),
+  B("dict", dict_get_chained),
+  B("dict", dict_set),
+  B("dict", dict_set_chained),
+  BB("vertex", vertex_hashtable_get_or_set, NULL, BENCH_VERTICES),
+  BB("vertex", vertex_hashtable_get, bench_vertex_table, BENCH_VERTICES),
+  BF("file", obj_lines_unbuffered, bench_obj_file),
+  BF("file", obj_lines_buffered, bench_obj_file),
+  BF("file", obj_read_file, bench_obj_file),
+  BF("file", ply_ascii_load_file, bench_ply_ascii_file),
+  BF("file", ply_binary_load_file, bench_ply_binary_file),
+};
+
+static int bench_compare(const void* a, const void* b) {
+  double ta = *(const double*)a;
+  double tb = *(const double*)b;
+  return (ta > tb) - (ta < tb);
+}
+
+static double bench_trial(bench* b) {
+  double start = bench_clock();
+  b->func(b->calls);
+  return bench_clock() - start;
+}
+
+static void bench_run(bench* b, int trials, int warmup) {
+
+  if (b->setup) { b->bytes = b->setup(); }
+
+  /* Double the calls until a trial is long enough */
+  b->calls = b->block;
+  while (bench_trial(b) < BENCH_TRIAL_TIME && b->calls < (1 << 28)) {
+    b->calls *= 2;
+  }
+
+  for (int i = 0; i < warmup; i++) { bench_trial(b); }
+
+  double times[BENCH_MAX];
+  for (int i = 0; i < trials; i++) {
+    times[i] = bench_trial(b) * 1e9 / b->calls;
+  }
+
+  qsort(times, trials, sizeof(double), bench_compare);
+  b->min = times[0];
+  b->median = (trials % 2) ? times[trials/2] : (times[trials/2-1] + times[trials/2]) / 2;
+}
+
+static double bench_throughput(bench* b) {
+  return b->bytes * 1e3 / b->median;
+}
+
+static void bench_report_write(SDL_RWops* file, const char* fmt, ...) {
+  char line[1024];
+  va_list args;
+  va_start(args, fmt);
+  vsnprintf(line, sizeof(line), fmt, args);
+  va_end(args);
+  SDL_RWwrite(file, line, strlen(line), 1);
+}
+
+static void bench_report(char* filename, bench** run, int num_run, char* label, int trials, int warmup) {
+
+  fpath ext;
+  SDL_PathFileExtension(ext.ptr, filename);
+  bool json = (strcmp(ext.ptr, "json") == 0);
+
+  SDL_RWops* file = SDL_RWFromFile(filename, "w");
+  if (file == NULL) {
+    error("Cannot write results to %s", filename);
+    return;
+  }
+
+  if (json) {
+
+    bench_report_write(file, "{\n  \"label\": \"%s\",\n  \"trials\": %i,\n  \"warmup\": %i,\n  \"benchmarks\": [\n",
+      label, trials, warmup);
+
+    for (int i = 0; i < num_run; i++) {
+      bench_report_write(file,
+        "    { \"group\": \"%s\", \"name\": \"%s\", \"calls\": %i, \"min_ns\": %.3f, \"median_ns\": %.3f",
+        run[i]->group, run[i]->name, run[i]->calls, run[i]->min, run[i]->median);
+      if (run[i]->bytes) {
+        bench_report_write(file, ", \"mb_per_s\": %.3f", bench_throughput(run[i]));
+      }
+      bench_report_write(file, " }%s\n", i == num_run-1 ? "" : ",");
+    }
+
+    bench_report_write(file, "  ]\n}\n");
+
+  } else {
+
+    bench_report_write(file, "label,group,name,calls,min_ns,median_ns,mb_per_s\n");
+
+    for (int i = 0; i < num_run; i++) {
+      bench_report_write(file, "%s,%s,%s,%i,%.3f,%.3f,",
+        label, run[i]->group, run[i]->name, run[i]->calls, run[i]->min, run[i]->median);
+      if (run[i]->bytes) {
+        bench_report_write(file, "%.3f", bench_throughput(run[i]));
+      }
+      bench_report_write(file, "\n");
+    }
+  }
+
+  SDL_RWclose(file);
+}
+
+static bool bench_matches(bench* b, char** filters, int num_filters) {
+  if (num_filters == 0) { return true; }
+  for (int i = 0; i < num_filters; i++) {
+    if (strstr(b->name, filters[i]) || strcmp(b->group, filters[i]) == 0) { return true; }
+  }
+  return false;
+}
+
+static void bench_usage(void) {
+  printf("Usage: bench [-t trials] [-w warmup] [-l label] [-o results.csv|results.json] [filter...]\n");
+}
+
+int main(int argc, char **argv) {
+
+  int trials = 15;
+  int warmup = 3;
+  char* label = "";
+  char* output = NULL;
+
+  int num_filters = 0;
+  char** filters = malloc(sizeof(char*) * argc);
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-t") == 0 && i+1 < argc) {
+      trials = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-w") == 0 && i+1 < argc) {
+      warmup = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-l") == 0 && i+1 < argc) {
+      label = argv[++i];
+    } else if (strcmp(argv[i], "-o") == 0 && i+1 < argc) {
+      output = argv[++i];
+    } else if (argv[i][0] == '-') {
+      bench_usage();
+      return EXIT_FAILURE;
+    } else {
+      filters[num_filters++] = argv[i];
+    }
+  }
+
+  trials = clamp(trials, 1, BENCH_MAX);
+  warmup = max(warmup, 0);
+
+  asset_init();
+  net_set_server(true);
+  bench_inputs();
+
+  int num_benches = sizeof(benches) / sizeof(bench);
+  int num_run = 0;
+  bench** run = malloc(sizeof(bench*) * num_benches);
+
+  printf("%-8s %-36s %12s %12s %10s\n", "group", "name", "min ns", "median ns", "MB/s");
+
+  for (int i = 0; i < num_benches; i++) {
+    if (!bench_matches(&benches[i], filters, num_filters)) { continue; }
+    bench_run(&benches[i], trials, warmup);
+    printf("%-8s %-36s %12.3f %12.3f", benches[i].group, benches[i].name, benches[i].min, benches[i].median);
+    if (benches[i].bytes) { printf(" %10.1f", bench_throughput(&benches[i])); }
+    printf("\n");
+    fflush(stdout);
+    run[num_run++] = &benches[i];
+  }
+
+  if (output) { bench_report(output, run, num_run, label, trials, warmup); }
+
+  bench_files_delete();
+  cmesh_delete(terrain_mesh);
+  dict_delete(lookup_dict);
+  if (lookup_verticies) { vertex_hashtable_delete(lookup_verticies); }
+  asset_finish();
+  bench_chained_delete(lookup_chained);
+  free(run);
+  free(filters);
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,27 @@
+/**
+*** :: Check ::
+***
+***   Shared by the check programs. A fixed seed xorshift
+***   so every run checks the same cases on every platform.
+***
+**/
+
+#ifndef check_h
+#define check_h
+
+#include "cengine.h"
+
+static uint32_t check_seed = 0x9E3779B9;
+
+static float check_rand(float lo, float hi) {
+  check_seed ^= check_seed << 13;
+  check_seed ^= check_seed >> 17;
+  check_seed ^= check_seed << 5;
+  return lo + (hi - lo) * ((check_seed >> 8) / 16777216.0f);
+}
+
+static vec3 check_rand_vec3(float lo, float hi) {
+  return vec3_new(check_rand(lo, hi), check_rand(lo, hi), check_rand(lo, hi));
+}
+
+#endif
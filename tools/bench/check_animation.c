@@ -0,0 +1,208 @@
+/**
+*** :: Check Animation ::
+***
+***   Compresses animations, saves and loads them as bani
+***   and compares them against the source frames. Every
+***   joint must be within the compression error of the
+***   source, which is per joint so it is checked in the
+***   joint's own space rather than along the chain.
+***
+***   Also checks that the compressed animation is smaller
+***   and that bani files with bad joint parents or frame
+***   times are rejected.
+***
+***   check_animation [file.ani ...]
+***
+**/
+
+#include "corange.h"
+#include "check.h"
+
+#define CHECK_JOINTS 12
+#define CHECK_FRAMES 240
+#define CHECK_SLACK 1.01
+#define CHECK_FILE "check_animation.bani"
+
+/*
+** A branching skeleton moving along smooth curves with
+** some joints held still for stretches, so that there
+** are keys to drop and keys which must be kept.
+*/
+
+static animation* check_synthetic(void) {
+
+  check_seed = 0x9E3779B9;
+
+  frame* base = frame_new();
+  for (int i = 0; i < CHECK_JOINTS; i++) {
+    int parent = i == 0 ? -1 : (int)check_rand(0, i);
+    frame_joint_add(base, parent, vec3_new(check_rand(-1, 1), check_rand(0, 2), check_rand(-1, 1)), quat_id());
+  }
+
+  float speeds[CHECK_JOINTS], phases[CHECK_JOINTS];
+  for (int i = 0; i < CHECK_JOINTS; i++) {
+    speeds[i] = check_rand(0.5, 4);
+    phases[i] = check_rand(0, 6.28);
+  }
+
+  animation* a = animation_new();
+  a->frame_time = 1.0 / 30.0;
+
+  for (int f = 0; f < CHECK_FRAMES; f++) {
+    float t = f * a->frame_time;
+    frame* out = animation_add_frame(a, base);
+    for (int i = 0; i < CHECK_JOINTS; i++) {
+      float s = (f / 40) % 2 == 0 || i % 3 == 0 ? sinf(speeds[i] * t + phases[i]) : 0;
+      out->joint_positions[i] = vec3_add(base->joint_positions[i], vec3_new(0.5 * s, 0.1 * s * s, 0.25 * cosf(t)));
+      out->joint_rotations[i] = quat_from_euler(vec3_new(s, 0.5 * sinf(2 * t + phases[i]), 0.3 * s));
+    }
+  }
+
+  frame_delete(base);
+
+  return a;
+}
+
+static float check_rotation_error(quat q, quat r) {
+  if (quat_dot(q, r) < 0) { q = quat_neg(q); }
+  return 4 * asinf(min(vec4_length(vec4_sub(q, r)) / 2, 1));
+}
+
+/* Samples on and between frames, over the whole duration */
+static void check_errors(animation* source, animation* compressed, float* position_error, float* rotation_error) {
+
+  frame* f0 = animation_sample(source, 0);
+  frame* f1 = animation_sample(compressed, 0);
+
+  *position_error = 0;
+  *rotation_error = 0;
+
+  for (int i = 0; i < 2 * (source->frame_count-1); i++) {
+    float time = i * 0.5 * source->frame_time;
+    animation_sample_to(source, time, f0);
+    animation_sample_to(compressed, time, f1);
+    for (int j = 0; j < f0->joint_count; j++) {
+      *position_error = max(*position_error, vec3_dist(f0->joint_positions[j], f1->joint_positions[j]));
+      *rotation_error = max(*rotation_error, check_rotation_error(
+        quat_normalize(f0->joint_rotations[j]), quat_normalize(f1->joint_rotations[j])));
+    }
+  }
+
+  frame_delete(f0);
+  frame_delete(f1);
+}
+
+static int check_animation(char* name, animation* source, animation* compressed) {
+
+  size_t source_size = animation_size(source);
+  animation_compress(compressed, ANIMATION_POSITION_ERROR, ANIMATION_ROTATION_ERROR);
+  bani_save_file(compressed, CHECK_FILE);
+
+  animation* loaded = bani_load_file(CHECK_FILE);
+  if (loaded == NULL) {
+    printf("%s: could not load the saved bani file\n", name);
+    animation_delete(compressed);
+    return 1;
+  }
+
+  size_t compressed_size = animation_size(loaded);
+
+  float position_error, rotation_error;
+  check_errors(source, loaded, &position_error, &rotation_error);
+
+  printf("check_animation: %s, %i frames, %i joints, position error %g, rotation error %g, %i to %i bytes\n",
+    name, source->frame_count, loaded->joint_count, position_error, rotation_error,
+    (int)source_size, (int)compressed_size);
+
+  int failures = 0;
+
+  if (position_error > ANIMATION_POSITION_ERROR * CHECK_SLACK) {
+    printf("%s: position error %g is over %g\n", name, position_error, ANIMATION_POSITION_ERROR);
+    failures++;
+  }
+
+  if (rotation_error > ANIMATION_ROTATION_ERROR * CHECK_SLACK) {
+    printf("%s: rotation error %g is over %g\n", name, rotation_error, ANIMATION_ROTATION_ERROR);
+    failures++;
+  }
+
+  if (compressed_size >= source_size) {
+    printf("%s: compressed size %i is not smaller than %i\n", name, (int)compressed_size, (int)source_size);
+    failures++;
+  }
+
+  animation_delete(loaded);
+  animation_delete(compressed);
+
+  return failures;
+}
+
+/* Overwrites part of the saved file and expects loading it to fail */
+static int check_rejected(char* name, long offset, void* data, size_t size) {
+
+  FILE* f = fopen(CHECK_FILE, "r+b");
+  if (f == NULL) { printf("Could not open %s\n", CHECK_FILE); return 1; }
+  fseek(f, offset, SEEK_SET);
+  fwrite(data, size, 1, f);
+  fclose(f);
+
+  animation* a = bani_load_file(CHECK_FILE);
+  if (a == NULL) { return 0; }
+
+  printf("bani file with %s was loaded\n", name);
+  animation_delete(a);
+  return 1;
+}
+
+/* Header is magic, version, frame count, frame time and joint count */
+#define CHECK_FRAME_TIME_OFFSET (3 + 2 * sizeof(uint32_t))
+#define CHECK_PARENTS_OFFSET (3 + 3 * sizeof(uint32_t) + sizeof(float))
+
+static int check_malformed(void) {
+
+  int failures = 0;
+  float frame_times[] = { 0, -1, NAN };
+  int32_t parents[] = { -2, CHECK_JOINTS, 0x7FFFFFFF };
+
+  for (int i = 0; i < 3; i++) {
+    animation* a = check_synthetic();
+    animation_compress(a, ANIMATION_POSITION_ERROR, ANIMATION_ROTATION_ERROR);
+    bani_save_file(a, CHECK_FILE);
+    animation_delete(a);
+    failures += check_rejected("a bad frame time", CHECK_FRAME_TIME_OFFSET, &frame_times[i], sizeof(float));
+  }
+
+  for (int i = 0; i < 3; i++) {
+    animation* a = check_synthetic();
+    animation_compress(a, ANIMATION_POSITION_ERROR, ANIMATION_ROTATION_ERROR);
+    bani_save_file(a, CHECK_FILE);
+    animation_delete(a);
+    long offset = CHECK_PARENTS_OFFSET + sizeof(int32_t) * (CHECK_JOINTS-1);
+    failures += check_rejected("a bad joint parent", offset, &parents[i], sizeof(int32_t));
+  }
+
+  return failures;
+}
+
+int main(int argc, char** argv) {
+
+  int failures = 0;
+
+  animation* source = check_synthetic();
+  failures += check_animation("synthetic", source, check_synthetic());
+  animation_delete(source);
+
+  for (int i = 1; i < argc; i++) {
+    animation* source = ani_load_file(argv[i]);
+    failures += check_animation(argv[i], source, ani_load_file(argv[i]));
+    animation_delete(source);
+  }
+
+  failures += check_malformed();
+
+  remove(CHECK_FILE);
+
+  printf("check_animation: %i failures\n", failures);
+
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,183 @@
+/**
+*** :: Check Async ::
+***
+***   Queues assets with file_load_async using a handler
+***   whose read stage takes longer for earlier files, so
+***   the workers finish reading out of order. Uploads must
+***   still happen in the order the files were queued, on
+***   the main thread, and only inside asset_async_update.
+***
+***   Uploads take a fixed time, so each update can be
+***   checked against its budget by how many it uploads.
+***
+***   check_async
+***
+**/
+
+#include "corange.h"
+
+#define CHECK_JOBS 64
+#define CHECK_BUDGET 4
+#define CHECK_UPLOAD 2
+
+typedef struct {
+  int index;
+} check_asset;
+
+static Uint32 check_main_thread;
+static bool check_updating = false;
+
+static SDL_mutex* check_reads_lock;
+static int check_reads[CHECK_JOBS];
+static int check_num_reads = 0;
+
+static int check_uploads[CHECK_JOBS];
+static int check_num_uploads = 0;
+static int check_off_main = 0;
+static int check_outside_update = 0;
+
+static int check_index(const char* filename) {
+  return atoi(strrchr(filename, '/') + 1);
+}
+
+/* Every group of four reads finishes backwards */
+static check_asset* check_read(const char* filename) {
+
+  int index = check_index(filename);
+  SDL_Delay(2 * (3 - index % 4));
+
+  SDL_LockMutex(check_reads_lock);
+  check_reads[check_num_reads++] = index;
+  SDL_UnlockMutex(check_reads_lock);
+
+  check_asset* a = malloc(sizeof(check_asset));
+  a->index = index;
+  return a;
+}
+
+static check_asset* check_upload(const char* filename, check_asset* a) {
+
+  if (SDL_ThreadID() != check_main_thread) { check_off_main++; }
+  if (!check_updating) { check_outside_update++; }
+
+  SDL_Delay(CHECK_UPLOAD);
+  check_uploads[check_num_uploads++] = a->index;
+  return a;
+}
+
+static void check_delete(check_asset* a) {
+  free(a);
+}
+
+static int check_read_order(void) {
+
+  int out_of_order = 0;
+  for(int i = 1; i < check_num_reads; i++) {
+    out_of_order += check_reads[i] < check_reads[i-1];
+  }
+
+  printf("check_async: %i reads, %i out of order\n", check_num_reads, out_of_order);
+
+  if (out_of_order == 0) {
+    printf("check_async: reads finished in order so upload order is untested\n");
+    return 1;
+  }
+
+  return 0;
+}
+
+static int check_upload_order(void) {
+
+  int failures = 0;
+
+  if (check_num_uploads != CHECK_JOBS) {
+    printf("check_async: %i of %i assets uploaded\n", check_num_uploads, CHECK_JOBS);
+    failures++;
+  }
+
+  for(int i = 0; i < check_num_uploads; i++) {
+    if (check_uploads[i] != i) {
+      printf("check_async: upload %i was asset %i\n", i, check_uploads[i]);
+      failures++;
+      break;
+    }
+  }
+
+  if (check_off_main) {
+    printf("check_async: %i uploads off the main thread\n", check_off_main);
+    failures++;
+  }
+
+  if (check_outside_update) {
+    printf("check_async: %i uploads outside asset_async_update\n", check_outside_update);
+    failures++;
+  }
+
+  for(int i = 0; i < CHECK_JOBS; i++) {
+    char path[64];
+    snprintf(path, sizeof(path), "./check_async/%i.chk", i);
+    if (!file_isloaded(P(path))) {
+      printf("check_async: '%s' not loaded\n", path);
+      failures++;
+    }
+  }
+
+  return failures;
+}
+
+int main(int argc, char** argv) {
+
+  SDL_Init(SDL_INIT_TIMER);
+  asset_init();
+  asset_handler_async(check_asset, "chk", check_read, check_upload, check_delete);
+
+  check_main_thread = SDL_ThreadID();
+  check_reads_lock = SDL_CreateMutex();
+
+  for(int i = 0; i < CHECK_JOBS; i++) {
+    char path[64];
+    snprintf(path, sizeof(path), "./check_async/%i.chk", i);
+    file_load_async(P(path));
+  }
+
+  /*
+  ** Each upload takes at least CHECK_UPLOAD ms and an
+  ** update stops once it has spent its budget, so it
+  ** can upload at most one more than fits in it.
+  */
+  int failures = 0;
+  int updates = 0;
+  int most = 0;
+
+  while (asset_async_pending()) {
+
+    int before = check_num_uploads;
+    check_updating = true;
+    asset_async_update(CHECK_BUDGET);
+    check_updating = false;
+
+    int uploaded = check_num_uploads - before;
+    if (uploaded > most) { most = uploaded; }
+    updates++;
+
+    if (uploaded > CHECK_BUDGET / CHECK_UPLOAD + 1) {
+      printf("check_async: update %i uploaded %i assets in a %i ms budget\n", updates, uploaded, CHECK_BUDGET);
+      failures++;
+    }
+
+    SDL_Delay(1);
+  }
+
+  printf("check_async: %i uploads over %i updates, at most %i per update\n", check_num_uploads, updates, most);
+
+  failures += check_read_order();
+  failures += check_upload_order();
+
+  asset_finish();
+  SDL_DestroyMutex(check_reads_lock);
+  SDL_Quit();
+
+  printf("check_async: %i failures\n", failures);
+
+  return failures != 0;
+}
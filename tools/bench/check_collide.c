@@ -0,0 +1,294 @@
+/**
+*** :: Check Collide ::
+***
+***   Compares the mesh sweeps in cphysics, which move the
+***   query into mesh space, against a reference which
+***   moves every triangle out into world space and tests
+***   all of them, like the sweeps used to.
+***
+***   Points, spheres and ellipsoids are swept against a
+***   terrain and a sphere mesh under rotated worlds with
+***   uneven scale, where spheres fall back to moving the
+***   triangles, and with even scale, where they don't.
+***
+***   Hits must agree and times must match. Normals must
+***   match one of the reference contacts at that time,
+***   as ties between triangles can be won by either.
+***   Whether a point sweeping over an edge touches it is
+***   down to rounding, so for points only contacts with
+***   faces have to agree.
+***
+**/
+
+#include "corange.h"
+#include "check.h"
+
+#define CHECK_QUERIES 1500
+#define CHECK_TIME 1e-4
+#define CHECK_NORMAL 0.999
+
+enum {
+  CHECK_POINT     = 0,
+  CHECK_SPHERE    = 1,
+  CHECK_ELLIPSOID = 2,
+};
+
+static char* check_kinds[] = { "point", "sphere", "ellipsoid" };
+
+/* Meshes */
+
+static ctri check_ctri(vec3 a, vec3 b, vec3 c) {
+  return ctri_new(a, b, c, vec3_normalize(vec3_cross(vec3_sub(b, a), vec3_sub(c, a))));
+}
+
+static cmesh* check_terrain(int size) {
+
+  int triangles_num = size * size * 2;
+  ctri* triangles = malloc(sizeof(ctri) * triangles_num);
+
+  for (int y = 0; y < size; y++)
+  for (int x = 0; x < size; x++) {
+    vec3 p[4];
+    for (int i = 0; i < 4; i++) {
+      float px = x + (i & 1) - size / 2;
+      float pz = y + (i >> 1) - size / 2;
+      p[i] = vec3_new(px, sinf(px * 0.3) * cosf(pz * 0.2) * 2, pz);
+    }
+    ctri* t = &triangles[(y * size + x) * 2];
+    t[0] = check_ctri(p[0], p[2], p[1]);
+    t[1] = check_ctri(p[1], p[2], p[3]);
+  }
+
+  return cmesh_new(triangles, triangles_num);
+}
+
+static vec3 check_sphere_point(int i, int j, int rings, int segments, float radius) {
+  float theta = M_PI * i / rings;
+  float phi = 2 * M_PI * j / segments;
+  return vec3_new(radius * sinf(theta) * cosf(phi), radius * cosf(theta), radius * sinf(theta) * sinf(phi));
+}
+
+static cmesh* check_sphere(int rings, int segments, float radius) {
+
+  int triangles_num = 0;
+  ctri* triangles = malloc(sizeof(ctri) * rings * segments * 2);
+
+  for (int i = 0; i < rings; i++)
+  for (int j = 0; j < segments; j++) {
+    vec3 p00 = check_sphere_point(i,   j,   rings, segments, radius);
+    vec3 p01 = check_sphere_point(i,   j+1, rings, segments, radius);
+    vec3 p10 = check_sphere_point(i+1, j,   rings, segments, radius);
+    vec3 p11 = check_sphere_point(i+1, j+1, rings, segments, radius);
+    if (i != 0)       { triangles[triangles_num++] = check_ctri(p00, p01, p10); }
+    if (i != rings-1) { triangles[triangles_num++] = check_ctri(p01, p11, p10); }
+  }
+
+  return cmesh_new(triangles, triangles_num);
+}
+
+/*
+** The reference moves every triangle into query space
+** and records each of its contacts, with the normal
+** moved back out and whether it was with a face.
+*/
+
+typedef struct {
+  float time;
+  vec3 norm;
+  bool face;
+} check_contact;
+
+typedef struct {
+  int contacts_num;
+  int contacts_max;
+  check_contact* contacts;
+  float time;
+} check_reference;
+
+static void check_reference_add(check_reference* r, collision c, bool face, mat3 space) {
+  if (!c.collided) { return; }
+  if (r->contacts_num == r->contacts_max) {
+    r->contacts_max = r->contacts_max == 0 ? 64 : r->contacts_max * 2;
+    r->contacts = realloc(r->contacts, sizeof(check_contact) * r->contacts_max);
+  }
+  check_contact* cc = &r->contacts[r->contacts_num++];
+  cc->time = c.time;
+  cc->norm = vec3_normalize(mat3_mul_vec3(space, c.norm));
+  cc->face = face;
+  r->time = min(r->time, c.time);
+}
+
+static void check_reference_sweep(check_reference* r, int kind, cmesh* cm, mat4 world, mat3 world_normal, sphere s, vec3 radiuses, vec3 v) {
+
+  r->contacts_num = 0;
+  r->time = FLT_MAX;
+
+  /* Ellipsoids are swept as a unit sphere in a space scaled by their radiuses */
+  vec3 offset = kind == CHECK_ELLIPSOID ? s.center : vec3_zero();
+  mat3 space = kind == CHECK_ELLIPSOID ? mat3_scale(vec3_div_vec3(vec3_one(), radiuses)) : mat3_id();
+  mat3 space_inv = kind == CHECK_ELLIPSOID ? mat3_scale(radiuses) : mat3_id();
+  mat3 space_normal = mat3_transpose(space_inv);
+
+  if (kind == CHECK_ELLIPSOID) {
+    s = sphere_unit();
+    v = mat3_mul_vec3(space, v);
+  }
+
+  for (int i = 0; i < cm->triangles_num; i++) {
+
+    ctri t = ctri_transform(cm->triangles[i], world, world_normal);
+    t.a = vec3_sub(t.a, offset);
+    t.b = vec3_sub(t.b, offset);
+    t.c = vec3_sub(t.c, offset);
+    t = ctri_transform_space(t, space, space_normal);
+
+    /* Like the ctri sweeps, edges and vertices only count if the face is missed */
+    if (kind == CHECK_POINT) {
+      if (!point_swept_intersects_plane(s.center, v, plane_new(t.a, t.norm))) { continue; }
+      collision face = point_collide_face(s.center, v, t);
+      check_reference_add(r, face, true, space);
+      if (face.collided) { continue; }
+      check_reference_add(r, point_collide_edge(s.center, v, t.a, t.b), false, space);
+      check_reference_add(r, point_collide_edge(s.center, v, t.b, t.c), false, space);
+      check_reference_add(r, point_collide_edge(s.center, v, t.c, t.a), false, space);
+      check_reference_add(r, point_collide_point(s.center, v, t.a), false, space);
+      check_reference_add(r, point_collide_point(s.center, v, t.b), false, space);
+      check_reference_add(r, point_collide_point(s.center, v, t.c), false, space);
+    } else {
+      if (!sphere_swept_intersects_plane(s, v, plane_new(t.a, t.norm))) { continue; }
+      collision face = sphere_collide_face(s, v, t);
+      check_reference_add(r, face, true, space);
+      if (face.collided) { continue; }
+      check_reference_add(r, sphere_collide_edge(s, v, t.a, t.b), false, space);
+      check_reference_add(r, sphere_collide_edge(s, v, t.b, t.c), false, space);
+      check_reference_add(r, sphere_collide_edge(s, v, t.c, t.a), false, space);
+      check_reference_add(r, sphere_collide_point(s, v, t.a), false, space);
+      check_reference_add(r, sphere_collide_point(s, v, t.b), false, space);
+      check_reference_add(r, sphere_collide_point(s, v, t.c), false, space);
+    }
+  }
+}
+
+static bool check_reference_normal(check_reference* r, collision c) {
+  for (int i = 0; i < r->contacts_num; i++) {
+    check_contact cc = r->contacts[i];
+    if (fabs(cc.time - c.time) <= CHECK_TIME &&
+        vec3_dot(cc.norm, c.norm) >= CHECK_NORMAL) { return true; }
+  }
+  return false;
+}
+
+/*
+** A point only touches an edge or vertex if it sweeps
+** exactly over it, so those contacts come and go with
+** rounding. For points a disagreement is let through if
+** no face contact comes before the one found, but only
+** for a small share of the hits so that wrong normals
+** on faces are still caught.
+*/
+#define CHECK_POINT_EDGES 0.1
+
+static bool check_point_faces(check_reference* r, collision c) {
+  float time = c.collided ? c.time : FLT_MAX;
+  for (int i = 0; i < r->contacts_num; i++) {
+    if (r->contacts[i].face && r->contacts[i].time < time - CHECK_TIME) { return false; }
+  }
+  return true;
+}
+
+static int check_mesh(char* name, cmesh* cm, char* world_name, mat4 world, float scale) {
+
+  mat3 world_normal = mat3_transpose(mat3_inverse(mat4_to_mat3(world)));
+  vec3 center = mat4_mul_vec3(world, cm->bound.center);
+  float radius = cm->bound.radius * scale;
+
+  check_reference r = { 0, 0, NULL, FLT_MAX };
+  int failures = 0;
+
+  for (int kind = 0; kind < 3; kind++) {
+
+    int hits = 0, edges = 0, fails = 0;
+
+    for (int i = 0; i < CHECK_QUERIES; i++) {
+
+      vec3 p = vec3_add(center, check_rand_vec3(-radius * 1.2, radius * 1.2));
+      vec3 target = vec3_add(center, check_rand_vec3(-radius * 0.5, radius * 0.5));
+      vec3 v = vec3_mul(vec3_sub(target, p), i % 3 == 0 ? 0.05 : 1.3);
+
+      /* Every other ellipsoid is round so it can stay a sphere in mesh space */
+      float size = radius * 0.04;
+      vec3 radiuses = i % 2 == 0 ?
+        vec3_new(size * 0.75, size * 2, size * 1.25) : vec3_new(size, size, size);
+
+      collision c;
+      sphere s = sphere_new(p, kind == CHECK_POINT ? 0 : size);
+      if (kind == CHECK_POINT)     { c = point_collide_mesh(p, v, cm, world, world_normal); }
+      if (kind == CHECK_SPHERE)    { c = sphere_collide_mesh(s, v, cm, world, world_normal); }
+      if (kind == CHECK_ELLIPSOID) { c = ellipsoid_collide_mesh(ellipsoid_new(p, radiuses), v, cm, world, world_normal); }
+
+      check_reference_sweep(&r, kind, cm, world, world_normal, s, radiuses, v);
+
+      bool agree = (c.collided == (r.contacts_num > 0));
+      if (agree && c.collided) {
+        agree = (fabs(c.time - r.time) <= CHECK_TIME) && check_reference_normal(&r, c);
+      }
+
+      hits += c.collided;
+
+      if (agree) { continue; }
+
+      if (kind == CHECK_POINT && check_point_faces(&r, c)) {
+        edges++;
+        continue;
+      }
+
+      if (fails++ < 4) {
+        printf("  %s %s %s sweep %i: hit %i time %g, reference hit %i time %g\n",
+          name, world_name, check_kinds[kind], i, c.collided, c.time, r.contacts_num > 0, r.time);
+      }
+    }
+
+    if (edges > hits * CHECK_POINT_EDGES) {
+      printf("  %s %s %s: %i edge contacts disagree, over %g of hits\n",
+        name, world_name, check_kinds[kind], edges, CHECK_POINT_EDGES);
+      fails++;
+    }
+
+    printf("check_collide: %-8s %-10s %-9s %i sweeps, %i hits, %i edge contacts, %i failures\n",
+      name, world_name, check_kinds[kind], CHECK_QUERIES, hits, edges, fails);
+
+    failures += fails;
+  }
+
+  free(r.contacts);
+
+  return failures;
+}
+
+int main(int argc, char** argv) {
+
+  cmesh* meshes[] = { check_terrain(24), check_sphere(12, 16, 3) };
+  char* mesh_names[] = { "terrain", "sphere" };
+
+  quat rotation = quat_from_euler(vec3_new(0.3, 1.1, -0.7));
+  mat4 worlds[] = {
+    mat4_world(vec3_new(1, -2, 3), vec3_new(1.5, 0.7, 2.2), rotation),
+    mat4_world(vec3_new(1, -2, 3), vec3_new(1.7, 1.7, 1.7), rotation),
+  };
+  float world_scales[] = { 2.2, 1.7 };
+  char* world_names[] = { "non-uniform", "uniform" };
+
+  int failures = 0;
+  for (int i = 0; i < 2; i++)
+  for (int j = 0; j < 2; j++) {
+    failures += check_mesh(mesh_names[i], meshes[i], world_names[j], worlds[j], world_scales[j]);
+  }
+
+  for (int i = 0; i < 2; i++) {
+    cmesh_delete(meshes[i]);
+  }
+
+  printf("check_collide: %i failures\n", failures);
+
+  return failures == 0 ? 0 : 1;
+}
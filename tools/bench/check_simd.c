@@ -0,0 +1,162 @@
+/**
+*** :: Check SIMD ::
+***
+***   Compares the SSE and scalar maths in cengine. This
+***   file is built twice, once with CORANGE_NO_SIMD, and
+***   the scalar build writes its results for the SSE
+***   build to read back and compare against.
+***
+***   check_simd -w reference
+***   check_simd -r reference
+***
+***   Products, transposes and world matrices must match
+***   bit for bit. Inverses round differently so they are
+***   checked by how far their product with the original
+***   is from the identity and how far they are from the
+***   scalar inverse.
+***
+**/
+
+#include "cengine.h"
+#include "check.h"
+
+#define CHECK_CASES 512
+#define CHECK_INVERSE_RESIDUAL 1e-4
+#define CHECK_INVERSE_DIFFERENCE 1e-4
+
+typedef struct {
+  mat4 mul_mat4;
+  vec4 mul_vec4;
+  mat4 transpose;
+  quat mul_quat;
+  mat4 world;
+  mat4 invertible;
+  mat4 inverse;
+} check_result;
+
+static quat check_rand_quat(void) {
+  return quat_normalize(quat_new(
+    check_rand(-1, 1), check_rand(-1, 1),
+    check_rand(-1, 1), check_rand(-1, 1)));
+}
+
+static mat4 check_rand_mat4(void) {
+  mat4 m;
+  float* f = (float*)&m;
+  for (int i = 0; i < 16; i++) { f[i] = check_rand(-10, 10); }
+  return m;
+}
+
+/* Worlds and diagonally heavy matrices keep the inverses well conditioned */
+static mat4 check_rand_invertible(int i) {
+  if (i % 2 == 0) {
+    return mat4_world(check_rand_vec3(-100, 100), check_rand_vec3(0.1, 10), check_rand_quat());
+  }
+  mat4 m = check_rand_mat4();
+  m.xx += 40; m.yy += 40; m.zz += 40; m.ww += 40;
+  return m;
+}
+
+static void check_results(check_result* results) {
+  for (int i = 0; i < CHECK_CASES; i++) {
+    mat4 m0 = check_rand_mat4();
+    mat4 m1 = check_rand_mat4();
+    vec4 v = vec4_new(check_rand(-10, 10), check_rand(-10, 10), check_rand(-10, 10), check_rand(-10, 10));
+    results[i].mul_mat4   = mat4_mul_mat4(m0, m1);
+    results[i].mul_vec4   = mat4_mul_vec4(m0, v);
+    results[i].transpose  = mat4_transpose(m1);
+    results[i].mul_quat   = quat_mul_quat(check_rand_quat(), check_rand_quat());
+    results[i].world      = mat4_world(check_rand_vec3(-100, 100), check_rand_vec3(0.1, 10), check_rand_quat());
+    results[i].invertible = check_rand_invertible(i);
+    results[i].inverse    = mat4_inverse(results[i].invertible);
+  }
+}
+
+static int check_exact(char* name, int index, void* result, void* reference, size_t size) {
+  if (memcmp(result, reference, size) == 0) { return 0; }
+  printf("%s differs from the scalar result in case %i\n", name, index);
+  return 1;
+}
+
+static float check_residual(mat4 m, mat4 inverse) {
+  mat4 p = mat4_mul_mat4(m, inverse);
+  mat4 id = mat4_id();
+  float* fp = (float*)&p;
+  float* fi = (float*)&id;
+  float residual = 0;
+  for (int i = 0; i < 16; i++) { residual = max(residual, fabs(fp[i] - fi[i])); }
+  return residual;
+}
+
+static float check_difference(mat4 m0, mat4 m1) {
+  float* f0 = (float*)&m0;
+  float* f1 = (float*)&m1;
+  float largest = 0, difference = 0;
+  for (int i = 0; i < 16; i++) {
+    largest = max(largest, fabs(f0[i]));
+    difference = max(difference, fabs(f0[i] - f1[i]));
+  }
+  return largest > 0 ? difference / largest : difference;
+}
+
+int main(int argc, char** argv) {
+
+  if (argc != 3 || (strcmp(argv[1], "-w") != 0 && strcmp(argv[1], "-r") != 0)) {
+    printf("Usage: check_simd -w|-r reference\n");
+    return 1;
+  }
+
+  check_result* results = malloc(sizeof(check_result) * CHECK_CASES);
+  check_results(results);
+
+  if (strcmp(argv[1], "-w") == 0) {
+    FILE* f = fopen(argv[2], "wb");
+    if (f == NULL) { printf("Could not open %s for writing\n", argv[2]); return 1; }
+    fwrite(results, sizeof(check_result), CHECK_CASES, f);
+    fclose(f);
+    free(results);
+    return 0;
+  }
+
+  check_result* reference = malloc(sizeof(check_result) * CHECK_CASES);
+  FILE* f = fopen(argv[2], "rb");
+  if (f == NULL || fread(reference, sizeof(check_result), CHECK_CASES, f) != CHECK_CASES) {
+    printf("Could not read %s\n", argv[2]);
+    return 1;
+  }
+  fclose(f);
+
+  int failures = 0;
+  float residual = 0, difference = 0;
+
+  for (int i = 0; i < CHECK_CASES; i++) {
+    check_result r = results[i], s = reference[i];
+    failures += check_exact("mat4_mul_mat4",  i, &r.mul_mat4,  &s.mul_mat4,  sizeof(mat4));
+    failures += check_exact("mat4_mul_vec4",  i, &r.mul_vec4,  &s.mul_vec4,  sizeof(vec4));
+    failures += check_exact("mat4_transpose", i, &r.transpose, &s.transpose, sizeof(mat4));
+    failures += check_exact("quat_mul_quat",  i, &r.mul_quat,  &s.mul_quat,  sizeof(quat));
+    failures += check_exact("mat4_world",     i, &r.world,     &s.world,     sizeof(mat4));
+    failures += check_exact("inverse input",  i, &r.invertible, &s.invertible, sizeof(mat4));
+    residual = max(residual, check_residual(s.invertible, r.inverse));
+    residual = max(residual, check_residual(s.invertible, s.inverse));
+    difference = max(difference, check_difference(s.inverse, r.inverse));
+  }
+
+  if (residual > CHECK_INVERSE_RESIDUAL) {
+    printf("mat4_inverse residual %g is over %g\n", residual, CHECK_INVERSE_RESIDUAL);
+    failures++;
+  }
+
+  if (difference > CHECK_INVERSE_DIFFERENCE) {
+    printf("mat4_inverse differs from the scalar result by %g, over %g\n", difference, CHECK_INVERSE_DIFFERENCE);
+    failures++;
+  }
+
+  printf("check_simd: %i cases, %i failures, inverse residual %g, difference %g\n",
+    CHECK_CASES, failures, residual, difference);
+
+  free(reference);
+  free(results);
+
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,224 @@
+/**
+*** :: Check Simplify ::
+***
+***   Simplifies an open terrain grid and a closed sphere
+***   with a texture seam down to a target triangle count
+***   and checks the result.
+***
+***   The count must reach the target, no triangle may be
+***   degenerate or flipped against the surface, and the
+***   open border of the grid must be kept edge for edge.
+***   The sphere must stay closed, which also covers the
+***   seam, whose verticies are split.
+***
+**/
+
+#include "cengine.h"
+#include "check.h"
+
+#define CHECK_AREA 1e-6
+
+static mesh* check_mesh(int num_verts, int num_triangles) {
+  mesh* m = mesh_new();
+  m->num_verts = num_verts;
+  m->num_triangles = num_triangles;
+  m->verticies = realloc(m->verticies, sizeof(vertex) * num_verts);
+  m->triangles = realloc(m->triangles, sizeof(uint32_t) * num_triangles * 3);
+  for (int i = 0; i < num_verts; i++) { m->verticies[i] = vertex_new(); }
+  return m;
+}
+
+/* A grid of quads over gently rolling ground with a little noise */
+static mesh* check_terrain(int size) {
+
+  mesh* m = check_mesh((size+1) * (size+1), size * size * 2);
+
+  for (int y = 0; y <= size; y++)
+  for (int x = 0; x <= size; x++) {
+    vertex* v = &m->verticies[y * (size+1) + x];
+    float height = sinf(x * 0.3) * cosf(y * 0.2) * 2 + check_rand(-0.05, 0.05);
+    v->position = vec3_new(x, height, y);
+    v->uvs = vec2_new((float)x / size, (float)y / size);
+  }
+
+  for (int y = 0; y < size; y++)
+  for (int x = 0; x < size; x++) {
+    uint32_t i0 = (y+0) * (size+1) + x, i1 = i0 + 1;
+    uint32_t i2 = (y+1) * (size+1) + x, i3 = i2 + 1;
+    uint32_t* t = &m->triangles[(y * size + x) * 6];
+    t[0] = i0; t[1] = i2; t[2] = i1;
+    t[3] = i1; t[4] = i2; t[5] = i3;
+  }
+
+  mesh_generate_normals(m);
+
+  return m;
+}
+
+/* Uv sphere, the first column is repeated at the end as the seam */
+static mesh* check_sphere(int rings, int segments) {
+
+  int columns = segments + 1;
+  mesh* m = check_mesh((rings+1) * columns, rings * segments * 2);
+
+  for (int r = 0; r <= rings; r++)
+  for (int s = 0; s <= segments; s++) {
+    float theta = M_PI * r / rings;
+    float phi = 2 * M_PI * (s % segments) / segments;
+    vertex* v = &m->verticies[r * columns + s];
+    v->position = vec3_new(sinf(theta) * cosf(phi), cosf(theta), sinf(theta) * sinf(phi));
+    if (r == 0 || r == rings) { v->position = vec3_new(0, r == 0 ? 1 : -1, 0); }
+    v->normal = v->position;
+    v->uvs = vec2_new((float)s / segments, (float)r / rings);
+  }
+
+  /* Triangles at the poles are degenerate so they are skipped */
+  int num_triangles = 0;
+  for (int r = 0; r < rings; r++)
+  for (int s = 0; s < segments; s++) {
+    uint32_t i0 = (r+0) * columns + s, i1 = i0 + 1;
+    uint32_t i2 = (r+1) * columns + s, i3 = i2 + 1;
+    uint32_t* t = &m->triangles[num_triangles * 3];
+    if (r != 0) { t[0] = i0; t[1] = i1; t[2] = i2; t += 3; num_triangles++; }
+    if (r != rings-1) { t[0] = i1; t[1] = i3; t[2] = i2; num_triangles++; }
+  }
+  m->num_triangles = num_triangles;
+
+  return m;
+}
+
+/* Index of the first vertex at the same position, so seams count as joined */
+static int* check_weld(mesh* m) {
+  int* weld = malloc(sizeof(int) * m->num_verts);
+  for (int i = 0; i < m->num_verts; i++) {
+    weld[i] = i;
+    for (int j = 0; j < i; j++) {
+      if (vec3_equ(m->verticies[i].position, m->verticies[j].position)) { weld[i] = j; break; }
+    }
+  }
+  return weld;
+}
+
+static int check_edge_cmp(const void* a, const void* b) {
+  const int* ea = a;
+  const int* eb = b;
+  if (ea[0] != eb[0]) { return (ea[0] > eb[0]) - (ea[0] < eb[0]); }
+  return (ea[1] > eb[1]) - (ea[1] < eb[1]);
+}
+
+/* Sorted welded edges used by only one triangle, returns how many */
+static int check_border(mesh* m, int* weld, int** border) {
+
+  int num_edges = m->num_triangles * 3;
+  int* edges = malloc(sizeof(int) * 2 * num_edges);
+  for (int i = 0; i < m->num_triangles; i++)
+  for (int j = 0; j < 3; j++) {
+    int a = weld[m->triangles[i*3+j]];
+    int b = weld[m->triangles[i*3+(j+1)%3]];
+    edges[(i*3+j)*2+0] = a < b ? a : b;
+    edges[(i*3+j)*2+1] = a < b ? b : a;
+  }
+
+  qsort(edges, num_edges, sizeof(int) * 2, check_edge_cmp);
+
+  int num_border = 0;
+  *border = malloc(sizeof(int) * 2 * num_edges);
+  for (int i = 0; i < num_edges; ) {
+    int j = i + 1;
+    while (j < num_edges && check_edge_cmp(&edges[i*2], &edges[j*2]) == 0) { j++; }
+    if (j - i == 1) {
+      (*border)[num_border*2+0] = edges[i*2+0];
+      (*border)[num_border*2+1] = edges[i*2+1];
+      num_border++;
+    }
+    i = j;
+  }
+
+  free(edges);
+  return num_border;
+}
+
+/* Degenerate or facing away from the direction the surface faces at that point */
+static int check_triangles(char* name, mesh* m, int* weld, bool sphere) {
+
+  int failures = 0;
+
+  for (int i = 0; i < m->num_triangles; i++) {
+
+    uint32_t* t = &m->triangles[i*3];
+    vec3 a = m->verticies[t[0]].position;
+    vec3 b = m->verticies[t[1]].position;
+    vec3 c = m->verticies[t[2]].position;
+    vec3 n = vec3_cross(vec3_sub(b, a), vec3_sub(c, a));
+    vec3 up = sphere ? vec3_add(vec3_add(a, b), c) : vec3_up();
+
+    if (weld[t[0]] == weld[t[1]] || weld[t[1]] == weld[t[2]] || weld[t[2]] == weld[t[0]] ||
+        vec3_length(n) / 2 < CHECK_AREA) {
+      printf("%s: triangle %i is degenerate\n", name, i);
+      failures++;
+    } else if (vec3_dot(n, up) <= 0) {
+      printf("%s: triangle %i is flipped\n", name, i);
+      failures++;
+    }
+  }
+
+  return failures;
+}
+
+static int check_simplify(char* name, mesh* m, int target, bool sphere) {
+
+  int* weld = check_weld(m);
+  int* border = NULL;
+  int num_border = check_border(m, weld, &border);
+  int num_triangles = m->num_triangles;
+
+  int failures = check_triangles(name, m, weld, sphere);
+  if (failures != 0) {
+    printf("%s: source mesh is bad\n", name);
+    return failures;
+  }
+
+  float error = mesh_simplify(m, target);
+
+  if (m->num_triangles > target) {
+    printf("%s: %i triangles left, over the target of %i\n", name, m->num_triangles, target);
+    failures++;
+  }
+
+  failures += check_triangles(name, m, weld, sphere);
+
+  int* simplified_border = NULL;
+  int num_simplified_border = check_border(m, weld, &simplified_border);
+
+  if (num_simplified_border != num_border ||
+      memcmp(border, simplified_border, sizeof(int) * 2 * num_border) != 0) {
+    printf("%s: border has %i edges, was %i\n", name, num_simplified_border, num_border);
+    failures++;
+  }
+
+  printf("check_simplify: %s, %i to %i triangles, target %i, %i border edges, error %g\n",
+    name, num_triangles, m->num_triangles, target, num_border, error);
+
+  free(simplified_border);
+  free(border);
+  free(weld);
+
+  return failures;
+}
+
+int main(int argc, char** argv) {
+
+  int failures = 0;
+
+  mesh* terrain = check_terrain(32);
+  failures += check_simplify("terrain", terrain, 400, false);
+  mesh_delete(terrain);
+
+  mesh* sphere = check_sphere(24, 32);
+  failures += check_simplify("sphere", sphere, 200, true);
+  mesh_delete(sphere);
+
+  printf("check_simplify: %i failures\n", failures);
+
+  return failures == 0 ? 0 : 1;
+}
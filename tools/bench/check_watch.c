@@ -0,0 +1,204 @@
+/**
+*** :: Check Watch ::
+***
+***   Writes a folder of text assets and lists of them,
+***   where lists load their entries as dependencies, and
+***   watches it. Changing one text asset must reload it
+***   and the lists depending on it, directly or through
+***   another list, and nothing else.
+***
+***   Writing a file which isn't loaded must not reload
+***   anything or give it a slot.
+***
+***   check_watch
+***
+**/
+
+#include "corange.h"
+
+#ifdef __linux__
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define CHECK_FOLDER "./check_watch_files"
+#define CHECK_POLLS 100
+
+typedef struct {
+  char text[64];
+} check_text;
+
+typedef struct {
+  int num_items;
+  asset_hndl items[4];
+} check_list;
+
+static char* check_files[] = {
+  "leaf.txt", "other.txt", "scratch.txt",
+  "pair.lst", "top.lst", "other.lst"
+};
+
+static int check_loads[6];
+
+static int check_file(const char* filename) {
+  const char* name = strrchr(filename, '/') + 1;
+  for(int i = 0; i < 6; i++) {
+    if (strcmp(check_files[i], name) == 0) { return i; }
+  }
+  return -1;
+}
+
+static void check_write(const char* name, const char* contents) {
+  char path[256];
+  snprintf(path, sizeof(path), "%s/%s", CHECK_FOLDER, name);
+  FILE* f = fopen(path, "w");
+  if (f == NULL) {
+    printf("check_watch: could not write %s\n", path);
+    exit(1);
+  }
+  fputs(contents, f);
+  fclose(f);
+}
+
+static check_text* check_text_load(const char* filename) {
+
+  check_loads[check_file(filename)]++;
+
+  check_text* t = calloc(1, sizeof(check_text));
+  SDL_RWops* file = SDL_RWFromFile(filename, "r");
+  SDL_RWread(file, t->text, 1, sizeof(t->text) - 1);
+  SDL_RWclose(file);
+
+  return t;
+}
+
+static check_list* check_list_load(const char* filename) {
+
+  check_loads[check_file(filename)]++;
+
+  check_list* l = calloc(1, sizeof(check_list));
+  SDL_RWops* file = SDL_RWFromFile(filename, "r");
+
+  char line[256];
+  while (l->num_items < 4 && SDL_RWreadline(file, line, sizeof(line)) > 0) {
+    line[strcspn(line, "\r\n")] = '\0';
+    if (line[0] == '\0') { continue; }
+    l->items[l->num_items++] = asset_hndl_new_load(P(line));
+  }
+
+  SDL_RWclose(file);
+
+  return l;
+}
+
+static void check_delete(void* a) {
+  free(a);
+}
+
+#ifdef __linux__
+
+static int check_poll(void) {
+  for(int i = 0; i < CHECK_POLLS; i++) {
+    int reloaded = asset_watch_update();
+    if (reloaded) { return reloaded; }
+    SDL_Delay(10);
+  }
+  return 0;
+}
+
+static int check_reloads(char* change, int* before, bool* expected) {
+
+  int failures = 0;
+
+  for(int i = 0; i < 6; i++) {
+    int reloads = check_loads[i] - before[i];
+    if (reloads != (expected[i] ? 1 : 0)) {
+      printf("check_watch: after changing %s, %s reloaded %i times\n", change, check_files[i], reloads);
+      failures++;
+    }
+  }
+
+  return failures;
+}
+
+int main(int argc, char** argv) {
+
+  SDL_Init(SDL_INIT_TIMER);
+  asset_init();
+  asset_handler(check_text, "txt", check_text_load, check_delete);
+  asset_handler(check_list, "lst", check_list_load, check_delete);
+
+  mkdir(CHECK_FOLDER, 0755);
+  check_write("leaf.txt", "leaf");
+  check_write("other.txt", "other");
+  check_write("pair.lst", CHECK_FOLDER "/leaf.txt\n");
+  check_write("top.lst", CHECK_FOLDER "/pair.lst\n" CHECK_FOLDER "/other.txt\n");
+  check_write("other.lst", CHECK_FOLDER "/other.txt\n");
+
+  asset_watch(P(CHECK_FOLDER));
+  file_load(P(CHECK_FOLDER "/top.lst"));
+  file_load(P(CHECK_FOLDER "/other.lst"));
+
+  int failures = 0;
+  int before[6];
+
+  /* Changing the leaf reloads it, the pair using it, and the top using the pair */
+  memcpy(before, check_loads, sizeof(before));
+  check_write("leaf.txt", "changed");
+
+  int reloaded = check_poll();
+  printf("check_watch: leaf.txt changed, %i reloaded\n", reloaded);
+  if (reloaded != 1) {
+    printf("check_watch: expected 1 changed asset, got %i\n", reloaded);
+    failures++;
+  }
+
+  bool leaf_expected[6] = { true, false, false, true, true, false };
+  failures += check_reloads("leaf.txt", before, leaf_expected);
+
+  check_list* top = asset_get(P(CHECK_FOLDER "/top.lst"));
+  check_list* pair = asset_hndl_ptr(&top->items[0]);
+  check_text* leaf = asset_hndl_ptr(&pair->items[0]);
+  if (strcmp(leaf->text, "changed") != 0) {
+    printf("check_watch: leaf.txt reads '%s' through top.lst\n", leaf->text);
+    failures++;
+  }
+
+  /* Files which were never loaded are ignored */
+  memcpy(before, check_loads, sizeof(before));
+  check_write("scratch.txt", "scratch");
+
+  SDL_Delay(10);
+  reloaded = asset_watch_update();
+  printf("check_watch: scratch.txt written, %i reloaded\n", reloaded);
+  if (reloaded != 0 || file_isloaded(P(CHECK_FOLDER "/scratch.txt"))) {
+    printf("check_watch: scratch.txt was loaded\n");
+    failures++;
+  }
+
+  bool scratch_expected[6] = { false, false, false, false, false, false };
+  failures += check_reloads("scratch.txt", before, scratch_expected);
+
+  asset_finish();
+  SDL_Quit();
+
+  for(int i = 0; i < 6; i++) {
+    char path[256];
+    snprintf(path, sizeof(path), "%s/%s", CHECK_FOLDER, check_files[i]);
+    remove(path);
+  }
+  rmdir(CHECK_FOLDER);
+
+  printf("check_watch: %i failures\n", failures);
+
+  return failures != 0;
+}
+
+#else
+
+int main(int argc, char** argv) {
+  printf("check_watch: folder watching is only supported on Linux\n");
+  return 0;
+}
+
+#endif
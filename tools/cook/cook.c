@@ -0,0 +1,559 @@
+/**
+*** :: Cook ::
+***
+***   Offline asset cooker. Walks asset folders and
+***   converts meshes (obj, smd, ply) into version 2 bmf
+***   files, collision meshes (col) into prebuilt cmf
+***   trees, skeletons (skl) into bskl files and
+***   animations (ani) into compressed bani files, all
+***   written next to the source files.
+***
+***   Files are cooked on a pool of worker threads. Each
+***   folder keeps a manifest of input content hashes so
+***   unchanged inputs are skipped on the next run.
+***
+***   cook [-j threads] [-l lods] [-e error] [-f] [-r report] folder...
+***
+***     -j  Number of worker threads
+***     -l  Levels of detail to generate for each mesh
+***     -e  Error allowed when compressing animations
+***     -f  Cook everything, ignoring the manifests
+***     -r  Write a report of timings, .csv or .json
+***
+**/
+
+#include "corange.h"
+
+#ifdef __unix__
+  #include <unistd.h>
+#endif
+
+#define COOK_VERSION 2
+#define COOK_MANIFEST "cook.manifest"
+#define COOK_MAX_WORKERS 64
+
+enum {
+  COOK_MESH,
+  COOK_COLLISION,
+  COOK_SKELETON,
+  COOK_ANIMATION
+};
+
+enum {
+  COOK_PENDING,
+  COOK_COOKED,
+  COOK_SKIPPED,
+  COOK_FAILED
+};
+
+static const char* cook_status_names[] = {
+  "pending", "cooked", "skipped", "failed"
+};
+
+typedef struct {
+  fpath input;
+  fpath output;
+  fpath material;
+  int type;
+  int folder;
+  uint64_t previous;
+  uint64_t hash;
+  int status;
+  double time;
+  size_t bytes_in;
+  size_t bytes_out;
+} cook_job;
+
+static cook_job* cook_jobs = NULL;
+static int num_cook_jobs = 0;
+static int max_cook_jobs = 0;
+static int cook_jobs_next = 0;
+static SDL_mutex* cook_jobs_lock = NULL;
+
+static int cook_lods = RENDERABLE_MAX_LODS;
+static float cook_tolerance = ANIMATION_ROTATION_ERROR;
+static bool cook_force = false;
+
+/*
+** Manifest hashes of every folder, looked up by input
+** path. The dict stores an index into the hash array
+** plus one so that a missing entry reads as zero.
+*/
+
+static dict* cook_manifest = NULL;
+static uint64_t* cook_manifest_hashes = NULL;
+static int num_cook_manifest_hashes = 0;
+
+/* Set by any error reported on a worker while it cooks a file */
+static __thread bool cook_errored = false;
+
+static double cook_clock(void) {
+#ifdef __unix__
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec / 1e9;
+#else
+  return SDL_GetTicks() / 1000.0;
+#endif
+}
+
+static void cook_error(const char* str) {
+  fprintf(stderr, "%s\n", str); fflush(stderr);
+  cook_errored = true;
+}
+
+static void cook_warning(const char* str) {
+  fprintf(stdout, "%s\n", str); fflush(stdout);
+}
+
+static size_t cook_file_size(char* filename) {
+  SDL_RWops* file = SDL_RWFromFile(filename, "rb");
+  if (file == NULL) { return 0; }
+  int size = 0;
+  SDL_RWsize(file, &size);
+  SDL_RWclose(file);
+  return size;
+}
+
+static uint64_t cook_hash_bytes(uint64_t h, const void* data, size_t size) {
+
+  /* FNV-1a */
+  const unsigned char* p = data;
+  for(size_t i = 0; i < size; i++) {
+    h ^= p[i];
+    h *= 1099511628211ull;
+  }
+
+  return h;
+}
+
+/*
+** The hash covers the settings an output was cooked with
+** as well as the input contents, so changing the number
+** of lods or adding a material also cooks again.
+*/
+static uint64_t cook_hash_file(cook_job* job) {
+
+  char settings[MAX_PATH + 64];
+  snprintf(settings, sizeof(settings), "%i %i %i %f %s", COOK_VERSION, job->type, cook_lods, cook_tolerance, job->material.ptr);
+
+  uint64_t h = 14695981039346656037ull;
+  h = cook_hash_bytes(h, settings, strlen(settings));
+
+  SDL_RWops* file = SDL_RWFromFile(job->input.ptr, "rb");
+  if (file == NULL) { return h; }
+
+  char buffer[65536];
+  size_t read = 0;
+  job->bytes_in = 0;
+  while ((read = SDL_RWread(file, buffer, 1, sizeof(buffer))) > 0) {
+    h = cook_hash_bytes(h, buffer, read);
+    job->bytes_in += read;
+  }
+
+  SDL_RWclose(file);
+
+  return h;
+}
+
+static void cook_job_run(cook_job* job) {
+
+  double start = cook_clock();
+  cook_errored = false;
+
+  job->hash = cook_hash_file(job);
+
+  if (!cook_force && job->hash == job->previous && SDL_PathIsFile(job->output.ptr)) {
+    job->status = COOK_SKIPPED;
+  } else {
+
+    bool cooked = false;
+    if (job->type == COOK_MESH) {
+      cooked = bmf_cook_file(job->input.ptr, job->output.ptr, job->material.ptr, cook_lods);
+    } else if (job->type == COOK_COLLISION) {
+      cooked = col_cook_file(job->input.ptr, job->output.ptr);
+    } else if (job->type == COOK_SKELETON) {
+      cooked = skl_cook_file(job->input.ptr, job->output.ptr);
+    } else {
+      cooked = ani_cook_file(job->input.ptr, job->output.ptr, cook_tolerance, cook_tolerance);
+    }
+
+    job->status = (cooked && !cook_errored) ? COOK_COOKED : COOK_FAILED;
+  }
+
+  job->bytes_out = cook_file_size(job->output.ptr);
+  job->time = cook_clock() - start;
+
+  printf("%-7s %8.1f ms  %s\n", cook_status_names[job->status], job->time * 1000, job->input.ptr);
+  fflush(stdout);
+}
+
+/*
+** Jobs are all queued before the workers start and the
+** array isn't touched again until they have finished, so
+** the lock only needs to guard the next job index.
+*/
+static int cook_worker(void* unused) {
+
+  while (true) {
+
+    SDL_LockMutex(cook_jobs_lock);
+    int i = cook_jobs_next++;
+    SDL_UnlockMutex(cook_jobs_lock);
+
+    if (i >= num_cook_jobs) { break; }
+
+    cook_job_run(&cook_jobs[i]);
+  }
+
+  return 0;
+}
+
+static void cook_manifest_load(fpath folder) {
+
+  fpath filename = folder;
+  strcat(filename.ptr, "/" COOK_MANIFEST);
+
+  SDL_RWops* file = SDL_RWFromFileBuffered(filename.ptr, "r");
+  if (file == NULL) { return; }
+
+  char line[MAX_PATH + 64];
+  while (SDL_RWreadline(file, line, sizeof(line))) {
+
+    unsigned long long hash;
+    char name[MAX_PATH + 64];
+    if (sscanf(line, "%llx %[^\r\n]", &hash, name) != 2) { continue; }
+
+    fpath input = folder;
+    strcat(input.ptr, "/");
+    strcat(input.ptr, name);
+
+    num_cook_manifest_hashes++;
+    cook_manifest_hashes = realloc(cook_manifest_hashes, sizeof(uint64_t) * num_cook_manifest_hashes);
+    cook_manifest_hashes[num_cook_manifest_hashes-1] = hash;
+    dict_set(cook_manifest, input.ptr, (void*)(intptr_t)num_cook_manifest_hashes);
+  }
+
+  SDL_RWclose(file);
+}
+
+static void cook_manifest_save(fpath folder, int folder_id) {
+
+  fpath filename = folder;
+  strcat(filename.ptr, "/" COOK_MANIFEST);
+
+  SDL_RWops* file = SDL_RWFromFile(filename.ptr, "w");
+  if (file == NULL) {
+    error("Could not write manifest '%s'", filename.ptr);
+    return;
+  }
+
+  int prefix = strlen(folder.ptr) + 1;
+
+  for(int i = 0; i < num_cook_jobs; i++) {
+    cook_job* job = &cook_jobs[i];
+    if (job->folder != folder_id) { continue; }
+    if (job->status != COOK_COOKED && job->status != COOK_SKIPPED) { continue; }
+
+    char line[MAX_PATH + 64];
+    snprintf(line, sizeof(line), "%016llx %s\n", (unsigned long long)job->hash, job->input.ptr + prefix);
+    SDL_RWwrite(file, line, strlen(line), 1);
+  }
+
+  SDL_RWclose(file);
+}
+
+static void cook_job_add(fpath input, int folder_id) {
+
+  fpath ext, location, name;
+  SDL_PathFileExtension(ext.ptr, input.ptr);
+  SDL_PathFileLocation(location.ptr, input.ptr);
+  SDL_PathFileName(name.ptr, input.ptr);
+
+  cook_job job;
+  memset(&job, 0, sizeof(cook_job));
+  job.input = input;
+  job.folder = folder_id;
+  job.status = COOK_PENDING;
+
+  job.output = location;
+  strcat(job.output.ptr, name.ptr);
+
+  if ((strcmp(ext.ptr, "obj") == 0) ||
+      (strcmp(ext.ptr, "smd") == 0) ||
+      (strcmp(ext.ptr, "ply") == 0)) {
+
+    job.type = COOK_MESH;
+    strcat(job.output.ptr, ".bmf");
+
+    /* Material path is stored the same way bmf_save_file does */
+    fpath mat_file = location;
+    strcat(mat_file.ptr, name.ptr);
+    strcat(mat_file.ptr, ".mat");
+
+    if (SDL_PathIsFile(mat_file.ptr)) {
+      fpath full;
+      SDL_PathFullName(full.ptr, mat_file.ptr);
+      SDL_PathRelative(job.material.ptr, full.ptr);
+      SDL_PathForwardSlashes(job.material.ptr);
+    } else {
+      strcpy(job.material.ptr, "$CORANGE/shaders/basic.mat");
+    }
+
+  } else if (strcmp(ext.ptr, "col") == 0) {
+
+    job.type = COOK_COLLISION;
+    strcat(job.output.ptr, ".cmf");
+
+  } else if (strcmp(ext.ptr, "skl") == 0) {
+
+    job.type = COOK_SKELETON;
+    strcat(job.output.ptr, ".bskl");
+
+  } else if (strcmp(ext.ptr, "ani") == 0) {
+
+    job.type = COOK_ANIMATION;
+    strcat(job.output.ptr, ".bani");
+
+  } else {
+    return;
+  }
+
+  intptr_t entry = (intptr_t)dict_get(cook_manifest, input.ptr);
+  job.previous = entry ? cook_manifest_hashes[entry-1] : 0;
+
+  /* Size is only an estimate of cost used for ordering */
+  job.bytes_in = cook_file_size(input.ptr);
+
+  if (num_cook_jobs == max_cook_jobs) {
+    max_cook_jobs = max_cook_jobs == 0 ? 64 : max_cook_jobs * 2;
+    cook_jobs = realloc(cook_jobs, sizeof(cook_job) * max_cook_jobs);
+  }
+
+  cook_jobs[num_cook_jobs++] = job;
+}
+
+static void cook_folder_walk(fpath folder, int folder_id) {
+
+  DIR* dir = opendir(folder.ptr);
+  if (dir == NULL) {
+    error("Could not open directory '%s' to cook.", folder.ptr);
+    return;
+  }
+
+  struct dirent* ent;
+  while ((ent = readdir(dir)) != NULL) {
+
+    if ((strcmp(ent->d_name, ".") == 0) ||
+        (strcmp(ent->d_name, "..") == 0)) { continue; }
+
+    fpath filename = folder;
+    strcat(filename.ptr, "/");
+    strcat(filename.ptr, ent->d_name);
+
+    if (SDL_PathIsDirectory(filename.ptr)) {
+      cook_folder_walk(filename, folder_id);
+    } else {
+      cook_job_add(filename, folder_id);
+    }
+  }
+
+  closedir(dir);
+}
+
+/* Biggest inputs first so that no worker is left with a big one at the end */
+static int cook_compare_size(const void* a, const void* b) {
+  size_t sa = ((const cook_job*)a)->bytes_in;
+  size_t sb = ((const cook_job*)b)->bytes_in;
+  return (sa < sb) - (sa > sb);
+}
+
+static int cook_compare_time(const void* a, const void* b) {
+  double ta = ((const cook_job*)a)->time;
+  double tb = ((const cook_job*)b)->time;
+  return (ta < tb) - (ta > tb);
+}
+
+static void cook_report_write(SDL_RWops* file, const char* fmt, ...) {
+  char line[MAX_PATH * 2 + 512];
+  va_list args;
+  va_start(args, fmt);
+  vsnprintf(line, sizeof(line), fmt, args);
+  va_end(args);
+  SDL_RWwrite(file, line, strlen(line), 1);
+}
+
+static void cook_report_escape(char* dst, const char* src) {
+  while (*src) {
+    if (*src == '"' || *src == '\\') { *dst++ = '\\'; }
+    *dst++ = *src++;
+  }
+  *dst = '\0';
+}
+
+/* CSV fields are quoted, so quotes inside them are doubled */
+static void cook_report_escape_csv(char* dst, const char* src) {
+  while (*src) {
+    if (*src == '"') { *dst++ = '"'; }
+    *dst++ = *src++;
+  }
+  *dst = '\0';
+}
+
+static void cook_report(char* filename, int workers, double wall_time) {
+
+  fpath ext;
+  SDL_PathFileExtension(ext.ptr, filename);
+  bool json = (strcmp(ext.ptr, "json") == 0);
+
+  SDL_RWops* file = SDL_RWFromFile(filename, "w");
+  if (file == NULL) {
+    error("Cannot write report to %s", filename);
+    return;
+  }
+
+  /* Most expensive first */
+  qsort(cook_jobs, num_cook_jobs, sizeof(cook_job), cook_compare_time);
+
+  char input[MAX_PATH * 2];
+  char output[MAX_PATH * 2];
+
+  if (json) {
+
+    cook_report_write(file, "{\n  \"workers\": %i,\n  \"lods\": %i,\n  \"time_ms\": %.3f,\n  \"files\": [\n",
+      workers, cook_lods, wall_time * 1000);
+
+    for(int i = 0; i < num_cook_jobs; i++) {
+      cook_job* job = &cook_jobs[i];
+      cook_report_escape(input, job->input.ptr);
+      cook_report_escape(output, job->output.ptr);
+      cook_report_write(file,
+        "    { \"input\": \"%s\", \"output\": \"%s\", \"status\": \"%s\", \"time_ms\": %.3f, "
+        "\"bytes_in\": %lu, \"bytes_out\": %lu }%s\n",
+        input, output, cook_status_names[job->status], job->time * 1000,
+        (unsigned long)job->bytes_in, (unsigned long)job->bytes_out,
+        i == num_cook_jobs-1 ? "" : ",");
+    }
+
+    cook_report_write(file, "  ]\n}\n");
+
+  } else {
+
+    cook_report_write(file, "input,output,status,time_ms,bytes_in,bytes_out\n");
+
+    for(int i = 0; i < num_cook_jobs; i++) {
+      cook_job* job = &cook_jobs[i];
+      cook_report_escape_csv(input, job->input.ptr);
+      cook_report_escape_csv(output, job->output.ptr);
+      cook_report_write(file, "\"%s\",\"%s\",%s,%.3f,%lu,%lu\n",
+        input, output, cook_status_names[job->status], job->time * 1000,
+        (unsigned long)job->bytes_in, (unsigned long)job->bytes_out);
+    }
+  }
+
+  SDL_RWclose(file);
+}
+
+static void cook_usage(void) {
+  printf("Usage: cook [-j threads] [-l lods] [-e error] [-f] [-r report.csv|report.json] folder...\n");
+}
+
+int main(int argc, char **argv) {
+
+  at_error(cook_error);
+  at_warning(cook_warning);
+
+#ifdef __unix__
+  int workers = sysconf(_SC_NPROCESSORS_ONLN);
+#else
+  int workers = 4;
+#endif
+
+  char* report = NULL;
+
+  int num_folders = 0;
+  fpath* folders = malloc(sizeof(fpath) * argc);
+
+  for(int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-j") == 0 && i+1 < argc) {
+      workers = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-l") == 0 && i+1 < argc) {
+      cook_lods = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-e") == 0 && i+1 < argc) {
+      cook_tolerance = atof(argv[++i]);
+    } else if (strcmp(argv[i], "-r") == 0 && i+1 < argc) {
+      report = argv[++i];
+    } else if (strcmp(argv[i], "-f") == 0) {
+      cook_force = true;
+    } else if (argv[i][0] == '-') {
+      cook_usage();
+      return EXIT_FAILURE;
+    } else {
+      fpath folder = P(argv[i]);
+      int len = strlen(folder.ptr);
+      while (len > 1 && folder.ptr[len-1] == '/') { folder.ptr[--len] = '\0'; }
+      folders[num_folders++] = folder;
+    }
+  }
+
+  if (num_folders == 0) {
+    cook_usage();
+    return EXIT_FAILURE;
+  }
+
+  workers = clamp(workers, 1, COOK_MAX_WORKERS);
+  cook_lods = clamp(cook_lods, 0, RENDERABLE_MAX_LODS);
+
+  double start = cook_clock();
+
+  cook_manifest = dict_new(1024);
+
+  for(int i = 0; i < num_folders; i++) {
+    cook_manifest_load(folders[i]);
+    cook_folder_walk(folders[i], i);
+  }
+
+  qsort(cook_jobs, num_cook_jobs, sizeof(cook_job), cook_compare_size);
+
+  cook_jobs_lock = SDL_CreateMutex();
+
+  SDL_Thread* threads[COOK_MAX_WORKERS];
+  for(int i = 0; i < workers; i++) {
+    threads[i] = SDL_CreateThread(cook_worker, NULL);
+    if (threads[i] == NULL) {
+      error("Could not create cook worker thread: %s", SDL_GetError());
+    }
+  }
+
+  for(int i = 0; i < workers; i++) {
+    if (threads[i] != NULL) { SDL_WaitThread(threads[i], NULL); }
+  }
+
+  SDL_DestroyMutex(cook_jobs_lock);
+
+  for(int i = 0; i < num_folders; i++) {
+    cook_manifest_save(folders[i], i);
+  }
+
+  double wall_time = cook_clock() - start;
+
+  int counts[4] = {0, 0, 0, 0};
+  double work_time = 0;
+  for(int i = 0; i < num_cook_jobs; i++) {
+    counts[cook_jobs[i].status]++;
+    work_time += cook_jobs[i].time;
+  }
+
+  printf("Cooked %i, skipped %i, failed %i of %i files in %.3f s on %i threads (%.3f s of work)\n",
+    counts[COOK_COOKED], counts[COOK_SKIPPED], counts[COOK_FAILED], num_cook_jobs,
+    wall_time, workers, work_time);
+
+  if (report) { cook_report(report, workers, wall_time); }
+
+  dict_delete(cook_manifest);
+  free(cook_manifest_hashes);
+  free(cook_jobs);
+  free(folders);
+
+  return counts[COOK_FAILED] > 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}